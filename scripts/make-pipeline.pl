@@ -383,6 +383,7 @@ ifdef NKMERS
 endif
 ifdef NTHREADS
   CTX_ARGS:=$(CTX_ARGS) -t $(NTHREADS)
+  LINK_THREAD_ARGS=-t $(NTHREADS)
 endif
 
 #
@@ -767,7 +768,7 @@ for my $k (@kmers) {
 
   print "$ctp_clean_file: $ctp_raw_file $ctp_thresh_file\n";
   print "\tTHRESH=`tail -1 $proj/k$k/links/\$*.thresh.txt | grep -oE '[0-9]+\$\$'`; \\\n";
-  print "$ctx links -c \"\$\$THRESH\" -o \$@ \$< >& \$@.log\n\n";
+  print "$ctx links \$(LINK_THREAD_ARGS) -c \"\$\$THRESH\" -o \$@ \$< >& \$@.log\n\n";
 }
 
 # Assemble contigs
@@ -75,15 +75,30 @@ void asyncio_task_parse(AsyncIOInput *task, char shortopt, char *path_arg,
 
   AsyncIOInput tmp = {.file1 = sf1, .file2 = sf2,
                       .fq_offset = fq_offset, .interleaved = il,
-                      .ptr = NULL};
+                      .ptr = NULL, .hts = NULL};
   memcpy(task, &tmp, sizeof(AsyncIOInput));
 }
 
+void asyncio_task_set_hts(AsyncIOInput *task, const HtsReadOpts *opts)
+{
+  const char *path = task->file1->path, *ext = strrchr(path, '.');
+  bool is_cram = (ext != NULL && strcmp(ext, ".cram") == 0);
+
+  if(!seq_is_sam(task->file1) && !seq_is_bam(task->file1) && !is_cram) return;
+  if(task->file2 != NULL)
+    die("SAM/BAM/CRAM options cannot be used with --seq2: %s", path);
+
+  if(task->hts != NULL) hts_read_opts_free(task->hts);
+  task->hts = hts_read_opts_copy(opts);
+}
+
 void asyncio_task_close(AsyncIOInput *task)
 {
   if(task->file1 != NULL) seq_close(task->file1);
   if(task->file2 != NULL) seq_close(task->file2);
+  if(task->hts != NULL) hts_read_opts_free(task->hts);
   task->file1 = task->file2 = NULL;
+  task->hts = NULL;
 }
 
 void asynciodata_alloc(AsyncIOData *iod)
@@ -151,7 +166,12 @@ static void* async_io_reader(void *ptr)
   seq_read_alloc(&r1);
   seq_read_alloc(&r2);
 
-  if(task->interleaved)
+  if(task->hts != NULL)
+  {
+    hts_parse_reads(task->file1->path, task->hts, task->interleaved,
+                    task->fq_offset, &r1, &r2, add_to_pool, wrkr);
+  }
+  else if(task->interleaved)
   {
     seq_parse_interleaved_sf(task->file1, task->fq_offset,
                              &r1, &r2, add_to_pool, wrkr);
@@ -5,6 +5,7 @@
 #include "msg-pool/msgpool.h"
 
 #include "seq_loading_stats.h"
+#include "hts_reader.h"
 
 // Rename async_read_io.h -> async_read.h
 // AsyncIOInput->AsyncReadFiles AsyncIOData->AsyncReadData
@@ -15,6 +16,7 @@ typedef struct
   void *ptr; // general porpoise pointer for this file is passed into AsyncIOData
   const uint8_t fq_offset;
   const bool interleaved; // if file1 is an interleaved PE file
+  HtsReadOpts *hts; // if not NULL, read file1 with htslib (SAM/BAM/CRAM)
 } AsyncIOInput;
 
 typedef struct
@@ -38,6 +40,10 @@ typedef struct
 void asyncio_task_parse(AsyncIOInput *task, char shortopt, char *path_arg,
                         uint8_t fq_offset, char **out_base);
 
+// Read file1 directly with htslib using a copy of `opts`
+// Only SAM/BAM/CRAM files are affected. Not supported with --seq2 inputs
+void asyncio_task_set_hts(AsyncIOInput *task, const HtsReadOpts *opts);
+
 void asyncio_task_close(AsyncIOInput *task);
 
 void asynciodata_alloc(AsyncIOData *iod);
@@ -0,0 +1,138 @@
+#include "global.h"
+#include "chunk_writer.h"
+
+// Compress `in` into a single gzip member stored in `out`
+static void _chunk_gzip(const StrBuf *in, StrBuf *out, const char *path)
+{
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+
+  // windowBits 15+16 => write gzip header and trailer
+  if(deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15+16, 8,
+                  Z_DEFAULT_STRATEGY) != Z_OK) {
+    die("Cannot start gzip compression [%s]", path);
+  }
+
+  size_t bound = deflateBound(&strm, in->end);
+  strbuf_ensure_capacity(out, bound);
+
+  strm.next_in = (Bytef*)in->b;
+  strm.avail_in = in->end;
+  strm.next_out = (Bytef*)out->b;
+  strm.avail_out = bound;
+
+  if(deflate(&strm, Z_FINISH) != Z_STREAM_END)
+    die("gzip compression failed [%s]", path);
+
+  out->end = bound - strm.avail_out;
+  deflateEnd(&strm);
+}
+
+static void* chunk_writer_thread(void *arg)
+{
+  ChunkWriter *cw = (ChunkWriter*)arg;
+  StrBuf *sbuf;
+  int pos;
+
+  while((pos = msgpool_claim_read(&cw->pool)) != -1)
+  {
+    memcpy(&sbuf, msgpool_get_ptr(&cw->pool, pos), sizeof(StrBuf*));
+    if(fwrite(sbuf->b, 1, sbuf->end, cw->fout) != sbuf->end)
+      die("Cannot write to file: %s [%s]", cw->path, strerror(errno));
+    cw->num_chunks++;
+    cw->num_bytes += sbuf->end;
+    strbuf_reset(sbuf);
+    msgpool_release(&cw->pool, pos, MPOOL_EMPTY);
+  }
+
+  return NULL;
+}
+
+static void _pool_init(void *el, size_t idx, void *arg)
+{
+  StrBuf *bufs = (StrBuf*)arg;
+  StrBuf *ptr = &bufs[idx];
+  memcpy(el, &ptr, sizeof(StrBuf*));
+}
+
+size_t chunk_writer_fit(size_t mem, size_t *nthreads)
+{
+  ctx_assert(*nthreads > 0);
+  while(*nthreads > 1 &&
+        chunk_writer_mem(*nthreads, CHUNK_WRITER_MIN_SIZE) > mem) {
+    (*nthreads)--;
+  }
+  size_t chunk_size = mem / chunk_writer_mem(*nthreads, 1);
+  return MAX2(MIN2(chunk_size, CHUNK_WRITER_SIZE), CHUNK_WRITER_MIN_SIZE);
+}
+
+void chunk_writer_alloc(ChunkWriter *cw, FILE *fout, const char *path,
+                        size_t nthreads, size_t chunk_size, bool gzip)
+{
+  ctx_assert(chunk_size > 0);
+  size_t i, npool = nthreads * CHUNK_WRITER_POOL;
+  int rc;
+
+  memset(cw, 0, sizeof(ChunkWriter));
+  cw->fout = fout;
+  cw->path = path;
+  cw->gzip = gzip;
+  cw->nthreads = nthreads;
+  cw->chunk_size = chunk_size;
+  cw->bufs = ctx_calloc(nthreads, sizeof(StrBuf));
+  cw->zbufs = gzip ? ctx_calloc(nthreads, sizeof(StrBuf)) : NULL;
+  cw->pool_bufs = ctx_calloc(npool, sizeof(StrBuf));
+
+  // Allocate a little over the chunk size so we don't resize on the last record
+  for(i = 0; i < nthreads; i++) strbuf_alloc(&cw->bufs[i], chunk_size+1024);
+  for(i = 0; gzip && i < nthreads; i++) strbuf_alloc(&cw->zbufs[i], 1024);
+  for(i = 0; i < npool; i++) strbuf_alloc(&cw->pool_bufs[i], 1024);
+
+  msgpool_alloc(&cw->pool, npool, sizeof(StrBuf*), USE_MSG_POOL);
+  msgpool_iterate(&cw->pool, _pool_init, cw->pool_bufs);
+
+  rc = pthread_create(&cw->writer, NULL, chunk_writer_thread, cw);
+  if(rc != 0) die("Creating thread failed: %s", strerror(rc));
+}
+
+void chunk_writer_flush(ChunkWriter *cw, size_t threadid)
+{
+  StrBuf *sbuf = &cw->bufs[threadid], *chunk;
+  int pos;
+
+  if(sbuf->end == 0) return;
+
+  if(cw->gzip) {
+    _chunk_gzip(sbuf, &cw->zbufs[threadid], cw->path);
+    strbuf_reset(sbuf);
+    sbuf = &cw->zbufs[threadid];
+  }
+
+  // Swap our full buffer for an empty one from the pool
+  pos = msgpool_claim_write(&cw->pool);
+  memcpy(&chunk, msgpool_get_ptr(&cw->pool, pos), sizeof(StrBuf*));
+  SWAP(*chunk, *sbuf);
+  msgpool_release(&cw->pool, pos, MPOOL_FULL);
+}
+
+void chunk_writer_dealloc(ChunkWriter *cw)
+{
+  size_t i, npool = cw->nthreads * CHUNK_WRITER_POOL;
+  int rc;
+
+  for(i = 0; i < cw->nthreads; i++) chunk_writer_flush(cw, i);
+
+  msgpool_wait_til_empty(&cw->pool);
+  msgpool_close(&cw->pool);
+  rc = pthread_join(cw->writer, NULL);
+  if(rc != 0) die("Joining thread failed: %s", strerror(rc));
+  msgpool_dealloc(&cw->pool);
+
+  for(i = 0; i < cw->nthreads; i++) strbuf_dealloc(&cw->bufs[i]);
+  for(i = 0; cw->gzip && i < cw->nthreads; i++) strbuf_dealloc(&cw->zbufs[i]);
+  for(i = 0; i < npool; i++) strbuf_dealloc(&cw->pool_bufs[i]);
+
+  ctx_free(cw->bufs);
+  ctx_free(cw->zbufs);
+  ctx_free(cw->pool_bufs);
+}
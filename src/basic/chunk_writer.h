@@ -0,0 +1,68 @@
+#ifndef CHUNK_WRITER_H_
+#define CHUNK_WRITER_H_
+
+#include "msg-pool/msgpool.h"
+
+//
+// Many threads writing whole records to one output file
+//
+// Each thread appends to its own buffer. Once a buffer reaches the chunk
+// size (at most CHUNK_WRITER_SIZE bytes) it is handed to a writer thread, which writes
+// chunks in the order they arrive. Records are never split across chunks so
+// output from different threads never interleaves.
+//
+// With gzip, each thread compresses its own chunks into a separate gzip
+// member before handing them over. Concatenated members are a valid gzip file.
+//
+
+#define CHUNK_WRITER_SIZE (4*ONE_MEGABYTE) // largest chunk size
+#define CHUNK_WRITER_MIN_SIZE (4*1024) // smallest chunk size
+#define CHUNK_WRITER_POOL 2 // chunks in flight per thread
+
+// Memory used by a ChunkWriter: each thread has a text buffer, a gzip buffer
+// and CHUNK_WRITER_POOL chunks in flight
+#define chunk_writer_mem(nthreads,chunk_size) \
+        ((nthreads) * (2+CHUNK_WRITER_POOL) * (chunk_size))
+
+typedef struct
+{
+  FILE *fout;
+  const char *path;
+  bool gzip;
+  size_t nthreads, chunk_size;
+  StrBuf *bufs, *zbufs; // per thread text and gzip buffers
+  StrBuf *pool_bufs; // buffers passed through the pool
+  MsgPool pool;
+  pthread_t writer;
+  size_t num_chunks, num_bytes; // written to file
+} ChunkWriter;
+
+// Get the largest chunk size such that a ChunkWriter fits in `mem` bytes.
+// Reduces *nthreads if there is not enough memory for CHUNK_WRITER_MIN_SIZE
+// chunks, down to a minimum of one thread.
+size_t chunk_writer_fit(size_t mem, size_t *nthreads);
+
+// `path` is only used in error messages
+void chunk_writer_alloc(ChunkWriter *cw, FILE *fout, const char *path,
+                        size_t nthreads, size_t chunk_size, bool gzip);
+
+// Flush remaining output and wait for the writer thread. Does not close fout
+void chunk_writer_dealloc(ChunkWriter *cw);
+
+// Pass thread's buffer to the writer thread, even if not full
+void chunk_writer_flush(ChunkWriter *cw, size_t threadid);
+
+// Buffer for thread `threadid` to append to
+static inline StrBuf* chunk_writer_buf(ChunkWriter *cw, size_t threadid)
+{
+  return &cw->bufs[threadid];
+}
+
+// Call after appending one or more whole records
+static inline void chunk_writer_done(ChunkWriter *cw, size_t threadid)
+{
+  if(cw->bufs[threadid].end >= cw->chunk_size)
+    chunk_writer_flush(cw, threadid);
+}
+
+#endif /* CHUNK_WRITER_H_ */
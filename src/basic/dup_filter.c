@@ -0,0 +1,108 @@
+#include "global.h"
+#include "dup_filter.h"
+
+#define DUPF_SLOTS 4 // 16 bit fingerprints per 64 bit bucket
+#define DUPF_MAX_KICKS 500
+#define DUPF_OCCUPANCY 0.9
+
+#define _slot(v,s) ((uint16_t)((v) >> (16*(s))))
+#define _slot_mask(s) ((uint64_t)0xffff << (16*(s)))
+
+// Returns number of buckets to hold nkeys, power of two
+static size_t _dup_filter_nbkts(size_t nkeys)
+{
+  size_t min_bkts = (size_t)(nkeys / (DUPF_SLOTS*DUPF_OCCUPANCY)) + 1;
+  return min_bkts <= 64 ? 64 : roundup2pow(min_bkts-1);
+}
+
+size_t dup_filter_mem(size_t nkeys)
+{
+  return _dup_filter_nbkts(nkeys) * sizeof(uint64_t);
+}
+
+void dup_filter_alloc(DupFilter *fltr, size_t nkeys)
+{
+  size_t nbkts = _dup_filter_nbkts(nkeys);
+  DupFilter tmp = {.bkts = ctx_calloc(nbkts, sizeof(uint64_t)),
+                   .nbkts = nbkts, .mask = nbkts-1, .nfailed = 0};
+  memcpy(fltr, &tmp, sizeof(tmp));
+}
+
+void dup_filter_dealloc(DupFilter *fltr)
+{
+  ctx_free((void*)fltr->bkts);
+  memset(fltr, 0, sizeof(*fltr));
+}
+
+void dup_filter_reset(DupFilter *fltr)
+{
+  memset((void*)fltr->bkts, 0, fltr->nbkts * sizeof(uint64_t));
+}
+
+static inline uint16_t _fingerprint(uint64_t hash)
+{
+  uint16_t fp = (uint16_t)(hash >> 48);
+  return fp ? fp : 1;
+}
+
+// Alternative bucket: alt(alt(i)) == i
+static inline size_t _alt_bkt(const DupFilter *fltr, size_t i, uint16_t fp)
+{
+  return (i ^ ((size_t)fp * 0x5bd1e995UL)) & fltr->mask;
+}
+
+static inline bool _bkt_has(uint64_t v, uint16_t fp)
+{
+  return _slot(v,0) == fp || _slot(v,1) == fp ||
+         _slot(v,2) == fp || _slot(v,3) == fp;
+}
+
+// Add fingerprint to an empty slot in a bucket
+// Returns false if bucket is full
+static inline bool _bkt_add(volatile uint64_t *bkt, uint16_t fp)
+{
+  uint64_t v = *bkt, prev;
+  size_t s;
+
+  while(1) {
+    for(s = 0; s < DUPF_SLOTS && _slot(v,s); s++) {}
+    if(s == DUPF_SLOTS) return false;
+    prev = __sync_val_compare_and_swap(bkt, v, v | ((uint64_t)fp << (16*s)));
+    if(prev == v) return true;
+    v = prev;
+  }
+}
+
+bool dup_filter_add_mt(DupFilter *fltr, uint64_t hash)
+{
+  uint16_t fp = _fingerprint(hash), victim;
+  size_t i1 = hash & fltr->mask, i2 = _alt_bkt(fltr, i1, fp), i, s, n;
+  uint64_t v;
+
+  if(_bkt_has(fltr->bkts[i1], fp) || _bkt_has(fltr->bkts[i2], fp))
+    return true;
+
+  if(_bkt_add(&fltr->bkts[i1], fp) || _bkt_add(&fltr->bkts[i2], fp))
+    return false;
+
+  // Both buckets full: evict fingerprints into their alternative buckets.
+  // Another thread may briefly miss an evicted key; at worst a duplicate is
+  // kept, which is the safe direction.
+  i = (hash >> 32) & 1 ? i1 : i2;
+  for(n = 0; n < DUPF_MAX_KICKS; n++)
+  {
+    s = (hash >> (n & 31)) & (DUPF_SLOTS-1);
+    v = fltr->bkts[i];
+    victim = _slot(v,s);
+    if(!__sync_bool_compare_and_swap(&fltr->bkts[i], v,
+                                     (v & ~_slot_mask(s)) |
+                                     ((uint64_t)fp << (16*s)))) continue;
+    if(!victim) return false; // slot was emptied in the meantime
+    fp = victim;
+    i = _alt_bkt(fltr, i, fp);
+    if(_bkt_add(&fltr->bkts[i], fp)) return false;
+  }
+
+  __sync_fetch_and_add(&fltr->nfailed, 1);
+  return false;
+}
@@ -0,0 +1,36 @@
+#ifndef DUP_FILTER_H_
+#define DUP_FILTER_H_
+
+//
+// Concurrent cuckoo filter used to detect PCR duplicate reads
+//
+// Each bucket is a 64 bit word holding four 16 bit fingerprints (0 is empty).
+// Buckets are updated with compare-and-swap only, so adding from many threads
+// needs no locks. Memory depends on the number of reads, not the graph size.
+//
+// A read may be falsely reported as a duplicate with probability ~1e-4.
+// If the filter fills up, new keys are dropped and counted in `nfailed`; those
+// reads are never reported as duplicates.
+//
+
+typedef struct
+{
+  volatile uint64_t *bkts;
+  size_t nbkts, mask; // nbkts is a power of two
+  volatile size_t nfailed; // number of keys we could not add (filter full)
+} DupFilter;
+
+// Returns memory in bytes required to hold nkeys
+size_t dup_filter_mem(size_t nkeys);
+
+void dup_filter_alloc(DupFilter *fltr, size_t nkeys);
+void dup_filter_dealloc(DupFilter *fltr);
+
+// Remove all keys
+void dup_filter_reset(DupFilter *fltr);
+
+// Threadsafe
+// If `hash` has been seen before return true, otherwise add it, return false
+bool dup_filter_add_mt(DupFilter *fltr, uint64_t hash);
+
+#endif /* DUP_FILTER_H_ */
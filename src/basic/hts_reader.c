@@ -0,0 +1,269 @@
+#include "global.h"
+#include "hts_reader.h"
+#include "cmd.h"
+#include "util.h"
+#include "file_util.h"
+
+#include "htslib/sam.h"
+#include "htslib/khash.h"
+
+// Mate name -> read waiting for its mate
+KHASH_MAP_INIT_STR(kMateHash, read_t*);
+
+static char* _str_copy(const char *str)
+{
+  size_t len = strlen(str);
+  char *cpy = ctx_malloc(len+1);
+  memcpy(cpy, str, len+1);
+  return cpy;
+}
+
+static void _add_region(HtsReadOpts *opts, const char *region)
+{
+  opts->regions = ctx_reallocarray(opts->regions, opts->nregions+1, sizeof(char*));
+  opts->regions[opts->nregions++] = _str_copy(region);
+}
+
+// Add regions from a BED file (0-based half open) as chr:start-end (1-based)
+static void _load_bed(HtsReadOpts *opts, const char *path)
+{
+  FILE *fh = futil_fopen(path, "r");
+  StrBuf line, reg;
+  strbuf_alloc(&line, 512);
+  strbuf_alloc(&reg, 512);
+  char *fields[4]; // chrom, start, end, rest of line
+  size_t nregions = 0, start, end;
+
+  while(futil_fcheck(strbuf_reset_readline(&line, fh), fh, path) > 0)
+  {
+    strbuf_chomp(&line);
+    if(line.end == 0 || line.b[0] == '#' ||
+       strncmp(line.b, "track", 5) == 0 || strncmp(line.b, "browser", 7) == 0)
+      continue;
+    if(string_split_str(line.b, '\t', fields, 4) < 3 ||
+       !parse_entire_size(fields[1], &start) ||
+       !parse_entire_size(fields[2], &end) || end <= start) {
+      die("Bad BED line: %s [%s]", line.b, path);
+    }
+    strbuf_reset(&reg);
+    strbuf_sprintf(&reg, "%s:%zu-%zu", fields[0], start+1, end);
+    _add_region(opts, reg.b);
+    nregions++;
+  }
+
+  fclose(fh);
+  strbuf_dealloc(&line);
+  strbuf_dealloc(&reg);
+
+  status("[hts] Loaded %zu regions from %s", nregions, futil_inpath_str(path));
+}
+
+bool hts_read_opts_parse(HtsReadOpts *opts, int c, const char *cmd,
+                         const char *arg)
+{
+  switch(c) {
+    case HTS_OPT_THREADS: opts->nthreads = cmd_uint32_nonzero(cmd, arg); break;
+    case HTS_OPT_REF: opts->ref_path = arg; break;
+    case HTS_OPT_REGION: _add_region(opts, arg); break;
+    case HTS_OPT_BED: _load_bed(opts, arg); break;
+    case HTS_OPT_UNMAPPED: _add_region(opts, "*"); break;
+    case HTS_OPT_COLLATE: opts->collate = true; break;
+    default: return false;
+  }
+  return true;
+}
+
+bool hts_read_opts_used(const HtsReadOpts *opts)
+{
+  return opts->nthreads || opts->ref_path || opts->nregions || opts->collate;
+}
+
+HtsReadOpts* hts_read_opts_copy(const HtsReadOpts *opts)
+{
+  size_t i;
+  HtsReadOpts *cpy = ctx_malloc(sizeof(HtsReadOpts));
+  *cpy = *opts;
+  cpy->regions = NULL;
+  cpy->nregions = 0;
+  for(i = 0; i < opts->nregions; i++) _add_region(cpy, opts->regions[i]);
+  return cpy;
+}
+
+void hts_read_opts_dealloc(HtsReadOpts *opts)
+{
+  size_t i;
+  for(i = 0; i < opts->nregions; i++) ctx_free(opts->regions[i]);
+  ctx_free(opts->regions);
+  *opts = HTS_READ_OPTS_INIT;
+}
+
+void hts_read_opts_free(HtsReadOpts *opts)
+{
+  hts_read_opts_dealloc(opts);
+  ctx_free(opts);
+}
+
+// Copy an alignment into a read, in the original orientation of the read
+static void _bam_to_read(const bam1_t *b, read_t *r)
+{
+  size_t i, len = b->core.l_qseq;
+  const uint8_t *seq = bam_get_seq(b), *qual = bam_get_qual(b);
+
+  strbuf_set(&r->name, bam_get_qname(b));
+
+  strbuf_ensure_capacity(&r->seq, len);
+  for(i = 0; i < len; i++) r->seq.b[i] = seq_nt16_str[bam_seqi(seq, i)];
+  r->seq.b[r->seq.end = len] = '\0';
+
+  // 0xff means no quality scores
+  strbuf_reset(&r->qual);
+  if(len > 0 && qual[0] != 0xff) {
+    strbuf_ensure_capacity(&r->qual, len);
+    for(i = 0; i < len; i++) r->qual.b[i] = (char)(qual[i] + 33);
+    r->qual.b[r->qual.end = len] = '\0';
+  }
+
+  if(b->core.flag & BAM_FREVERSE) seq_read_reverse_complement(r);
+
+  bam_copy1(seq_read_bam(r), b);
+  r->from_sam = true;
+}
+
+// Pass mates as r1, r2 with the first read of the pair as r1
+static inline void _emit_pair(read_t *a, read_t *b, uint8_t qoffset,
+                              void (*read_func)(read_t *_r1, read_t *_r2,
+                                                uint8_t _qoffset1,
+                                                uint8_t _qoffset2,
+                                                void *_ptr),
+                              void *reader_ptr)
+{
+  bool swap = (seq_read_bam(b)->core.flag & BAM_FREAD1);
+  if(swap) read_func(b, a, qoffset, qoffset, reader_ptr);
+  else     read_func(a, b, qoffset, qoffset, reader_ptr);
+}
+
+void hts_parse_reads(const char *path, const HtsReadOpts *opts,
+                     bool interleaved, uint8_t ascii_fq_offset,
+                     read_t *r1, read_t *r2,
+                     void (*read_func)(read_t *_r1, read_t *_r2,
+                                       uint8_t _qoffset1, uint8_t _qoffset2,
+                                       void *_ptr),
+                     void *reader_ptr)
+{
+  samFile *fh;
+  bam_hdr_t *hdr;
+  hts_idx_t *idx = NULL;
+  hts_itr_t *itr = NULL;
+
+  if(strcmp(path, "-") == 0)
+    die("Cannot use SAM/BAM/CRAM options when reading from STDIN");
+
+  if((fh = sam_open(path, "r")) == NULL) die("Cannot open file: %s", path);
+  if(opts->ref_path && hts_set_fai_filename(fh, opts->ref_path) != 0)
+    die("Cannot use CRAM reference: %s", opts->ref_path);
+  if(opts->nthreads && hts_set_threads(fh, (int)opts->nthreads) != 0)
+    warn("Cannot start %zu htslib threads: %s", opts->nthreads, path);
+  if((hdr = sam_hdr_read(fh)) == NULL) die("Cannot read header: %s", path);
+
+  if(opts->nregions > 0) {
+    if((idx = sam_index_load(fh, path)) == NULL)
+      die("Cannot load index for regions (run `samtools index`): %s", path);
+    itr = sam_itr_regarray(idx, hdr, opts->regions, (unsigned int)opts->nregions);
+    if(itr == NULL) die("Bad regions for file: %s", path);
+  }
+
+  status("[hts] Reading %s [threads: %zu regions: %zu%s%s]",
+         futil_inpath_str(path), opts->nthreads, opts->nregions,
+         interleaved ? " paired" : "", opts->collate ? " collated" : "");
+
+  // SAM/BAM qualities are converted to phred+33
+  uint8_t qoffset = ascii_fq_offset ? ascii_fq_offset : 33;
+  size_t num_se_reads = 0, num_pe_pairs = 0, num_orphans = 0;
+  int s;
+
+  khash_t(kMateHash) *mates = NULL;
+  khiter_t k;
+  read_t *pending = NULL, *mate;
+  bool have_r1 = false;
+  int hret;
+
+  if(interleaved && opts->collate) mates = kh_init(kMateHash);
+
+  bam1_t *b = bam_init1();
+
+  while((s = itr ? sam_itr_next(fh, itr, b) : sam_read1(fh, hdr, b)) >= 0)
+  {
+    if(b->core.flag & (BAM_FSECONDARY | BAM_FSUPPLEMENTARY)) continue;
+
+    if(!interleaved || !(b->core.flag & BAM_FPAIRED)) {
+      if(have_r1) { read_func(r1, NULL, qoffset, 0, reader_ptr); num_se_reads++; }
+      have_r1 = false;
+      _bam_to_read(b, r2);
+      read_func(r2, NULL, qoffset, 0, reader_ptr);
+      num_se_reads++;
+    }
+    else if(mates != NULL) {
+      // Look up mate by name anywhere in the file
+      k = kh_get(kMateHash, mates, bam_get_qname(b));
+      if(k != kh_end(mates)) {
+        mate = kh_value(mates, k);
+        kh_del(kMateHash, mates, k);
+        _bam_to_read(b, r1);
+        _emit_pair(mate, r1, qoffset, read_func, reader_ptr);
+        seq_read_free(mate);
+        num_pe_pairs++;
+      } else {
+        mate = seq_read_new();
+        _bam_to_read(b, mate);
+        k = kh_put(kMateHash, mates, mate->name.b, &hret);
+        kh_value(mates, k) = mate;
+      }
+    }
+    else if(!have_r1) {
+      _bam_to_read(b, r1);
+      have_r1 = true;
+    }
+    else {
+      // Mates must be next to each other
+      _bam_to_read(b, r2);
+      if(strcmp(r1->name.b, r2->name.b) == 0) {
+        _emit_pair(r1, r2, qoffset, read_func, reader_ptr);
+        num_pe_pairs++;
+        have_r1 = false;
+      } else {
+        read_func(r1, NULL, qoffset, 0, reader_ptr);
+        num_se_reads++;
+        SWAP(*r1, *r2);
+      }
+    }
+  }
+
+  if(s < -1) warn("Input error: %s", path);
+
+  if(have_r1) { read_func(r1, NULL, qoffset, 0, reader_ptr); num_se_reads++; }
+
+  // Mates we never saw (e.g. outside of regions) are single ended
+  if(mates != NULL) {
+    kh_foreach_value(mates, pending, {
+      read_func(pending, NULL, qoffset, 0, reader_ptr);
+      seq_read_free(pending);
+      num_orphans++;
+    });
+    kh_destroy(kMateHash, mates);
+    num_se_reads += num_orphans;
+  }
+
+  bam_destroy1(b);
+  if(itr) hts_itr_destroy(itr);
+  if(idx) hts_idx_destroy(idx);
+  bam_hdr_destroy(hdr);
+  sam_close(fh);
+
+  char num_se_reads_str[100], num_pe_pairs_str[100], num_orphans_str[100];
+  ulong_to_str(num_se_reads, num_se_reads_str);
+  ulong_to_str(num_pe_pairs, num_pe_pairs_str);
+  ulong_to_str(num_orphans, num_orphans_str);
+  status("[hts] Loaded %s reads and %s reads pairs (%s unpaired mates) (file: %s)",
+         num_se_reads_str, num_pe_pairs_str, num_orphans_str,
+         futil_inpath_str(path));
+}
@@ -0,0 +1,74 @@
+#ifndef HTS_READER_H_
+#define HTS_READER_H_
+
+#include <getopt.h>
+#include "seq_file/seq_file.h"
+
+//
+// Read SAM/BAM/CRAM files directly with htslib, using its thread pool for
+// decompression. Supports reading only some regions (needs an index) and
+// pairing up mates that are not next to each other in the file
+// (e.g. coordinate sorted input).
+//
+
+typedef struct
+{
+  size_t nthreads; // htslib decompression threads, 0 => none
+  const char *ref_path; // reference FASTA (with .fai) for CRAM decoding
+  char **regions; // e.g. "chr1:1-1000", "*" is unmapped reads with no position
+  size_t nregions;
+  bool collate; // pair up mates anywhere in the file
+} HtsReadOpts;
+
+#define HTS_READ_OPTS_INIT (HtsReadOpts){.nthreads = 0, .ref_path = NULL, \
+                                         .regions = NULL, .nregions = 0,  \
+                                         .collate = false}
+
+// Long only command line options, these apply to following input files
+enum {
+  HTS_OPT_THREADS = 256, HTS_OPT_REF, HTS_OPT_REGION, HTS_OPT_BED,
+  HTS_OPT_UNMAPPED, HTS_OPT_COLLATE
+};
+
+#define HTS_READ_LONGOPTS                                         \
+  {"hts-threads",  required_argument, NULL, HTS_OPT_THREADS},     \
+  {"cram-ref",     required_argument, NULL, HTS_OPT_REF},         \
+  {"region",       required_argument, NULL, HTS_OPT_REGION},      \
+  {"region-bed",   required_argument, NULL, HTS_OPT_BED},         \
+  {"unmapped",     no_argument,       NULL, HTS_OPT_UNMAPPED},    \
+  {"collate",      no_argument,       NULL, HTS_OPT_COLLATE}
+
+#define HTS_READ_USAGE \
+"  SAM/BAM/CRAM input options (apply to following -1/-i inputs):\n"\
+"  --hts-threads <T>        Threads for htslib to decompress each input\n"\
+"  --cram-ref <ref.fa>      Reference used to decode CRAM\n"\
+"  --region <chr:s-e>       Only load reads in region (requires index)\n"\
+"  --region-bed <r.bed>     Only load reads in BED regions (requires index)\n"\
+"  --unmapped               Load unmapped reads with no position (with --region)\n"\
+"  --collate                Pair mates anywhere in the file e.g. sorted BAM (-i)\n"
+
+// Returns true if option `c` was one of ours and was parsed into `opts`
+bool hts_read_opts_parse(HtsReadOpts *opts, int c, const char *cmd,
+                         const char *arg);
+
+// Returns true if any options have been set
+bool hts_read_opts_used(const HtsReadOpts *opts);
+
+// Deep copy, free with hts_read_opts_free()
+HtsReadOpts* hts_read_opts_copy(const HtsReadOpts *opts);
+void hts_read_opts_free(HtsReadOpts *opts);
+
+// Release memory from an HtsReadOpts filled by hts_read_opts_parse()
+void hts_read_opts_dealloc(HtsReadOpts *opts);
+
+// Read primary alignments from a SAM/BAM/CRAM file and pass them to read_func
+// If `interleaved` is set, mates are passed together as r1, r2
+void hts_parse_reads(const char *path, const HtsReadOpts *opts,
+                     bool interleaved, uint8_t ascii_fq_offset,
+                     read_t *r1, read_t *r2,
+                     void (*read_func)(read_t *_r1, read_t *_r2,
+                                       uint8_t _qoffset1, uint8_t _qoffset2,
+                                       void *_ptr),
+                     void *reader_ptr);
+
+#endif /* HTS_READER_H_ */
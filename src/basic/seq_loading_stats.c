@@ -54,6 +54,18 @@ void seq_loading_stats_print(const SeqLoadingStats *stats, size_t ht_num_kmers)
            nkmers_parsed_str, nkmers_loaded_str);
   }
 
+  // PCR duplicate rates
+  if(stats->num_dup_se_reads > 0 || stats->num_dup_pe_pairs > 0)
+  {
+    char dup_se_str[50], dup_pe_str[50];
+    size_t num_pe_pairs = stats->num_pe_reads / 2;
+    ulong_to_str(stats->num_dup_se_reads, dup_se_str);
+    ulong_to_str(stats->num_dup_pe_pairs, dup_pe_str);
+    status("[SeqStats] PCR duplicates: single reads: %s (%.2f%%) read pairs: %s (%.2f%%)",
+           dup_se_str, safe_percent(stats->num_dup_se_reads, stats->num_se_reads),
+           dup_pe_str, safe_percent(stats->num_dup_pe_pairs, num_pe_pairs));
+  }
+
   if(stats->contigs_parsed > 0)
   {
     char klen_str[50];
@@ -28,6 +28,8 @@ const char breakpoints_usage[] =
 "  -r, --minref <N>        Require <N> kmers at ref breakpoint [default: "QUOTE_VALUE(DEFAULT_MIN_REF_NKMERS)"]\n"
 "  -R, --maxref <N>        Stop after <N> kmers at ref breakpoint [default: "QUOTE_VALUE(DEFAULT_MAX_REF_NKMERS)"]\n"
 "  -E, --no-ref-edges      Don't load edges from the reference\n"
+"  -I, --ref-index <file>  Reference kmer index (.kog): loaded if it matches\n"
+"                          --seq and kmer size, otherwise built and saved\n"
 "\n";
 
 static struct option longopts[] =
@@ -46,6 +48,7 @@ static struct option longopts[] =
   {"minref",       required_argument, NULL, 'r'},
   {"maxref",       required_argument, NULL, 'R'},
   {"no-ref-edges", no_argument,       NULL, 'E'},
+  {"ref-index",    required_argument, NULL, 'I'},
   {NULL, 0, NULL, 0}
 };
 
@@ -56,6 +59,7 @@ int ctx_breakpoints(int argc, char **argv)
   const char *output_file = NULL;
   size_t min_ref_flank = 0, max_ref_flank = 0;
   bool load_ref_edges = true; // by default load kmers and edges
+  const char *ref_index_path = NULL;
 
   GPathReader tmp_gpfile;
   GPathFileBuffer gpfiles;
@@ -97,6 +101,7 @@ int ctx_breakpoints(int argc, char **argv)
         seq_file_ptr_buf_add(&sfilebuf, tmp_sfile);
         break;
       case 'E': cmd_check(load_ref_edges,cmd); load_ref_edges = false; break;
+      case 'I': cmd_check(!ref_index_path,cmd); ref_index_path = optarg; break;
       case ':': /* BADARG */
       case '?': /* BADCH getopt_long has already printed error */
         // cmd_print_usage(NULL);
@@ -220,7 +225,7 @@ int ctx_breakpoints(int argc, char **argv)
 
   // Load path files
   for(i = 0; i < gpfiles.len; i++)
-    gpath_reader_load(&gpfiles.b[i], true, &db_graph);
+    gpath_reader_load_mt(&gpfiles.b[i], true, nthreads, &db_graph);
 
   // Get array of sequence file paths
   size_t num_seq_paths = sfilebuf.len;
@@ -253,7 +258,8 @@ int ctx_breakpoints(int argc, char **argv)
                    gzout, output_file,
                    rbuf.b, rbuf.len,
                    seq_paths, num_seq_paths,
-                   load_ref_edges, min_ref_flank, max_ref_flank,
+                   load_ref_edges, ref_index_path,
+                   min_ref_flank, max_ref_flank,
                    hdrs, gpfiles.len,
                    &db_graph);
 
@@ -14,6 +14,10 @@
 #define DEFAULT_MAX_FLANK 500
 #define DEFAULT_MAX_ALLELE 2000
 
+// Forks that explore more than this are deferred until the end
+#define DEFAULT_TASK_KMERS 100000
+#define DEFAULT_TASK_SECS 1
+
 #define SUBCMD "bubbles"
 
 const char bubbles_usage[] =
@@ -34,6 +38,8 @@ const char bubbles_usage[] =
 "  -A, --max-allele <len>  Max bubble branch length in kmers [default: "QUOTE_VALUE(DEFAULT_MAX_ALLELE)"]\n"
 "  -F, --max-flank <len>   Max flank length in kmers [default: "QUOTE_VALUE(DEFAULT_MAX_FLANK)"]\n"
 "  -S, --keep-serial       Keep serial bubbles. Use if mapping is hard. Higher FP.\n"
+"  -K, --task-kmers <N>    Defer forks that explore more than <N> kmers [default: "QUOTE_VALUE(DEFAULT_TASK_KMERS)"]\n"
+"  -T, --task-secs <S>     Defer forks that take longer than <S> seconds [default: "QUOTE_VALUE(DEFAULT_TASK_SECS)"]\n"
 "\n"
 "  When loading path files with -p, use offset (e.g. 2:in.ctp) to specify\n"
 "  which colour to load the data into.\n"
@@ -54,6 +60,8 @@ static struct option longopts[] =
   {"max-allele",   required_argument, NULL, 'A'},
   {"max-flank",    required_argument, NULL, 'F'},
   {"keep-serial",  required_argument, NULL, 'S'},
+  {"task-kmers",   required_argument, NULL, 'K'},
+  {"task-secs",    required_argument, NULL, 'T'},
   {NULL, 0, NULL, 0}
 };
 
@@ -63,6 +71,8 @@ int ctx_bubbles(int argc, char **argv)
   struct MemArgs memargs = MEM_ARGS_INIT;
   const char *out_path = NULL;
   size_t max_allele_len = 0, max_flank_len = 0;
+  size_t max_task_kmers = 0;
+  double max_task_secs = 0;
   bool remove_serial_bubbles = true;
 
   // List of haploid colours
@@ -102,6 +112,8 @@ int ctx_bubbles(int argc, char **argv)
       case 'A': cmd_check(!max_allele_len, cmd); max_allele_len = cmd_uint32_nonzero(cmd, optarg); break;
       case 'F': cmd_check(!max_flank_len, cmd); max_flank_len = cmd_uint32_nonzero(cmd, optarg); break;
       case 'S': cmd_check(remove_serial_bubbles,cmd); remove_serial_bubbles = false; break;
+      case 'K': cmd_check(!max_task_kmers, cmd); max_task_kmers = cmd_uint32_nonzero(cmd, optarg); break;
+      case 'T': cmd_check(max_task_secs <= 0, cmd); max_task_secs = cmd_udouble_nonzero(cmd, optarg); break;
       case ':': /* BADARG */
       case '?': /* BADCH getopt_long has already printed error */
         // cmd_print_usage(NULL);
@@ -115,6 +127,8 @@ int ctx_bubbles(int argc, char **argv)
   if(nthreads == 0) nthreads = DEFAULT_NTHREADS;
   if(max_allele_len == 0) max_allele_len = DEFAULT_MAX_ALLELE;
   if(max_flank_len == 0) max_flank_len = DEFAULT_MAX_FLANK;
+  if(max_task_kmers == 0) max_task_kmers = DEFAULT_TASK_KMERS;
+  if(max_task_secs <= 0) max_task_secs = DEFAULT_TASK_SECS;
 
   if(optind >= argc) cmd_print_usage("Require input graph files (.ctx)");
 
@@ -215,7 +229,8 @@ int ctx_bubbles(int argc, char **argv)
 
   // Load path files
   for(i = 0; i < gpfiles.len; i++)
-    gpath_reader_load(&gpfiles.b[i], GPATH_DIE_MISSING_KMERS, &db_graph);
+    gpath_reader_load_mt(&gpfiles.b[i], GPATH_DIE_MISSING_KMERS,
+                         nthreads, &db_graph);
 
   // Create array of cJSON** from input files
   cJSON **hdrs = ctx_malloc(gpfiles.len * sizeof(cJSON*));
@@ -226,7 +241,9 @@ int ctx_bubbles(int argc, char **argv)
                                    .max_flank_len = max_flank_len,
                                    .haploid_cols = hapcols,
                                    .nhaploid_cols = nhapcols,
-                                   .remove_serial_bubbles = remove_serial_bubbles};
+                                   .remove_serial_bubbles = remove_serial_bubbles,
+                                   .max_task_kmers = max_task_kmers,
+                                   .max_task_secs = max_task_secs};
 
   invoke_bubble_caller(nthreads, &call_prefs,
                        gzout, out_path,
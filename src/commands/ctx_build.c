@@ -23,6 +23,7 @@ const char build_usage[] =
 "  -t, --threads <T>        Number of threads to use [default: "QUOTE_VALUE(DEFAULT_NTHREADS)"]\n"
 //
 "  -k, --kmer <kmer>        Kmer size must be odd ("QUOTE_VALUE(MAX_KMER_SIZE)" >= k >= "QUOTE_VALUE(MIN_KMER_SIZE)")\n"
+"                           Pass multiple times to build a graph per kmer size\n"
 "  -s, --sample <name>      Sample name (required before any seq args)\n"
 "  -1, --seq <in.fa>        Load sequence data\n"
 "  -2, --seq2 <in1:in2>     Load paired end sequence data\n"
@@ -32,12 +33,18 @@ const char build_usage[] =
 "  -H, --cut-hp <bp>        Breaks reads at homopolymers >= <bp> [default: off]\n"
 "  -p, --remove-pcr         Remove (or keep) PCR duplicate reads\n"
 "  -P, --keep-pcr           Don't do PCR duplicate removal [default]\n"
+"  -D, --dup-filter         Use a compact read hash filter for --remove-pcr\n"
+"                           instead of 2 bits per graph kmer\n"
 "  -M, --matepair <orient>  Mate pair orientation: FF,FR,RF,RR [default: FR]\n"
 "                           (for --keep_pcr only)\n"
 "  -g, --graph <in.ctx>     Load samples from a graph file (.ctx)\n"
 "  -I, --intersect <i.ctx>  Only load kmers that appear in i.ctx. Multiple -I\n"
 "                           graphs will be merged, not intersected. Treated as\n"
 "                           single colour graphs.\n"
+"  -A, --append-to <p.ctx>  Write colours from p.ctx followed by the new samples.\n"
+"                           p.ctx is streamed, not loaded into memory.\n"
+"\n"
+HTS_READ_USAGE
 "\n"
 "  Note: Argument must come before input file\n"
 "  PCR duplicate removal works by ignoring read (pairs) if (both) reads\n"
@@ -47,6 +54,10 @@ const char build_usage[] =
 "  --graph argument can have colours specifed e.g. in.ctx:0,6-8 will load\n"
 "  samples 0,6,7,8.  Graphs are loaded into new colours.\n"
 "  See `"CMD" join` to combine .ctx files\n"
+"  Multiple -k values build one graph per kmer size from a single pass over the\n"
+"  input; <out.ctx> must then contain '{k}' e.g. sample.k{k}.ctx\n"
+"  --append-to adds samples to an existing (e.g. population) graph without\n"
+"  loading its colours. It cannot be used with --graph or --intersect.\n"
 "\n";
 
 static struct option longopts[] =
@@ -69,8 +80,12 @@ static struct option longopts[] =
   {"cut-hp",       required_argument, NULL, 'H'},
   {"remove-pcr",   no_argument,       NULL, 'p'},
   {"keep-pcr",     no_argument,       NULL, 'P'},
+  {"dup-filter",   no_argument,       NULL, 'D'},
   {"graph",        required_argument, NULL, 'g'},
   {"intersect",    required_argument, NULL, 'I'},
+  {"append-to",    required_argument, NULL, 'A'},
+// SAM/BAM/CRAM input
+  HTS_READ_LONGOPTS,
   {NULL, 0, NULL, 0}
 };
 
@@ -82,16 +97,33 @@ typedef struct {
 #include "madcrowlib/madcrow_buffer.h"
 madcrow_buffer(sample_name_buf, SampleNameBuffer, SampleName);
 
+// Up to this many kmer sizes can be built at once
+#define MAX_BUILD_KMER_SIZES 32
+
+// Assumed read length when sizing --dup-filter from input file sizes
+#define DUP_FILTER_READ_LEN 50
+
 static BuildGraphTaskBuffer gtaskbuf;
 static GraphFileBuffer gfilebuf, gisecbuf;
 static SampleNameBuffer snamebuf;
 
+// --append-to <pop.ctx>
+static char *append_path = NULL;
+static GraphFileReader appendfile;
+
 static size_t nthreads = 0;
 static struct MemArgs memargs = MEM_ARGS_INIT;
 
 static char *out_path = NULL;
 static size_t output_colours = 0, kmer_size = 0;
 
+// Multiple kmer sizes with -k; kmer_size is the first one
+static size_t kmer_sizes[MAX_BUILD_KMER_SIZES], num_kmer_sizes = 0;
+
+// --dup-filter
+static bool use_dup_filter = false;
+static DupFilter dupfilter;
+
 static void add_task(BuildGraphTask *task)
 {
   uint8_t fq_offset = task->files.fq_offset, fq_cutoff = task->prefs.fq_cutoff;
@@ -135,6 +167,7 @@ static void parse_args(int argc, char **argv)
   uint8_t fq_offset = 0;
   int intocolour = -1;
   GraphFileReader tmp_gfile;
+  HtsReadOpts htsopts = HTS_READ_OPTS_INIT;
 
   // Arg parsing
   char cmd[100], shortopts[100];
@@ -151,7 +184,12 @@ static void parse_args(int argc, char **argv)
       case 'm': cmd_mem_args_set_memory(&memargs, optarg); break;
       case 'n': cmd_mem_args_set_nkmers(&memargs, optarg); break;
       case 'f': cmd_check(!futil_get_force(), cmd); futil_set_force(true); break;
-      case 'k': cmd_check(!kmer_size,cmd); kmer_size = cmd_kmer_size(cmd, optarg); break;
+      case 'k':
+        if(num_kmer_sizes == MAX_BUILD_KMER_SIZES)
+          cmd_print_usage("Too many kmer sizes (max %i)", MAX_BUILD_KMER_SIZES);
+        kmer_sizes[num_kmer_sizes++] = cmd_kmer_size(cmd, optarg);
+        kmer_size = kmer_sizes[0];
+        break;
       case 's':
         intocolour++;
         check_sample_name(optarg);
@@ -166,6 +204,8 @@ static void parse_args(int argc, char **argv)
         if(!sample_named)
           cmd_print_usage("Please give sample name first [-s,--sample <name>]");
         asyncio_task_parse(&task.files, c, optarg, fq_offset, NULL);
+        if(hts_read_opts_used(&htsopts))
+          asyncio_task_set_hts(&task.files, &htsopts);
         task.prefs.colour = intocolour;
         add_task(&task);
         break;
@@ -181,6 +221,7 @@ static void parse_args(int argc, char **argv)
       case 'H': task.prefs.hp_cutoff = cmd_uint8(cmd, optarg); pref_unused = true; break;
       case 'p': task.prefs.remove_pcr_dups = true; pref_unused = true; break;
       case 'P': task.prefs.remove_pcr_dups = false; pref_unused = true; break;
+      case 'D': use_dup_filter = true; break;
       case 'g':
         if(intocolour == -1) intocolour = 0;
         graph_file_reset(&tmp_gfile);
@@ -197,6 +238,12 @@ static void parse_args(int argc, char **argv)
         file_filter_flatten(&tmp_gfile.fltr, 0);
         gfile_buf_push(&gisecbuf, &tmp_gfile, 1);
         break;
+      case 'A': cmd_check(!append_path,cmd); append_path = optarg; break;
+      case HTS_OPT_THREADS: case HTS_OPT_REF: case HTS_OPT_REGION:
+      case HTS_OPT_BED: case HTS_OPT_UNMAPPED: case HTS_OPT_COLLATE:
+        hts_read_opts_parse(&htsopts, c, cmd, optarg);
+        pref_unused = true;
+        break;
       case ':': /* BADARG */
       case '?': /* BADCH getopt_long has already printed error */
         // cmd_print_usage(NULL);
@@ -205,6 +252,8 @@ static void parse_args(int argc, char **argv)
     }
   }
 
+  hts_read_opts_dealloc(&htsopts);
+
   // Defaults
   if(!nthreads) nthreads = DEFAULT_NTHREADS;
 
@@ -221,10 +270,45 @@ static void parse_args(int argc, char **argv)
 
   if(pref_unused) cmd_print_usage("Arguments not given BEFORE sequence file");
 
+  // Open graph we are appending to, take kmer size from it if not given
+  if(append_path != NULL)
+  {
+    if(gfilebuf.len > 0 || gisecbuf.len > 0)
+      cmd_print_usage("--append-to cannot be used with --graph or --intersect");
+    if(strcmp(append_path, out_path) == 0)
+      cmd_print_usage("--append-to graph cannot also be the output graph");
+
+    graph_file_reset(&appendfile);
+    graph_file_open(&appendfile, append_path);
+
+    if(!kmer_size) kmer_sizes[num_kmer_sizes++] = kmer_size = appendfile.hdr.kmer_size;
+    else if(appendfile.hdr.kmer_size != kmer_size) {
+      cmd_print_usage("--append-to graph kmer_size doesn't match [%u vs %zu]: %s",
+                      appendfile.hdr.kmer_size, kmer_size,
+                      file_filter_input(&appendfile.fltr));
+    }
+  }
+
   if(!kmer_size) die("kmer size not set with -k <K>");
 
+  // Multiple kmer sizes: one output per kmer size
+  size_t i, j;
+  if(num_kmer_sizes > 1)
+  {
+    if(gfilebuf.len > 0 || gisecbuf.len > 0 || append_path != NULL) {
+      cmd_print_usage("Cannot use --graph, --intersect or --append-to with "
+                      "multiple kmer sizes");
+    }
+    if(strstr(out_path, "{k}") == NULL)
+      cmd_print_usage("Output path must contain '{k}' with multiple -k <K> args");
+
+    for(i = 0; i < num_kmer_sizes; i++)
+      for(j = i+1; j < num_kmer_sizes; j++)
+        if(kmer_sizes[i] == kmer_sizes[j])
+          cmd_print_usage("Duplicate kmer size: %zu", kmer_sizes[i]);
+  }
+
   // Check kmer size in graphs to load
-  size_t i;
   for(i = 0; i < gfilebuf.len; i++) {
     if(gfilebuf.b[i].hdr.kmer_size != kmer_size) {
       cmd_print_usage("Input graph kmer_size doesn't match [%u vs %zu]: %s",
@@ -236,10 +320,21 @@ static void parse_args(int argc, char **argv)
   output_colours = intocolour + (sample_named ? 1 : 0);
 }
 
+// Replace '{k}' in output path with kmer size
+static void multik_out_path(StrBuf *sbuf, const char *path, size_t ksize)
+{
+  const char *pos = strstr(path, "{k}");
+  strbuf_reset(sbuf);
+  if(pos == NULL) { strbuf_set(sbuf, path); return; }
+  strbuf_append_strn(sbuf, path, pos - path);
+  strbuf_append_ulong(sbuf, ksize);
+  strbuf_append_str(sbuf, pos+strlen("{k}"));
+}
+
 
 int ctx_build(int argc, char **argv)
 {
-  size_t i;
+  size_t i, g;
   build_graph_task_buf_alloc(&gtaskbuf, 16);
   gfile_buf_alloc(&gfilebuf, 8);
   gfile_buf_alloc(&gisecbuf, 8);
@@ -254,6 +349,7 @@ int ctx_build(int argc, char **argv)
   // Did any tasks require PCR duplicate removal
   for(i = 0; i < ntasks && !tasks[i].prefs.remove_pcr_dups; i++) {}
   bool remove_pcr_used = (i < ntasks);
+  bool readstrt_used = remove_pcr_used && !use_dup_filter;
 
   //
   // Print inputs
@@ -303,10 +399,12 @@ int ctx_build(int argc, char **argv)
   size_t bits_per_kmer, kmers_in_hash, graph_mem;
 
   // remove_pcr_dups requires a fw and rv bit per kmer
+  // each kmer size has its own hash table
   bits_per_kmer = sizeof(BinaryKmer)*8 +
                   (sizeof(Covg) + sizeof(Edges)) * 8 * output_colours +
                   (gisecbuf.len > 0 ? sizeof(Edges)*8 : 0) +
-                  remove_pcr_used*2;
+                  readstrt_used*2;
+  bits_per_kmer *= num_kmer_sizes;
 
   kmers_in_hash = cmd_get_kmers_in_hash(memargs.mem_to_use,
                                         memargs.mem_to_use_set,
@@ -315,78 +413,121 @@ int ctx_build(int argc, char **argv)
                                         bits_per_kmer, 0, max_kmers,
                                         true, &graph_mem);
 
-  cmd_check_mem_limit(memargs.mem_to_use, graph_mem);
+  // Size PCR duplicate filter by the max number of reads in a colour
+  size_t dupfltr_nreads = 0, dupfltr_mem = 0;
+  if(remove_pcr_used && use_dup_filter)
+  {
+    size_t nbases, col_nreads = 0;
+    for(t = 0; t < ntasks; t++) {
+      if(t > 0 && tasks[t].prefs.colour != tasks[t-1].prefs.colour) col_nreads = 0;
+      if(!tasks[t].prefs.remove_pcr_dups) continue;
+      nbases = asyncio_input_nkmers(&tasks[t].files);
+      col_nreads += (nbases == SIZE_MAX ? kmers_in_hash
+                                        : nbases / DUP_FILTER_READ_LEN);
+      dupfltr_nreads = MAX2(dupfltr_nreads, col_nreads);
+    }
+    dupfltr_mem = dup_filter_mem(dupfltr_nreads);
+
+    char nreads_str[50], mem_str[50];
+    ulong_to_str(dupfltr_nreads, nreads_str);
+    bytes_to_str(dupfltr_mem, 1, mem_str);
+    status("[memory] PCR duplicate filter: %s for %s reads", mem_str, nreads_str);
+  }
+
+  cmd_check_mem_limit(memargs.mem_to_use, graph_mem + dupfltr_mem);
 
   //
-  // Check output path
+  // Check output paths
   //
-  futil_create_output(out_path);
-
-  status("Writing %zu colour graph to %s\n", output_colours, futil_outpath_str(out_path));
+  StrBuf *out_paths = ctx_calloc(num_kmer_sizes, sizeof(StrBuf));
+  for(i = 0; i < num_kmer_sizes; i++) {
+    strbuf_alloc(&out_paths[i], 256);
+    multik_out_path(&out_paths[i], out_path, kmer_sizes[i]);
+    futil_create_output(out_paths[i].b);
+    status("Writing %zu colour k=%zu graph to %s\n", output_colours,
+           kmer_sizes[i], futil_outpath_str(out_paths[i].b));
+  }
 
-  // Create db_graph
-  dBGraph db_graph;
+  // Create one db_graph per kmer size
+  dBGraph *graphs = ctx_calloc(num_kmer_sizes, sizeof(dBGraph));
+  dBGraph *db_graph = &graphs[0];
   int alloc_flags = DBG_ALLOC_EDGES | DBG_ALLOC_COVGS | DBG_ALLOC_BKTLOCKS |
-                    (remove_pcr_used ? DBG_ALLOC_READSTRT : 0);
+                    (readstrt_used ? DBG_ALLOC_READSTRT : 0);
+
+  for(i = 0; i < num_kmer_sizes; i++) {
+    db_graph_alloc(&graphs[i], kmer_sizes[i], output_colours, output_colours,
+                   kmers_in_hash, alloc_flags);
+  }
 
-  db_graph_alloc(&db_graph, kmer_size, output_colours, output_colours,
-                 kmers_in_hash, alloc_flags);
+  if(remove_pcr_used && use_dup_filter) {
+    dup_filter_alloc(&dupfilter, dupfltr_nreads);
+    for(t = 0; t < ntasks; t++)
+      if(tasks[t].prefs.remove_pcr_dups) tasks[t].prefs.dup_filter = &dupfilter;
+  }
 
   Edges *isec_edges = NULL;
   if(gisecbuf.len > 0)
-    isec_edges = ctx_calloc(db_graph.ht.capacity, sizeof(Edges));
+    isec_edges = ctx_calloc(db_graph->ht.capacity, sizeof(Edges));
 
-  hash_table_print_stats(&db_graph.ht);
+  hash_table_print_stats(&db_graph->ht);
 
   // Load intersection graphs
   if(gisecbuf.len > 0)
   {
-    GraphLoadingPrefs gprefs = graph_loading_prefs(&db_graph);
+    GraphLoadingPrefs gprefs = graph_loading_prefs(db_graph);
     Covg *tmp_covgs = NULL;
-    SWAP(db_graph.col_covgs, tmp_covgs);
-    SWAP(db_graph.col_edges, isec_edges); db_graph.num_edge_cols = 1;
+    SWAP(db_graph->col_covgs, tmp_covgs);
+    SWAP(db_graph->col_edges, isec_edges); db_graph->num_edge_cols = 1;
     for(i = 0; i < gisecbuf.len; i++) {
       graph_load(&gisecbuf.b[i], gprefs, NULL);
-      hash_table_print_stats(&db_graph.ht);
+      hash_table_print_stats(&db_graph->ht);
       graph_file_close(&gisecbuf.b[i]);
     }
-    SWAP(db_graph.col_covgs, tmp_covgs);
-    SWAP(db_graph.col_edges, isec_edges); db_graph.num_edge_cols = output_colours;
+    SWAP(db_graph->col_covgs, tmp_covgs);
+    SWAP(db_graph->col_edges, isec_edges); db_graph->num_edge_cols = output_colours;
     // reset ginfo
-    graph_info_init(&db_graph.ginfo[0]);
+    graph_info_init(&db_graph->ginfo[0]);
   }
 
   // Load graphs
   if(gfilebuf.len > 0)
   {
-    GraphLoadingPrefs gprefs = graph_loading_prefs(&db_graph);
+    GraphLoadingPrefs gprefs = graph_loading_prefs(db_graph);
     gprefs.must_exist_in_graph = (gisecbuf.len > 0);
     gprefs.must_exist_in_edges = isec_edges;
 
     for(i = 0; i < gfilebuf.len; i++) {
       graph_load(&gfilebuf.b[i], gprefs, NULL);
-      hash_table_print_stats(&db_graph.ht);
+      hash_table_print_stats(&db_graph->ht);
       graph_file_close(&gfilebuf.b[i]);
     }
   }
 
   // Set sample names using seq_colours array
-  for(i = 0; i < ncolours; i++) {
-    strbuf_set(&db_graph.ginfo[samples[i].colour].sample_name, samples[i].name);
+  for(g = 0; g < num_kmer_sizes; g++) {
+    for(i = 0; i < ncolours; i++)
+      strbuf_set(&graphs[g].ginfo[samples[i].colour].sample_name, samples[i].name);
   }
 
   size_t start, end, num_load, colour, prev_colour = 0;
+  SeqLoadingStats *graph_stats = ctx_calloc(num_kmer_sizes, sizeof(SeqLoadingStats));
 
   // If we are using PCR duplicate removal,
   // it's best to load one colour at a time
   for(start = 0; start < ntasks; start = end, prev_colour = colour)
   {
-    // Wipe read start bitfield
+    // Wipe read start bitfield or duplicate filter
     colour = tasks[start].prefs.colour;
     if(remove_pcr_used)
     {
-      if(colour != prev_colour)
-        memset(db_graph.readstrt, 0, roundup_bits2bytes(db_graph.ht.capacity)*2);
+      if(colour != prev_colour && use_dup_filter)
+        dup_filter_reset(&dupfilter);
+      else if(colour != prev_colour) {
+        for(g = 0; g < num_kmer_sizes; g++) {
+          memset(graphs[g].readstrt, 0,
+                 roundup_bits2bytes(graphs[g].ht.capacity)*2);
+        }
+      }
 
       end = start+1;
       while(end < ntasks && end-start < MAX_IO_THREADS &&
@@ -397,17 +538,30 @@ int ctx_build(int argc, char **argv)
     }
 
     num_load = end-start;
-    build_graph(&db_graph, tasks+start, num_load, nthreads);
+    build_graphs(graphs, num_kmer_sizes, tasks+start, num_load, nthreads,
+                 graph_stats);
   }
 
   // Remove kmers with no coverage
   if(gisecbuf.len > 0) {
-    db_graph_remove_no_covg_kmers(&db_graph, nthreads);
-    db_graph_intersect_edges(&db_graph, nthreads, isec_edges);
+    db_graph_remove_no_covg_kmers(db_graph, nthreads);
+    db_graph_intersect_edges(db_graph, nthreads, isec_edges);
   }
 
   // Print stats for hash table
-  hash_table_print_stats(&db_graph.ht);
+  for(g = 0; g < num_kmer_sizes; g++) {
+    if(num_kmer_sizes > 1) {
+      status("[k=%zu]", kmer_sizes[g]);
+      seq_loading_stats_print(&graph_stats[g], graphs[g].ht.num_kmers);
+    }
+    hash_table_print_stats(&graphs[g].ht);
+  }
+
+  if(dupfilter.nfailed > 0) {
+    warn("PCR duplicate filter was full, %zu reads not checked for duplicates. "
+         "Consider the default --remove-pcr without --dup-filter",
+         (size_t)dupfilter.nfailed);
+  }
 
   // Print stats per input file
   for(i = 0; i < ntasks; i++) {
@@ -415,9 +569,17 @@ int ctx_build(int argc, char **argv)
     build_graph_task_destroy(&tasks[i]);
   }
 
-  status("Dumping graph...\n");
-  graph_writer_save_mkhdr(out_path, &db_graph, CTX_GRAPH_FILEFORMAT, NULL,
-                          0, output_colours);
+  status("Dumping graph%s...\n", num_kmer_sizes > 1 ? "s" : "");
+  if(append_path != NULL) {
+    graph_writer_stream_append_mkhdr(out_path, &appendfile, db_graph);
+    graph_file_close(&appendfile);
+  }
+  else {
+    for(g = 0; g < num_kmer_sizes; g++) {
+      graph_writer_save_mkhdr(out_paths[g].b, &graphs[g], CTX_GRAPH_FILEFORMAT,
+                              NULL, 0, output_colours);
+    }
+  }
 
   build_graph_task_buf_dealloc(&gtaskbuf);
   gfile_buf_dealloc(&gfilebuf);
@@ -425,7 +587,15 @@ int ctx_build(int argc, char **argv)
   sample_name_buf_dealloc(&snamebuf);
 
   ctx_free(isec_edges);
-  db_graph_dealloc(&db_graph);
+  if(dupfilter.bkts != NULL) dup_filter_dealloc(&dupfilter);
+
+  for(g = 0; g < num_kmer_sizes; g++) {
+    db_graph_dealloc(&graphs[g]);
+    strbuf_dealloc(&out_paths[g]);
+  }
+  ctx_free(graphs);
+  ctx_free(out_paths);
+  ctx_free(graph_stats);
 
   return EXIT_SUCCESS;
 }
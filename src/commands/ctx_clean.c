@@ -28,6 +28,10 @@ const char clean_usage[] =
 "  -T[L], --tips[=L]        Clip tips shorter than <L> kmers [default: auto]\n"
 "  -U[X], --unitigs[=X]     Remove low coverage unitigs with median cov < X [default: auto]\n"
 "  -B, --fallback <T>       Fall back threshold if we can't pick\n"
+"  -I[N], --iterate[=N]     Re-check unitigs next to removed kmers, up to N rounds\n"
+"                           [default: until nothing is removed]\n"
+"  -E, --estimate           Only estimate thresholds for each colour by streaming\n"
+"                           the graph files, without loading them\n"
 "\n"
 "  Statistics:\n"
 "  -c, --covg-before <out.csv> Save kmer coverage histogram before cleaning\n"
@@ -54,6 +58,8 @@ static struct option longopts[] =
   {"unitigs",      optional_argument, NULL, 'U'},
   {"supernodes",   optional_argument, NULL, 'S'}, // alias for --unitigs
   {"fallback",     required_argument, NULL, 'B'},
+  {"estimate",     no_argument,       NULL, 'E'},
+  {"iterate",      optional_argument, NULL, 'I'},
 // output
   {"len-before",   required_argument, NULL, 'l'},
   {"len-after",    required_argument, NULL, 'L'},
@@ -69,6 +75,8 @@ int ctx_clean(int argc, char **argv)
   const char *out_ctx_path = NULL;
   int min_keep_tip = -1, unitig_min = -1; // <0 => default, 0 => noclean
   uint32_t fallback_thresh = 0;
+  bool estimate_only = false;
+  int max_rounds = -1; // <0 => no iterating, 0 => until no change
   const char *len_before_path = NULL, *len_after_path = NULL;
   const char *covg_before_path = NULL, *covg_after_path = NULL;
 
@@ -105,6 +113,11 @@ int ctx_clean(int argc, char **argv)
         unitig_min = (optarg != NULL ? cmd_uint32(cmd, optarg) : -1);
         break;
       case 'B': cmd_check(!fallback_thresh, cmd); fallback_thresh = cmd_uint32_nonzero(cmd, optarg); break;
+      case 'I':
+        cmd_check(max_rounds<0, cmd);
+        max_rounds = (optarg != NULL ? (int)cmd_uint32_nonzero(cmd, optarg) : 0);
+        break;
+      case 'E': cmd_check(!estimate_only, cmd); estimate_only = true; break;
       case 'l': cmd_check(!len_before_path, cmd); len_before_path = optarg; break;
       case 'L': cmd_check(!len_after_path, cmd); len_after_path = optarg; break;
       case 'c': cmd_check(!covg_before_path, cmd); covg_before_path = optarg; break;
@@ -127,7 +140,7 @@ int ctx_clean(int argc, char **argv)
 
   // If you ever want to estimate cleaning threshold without outputting
   // a graph, change this to a warning
-  if(doing_cleaning && out_ctx_path == NULL) {
+  if(doing_cleaning && out_ctx_path == NULL && !estimate_only) {
     cmd_print_usage("Please specify --out <out.ctx> for cleaned graph");
     // warn("No cleaning being done: you did not specify --out <out.ctx>");
   }
@@ -137,7 +150,7 @@ int ctx_clean(int argc, char **argv)
          "any cleaning (set -U, --unitigs or -t, --tips)");
   }
 
-  if(doing_cleaning && strcmp(out_ctx_path,"-") != 0 &&
+  if(doing_cleaning && !estimate_only && strcmp(out_ctx_path,"-") != 0 &&
      !futil_get_force() && futil_file_exists(out_ctx_path))
   {
     cmd_print_usage("Output file already exists: %s", out_ctx_path);
@@ -159,6 +172,26 @@ int ctx_clean(int argc, char **argv)
 
   size_t kmer_size = gfiles[0].hdr.kmer_size;
 
+  // Report a threshold for each colour without building a graph
+  if(estimate_only)
+  {
+    if(out_ctx_path || covg_before_path || covg_after_path ||
+       len_before_path || len_after_path) {
+      warn("--estimate given, not writing any output files");
+    }
+    int *est_thresholds = ctx_calloc(ncols, sizeof(int));
+    cleaning_estimate_thresholds(nthreads, gfiles, num_gfiles, false, ncols,
+                                 est_thresholds);
+    for(col = 0; col < ncols; col++) {
+      if(est_thresholds[col] < 0) printf("%zu\tNA\n", col);
+      else printf("%zu\t%i\n", col, est_thresholds[col]);
+    }
+    ctx_free(est_thresholds);
+    for(i = 0; i < num_gfiles; i++) graph_file_close(&gfiles[i]);
+    ctx_free(gfiles);
+    return EXIT_SUCCESS;
+  }
+
   // default to one colour for now
   if(use_ncols == 0) use_ncols = 1;
 
@@ -218,6 +251,10 @@ int ctx_clean(int argc, char **argv)
     status("%zu. Cleaning unitigs with coverage < %i", step++, unitig_min);
   if(unitig_min < 0)
     status("%zu. Cleaning unitigs with auto-detected threshold", step++);
+  if(max_rounds == 0 && (min_keep_tip || unitig_min))
+    status("%zu. Re-checking unitigs next to removed kmers until no change", step++);
+  if(max_rounds > 0 && (min_keep_tip || unitig_min))
+    status("%zu. Re-checking unitigs next to removed kmers (max %i rounds)", step++, max_rounds);
   if(covg_after_path != NULL)
     status("%zu. Saving kmer coverage distribution to: %s", step++, covg_after_path);
   if(len_after_path != NULL)
@@ -277,6 +314,18 @@ int ctx_clean(int argc, char **argv)
   if(use_ncols < ncols)
     edges_union = ctx_calloc(db_graph.ht.capacity, sizeof(Edges));
 
+  // With a single input file we can pick the threshold before loading, by
+  // streaming the file, instead of walking every unitig after loading
+  int est_min_covg = -1;
+  bool est_before_load = (unitig_min < 0 && num_gfiles == 1 &&
+                          covg_before_path == NULL && len_before_path == NULL &&
+                          !file_filter_isstdin(&gfiles[0].fltr));
+
+  if(est_before_load) {
+    cleaning_estimate_thresholds(nthreads, gfiles, num_gfiles, true, 1,
+                                 &est_min_covg);
+  }
+
   // Load graph into a single colour
   GraphLoadingPrefs gprefs = graph_loading_prefs(&db_graph);
 
@@ -313,10 +362,12 @@ int ctx_clean(int argc, char **argv)
   // if(unitig_min <= 0 || covg_before_path || len_before_path)
   // {
     // Get coverage distribution and estimate cleaning threshold
-    int est_min_covg = cleaning_get_threshold(nthreads,
-                                              covg_before_path,
-                                              len_before_path,
-                                              visited, &db_graph);
+    if(!est_before_load) {
+      est_min_covg = cleaning_get_threshold(nthreads,
+                                            covg_before_path,
+                                            len_before_path,
+                                            visited, &db_graph);
+    }
 
     if(est_min_covg < 0) status("Cannot find recommended cleaning threshold");
     else status("Recommended cleaning threshold is: %i", est_min_covg);
@@ -342,9 +393,15 @@ int ctx_clean(int argc, char **argv)
   if(unitig_min || min_keep_tip)
   {
     // Clean graph of tips (if min_keep_tip > 0) and unitigs (if threshold > 0)
-    clean_graph(nthreads, unitig_min, min_keep_tip,
-                covg_after_path, len_after_path,
-                visited, keep, &db_graph);
+    if(max_rounds < 0) {
+      clean_graph(nthreads, unitig_min, min_keep_tip,
+                  covg_after_path, len_after_path,
+                  visited, keep, &db_graph);
+    } else {
+      clean_graph_iterate(nthreads, unitig_min, min_keep_tip, max_rounds,
+                          covg_after_path, len_after_path,
+                          visited, keep, &db_graph);
+    }
   }
 
   ctx_free(visited);
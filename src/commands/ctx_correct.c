@@ -35,6 +35,8 @@ const char correct_usage[] =
 "  -l, --min-frag-len <bp>  Min fragment size for --seq2 [default:"QUOTE_VALUE(DEFAULT_CRTALN_FRAGLEN_MIN)"]\n"
 "  -L, --max-frag-len <bp>  Max fragment size for --seq2 [default:"QUOTE_VALUE(DEFAULT_CRTALN_FRAGLEN_MAX)"]\n"
 "\n"
+HTS_READ_USAGE
+"\n"
 "  Correction:\n"
 "  -w, --one-way            Use one-way gap filling (conservative)\n"
 "  -W, --two-way            Use two-way gap filling (liberal)\n"
@@ -98,6 +100,8 @@ static struct option longopts[] =
   // {"print-contigs", no_argument,       NULL, 'x'},
   // {"print-paths",   no_argument,       NULL, 'y'},
   // {"print-reads",   no_argument,       NULL, 'z'},
+// SAM/BAM/CRAM input
+  HTS_READ_LONGOPTS,
   {NULL, 0, NULL, 0}
 };
 
@@ -202,7 +206,8 @@ int ctx_correct(int argc, char **argv)
 
   // Load path files
   for(i = 0; i < gpfiles->len; i++) {
-    gpath_reader_load(&gpfiles->b[i], GPATH_DIE_MISSING_KMERS, &db_graph);
+    gpath_reader_load_mt(&gpfiles->b[i], GPATH_DIE_MISSING_KMERS,
+                         args.nthreads, &db_graph);
     gpath_reader_close(&gpfiles->b[i]);
   }
 
@@ -10,6 +10,8 @@
 
 #include "carrays/carrays.h" // gca_median_size()
 
+#include <pthread.h>
+
 #define DEFAULT_MAX_DIST 6
 #define DEFAULT_MAX_COVG 100
 
@@ -23,6 +25,7 @@ const char links_usage[] =
 "  -q,--quiet              Silence status output normally printed to STDERR\n"
 "  -f,--force              Overwrite output files\n"
 "  -o,--out <out.ctp.gz>   Save output link file [default: STDOUT]\n"
+"  -t,--threads <T>        Number of threads to clean with [default: 1]\n"
 "\n"
 "  -L,--limit <N>          Only use links from first N kmers\n"
 "\n"
@@ -42,6 +45,7 @@ static struct option longopts[] =
   {"help",         no_argument,       NULL, 'h'},
   {"out",          required_argument, NULL, 'o'},
   {"force",        no_argument,       NULL, 'f'},
+  {"threads",      required_argument, NULL, 't'},
 // command specific
   {"list",         required_argument, NULL, 'l'},
   {"clean",        required_argument, NULL, 'c'},
@@ -55,28 +59,338 @@ static struct option longopts[] =
   {NULL, 0, NULL, 0}
 };
 
-// Creates <base>.tmp.<rand>
-static FILE* create_tmp_file(StrBuf *path, const char *base)
+//
+// Pipeline: the main thread reads kmers and their links into batches, worker
+// threads build, clean and print a LinkTree for each kmer, and a writer
+// thread writes finished batches to output files in input order.
+//
+
+#define LINKS_BATCH_KMERS 1024
+#define LINKS_BATCH_BYTES ONE_MEGABYTE
+
+enum LinkBatchState { LBATCH_EMPTY, LBATCH_READ, LBATCH_CLEANED };
+
+typedef struct
+{
+  size_t first_knum, nkmers;
+  StrBuf strs; // kmers, junctions and sequences, each NUL terminated
+  // per kmer: kmer offset, nlinks;
+  // per link: fw, covg, njuncs, juncs offset, seq offset, junction positions
+  SizeBuffer nums;
+  StrBuf list_out, ctp_out, plot_out;
+  enum LinkBatchState state;
+} LinkBatch;
+
+typedef struct
+{
+  // Options
+  size_t kmer_size, cutoff, plot_kmer_idx, hist_distsize, hist_covgsize;
+  bool clean, list, save, plot, hist_covg;
+
+  // Output files
+  FILE *list_fh, *link_tmp_fh, *plot_fh;
+  const char *csv_out_path, *link_tmp_path, *plot_out_path;
+
+  // Batch i is in batches[i % nbatches]
+  LinkBatch *batches;
+  size_t nbatches, num_read, next_clean, next_write;
+  bool read_done;
+  pthread_mutex_t lock;
+  pthread_cond_t cond; // signalled when any batch changes state
+} LinkCleaner;
+
+typedef struct
+{
+  pthread_t thread;
+  LinkCleaner *lc;
+  LinkTree ltree;
+  LinkTreeStats stats;
+  uint64_t *hists; // hist_distsize x hist_covgsize
+} LinkWorker;
+
+static inline void _links_set_state(LinkCleaner *lc, LinkBatch *batch,
+                                    enum LinkBatchState state)
+{
+  pthread_mutex_lock(&lc->lock);
+  batch->state = state;
+  pthread_cond_broadcast(&lc->cond);
+  pthread_mutex_unlock(&lc->lock);
+}
+
+static void _links_clean_batch(LinkWorker *wrkr, LinkBatch *batch)
+{
+  const LinkCleaner *lc = wrkr->lc;
+  LinkTree *ltree = &wrkr->ltree;
+  const char *strs = batch->strs.b, *kmer;
+  size_t *nums = batch->nums.b;
+  size_t i, j, knum, nlinks, njuncs, num_links, init_num_links;
+
+  for(i = 0; i < batch->nkmers; i++)
+  {
+    knum = batch->first_knum + i;
+    kmer = strs + nums[0];
+    nlinks = nums[1];
+    nums += 2;
+
+    ltree_reset(ltree);
+    for(j = 0; j < nlinks; j++, nums += 5+njuncs) {
+      njuncs = nums[2];
+      ltree_add(ltree, nums[0], nums[1], nums+5, strs+nums[3], strs+nums[4]);
+    }
+
+    if(lc->hist_covg) {
+      ltree_update_covg_hists(ltree, wrkr->hists,
+                              lc->hist_distsize, lc->hist_covgsize);
+    }
+    if(lc->clean) ltree_clean(ltree, lc->cutoff);
+
+    // Accumulate statistics
+    init_num_links = wrkr->stats.num_links;
+    ltree_get_stats(ltree, &wrkr->stats);
+    num_links = wrkr->stats.num_links - init_num_links;
+
+    if(lc->list) ltree_write_list(ltree, &batch->list_out);
+    if(lc->save && num_links)
+      ltree_write_ctp(ltree, kmer, num_links, &batch->ctp_out);
+    if(lc->plot && knum == lc->plot_kmer_idx) {
+      status("Plotting tree...");
+      ltree_write_dot(ltree, &batch->plot_out);
+    }
+  }
+}
+
+static void* _links_worker(void *arg)
+{
+  LinkWorker *wrkr = (LinkWorker*)arg;
+  LinkCleaner *lc = wrkr->lc;
+  LinkBatch *batch;
+
+  while(1)
+  {
+    pthread_mutex_lock(&lc->lock);
+    while(lc->next_clean == lc->num_read && !lc->read_done)
+      pthread_cond_wait(&lc->cond, &lc->lock);
+    if(lc->next_clean == lc->num_read) {
+      pthread_mutex_unlock(&lc->lock);
+      break;
+    }
+    batch = &lc->batches[lc->next_clean++ % lc->nbatches];
+    pthread_mutex_unlock(&lc->lock);
+
+    _links_clean_batch(wrkr, batch);
+    _links_set_state(lc, batch, LBATCH_CLEANED);
+  }
+
+  return NULL;
+}
+
+static void _links_fwrite(const StrBuf *sbuf, FILE *fh, const char *path)
+{
+  if(sbuf->end && fwrite(sbuf->b, 1, sbuf->end, fh) != sbuf->end)
+    die("Cannot write to file: %s [%s]", path, strerror(errno));
+}
+
+static void* _links_writer(void *arg)
+{
+  LinkCleaner *lc = (LinkCleaner*)arg;
+  LinkBatch *batch;
+
+  while(1)
+  {
+    pthread_mutex_lock(&lc->lock);
+    while(lc->next_write < lc->num_read ?
+          lc->batches[lc->next_write % lc->nbatches].state != LBATCH_CLEANED :
+          !lc->read_done)
+      pthread_cond_wait(&lc->cond, &lc->lock);
+    if(lc->next_write == lc->num_read) {
+      pthread_mutex_unlock(&lc->lock);
+      break;
+    }
+    batch = &lc->batches[lc->next_write++ % lc->nbatches];
+    pthread_mutex_unlock(&lc->lock);
+
+    if(lc->list) _links_fwrite(&batch->list_out, lc->list_fh, lc->csv_out_path);
+    if(lc->save) _links_fwrite(&batch->ctp_out, lc->link_tmp_fh, lc->link_tmp_path);
+    if(lc->plot) _links_fwrite(&batch->plot_out, lc->plot_fh, lc->plot_out_path);
+
+    strbuf_reset(&batch->list_out);
+    strbuf_reset(&batch->ctp_out);
+    strbuf_reset(&batch->plot_out);
+    _links_set_state(lc, batch, LBATCH_EMPTY);
+  }
+
+  return NULL;
+}
+
+// Append a NUL terminated string to the batch, returns its offset
+static inline size_t _links_batch_str(LinkBatch *batch, const StrBuf *sbuf)
+{
+  size_t offset = batch->strs.end;
+  strbuf_append_strn(&batch->strs, sbuf->b, sbuf->end);
+  strbuf_append_char(&batch->strs, '\0');
+  return offset;
+}
+
+// Read input into batches for the worker threads, stop after `limit` kmers
+// if limit > 0
+static void _links_read(LinkCleaner *lc, GPathReader *ctpin, size_t limit)
+{
+  SizeBuffer countbuf, jposbuf;
+  size_buf_alloc(&countbuf, 16);
+  size_buf_alloc(&jposbuf, 1024);
+
+  StrBuf kmerbuf, juncsbuf, seqbuf;
+  strbuf_alloc(&kmerbuf, 1024);
+  strbuf_alloc(&juncsbuf, 1024);
+  strbuf_alloc(&seqbuf, 1024);
+
+  LinkBatch *batch;
+  bool link_fw, more = true;
+  size_t i, njuncs, nlinks, num_links_exp = 0, knum = 0, nlinks_idx;
+
+  while(more && (!limit || knum < limit))
+  {
+    batch = &lc->batches[lc->num_read % lc->nbatches];
+
+    // Wait for writer to finish with this batch
+    pthread_mutex_lock(&lc->lock);
+    while(batch->state != LBATCH_EMPTY) pthread_cond_wait(&lc->cond, &lc->lock);
+    pthread_mutex_unlock(&lc->lock);
+
+    strbuf_reset(&batch->strs);
+    size_buf_reset(&batch->nums);
+    batch->first_knum = knum;
+    batch->nkmers = 0;
+
+    while(batch->nkmers < LINKS_BATCH_KMERS &&
+          batch->strs.end < LINKS_BATCH_BYTES &&
+          (!limit || knum < limit))
+    {
+      if(!gpath_reader_read_kmer(ctpin, &kmerbuf, &num_links_exp)) {
+        more = false;
+        break;
+      }
+      ctx_assert2(kmerbuf.end == lc->kmer_size, "Kmer incorrect length %zu != %zu",
+                  kmerbuf.end, lc->kmer_size);
+
+      size_buf_add(&batch->nums, _links_batch_str(batch, &kmerbuf));
+      nlinks_idx = size_buf_add(&batch->nums, 0);
+
+      for(nlinks = 0;
+          gpath_reader_read_link(ctpin, &link_fw, &njuncs,
+                                 &countbuf, &juncsbuf,
+                                 &seqbuf, &jposbuf);
+          nlinks++)
+      {
+        size_buf_add(&batch->nums, link_fw);
+        size_buf_add(&batch->nums, countbuf.b[0]);
+        size_buf_add(&batch->nums, juncsbuf.end);
+        size_buf_add(&batch->nums, _links_batch_str(batch, &juncsbuf));
+        size_buf_add(&batch->nums, _links_batch_str(batch, &seqbuf));
+        for(i = 0; i < juncsbuf.end; i++) size_buf_add(&batch->nums, jposbuf.b[i]);
+      }
+
+      if(nlinks != num_links_exp)
+        warn("Links count mismatch %zu != %zu", nlinks, num_links_exp);
+
+      batch->nums.b[nlinks_idx] = nlinks;
+      batch->nkmers++;
+      knum++;
+    }
+
+    if(batch->nkmers) {
+      pthread_mutex_lock(&lc->lock);
+      batch->state = LBATCH_READ;
+      lc->num_read++;
+      pthread_cond_broadcast(&lc->cond);
+      pthread_mutex_unlock(&lc->lock);
+    }
+  }
+
+  pthread_mutex_lock(&lc->lock);
+  lc->read_done = true;
+  pthread_cond_broadcast(&lc->cond);
+  pthread_mutex_unlock(&lc->lock);
+
+  size_buf_dealloc(&countbuf);
+  size_buf_dealloc(&jposbuf);
+  strbuf_dealloc(&kmerbuf);
+  strbuf_dealloc(&juncsbuf);
+  strbuf_dealloc(&seqbuf);
+}
+
+// Clean all links with `nthreads` workers. Merges per-thread link stats into
+// `tree_stats` and coverage histograms into `hists` if lc->hist_covg
+static void links_clean_mt(LinkCleaner *lc, GPathReader *ctpin, size_t limit,
+                           size_t nthreads, LinkTreeStats *tree_stats,
+                           uint64_t *hists)
 {
-  size_t i;
-  const size_t attempt_limit = 100;
-  FILE *fh;
-
-  for(i = 0; i < attempt_limit; i++) {
-    size_t r = rand() % 9999;
-    strbuf_reset(path);
-    strbuf_sprintf(path, "%s.tmp.%04zu", base, r);
-    if(!futil_file_exists(path->b)) break;
+  size_t i, j, nhist = lc->hist_distsize * lc->hist_covgsize;
+  int rc;
+
+  lc->nbatches = 2*nthreads+2;
+  lc->batches = ctx_calloc(lc->nbatches, sizeof(LinkBatch));
+  lc->num_read = lc->next_clean = lc->next_write = 0;
+  lc->read_done = false;
+  pthread_mutex_init(&lc->lock, NULL);
+  pthread_cond_init(&lc->cond, NULL);
+
+  for(i = 0; i < lc->nbatches; i++) {
+    LinkBatch *batch = &lc->batches[i];
+    strbuf_alloc(&batch->strs, LINKS_BATCH_BYTES+1024);
+    size_buf_alloc(&batch->nums, 1024);
+    strbuf_alloc(&batch->list_out, 1024);
+    strbuf_alloc(&batch->ctp_out, 1024);
+    strbuf_alloc(&batch->plot_out, 1024);
+    batch->state = LBATCH_EMPTY;
+  }
+
+  LinkWorker *workers = ctx_calloc(nthreads, sizeof(LinkWorker));
+  pthread_t writer;
+
+  for(i = 0; i < nthreads; i++) {
+    workers[i].lc = lc;
+    ltree_alloc(&workers[i].ltree, lc->kmer_size);
+    if(lc->hist_covg) workers[i].hists = ctx_calloc(nhist, sizeof(uint64_t));
+    rc = pthread_create(&workers[i].thread, NULL, _links_worker, &workers[i]);
+    if(rc != 0) die("Creating thread failed: %s", strerror(rc));
   }
-  if(i == attempt_limit)
-    die("Temporary files already exist (%zu tries): %s", attempt_limit, path->b);
 
-  if((fh = futil_fopen_create(path->b, "r+")) == NULL) {
-    die("Cannot write temporary file: %s [%s]", path->b, strerror(errno));
+  rc = pthread_create(&writer, NULL, _links_writer, lc);
+  if(rc != 0) die("Creating thread failed: %s", strerror(rc));
+
+  _links_read(lc, ctpin, limit);
+
+  for(i = 0; i < nthreads; i++) {
+    rc = pthread_join(workers[i].thread, NULL);
+    if(rc != 0) die("Joining thread failed: %s", strerror(rc));
+  }
+  rc = pthread_join(writer, NULL);
+  if(rc != 0) die("Joining thread failed: %s", strerror(rc));
+
+  // Merge results
+  for(i = 0; i < nthreads; i++) {
+    tree_stats->num_trees_with_links += workers[i].stats.num_trees_with_links;
+    tree_stats->num_links += workers[i].stats.num_links;
+    tree_stats->num_link_bytes += workers[i].stats.num_link_bytes;
+    for(j = 0; lc->hist_covg && j < nhist; j++) hists[j] += workers[i].hists[j];
+    ltree_dealloc(&workers[i].ltree);
+    ctx_free(workers[i].hists);
+  }
+  ctx_free(workers);
+
+  for(i = 0; i < lc->nbatches; i++) {
+    LinkBatch *batch = &lc->batches[i];
+    strbuf_dealloc(&batch->strs);
+    size_buf_dealloc(&batch->nums);
+    strbuf_dealloc(&batch->list_out);
+    strbuf_dealloc(&batch->ctp_out);
+    strbuf_dealloc(&batch->plot_out);
   }
+  ctx_free(lc->batches);
 
-  unlink(path->b); // Immediately unlink to hide temp file
-  return fh;
+  pthread_cond_destroy(&lc->cond);
+  pthread_mutex_destroy(&lc->lock);
 }
 
 static void print_suggest_cutoff(size_t hist_distsize, size_t hist_covgsize,
@@ -116,7 +430,7 @@ static void print_suggest_cutoff(size_t hist_distsize, size_t hist_covgsize,
 
 int ctx_links(int argc, char **argv)
 {
-  size_t limit = 0;
+  size_t limit = 0, nthreads = 0;
   const char *link_out_path = NULL, *csv_out_path = NULL, *plot_out_path = NULL;
   const char *thresh_path = NULL, *hist_path = NULL;
 
@@ -137,6 +451,7 @@ int ctx_links(int argc, char **argv)
       case 'h': cmd_print_usage(NULL); break;
       case 'o': cmd_check(!link_out_path, cmd); link_out_path = optarg; break;
       case 'f': cmd_check(!futil_get_force(), cmd); futil_set_force(true); break;
+      case 't': cmd_check(!nthreads, cmd); nthreads = cmd_uint32_nonzero(cmd, optarg); break;
       case 'l': cmd_check(!csv_out_path, cmd); csv_out_path = optarg; break;
       case 'c': cmd_check(!cutoff, cmd); cutoff = cmd_size(cmd, optarg); clean = true; break;
       case 'L': cmd_check(!limit, cmd); limit = cmd_size(cmd, optarg); break;
@@ -157,6 +472,7 @@ int ctx_links(int argc, char **argv)
   if(hist_covgsize && !hist_path) cmd_print_usage("--max-covg without --covg-hist");
 
   // Defaults
+  if(!nthreads) nthreads = 1;
   if(!hist_distsize) hist_distsize = DEFAULT_MAX_DIST;
   if(!hist_covgsize) hist_covgsize = DEFAULT_MAX_COVG;
 
@@ -240,7 +556,7 @@ int ctx_links(int argc, char **argv)
       die("Cannot find required header entries");
 
     // Create a random temporary file
-    link_tmp_fh = create_tmp_file(&link_tmp_path, link_out_path);
+    link_tmp_fh = futil_create_tmp_file(&link_tmp_path, link_out_path);
 
     status("Saving output to: %s", link_out_path);
     status("Temporary output: %s", link_tmp_path.b);
@@ -271,86 +587,22 @@ int ctx_links(int argc, char **argv)
       die("Cannot open output .dot file %s", plot_out_path);
   }
 
-  SizeBuffer countbuf, jposbuf;
-  size_buf_alloc(&countbuf, 16);
-  size_buf_alloc(&jposbuf, 1024);
-
-  StrBuf kmerbuf, juncsbuf, seqbuf, outbuf;
-  strbuf_alloc(&kmerbuf, 1024);
-  strbuf_alloc(&juncsbuf, 1024);
-  strbuf_alloc(&seqbuf, 1024);
-  strbuf_alloc(&outbuf, 1024);
-
-  bool link_fw;
-  size_t njuncs;
-  size_t knum, nlinks, num_links_exp = 0;
-
-  LinkTree ltree;
-  ltree_alloc(&ltree, kmer_size);
-
   LinkTreeStats tree_stats;
   memset(&tree_stats, 0, sizeof(tree_stats));
-  size_t init_num_links = 0, num_links = 0;
-
-  for(knum = 0; !limit || knum < limit; knum++)
-  {
-    ltree_reset(&ltree);
-    if(!gpath_reader_read_kmer(&ctpin, &kmerbuf, &num_links_exp)) break;
-    ctx_assert2(kmerbuf.end == kmer_size, "Kmer incorrect length %zu != %zu",
-                kmerbuf.end, kmer_size);
-    // status("kmer: %s", kmerbuf.b);
-
-    for(nlinks = 0;
-        gpath_reader_read_link(&ctpin, &link_fw, &njuncs,
-                               &countbuf, &juncsbuf,
-                               &seqbuf, &jposbuf);
-        nlinks++)
-    {
-      ltree_add(&ltree, link_fw, countbuf.b[0], jposbuf.b,
-                juncsbuf.b, seqbuf.b);
-    }
 
-    if(nlinks != num_links_exp)
-      warn("Links count mismatch %zu != %zu", nlinks, num_links_exp);
+  LinkCleaner lc = {.kmer_size = kmer_size, .cutoff = cutoff,
+                    .plot_kmer_idx = plot_kmer_idx,
+                    .hist_distsize = hist_distsize,
+                    .hist_covgsize = hist_covgsize,
+                    .clean = clean, .list = list, .save = save, .plot = plot,
+                    .hist_covg = hist_covg,
+                    .list_fh = list_fh, .link_tmp_fh = link_tmp_fh,
+                    .plot_fh = plot_fh, .csv_out_path = csv_out_path,
+                    .link_tmp_path = link_tmp_path.b,
+                    .plot_out_path = plot_out_path};
 
-    if(hist_covg)
-    {
-      ltree_update_covg_hists(&ltree, (uint64_t*)hists,
-                              hist_distsize, hist_covgsize);
-    }
-    if(clean)
-    {
-      ltree_clean(&ltree, cutoff);
-    }
-
-    // Accumulate statistics
-    ltree_get_stats(&ltree, &tree_stats);
-    num_links = tree_stats.num_links - init_num_links;
-    init_num_links = tree_stats.num_links;
-
-    if(list)
-    {
-      ltree_write_list(&ltree, &outbuf);
-      if(fwrite(outbuf.b, 1, outbuf.end, list_fh) != outbuf.end)
-        die("Cannot write CSV file to: %s", csv_out_path);
-      strbuf_reset(&outbuf);
-    }
-    if(save && num_links)
-    {
-      ltree_write_ctp(&ltree, kmerbuf.b, num_links, &outbuf);
-      if(fwrite(outbuf.b, 1, outbuf.end, link_tmp_fh) != outbuf.end)
-        die("Cannot write ctp file to: %s", link_tmp_path.b);
-      strbuf_reset(&outbuf);
-    }
-    if(plot && knum == plot_kmer_idx)
-    {
-      status("Plotting tree...");
-      ltree_write_dot(&ltree, &outbuf);
-      if(fwrite(outbuf.b, 1, outbuf.end, plot_fh) != outbuf.end)
-        die("Cannot write plot DOT file to: %s", plot_out_path);
-      strbuf_reset(&outbuf);
-    }
-  }
+  if(nthreads > 1) status("Cleaning links with %zu threads", nthreads);
+  links_clean_mt(&lc, &ctpin, limit, nthreads, &tree_stats, (uint64_t*)hists);
 
   gpath_reader_close(&ctpin);
 
@@ -429,13 +681,6 @@ int ctx_links(int argc, char **argv)
   ctx_free(hists);
   cJSON_Delete(newhdr);
   strbuf_dealloc(&link_tmp_path);
-  ltree_dealloc(&ltree);
-  size_buf_dealloc(&countbuf);
-  size_buf_dealloc(&jposbuf);
-  strbuf_dealloc(&kmerbuf);
-  strbuf_dealloc(&juncsbuf);
-  strbuf_dealloc(&seqbuf);
-  strbuf_dealloc(&outbuf);
 
   return EXIT_SUCCESS;
 }
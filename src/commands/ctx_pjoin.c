@@ -7,6 +7,7 @@
 #include "gpath_reader.h"
 #include "gpath_checks.h"
 #include "gpath_save.h"
+#include "gpath_merge.h"
 
 const char pjoin_usage[] =
 "usage: "CMD" pjoin [options] <in1.ctp> [[offset:]in2.ctp[:0,2-4] ...]\n"
@@ -16,7 +17,7 @@ const char pjoin_usage[] =
 "  -h, --help             This help message\n"
 "  -q, --quiet            Silence status output normally printed to STDERR\n"
 "  -f, --force            Overwrite output files\n"
-"  -o, --out <out.ctp>    Output file [required]\n"
+"  -o, --out <out.ctp>    Output file [required] (.ctpb => binary format)\n"
 "  -m, --memory <mem>     Memory to use (required) recommend 80G for human\n"
 "  -n, --nkmers <nkmers>  Number of hash table entries (e.g. 1G ~ 1 billion)\n"
 "  -t, --threads <T>      Number of threads to use [default: "QUOTE_VALUE(DEFAULT_NTHREADS)"]\n"
@@ -24,6 +25,9 @@ const char pjoin_usage[] =
 "  -g, --graph <in.ctx>   Get number of hash table entries from graph file\n"
 "  -c, --outcols <C>      How many 'colours' should the output file have\n"
 "  -r, --noredundant      Remove redundant paths\n"
+"  -s, --sorted           Inputs are sorted by kmer (see `"CMD" sort`), merge them\n"
+"                         one kmer at a time in constant memory (-m,-n ignored)\n"
+"                         Binary link files (.ctpb) are always sorted\n"
 "\n"
 "  Files can be specified with specific colours: samples.ctp:2,3\n"
 "  Offset specifies where to load the first colour: 3:samples.ctp\n"
@@ -42,6 +46,7 @@ static struct option longopts[] =
   {"graph",        required_argument, NULL, 'g'},
   {"outcols",      required_argument, NULL, 'c'},
   {"noredundant",  required_argument, NULL, 'r'},
+  {"sorted",       no_argument,       NULL, 's'},
   {NULL, 0, NULL, 0}
 };
 
@@ -49,7 +54,7 @@ int ctx_pjoin(int argc, char **argv)
 {
   size_t nthreads = 0;
   struct MemArgs memargs = MEM_ARGS_INIT;
-  bool noredundant = false;
+  bool noredundant = false, sorted = false;
   size_t output_ncols = 0;
   char *graph_file = NULL;
   const char *out_ctp_path = NULL;
@@ -76,6 +81,7 @@ int ctx_pjoin(int argc, char **argv)
       case 'g': cmd_check(!graph_file,cmd); graph_file = optarg; break;
       case 'c': cmd_check(!output_ncols, cmd); output_ncols = cmd_uint32_nonzero(cmd, optarg); break;
       case 'r': cmd_check(!noredundant,cmd); noredundant = true; break;
+      case 's': cmd_check(!sorted,cmd); sorted = true; break;
       case ':': /* BADARG */
       case '?': /* BADCH getopt_long has already printed error */
         // cmd_print_usage(NULL);
@@ -90,6 +96,11 @@ int ctx_pjoin(int argc, char **argv)
   if(out_ctp_path == NULL) cmd_print_usage("--out <out.ctp> required");
   if(optind >= argc) cmd_print_usage("Please specify at least one input file");
 
+  // Output file type
+  bool out_binary = gpath_save_is_binary(out_ctp_path);
+  if(sorted && out_binary)
+    cmd_print_usage("--sorted cannot write binary output (.ctpb)");
+
   // argi .. argend-1 are graphs to load
   size_t num_pfiles = (size_t)(argc - optind);
   char **paths = argv + optind;
@@ -154,46 +165,74 @@ int ctx_pjoin(int argc, char **argv)
   //               ctp_max_kmers);
   // }
 
-  //
-  // Decide on memory
-  //
-  size_t bits_per_kmer, kmers_in_hash, graph_mem, path_mem, total_mem;
-
-  // Each kmer stores a pointer to its list of paths
-  bits_per_kmer = sizeof(BinaryKmer)*8 + sizeof(GPath*)*8;
-
-  kmers_in_hash = cmd_get_kmers_in_hash(memargs.mem_to_use,
-                                        memargs.mem_to_use_set,
-                                        memargs.num_kmers,
-                                        memargs.num_kmers_set,
-                                        bits_per_kmer,
-                                        ctp_max_kmers, ctp_sum_kmers,
-                                        false, &graph_mem);
-
-  // Paths memory
-  size_t rem_mem = memargs.mem_to_use - MIN2(memargs.mem_to_use, graph_mem);
-  path_mem = gpath_reader_mem_req(pfiles, num_pfiles, output_ncols, rem_mem, true);
-
-  // Shift path store memory from graphs->paths
-  graph_mem -= sizeof(GPath*)*kmers_in_hash;
-  path_mem  += sizeof(GPath*)*kmers_in_hash;
-  cmd_print_mem(path_mem, "paths");
-
-  total_mem = graph_mem + path_mem;
-
-  cmd_check_mem_limit(memargs.mem_to_use, total_mem);
-
-  // Open output file
-  gzFile gzout = futil_gzopen_create(out_ctp_path, "w");
-
   // Set up graph and PathStore
   size_t kmer_size = gpath_reader_get_kmer_size(&pfiles[0]);
   dBGraph db_graph;
-  db_graph_alloc(&db_graph, kmer_size, output_ncols, 0, kmers_in_hash, 0);
 
-  // Create a path store that tracks path counts
-  gpath_reader_alloc_gpstore(pfiles, num_pfiles,
-                             path_mem, true, &db_graph);
+  // Threads that print and compress output, each needs its own buffers
+  size_t output_threads = MIN2(nthreads, MAX_IO_THREADS);
+  size_t output_mem = 0;
+
+  if(sorted)
+  {
+    // Links are streamed one kmer at a time. We only need a graph for sample
+    // names and a path store with the right number of colours for the header
+    size_t sorted_capacity = 1024;
+    output_mem = MIN2(memargs.mem_to_use, chunk_writer_mem(1, CHUNK_WRITER_SIZE));
+    cmd_print_mem(output_mem, "output buffers");
+    db_graph_alloc(&db_graph, kmer_size, output_ncols, 0, sorted_capacity, 0);
+    gpath_store_alloc(&db_graph.gpstore, output_ncols, db_graph.ht.capacity,
+                      0, db_graph.ht.capacity*sizeof(GPath*) + ONE_MEGABYTE,
+                      true, false);
+  }
+  else
+  {
+    //
+    // Decide on memory
+    //
+    size_t bits_per_kmer, kmers_in_hash, graph_mem, path_mem, total_mem;
+
+    // Each kmer stores a pointer to its list of paths
+    bits_per_kmer = sizeof(BinaryKmer)*8 + sizeof(GPath*)*8;
+
+    kmers_in_hash = cmd_get_kmers_in_hash(memargs.mem_to_use,
+                                          memargs.mem_to_use_set,
+                                          memargs.num_kmers,
+                                          memargs.num_kmers_set,
+                                          bits_per_kmer,
+                                          ctp_max_kmers, ctp_sum_kmers,
+                                          false, &graph_mem);
+
+    // Paths memory, keeping back the smallest output buffers
+    size_t output_min = out_binary ? 0 : chunk_writer_mem(1, CHUNK_WRITER_MIN_SIZE);
+    size_t output_max = chunk_writer_mem(output_threads, CHUNK_WRITER_SIZE);
+    size_t rem_mem = memargs.mem_to_use - MIN2(memargs.mem_to_use,
+                                               graph_mem + output_min);
+    path_mem = gpath_reader_mem_req(pfiles, num_pfiles, output_ncols, rem_mem, true);
+
+    // Output buffers also get whatever is left over, up to what they can use
+    if(!out_binary)
+      output_mem = output_min + MIN2(rem_mem - path_mem, output_max - output_min);
+
+    // Shift path store memory from graphs->paths
+    graph_mem -= sizeof(GPath*)*kmers_in_hash;
+    path_mem  += sizeof(GPath*)*kmers_in_hash;
+    cmd_print_mem(path_mem, "paths");
+    if(!out_binary) cmd_print_mem(output_mem, "output buffers");
+
+    total_mem = graph_mem + path_mem + output_mem;
+
+    cmd_check_mem_limit(memargs.mem_to_use, total_mem);
+
+    db_graph_alloc(&db_graph, kmer_size, output_ncols, 0, kmers_in_hash, 0);
+
+    // Create a path store that tracks path counts
+    gpath_reader_alloc_gpstore(pfiles, num_pfiles,
+                               path_mem, true, &db_graph);
+  }
+
+  // Open output file
+  FILE *fout = futil_fopen_create(out_ctp_path, "w");
 
   for(i = 0; i < num_pfiles; i++)
     gpath_reader_load_sample_names(&pfiles[i], &db_graph);
@@ -214,30 +253,46 @@ int ctx_pjoin(int argc, char **argv)
     }
   }
 
-  // Load path files
-  for(i = 0; i < num_pfiles; i++)
-    gpath_reader_load(&pfiles[i], GPATH_ADD_MISSING_KMERS, &db_graph);
-
-  status("Got %zu path bytes", (size_t)db_graph.gpstore.path_bytes);
-
-  size_t output_threads = MIN2(nthreads, MAX_IO_THREADS);
-
   cJSON **hdrs = ctx_calloc(num_pfiles, sizeof(cJSON*));
   for(i = 0; i < num_pfiles; i++) hdrs[i] = pfiles[i].json;
 
-  // Write output file
-  gpath_save(gzout, out_ctp_path, output_threads, false,
-             NULL, NULL, hdrs, num_pfiles,
-             contig_histgrms, output_ncols,
-             &db_graph);
+  if(sorted)
+  {
+    // Stream merge, never holds more than one kmer's links
+    gpath_merge_sorted(pfiles, num_pfiles, fout, out_ctp_path,
+                       output_mem, false,
+                       NULL, NULL, hdrs, num_pfiles,
+                       contig_histgrms, output_ncols, &db_graph);
+  }
+  else
+  {
+    // Load path files
+    for(i = 0; i < num_pfiles; i++)
+      gpath_reader_load_mt(&pfiles[i], GPATH_ADD_MISSING_KMERS,
+                           nthreads, &db_graph);
+
+    status("Got %zu path bytes", (size_t)db_graph.gpstore.path_bytes);
+
+    // Write output file
+    if(out_binary) {
+      gpath_save_binary(fout, out_ctp_path, NULL, NULL, hdrs, num_pfiles,
+                        contig_histgrms, output_ncols, &db_graph);
+    } else {
+      gpath_save(fout, out_ctp_path, output_threads, output_mem, false,
+                 NULL, NULL, hdrs, num_pfiles,
+                 contig_histgrms, output_ncols,
+                 &db_graph);
+    }
+  }
+
+  ctx_free(hdrs);
 
   for(i = 0; i < output_ncols; i++)
     zsize_buf_dealloc(&contig_histgrms[i]);
 
   ctx_free(contig_histgrms);
 
-  gzclose(gzout);
-  ctx_free(hdrs);
+  fclose(fout);
 
   // Close ctp files
   // Don't close until now since we were using their headers in the output file
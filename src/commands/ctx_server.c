@@ -94,7 +94,7 @@ static inline void kmer_response(StrBuf *resp, dBNode node, const char *keystr,
   size_t nlinks;
   const GPath *gpath = gpath_store_safe_fetch(&db_graph->gpstore, node.key);
   const GPathSet *gpset = &db_graph->gpstore.gpset;
-  for(nlinks = 0; gpath != NULL; gpath = gpath->next, nlinks++)
+  for(nlinks = 0; gpath != NULL; gpath = gpath_next(gpath), nlinks++)
   {
     if(nlinks) strbuf_append_str(resp, pretty ? ",\n            " : ", ");
     strbuf_append_str(resp, "{\"forward\": ");
@@ -103,7 +103,7 @@ static inline void kmer_response(StrBuf *resp, dBNode node, const char *keystr,
 
     // Print link sequence
     for(i = 0; i < gpath->num_juncs; i++)
-      strbuf_append_char(resp, dna_nuc_to_char(binary_seq_get(gpath->seq, i)));
+      strbuf_append_char(resp, dna_nuc_to_char(binary_seq_get(gpath_seq(gpath), i)));
 
     // Print link colours
     // counts may be null if user did not specify -C,--coverages
@@ -5,13 +5,15 @@
 #include "graphs_load.h"
 #include "graph_writer.h"
 #include "binary_kmer.h"
-
-// TODO: add .ctp.gz sorting
+#include "gpath_reader.h"
+#include "gpath_save.h"
+#include "json_hdr.h"
 
 const char sort_usage[] =
-"usage: "CMD" sort [options] <in.ctx>\n"
+"usage: "CMD" sort [options] <in.ctx|in.ctp.gz>\n"
 "\n"
-"  Sort a cortex graph file.\n"
+"  Sort a cortex graph file or link file by kmer. Link files are read into\n"
+"  memory and require -o; -m and -n are ignored for link files.\n"
 "\n"
 "  -h, --help              This help message\n"
 "  -q, --quiet             Silence status output normally printed to STDERR\n"
@@ -47,6 +49,103 @@ static inline void sort_block(char **entries, size_t num)
   qsort(entries, num, sizeof(char*), binary_kmers_qcmp_ptrs);
 }
 
+typedef struct
+{
+  BinaryKmer bkey;
+  size_t offset, len; // kmer line and its links in text
+} LinkEntry;
+
+static int _link_entry_cmp(const void *aa, const void *bb)
+{
+  const LinkEntry *a = (const LinkEntry*)aa, *b = (const LinkEntry*)bb;
+  return binary_kmers_cmp(a->bkey, b->bkey);
+}
+
+// Sort the entries of a text link file by kmer. Comments are not copied.
+static void sort_link_file(const char *in_path, const char *out_path)
+{
+  GPathReader ctpin;
+  memset(&ctpin, 0, sizeof(ctpin));
+  gpath_reader_open(&ctpin, in_path);
+
+  if(gpath_reader_is_binary(&ctpin))
+    die("Binary link files are already sorted by kmer: %s", in_path);
+  if(!file_filter_is_direct(&ctpin.fltr))
+    die("Cannot open link file with a filter ('in.ctp:blah' syntax)");
+
+  const size_t kmer_size = gpath_reader_get_kmer_size(&ctpin);
+  gzFile gzout = futil_gzopen_create(out_path, "w");
+
+  // Read whole file, one NUL terminated line after another
+  StrBuf text;
+  strbuf_alloc(&text, 16 * ONE_MEGABYTE);
+  size_t start, end, i, nentries = 0, entries_cap = 1024;
+  LinkEntry *entries = ctx_malloc(entries_cap * sizeof(LinkEntry));
+
+  while(gpath_reader_append_line(&ctpin, &text, &start))
+  {
+    const char *line = text.b + start;
+    if(char_is_acgt(line[0])) {
+      if(line[kmer_size] != ' ')
+        die("Bad kmer line [%s]: %s", in_path, line);
+      if(nentries == entries_cap) {
+        entries_cap *= 2;
+        entries = ctx_realloc(entries, entries_cap * sizeof(LinkEntry));
+      }
+      entries[nentries].bkey = binary_kmer_from_str(line, kmer_size);
+      entries[nentries].offset = start;
+      nentries++;
+    }
+    else if(nentries == 0)
+      die("Link before first kmer [%s]: %s", in_path, line);
+  }
+
+  char nentries_str[50], mem_str[50];
+  ulong_to_str(nentries, nentries_str);
+  bytes_to_str(text.end + nentries*sizeof(LinkEntry), 1, mem_str);
+  status("Read %s kmers with links using %s of memory", nentries_str, mem_str);
+
+  // Entries run from one kmer line to the next
+  for(i = 0; i < nentries; i++) {
+    end = (i+1 < nentries ? entries[i+1].offset : text.end);
+    entries[i].len = end - entries[i].offset;
+  }
+
+  for(i = 0; i < text.end; i++)
+    if(text.b[i] == '\0') text.b[i] = '\n';
+
+  qsort(entries, nentries, sizeof(LinkEntry), _link_entry_cmp);
+
+  for(i = 1; i < nentries; i++) {
+    if(binary_kmers_are_equal(entries[i-1].bkey, entries[i].bkey)) {
+      die("Kmer appears more than once [%s]: %.*s", in_path,
+          (int)kmer_size, text.b + entries[i].offset);
+    }
+  }
+
+  // Write header with this command added
+  cJSON *json = cJSON_Duplicate(ctpin.json, 1);
+  json_hdr_add_curr_cmd(json, out_path);
+  json_hdr_gzprint(json, gzout);
+  cJSON_Delete(json);
+  gzputs(gzout, ctp_explanation_comment);
+
+  // Write entries in kmer order
+  for(i = 0; i < nentries; i++) {
+    if(gzwrite(gzout, text.b + entries[i].offset, entries[i].len) !=
+       (int)entries[i].len) {
+      die("Cannot write to output: %s", out_path);
+    }
+  }
+
+  gzclose(gzout);
+  gpath_reader_close(&ctpin);
+  ctx_free(entries);
+  strbuf_dealloc(&text);
+
+  status("Sorted links written to: %s", out_path);
+}
+
 int ctx_sort(int argc, char **argv)
 {
   const char *out_path = NULL;
@@ -79,10 +178,20 @@ int ctx_sort(int argc, char **argv)
   }
 
   if(optind+1 != argc)
-    cmd_print_usage("Require exactly one input graph file (.ctx)");
+    cmd_print_usage("Require exactly one input file (.ctx or .ctp.gz)");
 
   const char *ctx_path = argv[optind];
 
+  // Link files are text so we sort them separately
+  if(futil_path_has_extension(ctx_path, ".ctp.gz") ||
+     futil_path_has_extension(ctx_path, ".ctp") ||
+     futil_path_has_extension(ctx_path, ".ctpb"))
+  {
+    if(out_path == NULL) cmd_print_usage("-o <out.ctp.gz> required for link files");
+    sort_link_file(ctx_path, out_path);
+    return EXIT_SUCCESS;
+  }
+
   //
   // Open Graph file
   //
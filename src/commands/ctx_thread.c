@@ -8,6 +8,8 @@
 #include "gpath_reader.h"
 #include "gpath_checks.h"
 #include "gpath_save.h"
+#include "gpath_stage.h"
+#include "gpath_spill.h"
 
 const char thread_usage[] =
 "usage: "CMD" thread [options] <in.ctx>\n"
@@ -19,7 +21,7 @@ const char thread_usage[] =
 "  -h, --help               This help message\n"
 "  -q, --quiet              Silence status output normally printed to STDERR\n"
 "  -f, --force              Overwrite output files\n"
-"  -o, --out <out.ctp.gz>   Save output file [required]\n"
+"  -o, --out <out.ctp.gz>   Save output file [required] (.ctpb => binary format)\n"
 "  -m, --memory <mem>       Memory to use (e.g. 1M, 20GB)\n"
 "  -n, --nkmers <N>         Number of hash table entries (e.g. 1G ~ 1 billion)\n"
 "  -t, --threads <T>        Number of threads to use [default: "QUOTE_VALUE(DEFAULT_NTHREADS)"]\n"
@@ -38,6 +40,8 @@ const char thread_usage[] =
 "  -l, --min-frag-len <bp>  Min fragment size for --seq2 [default:"QUOTE_VALUE(DEFAULT_CRTALN_FRAGLEN_MIN)"]\n"
 "  -L, --max-frag-len <bp>  Max fragment size for --seq2 [default:"QUOTE_VALUE(DEFAULT_CRTALN_FRAGLEN_MAX)"]\n"
 "\n"
+HTS_READ_USAGE
+"\n"
 "  Path Params:\n"
 "  -w, --one-way            Use one-way gap filling (conservative) [default]\n"
 "  -W, --two-way            Use two-way gap filling (liberal)\n"
@@ -50,12 +54,17 @@ const char thread_usage[] =
 "  -G, --frag-hist <o.csv>  Save size distribution of PE fragments\n"
 "\n"
 "  -u, --use-new-paths      Use paths as they are being added (higher err rate) [default: no]\n"
+"  -S, --link-mem <mem>     Memory for links [default: all left after graph]\n"
 "\n"
 "  Debugging Options: Probably best not to touch these\n"
 "    -x,--print-contigs -y,--print-paths -z,--print-reads\n"
 "\n"
 "  When loading existing paths with -p, use offset (e.g. 2:in.ctp) to specify\n"
 "  which colour to load the data into. See `"CMD" pjoin` to combine .ctp files\n"
+"\n"
+"  If links fill the memory given, they are written to temporary files\n"
+"  <out>.spill.N and merged when saving. Only with text output to a file and\n"
+"  without -p or -u, otherwise running out of memory for links is an error.\n"
 "\n";
 
 static struct option longopts[] =
@@ -91,10 +100,13 @@ static struct option longopts[] =
   {"frag-hist",     required_argument, NULL, 'G'},
 //
   {"use-new-paths", no_argument,       NULL, 'u'},
+  {"link-mem",      required_argument, NULL, 'S'},
 // Debug options
   {"print-contigs", no_argument,       NULL, 'x'},
   {"print-paths",   no_argument,       NULL, 'y'},
   {"print-reads",   no_argument,       NULL, 'z'},
+// SAM/BAM/CRAM input
+  HTS_READ_LONGOPTS,
   {NULL, 0, NULL, 0}
 };
 
@@ -137,16 +149,26 @@ int ctx_thread(int argc, char **argv)
                                         gfile->num_of_kmers,
                                         false, &graph_mem);
 
+  // Each thread collects new paths before adding them to the graph, using at
+  // most an eighth of the memory not needed by the graph
+  size_t stage_cap, stage_mem;
+  stage_mem = args.memargs.mem_to_use > graph_mem ?
+              (args.memargs.mem_to_use - graph_mem) / 8 : 0;
+  stage_cap = gpath_stage_fit(stage_mem / args.nthreads);
+  stage_mem = args.nthreads * gpath_stage_mem(stage_cap);
+  cmd_print_mem(stage_mem, "paths staging");
+
   // Paths memory
   size_t min_path_mem = 0;
   gpath_reader_sum_mem(gpfiles->b, gpfiles->len, 1, true, true, &min_path_mem);
 
-  if(graph_mem + min_path_mem > args.memargs.mem_to_use) {
+  if(graph_mem + stage_mem + min_path_mem > args.memargs.mem_to_use) {
     char buf[50];
-    die("Require at least %s memory", bytes_to_str(graph_mem+min_path_mem, 1, buf));
+    die("Require at least %s memory",
+        bytes_to_str(graph_mem+stage_mem+min_path_mem, 1, buf));
   }
 
-  path_mem = args.memargs.mem_to_use - graph_mem;
+  path_mem = args.memargs.mem_to_use - graph_mem - stage_mem;
   size_t pentry_hash_mem = sizeof(GPEntry)/0.7;
   size_t pentry_store_mem = sizeof(GPath) + 8 + // struct + sequence
                             1 + // in colour
@@ -154,18 +176,27 @@ int ctx_thread(int argc, char **argv)
                             sizeof(uint32_t); // kmer length
 
   size_t max_paths = path_mem / (pentry_store_mem + pentry_hash_mem);
+  if(args.link_mem)
+    max_paths = MIN2(max_paths,
+                     args.link_mem / (pentry_store_mem + pentry_hash_mem));
   path_store_mem = max_paths * pentry_store_mem;
   path_hash_mem = max_paths * pentry_hash_mem;
   cmd_print_mem(path_hash_mem, "paths hash");
   cmd_print_mem(path_store_mem, "paths store");
 
-  total_mem = graph_mem + path_mem;
+  // Output buffers reuse the paths hash memory, which is freed before saving
+  size_t output_threads = MIN2(args.nthreads, MAX_IO_THREADS);
+  size_t output_mem = MIN2(path_hash_mem,
+                           chunk_writer_mem(output_threads, CHUNK_WRITER_SIZE));
+
+  total_mem = graph_mem + stage_mem + path_mem;
   cmd_check_mem_limit(args.memargs.mem_to_use, total_mem);
 
   //
   // Open output file
   //
-  gzFile gzout = futil_gzopen_create(args.out_ctp_path, "w");
+  bool out_binary = gpath_save_is_binary(args.out_ctp_path);
+  FILE *fout = futil_fopen_create(args.out_ctp_path, "w");
 
   status("Creating paths file: %s", futil_outpath_str(args.out_ctp_path));
 
@@ -179,9 +210,11 @@ int ctx_thread(int argc, char **argv)
 
   // Split path memory 2:1 between store and hash
   // Create a path store that tracks path counts
+  // Per kmer link list heads are already counted in bits_per_kmer
   gpath_store_alloc(&db_graph.gpstore,
-                    db_graph.num_of_cols, db_graph.ht.capacity,
-                    0, path_store_mem, true, sep_path_list);
+                    db_graph.num_of_cols, db_graph.ht.capacity, 0,
+                    path_store_mem + db_graph.ht.capacity*sizeof(GPath*),
+                    true, sep_path_list);
 
   // Create path hash table for fast lookup
   gpath_hash_alloc(&db_graph.gphash, &db_graph.gpstore, path_hash_mem);
@@ -192,11 +225,16 @@ int ctx_thread(int argc, char **argv)
     status("Not using new paths as they are added (safe)");
   }
 
+  // Links can only be written out and cleared if nothing reads them
+  // Spill files are named after the output file, so not with STDOUT
+  bool spill_links = (!out_binary && gpfiles->len == 0 && !args.use_new_paths &&
+                      strcmp(args.out_ctp_path, "-") != 0);
+
   //
   // Start up workers to add paths to the graph
   //
   GenPathWorker *workers;
-  workers = gen_paths_workers_alloc(args.nthreads, &db_graph);
+  workers = gen_paths_workers_alloc(args.nthreads, stage_cap, &db_graph);
 
   // Path statistics
   SeqLoadingStats *load_stats = gen_paths_get_stats(workers);
@@ -221,7 +259,8 @@ int ctx_thread(int argc, char **argv)
 
   // Load existing paths
   for(i = 0; i < gpfiles->len; i++)
-    gpath_reader_load(&gpfiles->b[i], GPATH_DIE_MISSING_KMERS, &db_graph);
+    gpath_reader_load_mt(&gpfiles->b[i], GPATH_DIE_MISSING_KMERS,
+                         args.nthreads, &db_graph);
 
   // zero link counts of already loaded links
   if(args.zero_link_counts) {
@@ -232,6 +271,12 @@ int ctx_thread(int argc, char **argv)
   if(!args.use_new_paths)
     gpath_store_split_read_write(&db_graph.gpstore);
 
+  GPathSpill spill;
+  if(spill_links) {
+    gpath_spill_alloc(&spill, args.out_ctp_path, true, &db_graph);
+    gen_paths_workers_set_gate(workers, args.nthreads, &spill.gate);
+  }
+
   // Deal with a set of files at once
   // Can have different numbers of inputs vs threads
   size_t start, end;
@@ -256,8 +301,6 @@ int ctx_thread(int argc, char **argv)
   cJSON **hdrs = ctx_malloc(gpfiles->len * sizeof(cJSON*));
   for(i = 0; i < gpfiles->len; i++) hdrs[i] = gpfiles->b[i].json;
 
-  size_t output_threads = MIN2(args.nthreads, MAX_IO_THREADS);
-
   // Generate a cJSON header for all inputs
   cJSON *thread_hdr = cJSON_CreateObject();
   cJSON *inputs_hdr = cJSON_CreateArray();
@@ -266,14 +309,26 @@ int ctx_thread(int argc, char **argv)
     cJSON_AddItemToArray(inputs_hdr, correct_aln_input_json_hdr(&inputs->b[i]));
 
   // Write output file
-  gpath_save(gzout, args.out_ctp_path, output_threads, true,
-             "thread", thread_hdr, hdrs, gpfiles->len,
-             &aln_stats->contig_histgrm, 1,
-             &db_graph);
-
-  gzclose(gzout);
+  if(spill_links && spill.num_spills > 0) {
+    gpath_spill_merge(&spill, fout, args.out_ctp_path, output_mem,
+                      "thread", thread_hdr, hdrs, gpfiles->len,
+                      &aln_stats->contig_histgrm, 1);
+  }
+  else if(out_binary) {
+    gpath_save_binary(fout, args.out_ctp_path, "thread", thread_hdr,
+                      hdrs, gpfiles->len, &aln_stats->contig_histgrm, 1,
+                      &db_graph);
+  } else {
+    gpath_save(fout, args.out_ctp_path, output_threads, output_mem, true,
+               "thread", thread_hdr, hdrs, gpfiles->len,
+               &aln_stats->contig_histgrm, 1,
+               &db_graph);
+  }
+  fclose(fout);
   ctx_free(hdrs);
 
+  if(spill_links) gpath_spill_dealloc(&spill);
+
   // Optionally run path checks for debugging
   // gpath_checks_all_paths(&db_graph, args.nthreads);
 
@@ -9,11 +9,15 @@
 #include "graphs_load.h"
 #include "gpath_checks.h"
 #include "unitig_graph.h"
+#include "unitig_index.h"
+#include "chunk_writer.h"
 
 const char unitigs_usage[] =
 "usage: "CMD" unitigs [options] <in.ctx> [<in2.ctx> ...]\n"
+"       "CMD" unitigs [options] <in.ctu>\n"
 "\n"
-"  Print unitigs with k-1 bases of overlap.\n"
+"  Print unitigs with k-1 bases of overlap. Input can be graph files or a\n"
+"  unitig index (.ctu) saved with --index, which does not need loading.\n"
 "\n"
 "  -h, --help            This help message\n"
 "  -q, --quiet           Silence status output normally printed to STDERR\n"
@@ -27,6 +31,8 @@ const char unitigs_usage[] =
 "  -g, --gfa             Print in Graphical Fragment Assembly (GFA) format\n"
 "  -d, --dot             Print in graphviz (DOT) format\n"
 "  -P, --points          Used with --dot, print contigs as points\n"
+"  -x, --index <out.ctu> Save unitig index (unitigs, links and kmer positions)\n"
+"  -z, --gzip            gzip output, in parallel (default if --out ends .gz)\n"
 "\n"
 "  e.g. "CMD" unitigs --dot in.ctx | dot -Tpdf > in.pdf\n"
 "\n";
@@ -45,6 +51,8 @@ static struct option longopts[] =
   {"gfa",          no_argument,       NULL, 'g'},
   {"dot",          no_argument,       NULL, 'd'},
   {"points",       no_argument,       NULL, 'P'},
+  {"index",        required_argument, NULL, 'x'},
+  {"gzip",         no_argument,       NULL, 'z'},
   {NULL, 0, NULL, 0}
 };
 
@@ -63,31 +71,67 @@ typedef struct
   const dBGraph *db_graph;
   size_t nthreads;
   uint8_t *visited;
+  uint8_t *linkbits; // one bit per kmer, orientation and nucleotide (8 bits)
   UnitigSyntax syntax;
-  FILE *fout;
-  pthread_mutex_t outlock;
+  ChunkWriter writer;
   UnitigKmerGraph ugraph;
   volatile size_t num_unitigs;
 } UnitigPrinter;
 
+// Append unitig sequence to buffer
+static inline void _strbuf_append_nodes(StrBuf *sbuf, const dBNode *nodes,
+                                        size_t n, const dBGraph *db_graph)
+{
+  strbuf_ensure_capacity(sbuf, sbuf->end + n + db_graph->kmer_size);
+  sbuf->end += db_nodes_to_str(nodes, n, db_graph, sbuf->b + sbuf->end);
+}
+
+// An edge can be seen from the unitigs at either end. Returns true if we are
+// first to claim it and should print it.
+static inline bool _claim_edge(UnitigPrinter *p, dBNode node, BinaryKmer bkey,
+                               dBNode next, Nucleotide nuc)
+{
+  size_t kmer_size = p->db_graph->kmer_size;
+  size_t bit;
+  bool got_lock = false;
+
+  // Same edge from the other side: leave `next` reverse complemented,
+  // adding the last base of reverse complemented `node`
+  if(node.key < next.key ||
+     (node.key == next.key && node.orient <= !next.orient)) {
+    bit = (size_t)node.key*8 + node.orient*4 + nuc;
+  } else {
+    nuc = bkmer_get_last_nuc(bkey, !node.orient, kmer_size);
+    bit = (size_t)next.key*8 + (!next.orient)*4 + nuc;
+  }
+
+  bitlock_try_acquire(p->linkbits, bit, &got_lock);
+  return got_lock;
+}
+
 /**
- * @param right_edge is true iff we this kmer is the last in a unitig, and we
- *                   are leaving by the forward strand
+ * Print links leaving one end of a unitig, to unitigs that have already been
+ * stored. Unitigs stored after us print the link when they are stored.
+ * @param right_edge is true iff we are leaving the last kmer of the unitig by
+ *                   the forward strand
  */
-static inline void _print_edge(hkey_t node, bool right_edge,
-                               BinaryKmer bkey, Edges edges,
-                               UnitigEnd uend0,
-                               UnitigPrinter *p)
+static inline void _print_links(UnitigPrinter *p, dBNode node, bool right_edge,
+                                size_t uid0, StrBuf *sbuf)
 {
   // DOT: leave from east end if +, west end if -
   //      connect to west end if +, east end if -
   const char dot_exit[2] = "ew", dot_join[2] = "we", gfa_orient[2] = "+-";
+  const volatile UnitigEnd *unitig_ends = p->ugraph.unitig_ends;
   size_t i, n;
   dBNode next_nodes[4];
   Nucleotide next_nucs[4];
-  Orientation orient = right_edge ? uend0.rorient : !uend0.lorient;
+  UnitigEnd uend1;
 
-  n = db_graph_next_nodes(p->db_graph, bkey, orient, edges,
+  BinaryKmer bkey = db_node_get_bkmer(p->db_graph, node.key);
+  Edges edges = db_node_get_edges(p->db_graph, node.key, 0);
+  if(!right_edge) node.orient = !node.orient;
+
+  n = db_graph_next_nodes(p->db_graph, bkey, node.orient, edges,
                           next_nodes, next_nucs);
 
   // Unitig orientations
@@ -96,156 +140,196 @@ static inline void _print_edge(hkey_t node, bool right_edge,
 
   for(i = 0; i < n; i++)
   {
-    UnitigEnd uend1 = p->ugraph.unitig_ends[next_nodes[i].key];
-
-    // Debugging
-    if(!uend1.assigned) {
-      char tmpstr[100];
-      db_node_to_str(p->db_graph, next_nodes[i], tmpstr);
-      status(" -> node %zu [%s]", (size_t)uend1.unitigid, tmpstr);
-    }
+    uend1 = unitig_ends[next_nodes[i].key];
+    if(!uend1.assigned) continue;
 
-    ctx_assert(next_nodes[i].key != HASH_NOT_FOUND);
-    ctx_assert(uend1.assigned);
     ctx_assert((uend1.left  && next_nodes[i].orient ==  uend1.lorient) ||
                (uend1.right && next_nodes[i].orient == !uend1.rorient));
 
-    ut_or1 = uend1.left && next_nodes[i].orient ==  uend1.lorient ? FORWARD : REVERSE;
-
-    // Don't do reverse-to-reverse links when node links to itself,
-    // these are duplicates of forward-to-forward
-    if(node < next_nodes[i].key ||
-       (node == next_nodes[i].key && ut_or0 + ut_or1 < 2))
-    {
-      pthread_mutex_lock(&p->outlock);
-
-      switch(p->syntax) {
-        case PRINT_DOT:
-          fprintf(p->fout, "  node%zu:%c -> node%zu:%c\n",
-                  (size_t)uend0.unitigid, dot_exit[ut_or0],
-                  (size_t)uend1.unitigid, dot_join[ut_or1]);
-          break;
-        case PRINT_GFA:
-          fprintf(p->fout, "L\tnode%zu\t%c\tnode%zu\t%c\t%zuM\n",
-                  (size_t)uend0.unitigid, gfa_orient[ut_or0],
-                  (size_t)uend1.unitigid, gfa_orient[ut_or1],
-                  p->db_graph->kmer_size - 1);
-          break;
-        default: die("Bad syntax: %i", p->syntax);
-      }
-
-      pthread_mutex_unlock(&p->outlock);
-    }
-  }
-}
-
-// For every kmer in the graph, we run this function
-static inline bool print_edges(hkey_t hkey, size_t threadid, void *arg)
-{
-  (void)threadid;
-  UnitigPrinter *p = (UnitigPrinter*)arg;
-  UnitigEnd uend = p->ugraph.unitig_ends[hkey];
+    ut_or1 = uend1.left && next_nodes[i].orient == uend1.lorient ? FORWARD : REVERSE;
 
-  // Check if node is an end of a unitig
-  if(uend.assigned) {
-    BinaryKmer bkey = db_node_get_bkmer(p->db_graph, hkey);
-    Edges edges = db_node_get_edges(p->db_graph, hkey, 0);
+    if(!_claim_edge(p, node, bkey, next_nodes[i], next_nucs[i])) continue;
 
-    if(uend.left) {
-      _print_edge(hkey, false, bkey, edges, uend, p);
-    }
-    if(uend.right) {
-      _print_edge(hkey, true, bkey, edges, uend, p);
+    if(p->syntax == PRINT_DOT) {
+      strbuf_sprintf(sbuf, "  node%zu:%c -> node%zu:%c\n",
+                     uid0, dot_exit[ut_or0],
+                     (size_t)uend1.unitigid, dot_join[ut_or1]);
+    } else {
+      strbuf_sprintf(sbuf, "L\tnode%zu\t%c\tnode%zu\t%c\t%zuM\n",
+                     uid0, gfa_orient[ut_or0],
+                     (size_t)uend1.unitigid, gfa_orient[ut_or1],
+                     p->db_graph->kmer_size - 1);
     }
   }
-
-  return false; // keep iterating
 }
 
 // Does not allocate ugraph
 void unitig_printer_init(UnitigPrinter *printer, const dBGraph *db_graph,
-                         size_t nthreads, UnitigSyntax syntax, FILE *fout)
+                         size_t nthreads, UnitigSyntax syntax)
 {
   memset(printer, 0, sizeof(UnitigPrinter));
   printer->db_graph = db_graph;
   printer->syntax = syntax;
-  printer->fout = fout;
   printer->nthreads = nthreads;
   printer->num_unitigs = 0;
   printer->visited = ctx_calloc(roundup_bits2bytes(db_graph->ht.capacity), 1);
-  if(pthread_mutex_init(&printer->outlock, NULL) != 0) die("Mutex init failed");
 }
 
 void unitig_printer_destroy(UnitigPrinter *printer)
 {
-  pthread_mutex_destroy(&printer->outlock);
   unitig_graph_dealloc(&printer->ugraph);
   ctx_free(printer->visited);
+  ctx_free(printer->linkbits);
 }
 
-static void print_unitig_fasta(dBNodeBuffer nbuf, size_t threadid, void *arg)
+// Each thread prints into its own buffer. For GFA and DOT, a unitig is given
+// an ID when stored, then we print links to any neighbours that already have
+// one. Segments and links are printed in a single pass.
+static void print_unitig(dBNodeBuffer nbuf, size_t threadid, void *arg)
 {
-  (void)threadid;
   UnitigPrinter *p = (UnitigPrinter*)arg;
-  pthread_mutex_lock(&p->outlock);
-  size_t idx = p->num_unitigs++;
-  fprintf(p->fout, ">unitig%zu\n", idx);
-  db_nodes_print(nbuf.b, nbuf.len, p->db_graph, p->fout);
-  fputc('\n', p->fout);
-  pthread_mutex_unlock(&p->outlock);
-}
+  StrBuf *sbuf = chunk_writer_buf(&p->writer, threadid);
+  size_t uid;
 
-static void print_unitig_dot(const dBNode *nodes, size_t num_nodes,
-                             size_t unitig_idx, void *arg)
-{
-  UnitigPrinter *p = (UnitigPrinter*)arg;
-  pthread_mutex_lock(&p->outlock);
-  fprintf(p->fout, "  node%zu [label=", unitig_idx);
-  db_nodes_print(nodes, num_nodes, p->db_graph, p->fout);
-  fputs("]\n", p->fout);
-  pthread_mutex_unlock(&p->outlock);
+  if(p->syntax == PRINT_FASTA)
+  {
+    uid = __sync_fetch_and_add(&p->num_unitigs, 1);
+    strbuf_sprintf(sbuf, ">unitig%zu\n", uid);
+    _strbuf_append_nodes(sbuf, nbuf.b, nbuf.len, p->db_graph);
+    strbuf_append_char(sbuf, '\n');
+  }
+  else
+  {
+    supernode_normalise(nbuf.b, nbuf.len, p->db_graph);
+    uid = unitig_graph_store_end_mt(nbuf.b, nbuf.len, &p->ugraph);
+
+    // Our ends must be visible to other threads before we look at theirs,
+    // otherwise we could both miss a link
+    __sync_synchronize();
+
+    if(p->syntax == PRINT_GFA) strbuf_sprintf(sbuf, "S\tnode%zu\t", uid);
+    else strbuf_sprintf(sbuf, "  node%zu [label=", uid);
+    _strbuf_append_nodes(sbuf, nbuf.b, nbuf.len, p->db_graph);
+    strbuf_append_str(sbuf, p->syntax == PRINT_GFA ? "\n" : "]\n");
+
+    _print_links(p, nbuf.b[0], false, uid, sbuf);
+    _print_links(p, nbuf.b[nbuf.len-1], true, uid, sbuf);
+  }
+
+  chunk_writer_done(&p->writer, threadid);
 }
 
-static void print_dot_syntax(UnitigPrinter *p, bool dot_use_points)
+static void print_unitigs(UnitigPrinter *p, bool dot_use_points)
 {
-  fputs("digraph G {\n", p->fout);
-  fputs("  edge [dir=both arrowhead=none arrowtail=none color=\"blue\"]\n", p->fout);
-  fprintf(p->fout, "  node [%s, fontname=courier, fontsize=9]\n",
-          dot_use_points ? "shape=point, label=none" : "shape=none");
+  StrBuf *sbuf = chunk_writer_buf(&p->writer, 0);
+  size_t i;
+
+  if(p->syntax == PRINT_GFA) strbuf_append_str(sbuf, "H\tVN:Z:1.0\n");
+  else if(p->syntax == PRINT_DOT) {
+    strbuf_append_str(sbuf, "digraph G {\n");
+    strbuf_append_str(sbuf, "  edge [dir=both arrowhead=none arrowtail=none color=\"blue\"]\n");
+    strbuf_sprintf(sbuf, "  node [%s, fontname=courier, fontsize=9]\n",
+                   dot_use_points ? "shape=point, label=none" : "shape=none");
+  }
+  chunk_writer_flush(&p->writer, 0);
+
+  if(p->syntax != PRINT_FASTA)
+    p->linkbits = ctx_calloc(p->db_graph->ht.capacity, 1);
 
-  unitig_graph_create(&p->ugraph, p->nthreads, p->visited,
-                      print_unitig_dot, p);
+  status("Printing unitigs in %s using %zu threads",
+         syntax_strs[p->syntax], p->nthreads);
 
-  p->num_unitigs = p->ugraph.num_unitigs;
+  supernodes_iterate(p->nthreads, p->visited, p->db_graph, print_unitig, p);
 
-  // Now print edges
-  fputc('\n', p->fout);
-  hash_table_iterate(&p->db_graph->ht, p->nthreads, print_edges, p);
-  fputs("}\n", p->fout);
+  if(p->syntax != PRINT_FASTA) p->num_unitigs = p->ugraph.num_unitigs;
+
+  if(p->syntax == PRINT_DOT) {
+    for(i = 0; i < p->nthreads; i++) chunk_writer_flush(&p->writer, i);
+    strbuf_append_str(chunk_writer_buf(&p->writer, 0), "}\n");
+  }
 }
 
+//
+// Print from a unitig index, unitigs are named by their index ID
+//
 
-static void print_unitig_gfa(const dBNode *nodes, size_t num_nodes,
-                             size_t unitig_idx, void *arg)
+// Each link is stored from both ends, only print one of them
+static inline bool _index_link_print(size_t uid0, Orientation or0,
+                                     size_t uid1, Orientation or1)
 {
-  UnitigPrinter *p = (UnitigPrinter*)arg;
-  pthread_mutex_lock(&p->outlock);
-  fprintf(p->fout, "S\tnode%zu\t", unitig_idx);
-  db_nodes_print(nodes, num_nodes, p->db_graph, p->fout);
-  fputc('\n', p->fout);
-  pthread_mutex_unlock(&p->outlock);
+  return uid0 < uid1 || (uid0 == uid1 && or0 + or1 < 2);
 }
 
-static void print_gfa_syntax(UnitigPrinter *p)
+static void _print_index_links(const UnitigIndex *ui, size_t uid,
+                               UnitigSyntax syntax, StrBuf *out)
 {
-  fputs("H\tVN:Z:1.0\n", p->fout);
+  const char dot_exit[2] = "ew", dot_join[2] = "we", gfa_orient[2] = "+-";
+  const uint64_t *links;
+  size_t i, n, uid1;
+  Orientation or0, or1;
+
+  for(or0 = 0; or0 < 2; or0++) {
+    n = unitig_index_links(ui, uid, or0, &links);
+    for(i = 0; i < n; i++) {
+      uid1 = unitig_link_id(links[i]);
+      or1 = unitig_link_orient(links[i]);
+      if(!_index_link_print(uid, or0, uid1, or1)) continue;
+      if(syntax == PRINT_DOT) {
+        strbuf_sprintf(out, "  node%zu:%c -> node%zu:%c\n",
+                       uid, dot_exit[or0], uid1, dot_join[or1]);
+      } else {
+        strbuf_sprintf(out, "L\tnode%zu\t%c\tnode%zu\t%c\t%zuM\n",
+                       uid, gfa_orient[or0], uid1, gfa_orient[or1],
+                       ui->kmer_size - 1);
+      }
+    }
+  }
+}
 
-  unitig_graph_create(&p->ugraph, p->nthreads, p->visited,
-                      print_unitig_gfa, p);
+// Unitigs are printed in ID order so output does not depend on threads
+static void print_from_index(const UnitigIndex *ui, UnitigSyntax syntax,
+                             bool dot_use_points, ChunkWriter *writer)
+{
+  size_t uid;
+  StrBuf *out = chunk_writer_buf(writer, 0);
+  StrBuf sbuf;
+  strbuf_alloc(&sbuf, 1024);
+
+  if(syntax == PRINT_GFA) strbuf_append_str(out, "H\tVN:Z:1.0\n");
+  if(syntax == PRINT_DOT) {
+    strbuf_append_str(out, "digraph G {\n");
+    strbuf_append_str(out, "  edge [dir=both arrowhead=none arrowtail=none color=\"blue\"]\n");
+    strbuf_sprintf(out, "  node [%s, fontname=courier, fontsize=9]\n",
+                   dot_use_points ? "shape=point, label=none" : "shape=none");
+  }
+
+  for(uid = 0; uid < ui->num_unitigs; uid++)
+  {
+    strbuf_reset(&sbuf);
+    unitig_index_seq(ui, uid, FORWARD, &sbuf);
+    switch(syntax) {
+      case PRINT_FASTA: strbuf_sprintf(out, ">unitig%zu\n%s\n", uid, sbuf.b); break;
+      case PRINT_GFA:
+        // Links only need unitig IDs so can be printed with each segment
+        strbuf_sprintf(out, "S\tnode%zu\t%s\n", uid, sbuf.b);
+        _print_index_links(ui, uid, syntax, out);
+        break;
+      case PRINT_DOT: strbuf_sprintf(out, "  node%zu [label=%s]\n", uid, sbuf.b); break;
+      default: die("Bad syntax: %i", syntax);
+    }
+    chunk_writer_done(writer, 0);
+  }
+
+  if(syntax == PRINT_DOT) {
+    strbuf_append_char(out, '\n');
+    for(uid = 0; uid < ui->num_unitigs; uid++) {
+      _print_index_links(ui, uid, syntax, out);
+      chunk_writer_done(writer, 0);
+    }
+    strbuf_append_str(out, "}\n");
+  }
 
-  p->num_unitigs = p->ugraph.num_unitigs;
-  // Now print edges
-  hash_table_iterate(&p->db_graph->ht, p->nthreads, print_edges, p);
+  strbuf_dealloc(&sbuf);
 }
 
 // Returns 0 on success, otherwise != 0
@@ -253,9 +337,9 @@ int ctx_unitigs(int argc, char **argv)
 {
   size_t nthreads = 0;
   struct MemArgs memargs = MEM_ARGS_INIT;
-  const char *out_path = NULL;
+  const char *out_path = NULL, *index_path = NULL;
   UnitigSyntax syntax = PRINT_FASTA;
-  bool dot_use_points = false;
+  bool dot_use_points = false, gzip_out = false;
 
   // Arg parsing
   char cmd[100];
@@ -280,6 +364,8 @@ int ctx_unitigs(int argc, char **argv)
       case 'g': cmd_check(!syntax, cmd); syntax = PRINT_GFA; break;
       case 'd': cmd_check(!syntax, cmd); syntax = PRINT_DOT; break;
       case 'P': cmd_check(!dot_use_points, cmd); dot_use_points = true; break;
+      case 'x': cmd_check(!index_path, cmd); index_path = optarg; break;
+      case 'z': cmd_check(!gzip_out, cmd); gzip_out = true; break;
       case ':': /* BADARG */
       case '?': /* BADCH getopt_long has already printed error */
         die("`"CMD" unitigs -h` for help. Bad option: %s", argv[optind-1]);
@@ -294,6 +380,9 @@ int ctx_unitigs(int argc, char **argv)
   if(out_path == NULL) out_path = "-";
   if(nthreads == 0) nthreads = DEFAULT_NTHREADS;
 
+  size_t outlen = strlen(out_path);
+  if(outlen > 3 && strcmp(out_path+outlen-3, ".gz") == 0) gzip_out = true;
+
   if(optind >= argc) cmd_print_usage(NULL);
 
   size_t i, num_gfiles = (size_t)(argc - optind);
@@ -304,6 +393,29 @@ int ctx_unitigs(int argc, char **argv)
 
   ctx_assert(num_gfiles > 0);
 
+  // Print from an existing unitig index
+  size_t pathlen = strlen(gfile_paths[0]);
+  if(pathlen > 4 && strcmp(gfile_paths[0]+pathlen-4, ".ctu") == 0)
+  {
+    if(num_gfiles > 1) cmd_print_usage("Only one unitig index (.ctu) allowed");
+    if(index_path) cmd_print_usage("Input is already a unitig index");
+    UnitigIndex uindex;
+    unitig_index_open(&uindex, gfile_paths[0]);
+    status("Output in %s format to %s\n", syntax_strs[syntax],
+           futil_outpath_str(out_path));
+    FILE *fout = futil_fopen_create(out_path, "w");
+    ChunkWriter writer;
+    chunk_writer_alloc(&writer, fout, out_path, 1, CHUNK_WRITER_SIZE, gzip_out);
+    print_from_index(&uindex, syntax, dot_use_points, &writer);
+    chunk_writer_dealloc(&writer);
+    fclose(fout);
+    char num_unitigs_str[50];
+    ulong_to_str(uindex.num_unitigs, num_unitigs_str);
+    status("Dumped %s unitigs\n", num_unitigs_str);
+    unitig_index_close(&uindex);
+    return EXIT_SUCCESS;
+  }
+
   // Open graph files
   GraphFileReader *gfiles = ctx_calloc(num_gfiles, sizeof(GraphFileReader));
   size_t ctx_max_kmers = 0, ctx_sum_kmers = 0;
@@ -317,7 +429,9 @@ int ctx_unitigs(int argc, char **argv)
   size_t bits_per_kmer, kmers_in_hash, graph_mem;
 
   bits_per_kmer = sizeof(BinaryKmer)*8 + sizeof(Edges)*8 + 1;
-  if(syntax != PRINT_FASTA) bits_per_kmer += sizeof(UnitigEnd) * 8;
+  if(syntax != PRINT_FASTA || index_path) bits_per_kmer += sizeof(UnitigEnd) * 8;
+  if(syntax != PRINT_FASTA && !index_path) bits_per_kmer += 8; // link bits
+  if(index_path) bits_per_kmer += sizeof(UnitigKmer) * 8 + 4; // + 2bit seq
 
   kmers_in_hash = cmd_get_kmers_in_hash(memargs.mem_to_use,
                                         memargs.mem_to_use_set,
@@ -329,8 +443,8 @@ int ctx_unitigs(int argc, char **argv)
 
   cmd_check_mem_limit(memargs.mem_to_use, graph_mem);
 
-  status("Output in %s format to %s\n", syntax_strs[syntax],
-         futil_outpath_str(out_path));
+  status("Output in %s format to %s%s\n", syntax_strs[syntax],
+         futil_outpath_str(out_path), gzip_out ? " (gzip)" : "");
 
   //
   // Open output file
@@ -347,9 +461,9 @@ int ctx_unitigs(int argc, char **argv)
                  DBG_ALLOC_EDGES);
 
   UnitigPrinter printer;
-  unitig_printer_init(&printer, &db_graph, nthreads, syntax, fout);
+  unitig_printer_init(&printer, &db_graph, nthreads, syntax);
 
-  if(syntax == PRINT_DOT || syntax == PRINT_GFA)
+  if(syntax == PRINT_DOT || syntax == PRINT_GFA || index_path)
     unitig_graph_alloc(&printer.ugraph, &db_graph);
 
   // Load graphs
@@ -364,22 +478,23 @@ int ctx_unitigs(int argc, char **argv)
 
   hash_table_print_stats(&db_graph.ht);
 
-  switch(syntax)
+  // Each thread buffers its output, full buffers are written by one thread
+  chunk_writer_alloc(&printer.writer, fout, out_path, nthreads,
+                     CHUNK_WRITER_SIZE, gzip_out);
+
+  if(index_path)
   {
-    case PRINT_FASTA:
-      status("Printing unitgs in FASTA using %zu threads", nthreads);
-      supernodes_iterate(nthreads, printer.visited, &db_graph,
-                         print_unitig_fasta, &printer);
-      break;
-    case PRINT_GFA:
-      print_gfa_syntax(&printer);
-      break;
-    case PRINT_DOT:
-      print_dot_syntax(&printer, dot_use_points);
-      break;
-    default:
-      die("Invalid print syntax: %i", syntax);
+    // Build and save index, then print from it so unitig IDs match
+    UnitigIndex uindex;
+    unitig_index_build(&uindex, &printer.ugraph, nthreads, printer.visited);
+    unitig_index_save(&uindex, index_path);
+    print_from_index(&uindex, syntax, dot_use_points, &printer.writer);
+    printer.num_unitigs = uindex.num_unitigs;
+    unitig_index_close(&uindex);
   }
+  else print_unitigs(&printer, dot_use_points);
+
+  chunk_writer_dealloc(&printer.writer);
 
   char num_unitigs_str[50];
   ulong_to_str(printer.num_unitigs, num_unitigs_str);
@@ -34,6 +34,7 @@ void read_thread_args_parse(struct ReadThreadCmdArgs *args,
   CorrectAlnInput task = CORRECT_ALN_INPUT_INIT;
   uint8_t fq_offset = 0;
   GPathReader tmp_gpfile;
+  HtsReadOpts htsopts = HTS_READ_OPTS_INIT;
 
   CorrectAlnInputBuffer *inputs = &args->inputs;
   args->memargs = (struct MemArgs)MEM_ARGS_INIT;
@@ -84,6 +85,8 @@ void read_thread_args_parse(struct ReadThreadCmdArgs *args,
         correct_aln_input_buf_push(inputs, &task, 1);
         asyncio_task_parse(&inputs->b[inputs->len-1].files, c, optarg,
                            fq_offset, correct_cmd ? &tmp_path : NULL);
+        if(hts_read_opts_used(&htsopts))
+          asyncio_task_set_hts(&inputs->b[inputs->len-1].files, &htsopts);
         if(correct_cmd) inputs->b[inputs->len-1].out_base = tmp_path;
         break;
       case 'M':
@@ -108,6 +111,10 @@ void read_thread_args_parse(struct ReadThreadCmdArgs *args,
       case 'g': cmd_check(!args->dump_seq_sizes, cmd); args->dump_seq_sizes = optarg; break;
       case 'G': cmd_check(!args->dump_frag_sizes, cmd); args->dump_frag_sizes = optarg; break;
       case 'u': args->use_new_paths = true; break;
+      case 'S':
+        cmd_check(!args->link_mem, cmd);
+        args->link_mem = cmd_parse_arg_mem(cmd, optarg);
+        break;
       case 'x': gen_paths_print_contigs = true; break;
       case 'y': gen_paths_print_paths = true; break;
       case 'z': gen_paths_print_reads = true; break;
@@ -118,6 +125,11 @@ void read_thread_args_parse(struct ReadThreadCmdArgs *args,
         args->fq_zero = optarg[0];
         break;
       case 'P': cmd_check(!args->append_orig_seq,cmd); args->append_orig_seq = true; break;
+      case HTS_OPT_THREADS: case HTS_OPT_REF: case HTS_OPT_REGION:
+      case HTS_OPT_BED: case HTS_OPT_UNMAPPED: case HTS_OPT_COLLATE:
+        hts_read_opts_parse(&htsopts, c, cmd, optarg);
+        used = 0;
+        break;
       case ':': /* BADARG */
       case '?': /* BADCH getopt_long has already printed error */
         // cmd_print_usage(NULL);
@@ -126,6 +138,8 @@ void read_thread_args_parse(struct ReadThreadCmdArgs *args,
     }
   }
 
+  hts_read_opts_dealloc(&htsopts);
+
   if(args->nthreads == 0) args->nthreads = DEFAULT_NTHREADS;
 
   // Check that optind+1 == argc
@@ -20,6 +20,7 @@ struct ReadThreadCmdArgs
   char *dump_seq_sizes, *dump_frag_sizes;
 
   bool zero_link_counts; // ctx_thread only
+  size_t link_mem; // ctx_thread only, 0 => use all remaining memory
 
   size_t colour; // ctx_correct only
   seq_format fmt; // ctx_correct only
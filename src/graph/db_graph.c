@@ -228,11 +228,12 @@ dBNode db_graph_next_node(const dBGraph *db_graph,
   return next_node;
 }
 
-uint8_t db_graph_next_nodes(const dBGraph *db_graph, const BinaryKmer node_bkey,
-                            Orientation orient, Edges edges,
-                            dBNode nodes[4], Nucleotide fw_nucs[4])
+// Kmers after node_bkey:orient, in the orientation they were reached
+// Returns number of kmers
+static inline uint8_t _next_bkmers(const BinaryKmer node_bkey, Orientation orient,
+                                   Edges edges, size_t kmer_size,
+                                   BinaryKmer bkmers[4], Nucleotide fw_nucs[4])
 {
-  const size_t kmer_size = db_graph->kmer_size;
   Edges tmp_edge;
   Nucleotide nuc;
   BinaryKmer bkmer;
@@ -246,10 +247,8 @@ uint8_t db_graph_next_nodes(const dBGraph *db_graph, const BinaryKmer node_bkey,
     if(edges & tmp_edge) {
       if(orient == FORWARD) binary_kmer_set_last_nuc(&bkmer, nuc);
       else binary_kmer_set_first_nuc(&bkmer, dna_nuc_complement(nuc), kmer_size);
-      nodes[count] = db_graph_find(db_graph, bkmer);
-      nodes[count].orient ^= orient;
+      bkmers[count] = bkmer;
       fw_nucs[count] = nuc;
-      ctx_assert(nodes[count].key != HASH_NOT_FOUND);
       count++;
     }
   }
@@ -257,6 +256,47 @@ uint8_t db_graph_next_nodes(const dBGraph *db_graph, const BinaryKmer node_bkey,
   return count;
 }
 
+void db_graph_prefetch_next(const dBGraph *db_graph, const BinaryKmer node_bkey,
+                            Orientation orient, Edges edges)
+{
+  const size_t kmer_size = db_graph->kmer_size;
+  BinaryKmer bkmers[4];
+  Nucleotide nucs[4];
+  uint8_t i, count;
+
+  count = _next_bkmers(node_bkey, orient, edges, kmer_size, bkmers, nucs);
+
+  for(i = 0; i < count; i++)
+    hash_table_prefetch(&db_graph->ht, binary_kmer_get_key(bkmers[i], kmer_size));
+}
+
+uint8_t db_graph_next_nodes(const dBGraph *db_graph, const BinaryKmer node_bkey,
+                            Orientation orient, Edges edges,
+                            dBNode nodes[4], Nucleotide fw_nucs[4])
+{
+  const size_t kmer_size = db_graph->kmer_size;
+  BinaryKmer bkmers[4], bkeys[4];
+  uint8_t i, count;
+
+  count = _next_bkmers(node_bkey, orient, edges, kmer_size, bkmers, fw_nucs);
+
+  // At a fork, request all buckets before looking any of them up so that the
+  // memory reads overlap
+  for(i = 0; i < count; i++) {
+    bkeys[i] = binary_kmer_get_key(bkmers[i], kmer_size);
+    if(count > 1) hash_table_prefetch(&db_graph->ht, bkeys[i]);
+  }
+
+  for(i = 0; i < count; i++) {
+    nodes[i].key = hash_table_find(&db_graph->ht, bkeys[i]);
+    nodes[i].orient = bkmer_get_orientation(bkeys[i], bkmers[i]) ^ orient;
+    ctx_assert(nodes[i].key != HASH_NOT_FOUND);
+    if(count > 1) db_graph_prefetch_node(db_graph, nodes[i].key);
+  }
+
+  return count;
+}
+
 uint8_t db_graph_next_nodes_union(const dBGraph *db_graph, dBNode node,
                                   dBNode nodes[4], Nucleotide fw_nucs[4])
 {
@@ -122,6 +122,28 @@ uint8_t db_graph_next_nodes(const dBGraph *db_graph, const BinaryKmer node_bkey,
                             Orientation orient, Edges edges,
                             dBNode nodes[4], Nucleotide fw_nucs[4]);
 
+//
+// Prefetching: graph traversal is bound by the latency of random memory reads,
+// these let us ask for memory we will need soon while working on something
+// else. They never change results.
+//
+
+// Prefetch hash table buckets of the nodes after node_bkey:orient
+// edges are forward+reverse as for db_graph_next_nodes. Pass edges=0xff to
+// prefetch all four possible next kmers when edges are not known yet
+void db_graph_prefetch_next(const dBGraph *db_graph, const BinaryKmer node_bkey,
+                            Orientation orient, Edges edges);
+
+// Prefetch kmer, edges and coverage of a node we have the hkey for
+static inline void db_graph_prefetch_node(const dBGraph *db_graph, hkey_t hkey)
+{
+  __builtin_prefetch(db_graph->ht.table + hkey, 0, 1);
+  if(db_graph->col_edges != NULL)
+    __builtin_prefetch(db_graph->col_edges + hkey*db_graph->num_edge_cols, 0, 1);
+  if(db_graph->col_covgs != NULL)
+    __builtin_prefetch(db_graph->col_covgs + hkey*db_graph->num_of_cols, 0, 1);
+}
+
 /**
  * Get next nodes in union graph (pop / all samples)
  */
@@ -13,19 +13,117 @@
 // Warning: not thread safe! Do not use the same GraphCache in more than one
 //          thread at the same time.
 
+//
+// Node -> unitig map
+//
+
+#define GC_NODEMAP_INIT 1024
+
+static inline uint64_t _nodemap_key(dBNode node)
+{
+  return ((uint64_t)node.key << 1) | node.orient;
+}
+
+// Fibonacci hashing, take the top log2(capacity) bits
+static inline size_t _nodemap_slot(const GCNodeMap *map, uint64_t key)
+{
+  return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> map->shift);
+}
+
+static void _nodemap_alloc(GCNodeMap *map, size_t capacity)
+{
+  map->table = ctx_calloc(capacity, sizeof(GCNodeEntry));
+  map->capacity = capacity;
+  map->shift = 64 - (size_t)__builtin_ctzl(capacity);
+  map->size = 0;
+  map->gen = 1; // gen 0 is never in use
+}
+
+static void _nodemap_dealloc(GCNodeMap *map)
+{
+  ctx_free(map->table);
+  memset(map, 0, sizeof(*map));
+}
+
+static inline void _nodemap_clear(GCNodeMap *map)
+{
+  map->size = 0;
+  if(++map->gen == 0) {
+    // generation wrapped around, old entries could look live again
+    memset(map->table, 0, map->capacity * sizeof(GCNodeEntry));
+    map->gen = 1;
+  }
+}
+
+// Returns entry for `key` or the empty slot where it would go
+static inline GCNodeEntry* _nodemap_lookup(const GCNodeMap *map, uint64_t key)
+{
+  size_t i = _nodemap_slot(map, key);
+  GCNodeEntry *e = map->table + i;
+  while(e->gen == map->gen && e->node != key) {
+    i = (i+1) & (map->capacity-1);
+    e = map->table + i;
+  }
+  return e;
+}
+
+static void _nodemap_grow(GCNodeMap *map)
+{
+  GCNodeMap old = *map;
+  GCNodeEntry *e;
+  size_t i;
+
+  _nodemap_alloc(map, old.capacity * 2);
+
+  for(i = 0; i < old.capacity; i++) {
+    if(old.table[i].gen == old.gen) {
+      e = _nodemap_lookup(map, old.table[i].node);
+      *e = (GCNodeEntry){.node = old.table[i].node,
+                         .unitigid = old.table[i].unitigid,
+                         .gen = map->gen};
+      map->size++;
+    }
+  }
+
+  ctx_free(old.table);
+}
+
+// Returns UINT32_MAX if not found
+static inline uint32_t _nodemap_get(const GCNodeMap *map, dBNode node)
+{
+  const GCNodeEntry *e = _nodemap_lookup(map, _nodemap_key(node));
+  return e->gen == map->gen ? e->unitigid : UINT32_MAX;
+}
+
+// Add or overwrite
+static inline void _nodemap_set(GCNodeMap *map, dBNode node, uint32_t unitigid)
+{
+  // Keep load factor below 3/4
+  if((map->size+1)*4 > map->capacity*3) _nodemap_grow(map);
+
+  GCNodeEntry *e = _nodemap_lookup(map, _nodemap_key(node));
+  if(e->gen != map->gen) map->size++;
+  *e = (GCNodeEntry){.node = _nodemap_key(node), .unitigid = unitigid,
+                     .gen = map->gen};
+}
+
+//
+// Cache
+//
+
 void graph_cache_alloc(GraphCache *cache, const dBGraph *db_graph)
 {
   db_node_buf_alloc(&cache->node_buf, 1024);
   cache_unitig_buf_alloc(&cache->unitig_buf, 1024);
   cache_step_buf_alloc(&cache->step_buf, 1024);
   cache_path_buf_alloc(&cache->path_buf, 1024);
-  cache->node2unitig = kh_init(Node2Unitig);
+  _nodemap_alloc(&cache->node2unitig, GC_NODEMAP_INIT);
   cache->db_graph = db_graph;
 }
 
 void graph_cache_dealloc(GraphCache *cache)
 {
-  kh_destroy(Node2Unitig, cache->node2unitig);
+  _nodemap_dealloc(&cache->node2unitig);
   db_node_buf_dealloc(&cache->node_buf);
   cache_unitig_buf_dealloc(&cache->unitig_buf);
   cache_step_buf_dealloc(&cache->step_buf);
@@ -34,7 +132,7 @@ void graph_cache_dealloc(GraphCache *cache)
 
 void graph_cache_reset(GraphCache *cache)
 {
-  kh_clear(Node2Unitig, cache->node2unitig);
+  _nodemap_clear(&cache->node2unitig);
   db_node_buf_reset(&cache->node_buf);
   cache_unitig_buf_reset(&cache->unitig_buf);
   cache_step_buf_reset(&cache->step_buf);
@@ -133,25 +231,18 @@ const GCacheStep* graph_cache_new_step(GraphCache *cache, dBNode node)
   GCachePath *path = graph_cache_path(cache, pathid);
 
   // Find or add unitig beginning with given node
-  uint32_t unitigid;
-  int hashret;
-  khiter_t k = kh_put(Node2Unitig, cache->node2unitig, node, &hashret);
-  bool unitig_already_exists = (hashret == 0);
+  uint32_t unitigid = _nodemap_get(&cache->node2unitig, node);
 
-  if(unitig_already_exists) {
-    unitigid = kh_value(cache->node2unitig, k);
-  }
-  else {
+  if(unitigid == UINT32_MAX) {
     // Create unitig
     GCacheUnitig tmp_unitig;
     gc_create_unitig(cache, node, &tmp_unitig);
     unitigid = cache_unitig_buf_add(&cache->unitig_buf, tmp_unitig);
-    kh_value(cache->node2unitig, k) = unitigid;
+    _nodemap_set(&cache->node2unitig, node, unitigid);
 
     // Get node at other end
     dBNode end_node = get_node_at_unitig_end(cache, &tmp_unitig, node);
-    k = kh_put(Node2Unitig, cache->node2unitig, end_node, &hashret);
-    kh_value(cache->node2unitig, k) = unitigid;
+    _nodemap_set(&cache->node2unitig, end_node, unitigid);
   }
 
   GCacheUnitig *unitig = graph_cache_unitig(cache, unitigid);
@@ -174,16 +265,8 @@ const GCacheStep* graph_cache_new_step(GraphCache *cache, dBNode node)
 // Returns NULL if not found
 GCacheUnitig* graph_cache_find_unitig(GraphCache *cache, dBNode node)
 {
-  uint32_t unitigid;
-  khiter_t k = kh_get(Node2Unitig, cache->node2unitig, node);
-  bool is_missing = (k == kh_end(cache->node2unitig));
-
-  if(!is_missing) {
-    unitigid = kh_value(cache->node2unitig, k);
-    return graph_cache_unitig(cache, unitigid);
-  }
-
-  return NULL;
+  uint32_t unitigid = _nodemap_get(&cache->node2unitig, node);
+  return unitigid == UINT32_MAX ? NULL : graph_cache_unitig(cache, unitigid);
 }
 
 
@@ -1,7 +1,6 @@
 #ifndef GRAPH_CACHE_H_
 #define GRAPH_CACHE_H_
 
-#include "htslib/khash.h"
 #include "db_node.h"
 
 // Build and store paths through the graph
@@ -45,8 +44,26 @@ madcrow_buffer(cache_unitig_buf, GCacheUnitigBuffer, GCacheUnitig);
 madcrow_buffer(cache_step_buf,   GCacheStepBuffer,   GCacheStep);
 madcrow_buffer(cache_path_buf,   GCachePathBuffer,   GCachePath);
 
-KHASH_INIT(Node2Unitig, dBNode, uint32_t, 1, db_node_hash, db_nodes_are_equal)
+// Open addressing hash map dBNode -> unitig id with linear probing
+// An entry is only in use if its gen matches the map's gen, so resetting the
+// map between explorations is O(1) rather than clearing the whole table
+typedef struct
+{
+  uint64_t node; // key << 1 | orient
+  uint32_t unitigid, gen;
+} GCNodeEntry;
 
+typedef struct
+{
+  GCNodeEntry *table;
+  size_t size, capacity; // capacity is a power of two
+  size_t shift; // 64 - log2(capacity)
+  uint32_t gen;
+} GCNodeMap;
+
+// Buffers and node map keep their memory between calls to
+// graph_cache_reset(), so each thread's cache acts as an arena that stops
+// allocating once it has grown to fit the largest exploration
 typedef struct
 {
   dBNodeBuffer       node_buf;
@@ -55,7 +72,7 @@ typedef struct
   GCachePathBuffer   path_buf;
 
   // hash map dBNode->uint32_t (unitig_id)
-  khash_t(Node2Unitig) *node2unitig;
+  GCNodeMap node2unitig;
 
   const dBGraph *db_graph;
 } GraphCache;
@@ -33,7 +33,7 @@ static void print_path_list(const GPathFollowBuffer *pbuf, FILE *fout)
 
   for(i = 0; i < pbuf->len; i++) {
     path = &pbuf->b[i];
-    fprintf(fout, "   %p ", path->gpath->seq);
+    fprintf(fout, "   %p ", gpath_seq(path->gpath));
     for(j = 0; j < path->len; j++)
       fputc(dna_nuc_to_char(gpath_follow_get_base(path, j)), fout);
     fprintf(fout, " [%zu/%zu] age: %zu %c\n", (size_t)path->pos,
@@ -172,16 +172,16 @@ static inline size_t pickup_paths(GraphWalker *wlk, dBNode node,
 
   GPath *gpath = gpath_store_fetch_traverse(gpstore, node.key);
 
-  for(; gpath != NULL; gpath = gpath->next)
+  for(; gpath != NULL; gpath = gpath_next(gpath))
   {
     if(node.orient == gpath->orient && gpath_has_colour(gpath, ncols, wlk->ctpcol))
     {
       GPathFollow fpath = gpath_follow_create(gpath);
 
       if(!cntr_filter_nuc0) gpath_follow_buf_add(pbuf, fpath);
-      else if(gpath_follow_get_base(&fpath, 0) == next_nuc) {
+      else if(gpath_follow_next_base(&fpath) == next_nuc) {
         // Loading a counter path at a fork
-        fpath.pos++; // already took a base
+        gpath_follow_advance(&fpath); // already took a base
         // check there are still junctions to take
         if(fpath.pos < fpath.len)
           gpath_follow_buf_add(pbuf, fpath);
@@ -308,7 +308,7 @@ static inline void update_path_forks(const GPathFollowBuffer *pbuf, bool taken[4
   GPathFollow *path;
   for(i = 0; i < pbuf->len; i++) {
     path = &pbuf->b[i];
-    taken[gpath_follow_get_base(path, path->pos)] = true;
+    taken[gpath_follow_next_base(path)] = true;
   }
 }
 
@@ -432,21 +432,16 @@ GraphStep graph_walker_choose(const GraphWalker *wlk, size_t num_next,
   // abandon if no path info
   if(wlk->paths.len == 0) _gw_choose_return(-1, GRPHWLK_NOPATHS, 0);
 
-  // Mark next bases available
-  bool forks[4] = {false}, taken[4] = {false};
+  // Bases of next nodes and bases taken by paths as bit masks (1<<base)
+  uint8_t forks = 0, taken;
 
-  // mark in forks the branches that are available
-  for(i = 0; i < num_next; i++) forks[bases[i]] = true;
+  for(i = 0; i < num_next; i++) forks |= (uint8_t)(1U << bases[i]);
 
-  // Check for path corruption
-  update_path_forks(&wlk->paths,      taken);
-  update_path_forks(&wlk->cntr_paths, taken);
+  taken = gpath_follow_buf_next_mask(&wlk->paths) |
+          gpath_follow_buf_next_mask(&wlk->cntr_paths);
 
-  if((taken[0] && !forks[0]) || (taken[1] && !forks[1]) ||
-     (taken[2] && !forks[2]) || (taken[3] && !forks[3]))
-  {
-    _corrupt_paths(wlk, num_next, nodes, bases);
-  }
+  // Check for path corruption
+  if(taken & ~forks) _corrupt_paths(wlk, num_next, nodes, bases);
 
   // Do all the oldest paths pick a consistent next node?
   GPathFollow *path, *oldest_path = &wlk->paths.b[0];
@@ -454,7 +449,7 @@ GraphStep graph_walker_choose(const GraphWalker *wlk, size_t num_next,
   Nucleotide greatest_nuc;
 
   greatest_age = oldest_path->age;
-  greatest_nuc = gpath_follow_get_base(oldest_path, oldest_path->pos);
+  greatest_nuc = gpath_follow_next_base(oldest_path);
 
   ctx_assert(oldest_path->pos < oldest_path->len);
 
@@ -464,7 +459,7 @@ GraphStep graph_walker_choose(const GraphWalker *wlk, size_t num_next,
   // OR wlk->paths.length if all paths agree
   for(i = 1; i < wlk->paths.len; i++) {
     path = &wlk->paths.b[i];
-    if(gpath_follow_get_base(path, path->pos) != greatest_nuc) break;
+    if(gpath_follow_next_base(path) != greatest_nuc) break;
   }
 
   // If a path of the same age disagrees, cannot proceed
@@ -498,7 +493,7 @@ GraphStep graph_walker_choose(const GraphWalker *wlk, size_t num_next,
   // Does every next node have a path?
   // Fail if missing assembly info
   if(wlk->missing_path_check &&
-     (size_t)taken[0]+taken[1]+taken[2]+taken[3] < num_next) {
+     (size_t)__builtin_popcount(taken) < num_next) {
     _gw_choose_return(-1, GRPHWLK_MISSING_PATHS, path_gap);
   }
 
@@ -516,6 +511,100 @@ GraphStep graph_walker_choose(const GraphWalker *wlk, size_t num_next,
 
 #undef _gw_choose_return
 
+//
+// Decision cache
+//
+
+void graph_walker_cache_alloc(GraphWalkerCache *cache, size_t nbits)
+{
+  size_t capacity = 1UL << nbits;
+  cache->table = ctx_calloc(capacity, sizeof(GraphWalkerCacheEntry));
+  cache->mask = capacity - 1;
+
+  char mem_str[50];
+  bytes_to_str(capacity * sizeof(GraphWalkerCacheEntry), 1, mem_str);
+  status("[GraphWalker] Junction decision cache: %s", mem_str);
+}
+
+void graph_walker_cache_dealloc(GraphWalkerCache *cache)
+{
+  ctx_free(cache->table);
+  memset(cache, 0, sizeof(GraphWalkerCache));
+}
+
+static inline uint64_t _gw_links_hash64(uint64_t hash,
+                                        const GPathFollowBuffer *pbuf)
+{
+  size_t i;
+  const GPathFollow *path;
+  hash = twang_mix64(hash ^ pbuf->len);
+  for(i = 0; i < pbuf->len; i++) {
+    path = &pbuf->b[i];
+    hash = twang_mix64(hash ^ (((uint64_t)(size_t)path->gpath << 16) | path->pos));
+  }
+  return hash;
+}
+
+// Key for a decision: the node we are at and the (link, pos) of each link we
+// are following. The walk since the oldest link was picked up, and so the
+// link ages, graph segments (path_gap) and next nodes, follow from these.
+static inline uint64_t _gw_choice_hash64(const GraphWalker *wlk)
+{
+  uint64_t hash = ((uint64_t)wlk->node.key << 1) | wlk->node.orient;
+  hash = _gw_links_hash64(hash, &wlk->paths);
+  hash = _gw_links_hash64(hash, &wlk->cntr_paths);
+  hash ^= ((uint64_t)wlk->ctxcol << 33) | ((uint64_t)wlk->ctpcol << 1) |
+          wlk->missing_path_check;
+  return twang_mix64(hash);
+}
+
+// Pack decision into a non-zero word: path_gap, status, idx+1
+static inline uint64_t _gw_step_pack(GraphStep step)
+{
+  return ((uint64_t)step.path_gap << 8) | ((uint64_t)step.status << 3) |
+         (uint64_t)(step.idx + 1);
+}
+
+static inline GraphStep _gw_step_unpack(uint64_t data)
+{
+  GraphStep step = {.idx = (int8_t)((int)(data & 7) - 1),
+                    .status = (enum GraphStepStatus)((data >> 3) & 31),
+                    .path_gap = (size_t)(data >> 8)};
+  return step;
+}
+
+// graph_walker_choose() using the decision cache at forks with links
+static GraphStep _graph_walker_choose_cached(GraphWalker *wlk, size_t num_next,
+                                             const dBNode nodes[4],
+                                             const Nucleotide bases[4])
+{
+  // Only forks where we are following links are worth caching
+  if(wlk->cache == NULL || num_next < 2 || wlk->paths.len == 0)
+    return graph_walker_choose(wlk, num_next, nodes, bases);
+
+  uint64_t key = _gw_choice_hash64(wlk);
+  GraphWalkerCacheEntry *entry = &wlk->cache->table[key & wlk->cache->mask];
+  uint64_t data = *(volatile uint64_t*)&entry->data;
+  uint64_t check = *(volatile uint64_t*)&entry->check;
+
+  wlk->cache_lookups++;
+
+  if(data != 0 && (check ^ data) == key) {
+    wlk->cache_hits++;
+    return _gw_step_unpack(data);
+  }
+
+  GraphStep step = graph_walker_choose(wlk, num_next, nodes, bases);
+
+  // Overwrite whatever was there. If another thread writes at the same time
+  // check won't match and the entry is ignored.
+  data = _gw_step_pack(step);
+  *(volatile uint64_t*)&entry->check = key ^ data;
+  *(volatile uint64_t*)&entry->data = data;
+
+  return step;
+}
+
 /**
  * This is the main traversal function, all other traversal functions call this
  * @param num_nodes is how many nodes we are jumping. If new node is adjacent to
@@ -565,9 +654,9 @@ static void _graph_walker_force_jump(GraphWalker *wlk,
     for(i = 0, j = 0; i < npaths; i++)
     {
       path = &wlk->paths.b[i];
-      pnuc = gpath_follow_get_base(path, path->pos);
+      pnuc = gpath_follow_next_base(path);
       if(base == pnuc) {
-        path->pos++;
+        gpath_follow_advance(path);
         if(path->pos < path->len) {
           wlk->paths.b[j++] = *path;
         }
@@ -575,7 +664,7 @@ static void _graph_walker_force_jump(GraphWalker *wlk,
           // Finished following a path from start to end
           if(wlk->used_paths) {
             // mark as used
-            size_t pathid = gpset_get_pkey(&wlk->gpstore->gpset, path->gpath);
+            size_t pathid = gpset_get_pathid(&wlk->gpstore->gpset, path->gpath);
             (void)bitset_set_mt(wlk->used_paths, pathid);
           }
         }
@@ -588,9 +677,9 @@ static void _graph_walker_force_jump(GraphWalker *wlk,
     for(i = 0, j = 0; i < wlk->cntr_paths.len; i++)
     {
       path = &wlk->cntr_paths.b[i];
-      pnuc = gpath_follow_get_base(path, path->pos);
+      pnuc = gpath_follow_next_base(path);
       if(base == pnuc && path->pos+1 < path->len) {
-        path->pos++;
+        gpath_follow_advance(path);
         wlk->cntr_paths.b[j++] = *path;
       }
     }
@@ -673,7 +762,7 @@ void graph_walker_force(GraphWalker *wlk, dBNode node, bool is_fork)
 bool graph_walker_next_nodes(GraphWalker *wlk, size_t num_next,
                              const dBNode nodes[4], const Nucleotide bases[4])
 {
-  wlk->last_step = graph_walker_choose(wlk, num_next, nodes, bases);
+  wlk->last_step = _graph_walker_choose_cached(wlk, num_next, nodes, bases);
   int idx = wlk->last_step.idx;
   if(idx == -1) return false;
   graph_walker_force(wlk, nodes[idx],
@@ -697,6 +786,61 @@ bool graph_walker_next(GraphWalker *wlk)
   return graph_walker_next_nodes(wlk, num_next, nodes, bases);
 }
 
+/**
+ * Fast path through non-branching stretches of the graph. Moves along the
+ * current unitig in one jump instead of choosing at every node.
+ * Stops before any node with more than one edge in (where counter paths would
+ * be picked up), or not in our colour, or already set in `traversed` (may be
+ * NULL). Stops on the first node that has links to pick up.
+ * Nodes passed over are set in `traversed`, the final node is not.
+ * Uses the same edges as graph_walker_next().
+ * @return number of nodes moved, added to the end of nbuf
+ */
+size_t graph_walker_jump_unitig(GraphWalker *wlk, uint64_t *traversed,
+                                dBNodeBuffer *nbuf)
+{
+  const dBGraph *db_graph = wlk->db_graph;
+  const size_t kmer_size = db_graph->kmer_size;
+  const bool use_paths = gpath_store_use_traverse(wlk->gpstore);
+  const hkey_t key0 = wlk->node.key;
+
+  dBNode node = wlk->node, next;
+  BinaryKmer bkmer = db_node_oriented_bkmer(db_graph, node);
+  Edges edges = db_node_get_edges(db_graph, node.key, 0);
+  Nucleotide nuc, prev_nuc;
+  size_t n = 0;
+
+  while(edges_has_precisely_one_edge(edges, node.orient, &nuc))
+  {
+    bkmer = binary_kmer_left_shift_add(bkmer, kmer_size, nuc);
+    db_graph_prefetch_next(db_graph, bkmer, FORWARD, 0xff);
+    next = db_graph_find(db_graph, bkmer);
+    ctx_assert(next.key != HASH_NOT_FOUND);
+
+    // Leave cycles and repeats to the repeat walker
+    if(next.key == key0 || next.key == node.key) break;
+    if(traversed && db_node_has_traversed(traversed, next)) break;
+    if(db_graph->node_in_cols != NULL &&
+       !db_node_has_col(db_graph, next.key, wlk->ctxcol)) break;
+
+    edges = db_node_get_edges(db_graph, next.key, 0);
+    if(!edges_has_precisely_one_edge(edges, rev_orient(next.orient), &prev_nuc))
+      break;
+
+    if(n > 0 && traversed) db_node_set_traversed(traversed, node);
+    db_node_buf_add(nbuf, next);
+    node = next;
+    n++;
+
+    // Paths are picked up when we arrive at a node
+    if(use_paths && gpath_store_fetch_traverse(wlk->gpstore, node.key) != NULL)
+      break;
+  }
+
+  if(n > 0) graph_walker_jump_along_snode(wlk, node, n);
+  return n;
+}
+
 
 //
 // Force traversal along an array of nodes (`priming' a GraphWalker)
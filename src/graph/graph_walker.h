@@ -16,6 +16,30 @@ typedef struct
 
 madcrow_list(gseg_list,GSegList,GraphSegment);
 
+//
+// Cache of junction decisions, shared between threads
+//
+// Repeats are resolved with the same set of links over and over. Decisions
+// made at forks are stored keyed by a hash of the walker state. The cache is
+// lossy: entries are overwritten on collision and written without locks.
+// Each entry stores key^data so a read racing with a write is seen as a miss.
+//
+#define GRAPH_WALKER_CACHE_BITS 20 // 16MB
+
+typedef struct
+{
+  uint64_t check, data; // check is key ^ data
+} GraphWalkerCacheEntry;
+
+typedef struct
+{
+  GraphWalkerCacheEntry *table;
+  uint64_t mask;
+} GraphWalkerCache;
+
+void graph_walker_cache_alloc(GraphWalkerCache *cache, size_t nbits);
+void graph_walker_cache_dealloc(GraphWalkerCache *cache);
+
 typedef struct
 {
   const dBGraph *db_graph;
@@ -23,7 +47,7 @@ typedef struct
   Colour ctxcol, ctpcol;
   bool missing_path_check; // if true do missing path check
   size_t *used_paths; // bit array for used paths; cast volatile when used
-  // 1 bit for each path loaded
+  // 1 bit per path id (gpset_get_pathid()), gpath_set_num_pathids() bits
 
   // Current position
   dBNode node;
@@ -33,9 +57,13 @@ typedef struct
   GPathFollowBuffer paths, cntr_paths;
   GSegList gsegs;
 
+  // Shared decision cache, NULL if not used
+  GraphWalkerCache *cache;
+
   // Statistics
   size_t fork_count; // how many forks we have traversed
   GraphStep last_step;
+  size_t cache_lookups, cache_hits; // not reset by graph_walker_start()
 } GraphWalker;
 
 void graph_walker_print_state(const GraphWalker *wlk, FILE *fout);
@@ -84,6 +112,17 @@ bool graph_walker_next(GraphWalker *wlk);
 bool graph_walker_next_nodes(GraphWalker *wlk, size_t num_next,
                              const dBNode nodes[4], const Nucleotide bases[4]);
 
+/**
+ * Jump along the current unitig to the next junction, a node with links or a
+ * node set in `traversed` (may be NULL). Much faster than graph_walker_next()
+ * on long non-branching stretches. Path ages are updated as if we stepped.
+ * Nodes passed over are set in `traversed`, the final node is not.
+ * @return number of nodes moved (0 if we are at a junction), these are added
+ *         to the end of nbuf
+ */
+size_t graph_walker_jump_unitig(GraphWalker *wlk, uint64_t *traversed,
+                                dBNodeBuffer *nbuf);
+
 /**
  * Pick up counter paths for missing information check
  * @param prev_nodes nodes before wlk->node, oriented away from wlk->node
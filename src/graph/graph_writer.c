@@ -511,6 +511,148 @@ size_t graph_writer_stream_mkhdr(const char *out_ctx_path,
   return nodes_dumped;
 }
 
+// Write a kmer that was not in the graph file we are appending to
+static inline void _graph_write_appended_kmer(hkey_t hkey,
+                                              const dBGraph *db_graph,
+                                              const uint8_t *seen,
+                                              size_t filecols,
+                                              FILE *fout,
+                                              const GraphFileHeader *hdr,
+                                              size_t *num_dumped)
+{
+  if(bitset_get(seen, hkey)) return;
+
+  const size_t ncols = hdr->num_of_cols;
+  Covg covgs[ncols];
+  Edges edges[ncols];
+
+  memset(covgs, 0, filecols*sizeof(Covg));
+  memset(edges, 0, filecols*sizeof(Edges));
+  memcpy(covgs+filecols, &db_node_covg(db_graph, hkey, 0),
+         db_graph->num_of_cols*sizeof(Covg));
+  memcpy(edges+filecols, &db_node_edges(db_graph, hkey, 0),
+         db_graph->num_of_cols*sizeof(Edges));
+
+  graph_write_kmer(fout, hdr->num_of_bitfields, ncols,
+                   db_node_get_bkmer(db_graph, hkey), covgs, edges);
+
+  (*num_dumped)++;
+}
+
+// Stream kmers from a graph file and write them out with all colours of the
+// graph in memory appended as new colours after those of the file. Kmers only
+// in the graph are written at the end. The colours in the file are never
+// loaded into memory.
+// `hdr` must have file_filter_into_ncols(&file->fltr)+db_graph->num_of_cols
+// colours. Returns number of kmers written
+size_t graph_writer_stream_append(const char *out_ctx_path, GraphFileReader *file,
+                                  const dBGraph *db_graph,
+                                  const GraphFileHeader *hdr)
+{
+  ctx_assert(db_graph->col_edges != NULL);
+  ctx_assert(db_graph->col_covgs != NULL);
+  ctx_assert(db_graph->num_of_cols == db_graph->num_edge_cols);
+
+  const FileFilter *fltr = &file->fltr;
+  const size_t filecols = file_filter_into_ncols(fltr);
+  const size_t graphcols = db_graph->num_of_cols;
+  const size_t ncols = filecols + graphcols;
+  ctx_assert(hdr->num_of_cols == ncols);
+
+  status("Appending %zu colour%s to %s with stream writer: %s",
+         graphcols, util_plural_str(graphcols), fltr->path.b,
+         futil_outpath_str(out_ctx_path));
+  graph_loading_print_status(file);
+
+  // seek to start of input file after header
+  if(!file_filter_isstdin(fltr) &&
+     graph_file_fseek(file, file->hdr_size, SEEK_SET) != 0)
+    die("fseek failed: %s", strerror(errno));
+
+  FILE *out = futil_fopen(out_ctx_path, "w");
+  graph_write_header(out, hdr);
+
+  // One bit per hash table entry, set if kmer was in the file
+  uint8_t *seen = ctx_calloc(roundup_bits2bytes(db_graph->ht.capacity), 1);
+
+  size_t i, nkmers_file = 0, nkmers_shared = 0, nkmers_graph = 0;
+  hkey_t hkey;
+  Covg keep_kmer;
+
+  BinaryKmer bkmer;
+  Covg covgs[ncols];
+  Edges edges[ncols];
+
+  while(graph_file_read_reset(file, &bkmer, covgs, edges))
+  {
+    keep_kmer = 0;
+    for(i = 0; i < filecols; i++) keep_kmer |= covgs[i];
+
+    hkey = hash_table_find(&db_graph->ht, bkmer);
+
+    if(hkey != HASH_NOT_FOUND) {
+      memcpy(covgs+filecols, &db_node_covg(db_graph, hkey, 0),
+             graphcols*sizeof(Covg));
+      memcpy(edges+filecols, &db_node_edges(db_graph, hkey, 0),
+             graphcols*sizeof(Edges));
+      bitset_set(seen, hkey);
+      nkmers_shared++;
+    }
+    else if(keep_kmer) {
+      memset(covgs+filecols, 0, graphcols*sizeof(Covg));
+      memset(edges+filecols, 0, graphcols*sizeof(Edges));
+    }
+    else continue; // kmer has no coverage in the colours we are keeping
+
+    graph_write_kmer(out, hdr->num_of_bitfields, ncols, bkmer, covgs, edges);
+    nkmers_file++;
+  }
+
+  // Write kmers that were only in the graph
+  HASH_ITERATE(&db_graph->ht, _graph_write_appended_kmer,
+               db_graph, seen, filecols, out, hdr, &nkmers_graph);
+
+  fflush(out);
+  fclose(out);
+  ctx_free(seen);
+
+  char nfile_str[50], nshared_str[50], ngraph_str[50];
+  ulong_to_str(nkmers_file, nfile_str);
+  ulong_to_str(nkmers_shared, nshared_str);
+  ulong_to_str(nkmers_graph, ngraph_str);
+  status("[graph_writer_stream_append] kmers from file: %s (of which in "
+         "graph: %s) novel kmers from graph: %s",
+         nfile_str, nshared_str, ngraph_str);
+
+  graph_writer_print_status(nkmers_file+nkmers_graph, ncols,
+                            out_ctx_path, CTX_GRAPH_FILEFORMAT);
+
+  return nkmers_file + nkmers_graph;
+}
+
+size_t graph_writer_stream_append_mkhdr(const char *out_ctx_path,
+                                        GraphFileReader *file,
+                                        const dBGraph *db_graph)
+{
+  size_t i, nodes_dumped, filecols = file_filter_into_ncols(&file->fltr);
+
+  GraphFileHeader outhdr;
+  memset(&outhdr, 0, sizeof(outhdr));
+  graph_file_merge_header(&outhdr, file);
+
+  outhdr.num_of_cols = filecols + db_graph->num_of_cols;
+  graph_header_capacity(&outhdr, outhdr.num_of_cols);
+
+  for(i = 0; i < db_graph->num_of_cols; i++)
+    graph_info_cpy(&outhdr.ginfo[filecols+i], &db_graph->ginfo[i]);
+
+  nodes_dumped = graph_writer_stream_append(out_ctx_path, file,
+                                            db_graph, &outhdr);
+  graph_header_dealloc(&outhdr);
+
+  return nodes_dumped;
+}
+
 // `kmers_loaded`: means all kmers to dump have been loaded
 // `colours_loaded`: means all kmer data have been loaded
 // `only_load_if_in_edges`: Edges to mask edges with, 1 per hash table entry
@@ -92,6 +92,20 @@ size_t graph_writer_stream_mkhdr(const char *out_ctx_path, GraphFileReader *file
                                  const Edges *only_load_if_in_edges,
                                  const char *intersect_gname);
 
+// Stream kmers from a graph file and write them out with all colours of the
+// graph in memory appended as new colours after those of the file. Kmers only
+// in the graph are written at the end. The colours in the file are never
+// loaded into memory.
+// `hdr` must have file_filter_into_ncols(&file->fltr)+db_graph->num_of_cols
+// colours. Returns number of kmers written
+size_t graph_writer_stream_append(const char *out_ctx_path, GraphFileReader *file,
+                                  const dBGraph *db_graph,
+                                  const GraphFileHeader *hdr);
+
+size_t graph_writer_stream_append_mkhdr(const char *out_ctx_path,
+                                        GraphFileReader *file,
+                                        const dBGraph *db_graph);
+
 size_t graph_writer_merge(const char *out_ctx_path,
                           GraphFileReader *files, size_t num_files,
                           bool kmers_loaded, bool colours_loaded,
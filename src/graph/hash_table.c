@@ -6,7 +6,8 @@
 // bit macros from BitArray library used for spinlocking
 #include "bit_array/bit_macros.h"
 
-// Hash table prefetching doesn't appear to be faster
+// Prefetching the rehash bucket doesn't appear to be faster. Traversal code
+// prefetches first buckets ahead of time instead (see hash_table_prefetch())
 // #define HASH_PREFETCH 1
 
 static const BinaryKmer unset_bkmer = {.b = {UNSET_BKMER_WORD}};
@@ -36,6 +36,16 @@ void hash_table_alloc(HashTable *htable, uint64_t capacity);
 void hash_table_dealloc(HashTable *hash_table);
 
 hkey_t hash_table_find(const HashTable *const htable, const BinaryKmer bkmer);
+
+// Prefetch the first bucket `bkmer` hashes to and its size. Lookups that miss
+// the first bucket are rare, so this hides the cost of most finds.
+// `bkmer` must be a key (see binary_kmer_get_key())
+static inline void hash_table_prefetch(const HashTable *ht, const BinaryKmer bkmer)
+{
+  uint_fast32_t h = binary_kmer_hash(bkmer, ht->seed) & ht->hash_mask;
+  __builtin_prefetch(ht->table + (size_t)h * ht->bucket_size, 0, 1);
+  __builtin_prefetch(ht->buckets[h], 0, 1);
+}
 hkey_t hash_table_insert(HashTable *const htable, const BinaryKmer bkmer);
 hkey_t hash_table_find_or_insert(HashTable *htable, const BinaryKmer bkmer,
                                  bool *found);
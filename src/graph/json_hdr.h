@@ -35,6 +35,7 @@ void json_hdr_augment_cmd(cJSON *json, const char *cmdstr,
 
 void json_hdr_gzprint(cJSON *json, gzFile gzout);
 void json_hdr_fprint(cJSON *json, FILE *fout);
+void json_hdr_sprint(cJSON *json, StrBuf *sbuf);
 
 // Get values from a JSON header - return NULL if not found
 cJSON* json_hdr_try(cJSON *json, const char *field, int type, const char *path);
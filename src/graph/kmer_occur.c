@@ -3,6 +3,14 @@
 #include "seq_reader.h"
 #include "util.h"
 #include "db_node.h"
+#include "file_util.h"
+
+#include "misc/city.h"
+
+#include <sys/mman.h>
+#include <fcntl.h> // open()
+#include <sys/stat.h>
+#include <unistd.h> // getpid()
 
 //
 // This file provides a datastore for loading sequences and recording where
@@ -125,13 +133,29 @@ static void generate_chrom_list(KOGraph *kograph,
   }
 }
 
+// Record an edge from src -> tgt in `ref_edges` as db_graph_add_edge_mt()
+// would in the graph
+// Threadsafe
+static inline void ref_edges_add_mt(Edges *ref_edges, dBNode src, dBNode tgt,
+                                    const dBGraph *db_graph)
+{
+  Nucleotide lhs_nuc, rhs_nuc;
+  lhs_nuc = db_node_get_first_nuc(src, db_graph);
+  rhs_nuc = db_node_get_last_nuc(tgt, db_graph);
+  __sync_or_and_fetch(&ref_edges[src.key], nuc_orient_to_edge(rhs_nuc, src.orient));
+  __sync_or_and_fetch(&ref_edges[tgt.key],
+                      nuc_orient_to_edge(dna_nuc_complement(lhs_nuc), !tgt.orient));
+}
+
 // Add missing kmers and edges to the graph whilst keeping track of the count
 // of how many times each kmer in the graph is seen in sequence (with klists)
+// Also records edges in ref_edges if it is not NULL
 // Returns number of kmers added to the graph
 // Threadsafe
 static inline void add_ref_seq_to_graph_mt(const char *seq, size_t len,
                                            size_t ref_col,
                                            KONodeList *klists,
+                                           Edges *ref_edges,
                                            dBGraph *db_graph)
 {
   const size_t kmer_size = db_graph->kmer_size;
@@ -156,6 +180,7 @@ static inline void add_ref_seq_to_graph_mt(const char *seq, size_t len,
     db_graph_update_node_mt(db_graph, curr, ref_col);
     __sync_fetch_and_add((volatile uint64_t*)&klists[curr.key].kcount, 1); // kcount++
     db_graph_add_edge_mt(db_graph, 0, prev, curr);
+    if(ref_edges) ref_edges_add_mt(ref_edges, prev, curr, db_graph);
   }
 }
 
@@ -165,6 +190,7 @@ static inline void add_ref_seq_to_graph_mt(const char *seq, size_t len,
 // Threadsafe
 static inline void add_ref_read_to_graph_mt(const read_t *r, size_t ref_col,
                                             KONodeList *klists,
+                                            Edges *ref_edges,
                                             dBGraph *db_graph)
 {
   const size_t kmer_size = db_graph->kmer_size;
@@ -180,7 +206,7 @@ static inline void add_ref_read_to_graph_mt(const read_t *r, size_t ref_col,
 
     contig_len = contig_end - contig_start;
     add_ref_seq_to_graph_mt(r->seq.b+contig_start, contig_len,
-                            ref_col, klists, db_graph);
+                            ref_col, klists, ref_edges, db_graph);
   }
 }
 
@@ -200,6 +226,7 @@ struct ReadUpdateCounts {
   KONodeList *klists;
   bool add_missing_kmers;
   size_t ref_col; // only used if add_missing_kmers is true
+  Edges *ref_edges; // only used if add_missing_kmers is true, may be NULL
   dBGraph *db_graph;
 };
 
@@ -212,7 +239,8 @@ static void read_update_counts(void *arg, size_t threadid)
   const read_t *r = data.r;
 
   if(data.add_missing_kmers) {
-    add_ref_read_to_graph_mt(r, data.ref_col, data.klists, data.db_graph);
+    add_ref_read_to_graph_mt(r, data.ref_col, data.klists, data.ref_edges,
+                             data.db_graph);
   }
   else {
     SeqLoadingStats stats;
@@ -222,9 +250,12 @@ static void read_update_counts(void *arg, size_t threadid)
   }
 }
 
-static void bkmer_store_kmer_pos(BinaryKmer bkmer, KONodeList *klists,
-                                 size_t chrom_id, uint64_t offset,
-                                 const dBGraph *db_graph)
+// klists[].kcount holds the index of the next free KOccur for each kmer
+// Threadsafe
+static void bkmer_store_kmer_pos_mt(BinaryKmer bkmer, KONodeList *klists,
+                                    KOccur *koccurs,
+                                    size_t chrom_id, uint64_t offset,
+                                    const dBGraph *db_graph)
 {
   // bkmers were already added to graph -> don't need to find_or_insert
   // if missing kmers weren't added then kmer might be missing -> skip
@@ -233,23 +264,69 @@ static void bkmer_store_kmer_pos(BinaryKmer bkmer, KONodeList *klists,
   if(node.key != HASH_NOT_FOUND)
   {
     // set all next to 1, set last one in kmerlist to zero later
-    KONodeList *kl = &klists[node.key];
-    *kl->first = (KOccur){.chrom = chrom_id,
+    uint64_t i = __sync_fetch_and_add((volatile uint64_t*)&klists[node.key].kcount, 1);
+    koccurs[i] = (KOccur){.chrom = chrom_id,
                           .offset = offset,
                           .orient = node.orient,
                           .next = 1};
-    kl->first++;
   }
 }
 
-static void read_store_kmer_pos(const read_t *r, size_t chrom_id,
-                                KONodeList *klists, const dBGraph *db_graph)
+struct ReadStorePos {
+  const read_t *r;
+  size_t chrom_id;
+  KONodeList *klists;
+  KOccur *koccurs;
+  const dBGraph *db_graph;
+};
+
+static void read_store_kmer_pos(void *arg, size_t threadid)
 {
-  const size_t kmer_size = db_graph->kmer_size;
+  (void)threadid;
+  struct ReadStorePos data = *(struct ReadStorePos*)arg;
   SeqLoadingStats stats;
   memset(&stats, 0, sizeof(stats));
-  READ_TO_BKMERS(r, kmer_size, 0, 0, &stats, bkmer_store_kmer_pos,
-                 klists, chrom_id, _offset, db_graph);
+  READ_TO_BKMERS(data.r, data.db_graph->kmer_size, 0, 0, &stats,
+                 bkmer_store_kmer_pos_mt,
+                 data.klists, data.koccurs, data.chrom_id, _offset,
+                 data.db_graph);
+}
+
+// Sort KOccur by chrom then offset
+static int koccur_cmp(const void *aa, const void *bb)
+{
+  const KOccur *a = (const KOccur*)aa, *b = (const KOccur*)bb;
+  if(a->chrom != b->chrom) return a->chrom < b->chrom ? -1 : 1;
+  if(a->offset != b->offset) return a->offset < b->offset ? -1 : 1;
+  return 0;
+}
+
+struct KOListSort {
+  KONodeList *klists;
+  size_t capacity, nthreads;
+};
+
+// Threads fill in lists in any order, put each list back in order of
+// chromosome and position
+static void kolists_sort(void *arg, size_t threadid)
+{
+  const struct KOListSort *data = (const struct KOListSort*)arg;
+  size_t i, n, start, end;
+  KOccur *kolist;
+
+  start = (data->capacity * threadid) / data->nthreads;
+  end = (data->capacity * (threadid+1)) / data->nthreads;
+
+  for(i = start; i < end; i++) {
+    if((kolist = data->klists[i].first) != NULL) {
+      for(n = 1; kolist[n-1].next; n++) {}
+      if(n > 1) {
+        qsort(kolist, n, sizeof(KOccur), koccur_cmp);
+        kolist[n-1].next = 0;
+        while(--n > 0) kolist[n-1].next = 1;
+      }
+    }
+  }
 }
 
 // Updates ginfo info add_missing_kmers is true
@@ -257,6 +334,7 @@ static void load_reads_count_kmers(const read_t *reads, size_t num_reads,
                                    bool add_missing_kmers, size_t ref_col,
                                    size_t num_threads,
                                    KONodeList *klists,
+                                   Edges *ref_edges,
                                    dBGraph *db_graph)
 {
   if(!num_reads) return;
@@ -272,6 +350,7 @@ static void load_reads_count_kmers(const read_t *reads, size_t num_reads,
                                            .klists = klists,
                                            .add_missing_kmers = add_missing_kmers,
                                            .ref_col = ref_col,
+                                           .ref_edges = ref_edges,
                                            .db_graph = db_graph};
   }
 
@@ -294,15 +373,11 @@ static void load_reads_count_kmers(const read_t *reads, size_t num_reads,
   }
 }
 
-/**
- * Create a KOGraph from given sequence reads
- * BEWARE: We add the reads to the graph if add_missing_kmers is true
- * db_graph->col_edges can be NULL even if we are adding kmers
- * @param add_missing_kmers  If true, add kmers to the graph in colour ref_col
- **/
-KOGraph kograph_create(const read_t *reads, size_t num_reads,
-                       bool add_missing_kmers, size_t ref_col,
-                       size_t num_threads, dBGraph *db_graph)
+// If ref_edges is not NULL, record edges from the reads in it
+static KOGraph _kograph_create(const read_t *reads, size_t num_reads,
+                               bool add_missing_kmers, size_t ref_col,
+                               size_t num_threads, Edges *ref_edges,
+                               dBGraph *db_graph)
 {
   size_t i;
 
@@ -334,9 +409,9 @@ KOGraph kograph_create(const read_t *reads, size_t num_reads,
 
   // 1. Loop through reads, add to graph and record kmer counts
   load_reads_count_kmers(reads, num_reads, add_missing_kmers, ref_col,
-                         num_threads, kograph.klists, db_graph);
+                         num_threads, kograph.klists, ref_edges, db_graph);
 
-  status("[kograh] Consolidating annotations (single-threaded)");
+  status("[kograh] Consolidating annotations");
 
   // 2. allocate a list for each kmer (some of length zero)
   uint64_t offset = 0, kcount, total_read_length = 0, total_kcount = 0;
@@ -354,43 +429,335 @@ KOGraph kograph_create(const read_t *reads, size_t num_reads,
 
   kograph.koccurs = total_kcount ? ctx_malloc(total_kcount * sizeof(KOccur)) : NULL;
 
+  // Replace counts with the offset of each kmer's first KOccur
   for(i = 0; i < db_graph->ht.capacity; i++)
   {
-    // kcount/start are in a union -- can't use both
     kcount = kograph.klists[i].kcount;
-    kograph.klists[i].first = kcount ? kograph.koccurs + offset : NULL;
+    kograph.klists[i].kcount = offset;
     offset += kcount;
   }
 
-  // Don't refer to klists[].kcount now -- only use klists[].start
-
   // 3. Loop through reads, record kmer pos
-  //    Don't multithread this section, since we want reads to be added in order
-  //    of read, and position in the read.
+  //    Threads claim the next KOccur of each kmer with an atomic increment, so
+  //    lists are filled out of order and sorted afterwards
   if(total_kcount > 0) {
+    struct ReadStorePos *tasks = ctx_malloc(num_reads * sizeof(struct ReadStorePos));
     for(i = 0; i < num_reads; i++) {
-      read_store_kmer_pos(&reads[i], i, kograph.klists, db_graph);
+      tasks[i] = (struct ReadStorePos){.r = &reads[i], .chrom_id = i,
+                                       .klists = kograph.klists,
+                                       .koccurs = kograph.koccurs,
+                                       .db_graph = db_graph};
     }
+    util_run_threads(tasks, num_reads, sizeof(struct ReadStorePos),
+                     num_threads, read_store_kmer_pos);
+    ctx_free(tasks);
   }
 
-  // 4. Rest pointers to point to the first item
-  KOccur *ptr = kograph.koccurs;
+  // 4. klists[].kcount is now the end offset of each list, convert to
+  //    pointers to the first item (kcount/first are in a union)
+  uint64_t start = 0, end;
   for(i = 0; i < db_graph->ht.capacity; i++) {
-    if(kograph.klists[i].first != NULL) {
-      (kograph.klists[i].first-1)->next = 0;
-      SWAP(kograph.klists[i].first, ptr);
-    }
+    end = kograph.klists[i].kcount;
+    kograph.klists[i].first = end > start ? kograph.koccurs + start : NULL;
+    if(end > start) kograph.koccurs[end-1].next = 0;
+    start = end;
+  }
+
+  // 5. Sort each list by chromosome and offset
+  if(total_kcount > 0) {
+    struct KOListSort sorter = {.klists = kograph.klists,
+                                .capacity = db_graph->ht.capacity,
+                                .nthreads = num_threads};
+    util_multi_thread(&sorter, num_threads, kolists_sort);
   }
 
   return kograph;
 }
 
+/**
+ * Create a KOGraph from given sequence reads
+ * BEWARE: We add the reads to the graph if add_missing_kmers is true
+ * db_graph->col_edges can be NULL even if we are adding kmers
+ * @param add_missing_kmers  If true, add kmers to the graph in colour ref_col
+ **/
+KOGraph kograph_create(const read_t *reads, size_t num_reads,
+                       bool add_missing_kmers, size_t ref_col,
+                       size_t num_threads, dBGraph *db_graph)
+{
+  return _kograph_create(reads, num_reads, add_missing_kmers, ref_col,
+                         num_threads, NULL, db_graph);
+}
+
 void kograph_dealloc(KOGraph *kograph)
 {
   ctx_free(kograph->chrom_name_buf);
   ctx_free(kograph->chroms);
   ctx_free(kograph->klists);
-  ctx_free(kograph->koccurs);
+  if(kograph->mmap_ptr) munmap(kograph->mmap_ptr, kograph->mmap_len);
+  else ctx_free(kograph->koccurs);
+  memset(kograph, 0, sizeof(*kograph));
+}
+
+//
+// Saving and loading
+//
+
+uint64_t kograph_checksum(const read_t *reads, size_t num_reads)
+{
+  uint64_t hash = num_reads;
+  size_t i;
+  for(i = 0; i < num_reads; i++) {
+    hash = CityHash64WithSeed(reads[i].name.b, reads[i].name.end, hash);
+    hash = CityHash64WithSeed(reads[i].seq.b, reads[i].seq.end, hash);
+  }
+  return hash;
+}
+
+static size_t _fwrite_pad8(const void *ptr, size_t nbytes, FILE *fh,
+                           const char *path)
+{
+  const uint8_t zeros[8] = {0};
+  size_t pad = (8 - (nbytes & 7)) & 7;
+  if(fwrite(ptr, 1, nbytes, fh) != nbytes || fwrite(zeros, 1, pad, fh) != pad)
+    die("Cannot write to file: %s [%s]", path, strerror(errno));
+  return nbytes + pad;
+}
+
+#define _pad8(x) (((x)+7) & ~(size_t)7)
+
+static void kograph_save(const KOGraph *kograph, const Edges *ref_edges,
+                         uint64_t checksum, uint64_t total_bases,
+                         const char *path, const dBGraph *db_graph)
+{
+  size_t i, nbytes = 0, names_bytes = 0, num_kmers = 0, num_koccurs = 0;
+  const KOccur *kolist;
+
+  for(i = 0; i < kograph->nchroms; i++)
+    names_bytes += strlen(kograph->chroms[i].name)+1;
+
+  for(i = 0; i < db_graph->ht.capacity; i++) {
+    if((kolist = kograph->klists[i].first) != NULL) {
+      num_kmers++;
+      for(num_koccurs++; kolist->next; kolist++) num_koccurs++;
+    }
+  }
+
+  KOGraphFileHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, KOG_MAGIC, sizeof(hdr.magic));
+  hdr.version = KOG_VERSION;
+  hdr.kmer_size = db_graph->kmer_size;
+  hdr.num_bkmer_words = NUM_BKMER_WORDS;
+  hdr.checksum = checksum;
+  hdr.nchroms = kograph->nchroms;
+  hdr.names_bytes = names_bytes;
+  hdr.num_kmers = num_kmers;
+  hdr.num_koccurs = num_koccurs;
+  hdr.total_bases = total_bases;
+
+  // Write to a temporary file then rename, so another job never loads a
+  // partially written file
+  StrBuf tmp_path;
+  strbuf_alloc(&tmp_path, strlen(path)+50);
+  strbuf_sprintf(&tmp_path, "%s.tmp.%i", path, (int)getpid());
+
+  status("[kograph] Saving reference index to: %s", futil_outpath_str(path));
+
+  FILE *fh = futil_fopen_create(tmp_path.b, "w");
+  nbytes += _fwrite_pad8(&hdr, sizeof(hdr), fh, path);
+
+  // Names were concatenated into chrom_name_buf by generate_chrom_list()
+  KOChromRecord chrom;
+  for(i = 0; i < kograph->nchroms; i++) {
+    chrom = (KOChromRecord){.length = kograph->chroms[i].length,
+                            .name_offset = kograph->chroms[i].name -
+                                           kograph->chrom_name_buf};
+    nbytes += _fwrite_pad8(&chrom, sizeof(chrom), fh, path);
+  }
+
+  nbytes += _fwrite_pad8(kograph->chrom_name_buf, names_bytes, fh, path);
+
+  KOKmerRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  for(i = 0; i < db_graph->ht.capacity; i++) {
+    if((kolist = kograph->klists[i].first) != NULL) {
+      rec.bkey = db_node_get_bkmer(db_graph, i);
+      rec.koccur = kolist - kograph->koccurs;
+      rec.edges = ref_edges[i];
+      nbytes += _fwrite_pad8(&rec, sizeof(rec), fh, path);
+    }
+  }
+
+  nbytes += _fwrite_pad8(kograph->koccurs, num_koccurs*sizeof(KOccur), fh, path);
+  fclose(fh);
+
+  if(rename(tmp_path.b, path) != 0)
+    die("Cannot rename %s -> %s [%s]", tmp_path.b, path, strerror(errno));
+
+  strbuf_dealloc(&tmp_path);
+
+  char num_kmers_str[50], mem_str[50];
+  ulong_to_str(num_kmers, num_kmers_str);
+  bytes_to_str(nbytes, 1, mem_str);
+  status("[kograph] Wrote %s kmers, %s", num_kmers_str, mem_str);
+}
+
+KOGraph kograph_create_save(const read_t *reads, size_t num_reads,
+                            size_t ref_col, size_t num_threads,
+                            uint64_t checksum, const char *path,
+                            dBGraph *db_graph)
+{
+  size_t i;
+  uint64_t total_bases = 0;
+  Edges *ref_edges = ctx_calloc(db_graph->ht.capacity, sizeof(Edges));
+
+  KOGraph kograph = _kograph_create(reads, num_reads, true, ref_col,
+                                    num_threads, ref_edges, db_graph);
+
+  for(i = 0; i < num_reads; i++) total_bases += reads[i].seq.end;
+
+  kograph_save(&kograph, ref_edges, checksum, total_bases, path, db_graph);
+  ctx_free(ref_edges);
+
+  return kograph;
+}
+
+struct KOGraphLoader {
+  const KOKmerRecord *kmers;
+  KOccur *koccurs;
+  size_t num_kmers, ref_col;
+  KONodeList *klists;
+  volatile size_t next_block;
+  dBGraph *db_graph;
+};
+
+#define KOG_LOAD_BLOCK 4096
+
+static void kograph_load_kmers(void *arg, size_t threadid)
+{
+  (void)threadid;
+  struct KOGraphLoader *ldr = (struct KOGraphLoader*)arg;
+  dBGraph *db_graph = ldr->db_graph;
+  size_t i, end;
+  const KOccur *kolist;
+  dBNode node;
+  bool found;
+
+  while((i = __sync_fetch_and_add(&ldr->next_block, KOG_LOAD_BLOCK)) < ldr->num_kmers)
+  {
+    end = MIN2(i + KOG_LOAD_BLOCK, ldr->num_kmers);
+    for(; i < end; i++)
+    {
+      node = db_graph_find_or_add_node_mt(db_graph, ldr->kmers[i].bkey, &found);
+      ldr->klists[node.key].first = ldr->koccurs + ldr->kmers[i].koccur;
+
+      // Update colour/coverage once per occurrence as kograph_create() does
+      for(kolist = ldr->klists[node.key].first; 1; kolist++) {
+        db_graph_update_node_mt(db_graph, node, ldr->ref_col);
+        if(!kolist->next) break;
+      }
+
+      // bkey is a kmer key so node.orient is FORWARD
+      if(db_graph->col_edges != NULL)
+        __sync_or_and_fetch(&db_node_edges(db_graph, node.key, 0),
+                            (Edges)ldr->kmers[i].edges);
+    }
+  }
+}
+
+bool kograph_load(KOGraph *kograph, const char *path, uint64_t checksum,
+                  size_t ref_col, size_t num_threads, dBGraph *db_graph)
+{
+  int fd;
+  struct stat st;
+  void *ptr;
+
+  ctx_assert(db_graph->num_edge_cols <= 1);
+  ctx_assert(db_graph->bktlocks != NULL);
+
+  if(!futil_file_exists(path)) return false;
+
+  if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+    die("Cannot open reference index: %s [%s]", path, strerror(errno));
+  if((size_t)st.st_size < sizeof(KOGraphFileHeader))
+    die("Not a reference index: %s", path);
+
+  ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(ptr == MAP_FAILED)
+    die("Cannot memory map file: %s [%s]", path, strerror(errno));
+
+  const KOGraphFileHeader *hdr = (const KOGraphFileHeader*)ptr;
+  if(memcmp(hdr->magic, KOG_MAGIC, sizeof(hdr->magic)) != 0)
+    die("Not a reference index: %s", path);
+  if(hdr->version != KOG_VERSION)
+    die("Reference index version %u not supported: %s", hdr->version, path);
+
+  if(hdr->num_bkmer_words != NUM_BKMER_WORDS ||
+     hdr->kmer_size != db_graph->kmer_size || hdr->checksum != checksum)
+  {
+    warn("Reference index doesn't match this reference/kmer size: %s", path);
+    munmap(ptr, st.st_size);
+    return false;
+  }
+
+  size_t offsets[5];
+  offsets[0] = _pad8(sizeof(KOGraphFileHeader));
+  offsets[1] = offsets[0] + _pad8(hdr->nchroms*sizeof(KOChromRecord));
+  offsets[2] = offsets[1] + _pad8(hdr->names_bytes);
+  offsets[3] = offsets[2] + _pad8(hdr->num_kmers*sizeof(KOKmerRecord));
+  offsets[4] = offsets[3] + _pad8(hdr->num_koccurs*sizeof(KOccur));
+
+  if(offsets[4] != (size_t)st.st_size) {
+    die("Reference index is corrupt: %s [expected %zu bytes, got %zu]",
+        path, offsets[4], (size_t)st.st_size);
+  }
+
+  status("[kograph] Loading reference index from %s using %zu thread%s",
+         futil_inpath_str(path), num_threads, util_plural_str(num_threads));
+
+  const uint8_t *b = (const uint8_t*)ptr;
+  const KOChromRecord *chroms = (const KOChromRecord*)(b + offsets[0]);
+  const char *names = (const char*)(b + offsets[1]);
+  size_t i;
+
+  memset(kograph, 0, sizeof(KOGraph));
+  kograph->nchroms = hdr->nchroms;
+  kograph->chroms = ctx_malloc(hdr->nchroms * sizeof(KOChrom));
+  for(i = 0; i < hdr->nchroms; i++) {
+    kograph->chroms[i] = (KOChrom){.id = i, .length = chroms[i].length,
+                                   .name = names + chroms[i].name_offset};
+  }
+
+  kograph->koccurs = (KOccur*)(b + offsets[3]);
+  kograph->klists = ctx_calloc(db_graph->ht.capacity, sizeof(KONodeList));
+  kograph->mmap_ptr = ptr;
+  kograph->mmap_len = st.st_size;
+
+  struct KOGraphLoader ldr = {.kmers = (const KOKmerRecord*)(b + offsets[2]),
+                              .koccurs = kograph->koccurs,
+                              .num_kmers = hdr->num_kmers,
+                              .ref_col = ref_col,
+                              .klists = kograph->klists,
+                              .next_block = 0,
+                              .db_graph = db_graph};
+
+  util_multi_thread(&ldr, num_threads, kograph_load_kmers);
+
+  // Update ginfo
+  SeqLoadingStats stats;
+  memset(&stats, 0, sizeof(stats));
+  stats.num_se_reads = hdr->nchroms;
+  stats.contigs_parsed = hdr->nchroms;
+  stats.total_bases_read = hdr->total_bases;
+  stats.total_bases_loaded = hdr->total_bases;
+  graph_info_update_stats(&db_graph->ginfo[ref_col], &stats);
+
+  char num_kmers_str[50];
+  ulong_to_str(hdr->num_kmers, num_kmers_str);
+  status("[kograph] Loaded %s reference kmers", num_kmers_str);
+
+  return true;
 }
 
 
@@ -39,8 +39,47 @@ typedef struct
   KONodeList *klists; // one entry per hash entry
   size_t nchroms;
   char *chrom_name_buf;
+  void *mmap_ptr; // non-NULL if koccurs and names are in a mapped file
+  size_t mmap_len;
 } KOGraph;
 
+//
+// Saved KOGraph (.kog) so the reference only needs to be indexed once.
+// The file is memory mapped on load, so concurrent jobs on the same machine
+// share one copy through the page cache.
+// File is keyed on kmer size and a checksum of the reference sequences.
+//
+// File layout (native endian, all sections 8 byte aligned):
+//   KOGraphFileHeader
+//   KOChromRecord chroms[nchroms]
+//   char          names[names_bytes]  NUL terminated chromosome names
+//   KOKmerRecord  kmers[num_kmers]
+//   KOccur        koccurs[num_koccurs]
+//
+
+#define KOG_MAGIC "CTXKOGRF"
+#define KOG_VERSION 1
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version, kmer_size, num_bkmer_words, padding;
+  uint64_t checksum, nchroms, names_bytes, num_kmers, num_koccurs, total_bases;
+} KOGraphFileHeader;
+
+typedef struct
+{
+  uint64_t length, name_offset;
+} KOChromRecord;
+
+// edges are those seen in the reference, with respect to bkey
+typedef struct
+{
+  BinaryKmer bkey;
+  uint64_t koccur; // index of first KOccur
+  uint64_t edges:8, padding:56;
+} KOKmerRecord;
+
 typedef struct {
   uint64_t first, last; // 0-bases chromosome coordinates
   uint32_t qoffset, chrom; // qoffset some query offset
@@ -65,6 +104,29 @@ KOGraph kograph_create(const read_t *reads, size_t num_reads,
 
 void kograph_dealloc(KOGraph *kograph);
 
+// Checksum of sequence names and bases, used to match saved KOGraphs
+uint64_t kograph_checksum(const read_t *reads, size_t num_reads);
+
+/**
+ * As kograph_create() with add_missing_kmers, and save the result to `path`
+ * (written to a temporary file then renamed, so readers never see a partial
+ * file).
+ * @param checksum from kograph_checksum() on `reads`
+ **/
+KOGraph kograph_create_save(const read_t *reads, size_t num_reads,
+                            size_t ref_col, size_t num_threads,
+                            uint64_t checksum, const char *path,
+                            dBGraph *db_graph);
+
+/**
+ * Load a saved KOGraph, adding its kmers (and edges if db_graph->col_edges is
+ * not NULL) to the graph in colour ref_col.
+ * @return false if `path` doesn't exist or was built with a different kmer
+ *         size or reference, dies if the file is corrupt
+ **/
+bool kograph_load(KOGraph *kograph, const char *path, uint64_t checksum,
+                  size_t ref_col, size_t num_threads, dBGraph *db_graph);
+
 // Get KOccur* to first occurance of a kmer in sequence
 #define kograph_get(kograph,hkey) ((kograph)->klists[hkey].first)
 
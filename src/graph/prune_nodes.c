@@ -26,13 +26,14 @@ void prune_node_without_edges_mt(dBGraph *db_graph, hkey_t hkey)
 }
 
 // For all flagged nodes, trim edges to non-flagged nodes
+// If `lost_edges` is not NULL, mark flagged nodes that lose an edge
 // After calling this function on all nodes, call:
 // prune_nodes_lacking_flag_no_edges
 static inline
 int prune_edges_to_nodes_lacking_flag(hkey_t hkey, const uint8_t *flags,
-                                      dBGraph *db_graph)
+                                      uint8_t *lost_edges, dBGraph *db_graph)
 {
-  Edges keep_edges = 0x0;
+  Edges keep_edges = 0x0, init_edges;
   Orientation orient;
   Nucleotide nuc;
   dBNode next_node;
@@ -43,7 +44,7 @@ int prune_edges_to_nodes_lacking_flag(hkey_t hkey, const uint8_t *flags,
   {
     // Check edges
     bkmer = db_node_get_bkmer(db_graph, hkey);
-    keep_edges = db_node_get_edges_union(db_graph, hkey);
+    keep_edges = init_edges = db_node_get_edges_union(db_graph, hkey);
 
     for(orient = 0; orient < 2; orient++)
     {
@@ -61,6 +62,9 @@ int prune_edges_to_nodes_lacking_flag(hkey_t hkey, const uint8_t *flags,
         }
       }
     }
+
+    if(lost_edges != NULL && keep_edges != init_edges)
+      (void)bitset_set_mt(lost_edges, hkey);
   }
 
   for(col = 0; col < db_graph->num_edge_cols; col++)
@@ -83,6 +87,7 @@ int prune_nodes_lacking_flag_no_edges(hkey_t hkey, const uint8_t *flags,
 typedef struct {
   size_t nthreads;
   const uint8_t *keep_flags;
+  uint8_t *lost_edges;
   dBGraph *db_graph;
 } GraphCleaning;
 
@@ -93,7 +98,7 @@ static void worker_prune_node_edges(void *arg, size_t threadid)
   // printf("== Edges == Thread %zu / %zu\n", threadid, cl.nthreads);
   HASH_ITERATE_PART(&cl.db_graph->ht, threadid, cl.nthreads,
                     prune_edges_to_nodes_lacking_flag,
-                    cl.keep_flags, cl.db_graph);
+                    cl.keep_flags, cl.lost_edges, cl.db_graph);
 }
 
 static void worker_prune_nodes(void *arg, size_t threadid)
@@ -109,9 +114,17 @@ static void worker_prune_nodes(void *arg, size_t threadid)
 // Remove all nodes that do not have a given flag
 void prune_nodes_lacking_flag(size_t nthreads, const uint8_t *flags,
                               dBGraph *db_graph)
+{
+  prune_nodes_lacking_flag_mark(nthreads, flags, NULL, db_graph);
+}
+
+// Remove all nodes that do not have a given flag, set a bit in `lost_edges`
+// for each remaining node that had an edge removed
+void prune_nodes_lacking_flag_mark(size_t nthreads, const uint8_t *flags,
+                                   uint8_t *lost_edges, dBGraph *db_graph)
 {
   GraphCleaning cleaning = {.nthreads = nthreads, .keep_flags = flags,
-                            .db_graph = db_graph};
+                            .lost_edges = lost_edges, .db_graph = db_graph};
 
   // Trim edges from valid nodes
   if(db_graph->col_edges != NULL) {
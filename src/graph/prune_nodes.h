@@ -21,6 +21,11 @@ void prune_unitig(dBNode *nodes, size_t len, dBGraph *db_graph);
 void prune_nodes_lacking_flag(size_t num_threads, const uint8_t *flags,
                               dBGraph *db_graph);
 
+// As above, also sets a bit in `lost_edges` for each remaining node that had
+// an edge removed. Used by clean_graph.c to find newly exposed tips
+void prune_nodes_lacking_flag_mark(size_t num_threads, const uint8_t *flags,
+                                   uint8_t *lost_edges, dBGraph *db_graph);
+
 // Currently unused
 // remove nodes if not in any colour
 // i.e. db_node_has_col(graph,node,colour) == false for all colours
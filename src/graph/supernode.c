@@ -1,4 +1,7 @@
 #include "global.h"
+
+#include <sys/time.h> // gettimeofday()
+
 #include "util.h"
 #include "binary_kmer.h"
 #include "hash_table.h"
@@ -101,6 +104,8 @@ bool supernode_extend(dBNodeBuffer *nbuf, size_t limit,
   while(edges_has_precisely_one_edge(edges, node.orient, &nuc))
   {
     bkmer = binary_kmer_left_shift_add(bkmer, kmer_size, nuc);
+    // Request the step after next while we look up the next node
+    db_graph_prefetch_next(db_graph, bkmer, FORWARD, 0xff);
     node = db_graph_find(db_graph, bkmer);
     edges = db_node_get_edges_union(db_graph, node.key);
 
@@ -164,6 +169,34 @@ size_t supernode_covg_mean(const Covg *covgs, size_t len)
 //
 // Iterate over supernodes in the graph with multiple threads
 //
+// Threads claim blocks of the hash table from a shared counter, so a thread
+// that finishes early takes more work rather than sitting idle. Unitigs are
+// only walked from their end kmers: interior kmers are skipped after looking
+// at one neighbour, so a unitig is walked once rather than once per thread
+// that lands on it. Closed cycles have no ends and are picked up by a second
+// pass over the kmers that are still unvisited.
+//
+
+#define SNODE_ITER_BLOCK (1UL<<16)
+
+// Returns true if we cannot walk backwards from node `hkey` in orientation
+// `orient`, i.e. supernode_extend() would stop here
+static inline bool supernode_is_end(hkey_t hkey, Orientation orient,
+                                    const dBGraph *db_graph)
+{
+  Edges edges = db_node_get_edges_union(db_graph, hkey);
+  dBNode prev[4];
+  Nucleotide nucs[4];
+
+  if(edges_get_indegree(edges, orient) != 1) return true;
+
+  BinaryKmer bkmer = db_node_get_bkmer(db_graph, hkey);
+  db_graph_next_nodes(db_graph, bkmer, rev_orient(orient), edges, prev, nucs);
+
+  if(prev[0].key == hkey) return true;
+  edges = db_node_get_edges_union(db_graph, prev[0].key);
+  return (edges_get_indegree(edges, prev[0].orient) != 1);
+}
 
 static inline int supernode_iterate_node(hkey_t hkey, size_t threadid,
                                          dBNodeBuffer *nbuf,
@@ -194,10 +227,11 @@ static inline int supernode_iterate_node(hkey_t hkey, size_t threadid,
         (void)bitset_set_mt(visited, nbuf->b[i].key);
 
       func(*nbuf, threadid, arg);
+      return 1;
     }
   }
 
-  return 0; // => keep iterating
+  return 0;
 }
 
 typedef struct {
@@ -206,19 +240,62 @@ typedef struct {
   const dBGraph *db_graph;
   void (*func)(dBNodeBuffer _nbuf, size_t threadid, void *_arg);
   void *arg;
+  volatile size_t next_block[2]; // next block of the table for each pass
+  volatile size_t num_unitigs, num_cycles;
 } SupernodeIterating;
 
+// Pass 0 starts only from unitig ends, pass 1 from any unvisited kmer
+static size_t supernodes_iterate_pass(SupernodeIterating *iter, size_t pass,
+                                      size_t threadid, dBNodeBuffer *nbuf)
+{
+  const HashTable *ht = &iter->db_graph->ht;
+  const BinaryKmer *table = ht->table;
+  size_t blk, start, end, h, n = 0;
+
+  while((blk = __sync_fetch_and_add(&iter->next_block[pass], 1)) *
+        SNODE_ITER_BLOCK < ht->capacity)
+  {
+    start = blk * SNODE_ITER_BLOCK;
+    end = MIN2(start + SNODE_ITER_BLOCK, ht->capacity);
+
+    for(h = start; h < end; h++) {
+      if(HASH_ENTRY_ASSIGNED(table[h]) && !bitset_get_mt(iter->visited, h) &&
+         (pass == 1 || supernode_is_end(h, FORWARD, iter->db_graph) ||
+                       supernode_is_end(h, REVERSE, iter->db_graph)))
+      {
+        n += supernode_iterate_node(h, threadid, nbuf, iter->visited,
+                                    iter->db_graph, iter->func, iter->arg);
+      }
+    }
+  }
+
+  return n;
+}
+
 static void supernodes_iterate_thread(void *arg, size_t threadid)
 {
-  SupernodeIterating iter = *(SupernodeIterating*)arg;
+  SupernodeIterating *iter = (SupernodeIterating*)arg;
+  size_t n;
+
+  dBNodeBuffer nbuf;
+  db_node_buf_alloc(&nbuf, 2048);
+
+  n = supernodes_iterate_pass(iter, 0, threadid, &nbuf);
+  __sync_fetch_and_add(&iter->num_unitigs, n);
+
+  db_node_buf_dealloc(&nbuf);
+}
+
+static void supernodes_iterate_cycles(void *arg, size_t threadid)
+{
+  SupernodeIterating *iter = (SupernodeIterating*)arg;
+  size_t n;
 
   dBNodeBuffer nbuf;
   db_node_buf_alloc(&nbuf, 2048);
 
-  HASH_ITERATE_PART(&iter.db_graph->ht, threadid, iter.nthreads,
-                    supernode_iterate_node,
-                    threadid, &nbuf, iter.visited, iter.db_graph,
-                    iter.func, iter.arg);
+  n = supernodes_iterate_pass(iter, 1, threadid, &nbuf);
+  __sync_fetch_and_add(&iter->num_cycles, n);
 
   db_node_buf_dealloc(&nbuf);
 }
@@ -237,7 +314,26 @@ void supernodes_iterate(size_t nthreads, uint8_t *visited,
                              .visited = visited,
                              .db_graph = db_graph,
                              .func = func,
-                             .arg = arg};
+                             .arg = arg,
+                             .next_block = {0,0},
+                             .num_unitigs = 0, .num_cycles = 0};
+
+  struct timeval t0, t1;
+  gettimeofday(&t0, NULL);
 
+  // Second pass has to wait for the first to finish, otherwise a thread would
+  // start walking mid-unitig before the owner of its end had marked it
   util_multi_thread(&iter, nthreads, supernodes_iterate_thread);
+  util_multi_thread(&iter, nthreads, supernodes_iterate_cycles);
+
+  gettimeofday(&t1, NULL);
+  double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1e6;
+  size_t total = iter.num_unitigs + iter.num_cycles;
+
+  char total_str[50], cycles_str[50], rate_str[50];
+  ulong_to_str(total, total_str);
+  ulong_to_str(iter.num_cycles, cycles_str);
+  ulong_to_str(secs > 0 ? (size_t)(total / secs) : total, rate_str);
+  status("[unitigs] %s unitigs (%s cycles) in %.2f secs [%s unitigs/s]",
+         total_str, cycles_str, secs, rate_str);
 }
@@ -0,0 +1,350 @@
+#include "global.h"
+#include "unitig_index.h"
+#include "db_node.h"
+#include "supernode.h"
+#include "file_util.h"
+#include "util.h"
+
+#include <sys/mman.h>
+#include <fcntl.h> // open()
+#include <sys/stat.h>
+
+#define _seq_nbytes(nbases) (((nbases)+3)/4)
+#define _seq_nuc(seq,i) (((seq)[(i)/4] >> (2*((i)&3))) & 3)
+#define _seq_set_nuc(seq,i,n) ((seq)[(i)/4] |= (uint8_t)((n) << (2*((i)&3))))
+
+// Memory used while building
+typedef struct
+{
+  UnitigKmerGraph *ugraph;
+  const dBGraph *db_graph;
+  UnitigRecord *unitigs;
+  UnitigKmer *kmers;
+  uint8_t *seq;
+  dBNode *uends; // first and last node of each unitig
+  volatile size_t kmers_used, seq_used;
+} UnitigIndexBuilder;
+
+// Store sequence, kmers and number of links from each end
+static void _index_unitig(dBNodeBuffer nbuf, size_t threadid, void *arg)
+{
+  (void)threadid;
+  UnitigIndexBuilder *bld = (UnitigIndexBuilder*)arg;
+  const dBGraph *db_graph = bld->db_graph;
+  const size_t kmer_size = db_graph->kmer_size, n = nbuf.len;
+  dBNode *nodes = nbuf.b;
+  size_t i, uid, kidx, sidx, nbases = n + kmer_size - 1;
+  Edges edges0, edges1;
+
+  supernode_normalise(nodes, n, db_graph);
+  uid = bld->ugraph->unitig_ends[nodes[0].key].unitigid;
+  kidx = __sync_fetch_and_add(&bld->kmers_used, n);
+  sidx = __sync_fetch_and_add(&bld->seq_used, _seq_nbytes(nbases));
+
+  // Pack sequence: first kmer then the last base of each following kmer
+  uint8_t *seq = bld->seq + sidx;
+  char kstr[MAX_KMER_SIZE+1];
+  BinaryKmer bkmer = db_node_oriented_bkmer(db_graph, nodes[0]);
+  binary_kmer_to_str(bkmer, kmer_size, kstr);
+  for(i = 0; i < kmer_size; i++)
+    _seq_set_nuc(seq, i, dna_char_to_nuc(kstr[i]));
+  for(i = 1; i < n; i++)
+    _seq_set_nuc(seq, i+kmer_size-1, db_node_get_last_nuc(nodes[i], db_graph));
+
+  for(i = 0; i < n; i++) {
+    bld->kmers[kidx+i] = (UnitigKmer){.bkey = db_node_get_bkmer(db_graph, nodes[i].key),
+                                      .unitig = uid, .offset = (uint32_t)i,
+                                      .orient = nodes[i].orient};
+  }
+
+  edges0 = db_node_get_edges_union(db_graph, nodes[0].key);
+  edges1 = db_node_get_edges_union(db_graph, nodes[n-1].key);
+
+  bld->unitigs[uid] = (UnitigRecord){.seq_offset = sidx, .links_offset = 0,
+                                     .num_kmers = (uint32_t)n,
+                                     .nleft = edges_get_indegree(edges0, nodes[0].orient),
+                                     .nright = edges_get_outdegree(edges1, nodes[n-1].orient),
+                                     .padding = 0};
+
+  bld->uends[2*uid] = nodes[0];
+  bld->uends[2*uid+1] = nodes[n-1];
+}
+
+typedef struct
+{
+  size_t nthreads;
+  UnitigIndexBuilder *bld;
+  uint64_t *links;
+} UnitigLinker;
+
+// Fill in links leaving `node`
+static inline void _store_links(dBNode node, uint64_t *links,
+                                const UnitigKmerGraph *ugraph)
+{
+  const dBGraph *db_graph = ugraph->db_graph;
+  dBNode next_nodes[4];
+  Nucleotide next_nucs[4];
+  size_t i, n;
+  Orientation orient;
+  BinaryKmer bkey = db_node_get_bkmer(db_graph, node.key);
+  Edges edges = db_node_get_edges_union(db_graph, node.key);
+
+  n = db_graph_next_nodes(db_graph, bkey, node.orient, edges,
+                          next_nodes, next_nucs);
+
+  for(i = 0; i < n; i++) {
+    UnitigEnd uend = ugraph->unitig_ends[next_nodes[i].key];
+    ctx_assert(uend.assigned);
+    orient = uend.left && next_nodes[i].orient == uend.lorient ? FORWARD : REVERSE;
+    links[i] = ((uint64_t)uend.unitigid << 1) | orient;
+  }
+}
+
+static void _link_unitigs(void *arg, size_t threadid)
+{
+  UnitigLinker *lnkr = (UnitigLinker*)arg;
+  UnitigIndexBuilder *bld = lnkr->bld;
+  size_t uid, num_unitigs = bld->ugraph->num_unitigs;
+  UnitigRecord *r;
+
+  for(uid = threadid; uid < num_unitigs; uid += lnkr->nthreads) {
+    r = &bld->unitigs[uid];
+    _store_links(db_node_reverse(bld->uends[2*uid]),
+                 lnkr->links + r->links_offset, bld->ugraph);
+    _store_links(bld->uends[2*uid+1],
+                 lnkr->links + r->links_offset + r->nleft, bld->ugraph);
+  }
+}
+
+static int _unitig_kmer_cmp(const void *aa, const void *bb)
+{
+  const UnitigKmer *a = (const UnitigKmer*)aa, *b = (const UnitigKmer*)bb;
+  return binary_kmers_cmp(a->bkey, b->bkey);
+}
+
+/**
+ * Build index of a loaded graph with a single colour of edges
+ * @param ugraph  allocated but not created, will hold unitig ends on return
+ * @param visited must be initialised to zero, will be dirty upon return
+ */
+void unitig_index_build(UnitigIndex *ui, UnitigKmerGraph *ugraph,
+                        size_t nthreads, uint8_t *visited)
+{
+  const dBGraph *db_graph = ugraph->db_graph;
+  const size_t kmer_size = db_graph->kmer_size;
+  size_t i, num_unitigs, num_kmers = db_graph->ht.num_kmers, num_links = 0;
+
+  status("[UnitigIndex] Finding unitigs with %zu threads...", nthreads);
+
+  // First pass: number unitigs and label their ends
+  unitig_graph_create(ugraph, nthreads, visited, NULL, NULL);
+  memset(visited, 0, roundup_bits2bytes(db_graph->ht.capacity));
+  num_unitigs = ugraph->num_unitigs;
+
+  // Each unitig is padded to a whole number of bytes
+  size_t max_seq_bytes = _seq_nbytes(num_kmers + num_unitigs*(kmer_size-1)) +
+                         num_unitigs;
+
+  UnitigIndexBuilder bld = {.ugraph = ugraph, .db_graph = db_graph,
+                            .unitigs = ctx_calloc(num_unitigs, sizeof(UnitigRecord)),
+                            .kmers = ctx_calloc(num_kmers, sizeof(UnitigKmer)),
+                            .seq = ctx_calloc(max_seq_bytes, 1),
+                            .uends = ctx_calloc(2*num_unitigs, sizeof(dBNode)),
+                            .kmers_used = 0, .seq_used = 0};
+
+  // Second pass: sequence, kmers and link counts
+  supernodes_iterate(nthreads, visited, db_graph, _index_unitig, &bld);
+  ctx_assert(bld.kmers_used == num_kmers);
+
+  for(i = 0; i < num_unitigs; i++) {
+    bld.unitigs[i].links_offset = num_links;
+    num_links += bld.unitigs[i].nleft + bld.unitigs[i].nright;
+  }
+
+  UnitigLinker lnkr = {.nthreads = nthreads, .bld = &bld,
+                       .links = ctx_calloc(num_links+1, sizeof(uint64_t))};
+  util_multi_thread(&lnkr, nthreads, _link_unitigs);
+  ctx_free(bld.uends);
+
+  qsort(bld.kmers, num_kmers, sizeof(UnitigKmer), _unitig_kmer_cmp);
+
+  UnitigIndex tmp = {.kmer_size = kmer_size, .num_unitigs = num_unitigs,
+                     .num_links = num_links, .num_kmers = num_kmers,
+                     .seq_bytes = bld.seq_used,
+                     .unitigs = bld.unitigs, .links = lnkr.links,
+                     .kmers = bld.kmers, .seq = bld.seq,
+                     .mmap_ptr = NULL, .mmap_len = 0};
+  memcpy(ui, &tmp, sizeof(tmp));
+
+  char num_unitigs_str[50], num_links_str[50];
+  ulong_to_str(num_unitigs, num_unitigs_str);
+  ulong_to_str(num_links, num_links_str);
+  status("[UnitigIndex] %s unitigs, %s links", num_unitigs_str, num_links_str);
+}
+
+static size_t _fwrite_pad8(const void *ptr, size_t nbytes, FILE *fh,
+                           const char *path)
+{
+  const uint8_t zeros[8] = {0};
+  size_t pad = (8 - (nbytes & 7)) & 7;
+  if(fwrite(ptr, 1, nbytes, fh) != nbytes || fwrite(zeros, 1, pad, fh) != pad)
+    die("Cannot write to file: %s [%s]", path, strerror(errno));
+  return nbytes + pad;
+}
+
+void unitig_index_save(const UnitigIndex *ui, const char *path)
+{
+  UnitigIndexHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, CTU_MAGIC, sizeof(hdr.magic));
+  hdr.version = CTU_VERSION;
+  hdr.kmer_size = ui->kmer_size;
+  hdr.num_bkmer_words = NUM_BKMER_WORDS;
+  hdr.num_unitigs = ui->num_unitigs;
+  hdr.num_links = ui->num_links;
+  hdr.num_kmers = ui->num_kmers;
+  hdr.seq_bytes = ui->seq_bytes;
+
+  status("[UnitigIndex] Saving to: %s", futil_outpath_str(path));
+
+  FILE *fh = futil_fopen_create(path, "w");
+  size_t nbytes = 0;
+  nbytes += _fwrite_pad8(&hdr, sizeof(hdr), fh, path);
+  nbytes += _fwrite_pad8(ui->unitigs, ui->num_unitigs*sizeof(UnitigRecord), fh, path);
+  nbytes += _fwrite_pad8(ui->links, ui->num_links*sizeof(uint64_t), fh, path);
+  nbytes += _fwrite_pad8(ui->kmers, ui->num_kmers*sizeof(UnitigKmer), fh, path);
+  nbytes += _fwrite_pad8(ui->seq, ui->seq_bytes, fh, path);
+  fclose(fh);
+
+  char mem_str[50];
+  bytes_to_str(nbytes, 1, mem_str);
+  status("[UnitigIndex] Wrote %s", mem_str);
+}
+
+#define _pad8(x) (((x)+7) & ~(size_t)7)
+
+void unitig_index_open(UnitigIndex *ui, const char *path)
+{
+  int fd;
+  struct stat st;
+  void *ptr;
+
+  if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+    die("Cannot open unitig index: %s [%s]", path, strerror(errno));
+  if((size_t)st.st_size < sizeof(UnitigIndexHeader))
+    die("Not a unitig index: %s", path);
+
+  ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(ptr == MAP_FAILED)
+    die("Cannot memory map file: %s [%s]", path, strerror(errno));
+
+  const UnitigIndexHeader *hdr = (const UnitigIndexHeader*)ptr;
+  if(memcmp(hdr->magic, CTU_MAGIC, sizeof(hdr->magic)) != 0)
+    die("Not a unitig index: %s", path);
+  if(hdr->version != CTU_VERSION)
+    die("Unitig index version %u not supported: %s", hdr->version, path);
+  if(hdr->num_bkmer_words != NUM_BKMER_WORDS) {
+    die("Unitig index was built with MAXK=%u, this is MAXK=%i: %s",
+        hdr->num_bkmer_words*32-1, MAX_KMER_SIZE, path);
+  }
+  db_graph_check_kmer_size(hdr->kmer_size, path);
+
+  size_t offsets[5];
+  offsets[0] = _pad8(sizeof(UnitigIndexHeader));
+  offsets[1] = offsets[0] + _pad8(hdr->num_unitigs*sizeof(UnitigRecord));
+  offsets[2] = offsets[1] + _pad8(hdr->num_links*sizeof(uint64_t));
+  offsets[3] = offsets[2] + _pad8(hdr->num_kmers*sizeof(UnitigKmer));
+  offsets[4] = offsets[3] + _pad8(hdr->seq_bytes);
+
+  if(offsets[4] != (size_t)st.st_size) {
+    die("Unitig index is corrupt: %s [expected %zu bytes, got %zu]",
+        path, offsets[4], (size_t)st.st_size);
+  }
+
+  const uint8_t *b = (const uint8_t*)ptr;
+  UnitigIndex tmp = {.kmer_size = hdr->kmer_size,
+                     .num_unitigs = hdr->num_unitigs,
+                     .num_links = hdr->num_links,
+                     .num_kmers = hdr->num_kmers,
+                     .seq_bytes = hdr->seq_bytes,
+                     .unitigs = (const UnitigRecord*)(b + offsets[0]),
+                     .links = (const uint64_t*)(b + offsets[1]),
+                     .kmers = (const UnitigKmer*)(b + offsets[2]),
+                     .seq = b + offsets[3],
+                     .mmap_ptr = ptr, .mmap_len = st.st_size};
+  memcpy(ui, &tmp, sizeof(tmp));
+
+  char num_unitigs_str[50], num_kmers_str[50];
+  ulong_to_str(ui->num_unitigs, num_unitigs_str);
+  ulong_to_str(ui->num_kmers, num_kmers_str);
+  status("[UnitigIndex] Loaded %s unitigs, %s kmers [k=%zu] from: %s",
+         num_unitigs_str, num_kmers_str, ui->kmer_size, futil_inpath_str(path));
+}
+
+void unitig_index_close(UnitigIndex *ui)
+{
+  if(ui->mmap_ptr != NULL) {
+    munmap(ui->mmap_ptr, ui->mmap_len);
+  } else {
+    ctx_free((void*)ui->unitigs);
+    ctx_free((void*)ui->links);
+    ctx_free((void*)ui->kmers);
+    ctx_free((void*)ui->seq);
+  }
+  memset(ui, 0, sizeof(*ui));
+}
+
+void unitig_index_seq(const UnitigIndex *ui, size_t uid, Orientation orient,
+                      StrBuf *sbuf)
+{
+  ctx_assert(uid < ui->num_unitigs);
+  const uint8_t *seq = ui->seq + ui->unitigs[uid].seq_offset;
+  size_t i, len = unitig_index_len(ui, uid);
+  char *out;
+
+  strbuf_ensure_capacity(sbuf, sbuf->end + len);
+  out = sbuf->b + sbuf->end;
+
+  if(orient == FORWARD) {
+    for(i = 0; i < len; i++)
+      out[i] = dna_nuc_to_char(_seq_nuc(seq, i));
+  } else {
+    for(i = 0; i < len; i++)
+      out[i] = dna_nuc_to_char(dna_nuc_complement(_seq_nuc(seq, len-1-i)));
+  }
+
+  sbuf->end += len;
+  sbuf->b[sbuf->end] = '\0';
+}
+
+const UnitigKmer* unitig_index_find(const UnitigIndex *ui, BinaryKmer bkmer)
+{
+  BinaryKmer bkey = binary_kmer_get_key(bkmer, ui->kmer_size);
+  size_t lo = 0, hi = ui->num_kmers, mid;
+  int cmp;
+
+  while(lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    cmp = binary_kmers_cmp(ui->kmers[mid].bkey, bkey);
+    if(cmp == 0) return &ui->kmers[mid];
+    if(cmp < 0) lo = mid + 1;
+    else hi = mid;
+  }
+
+  return NULL;
+}
+
+size_t unitig_index_links(const UnitigIndex *ui, size_t uid, Orientation orient,
+                          const uint64_t **links)
+{
+  ctx_assert(uid < ui->num_unitigs);
+  const UnitigRecord *r = &ui->unitigs[uid];
+  if(orient == FORWARD) {
+    *links = ui->links + r->links_offset + r->nleft;
+    return r->nright;
+  } else {
+    *links = ui->links + r->links_offset;
+    return r->nleft;
+  }
+}
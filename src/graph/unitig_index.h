@@ -0,0 +1,100 @@
+#ifndef UNITIG_INDEX_H_
+#define UNITIG_INDEX_H_
+
+#include "db_graph.h"
+#include "unitig_graph.h"
+
+//
+// Compacted de Bruijn graph saved to disk (.ctu), built once from a loaded
+// graph and then memory mapped. Holds a table of unitigs, their packed
+// sequences, links between unitigs by ID and a map from kmer to
+// (unitig, offset). Tools can then step between unitigs instead of doing a
+// hash table lookup for every kmer.
+//
+// File layout (native endian, all sections 8 byte aligned):
+//   UnitigIndexHeader
+//   UnitigRecord unitigs[num_unitigs]
+//   uint64_t     links[num_links]   each link is (unitig << 1 | orient)
+//   UnitigKmer   kmers[num_kmers]   sorted by kmer key
+//   uint8_t      seq[seq_bytes]     2 bits per base, each unitig byte aligned
+//
+
+#define CTU_MAGIC "CTXUNIDX"
+#define CTU_VERSION 1
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version, kmer_size, num_bkmer_words, padding;
+  uint64_t num_unitigs, num_links, num_kmers, seq_bytes;
+} UnitigIndexHeader;
+
+// Links from the left end are followed when reading a unitig reverse
+// complemented, links from the right end when reading it forward.
+// A link orient of FORWARD means the next unitig is read forward.
+typedef struct
+{
+  uint64_t seq_offset; // byte offset of packed sequence
+  uint64_t links_offset; // links from left end, then links from right end
+  uint32_t num_kmers;
+  uint8_t nleft, nright; // number of links from each end
+  uint16_t padding;
+} UnitigRecord;
+
+typedef struct
+{
+  BinaryKmer bkey;
+  uint64_t unitig;
+  uint32_t offset; // index of kmer in unitig
+  uint32_t orient; // orientation of bkey when reading unitig forward
+} UnitigKmer;
+
+typedef struct
+{
+  size_t kmer_size, num_unitigs, num_links, num_kmers, seq_bytes;
+  const UnitigRecord *unitigs;
+  const uint64_t *links;
+  const UnitigKmer *kmers;
+  const uint8_t *seq;
+  void *mmap_ptr; // NULL if built in memory
+  size_t mmap_len;
+} UnitigIndex;
+
+#define unitig_link_id(l) ((l) >> 1)
+#define unitig_link_orient(l) ((Orientation)((l) & 1))
+
+#define unitig_index_nkmers(ui,uid) ((size_t)(ui)->unitigs[uid].num_kmers)
+#define unitig_index_len(ui,uid) (unitig_index_nkmers(ui,uid)+(ui)->kmer_size-1)
+
+/**
+ * Build index of a loaded graph with a single colour of edges
+ * @param ugraph  allocated but not created, will hold unitig ends on return
+ * @param visited must be initialised to zero, will be dirty upon return
+ */
+void unitig_index_build(UnitigIndex *ui, UnitigKmerGraph *ugraph,
+                        size_t nthreads, uint8_t *visited);
+
+void unitig_index_save(const UnitigIndex *ui, const char *path);
+
+// Memory map a saved index, calls die() on error
+void unitig_index_open(UnitigIndex *ui, const char *path);
+
+// Release memory or unmap file
+void unitig_index_close(UnitigIndex *ui);
+
+// Append sequence of unitig `uid` to `sbuf`, reverse complemented if
+// `orient` is REVERSE
+void unitig_index_seq(const UnitigIndex *ui, size_t uid, Orientation orient,
+                      StrBuf *sbuf);
+
+// Find a kmer in any orientation, returns NULL if not found
+// Kmer orientation in the unitig is `r->orient` if binary_kmer_get_key() did
+// not reverse `bkmer`, otherwise `!r->orient`
+const UnitigKmer* unitig_index_find(const UnitigIndex *ui, BinaryKmer bkmer);
+
+// Links to follow when leaving unitig `uid` reading it in orientation `orient`
+// Returns number of links, sets *links to point at them
+size_t unitig_index_links(const UnitigIndex *ui, size_t uid, Orientation orient,
+                          const uint64_t **links);
+
+#endif /* UNITIG_INDEX_H_ */
@@ -0,0 +1,228 @@
+#include "global.h"
+#include "gpath_merge.h"
+#include "gpath_save.h"
+#include "gpath_subset.h"
+#include "binary_seq.h"
+#include "json_hdr.h"
+#include "file_util.h"
+#include "chunk_writer.h"
+
+typedef struct
+{
+  GPathReader *file;
+  StrBuf kmer;
+  BinaryKmer bkey;
+  bool started, more; // more is false once we reach the end of the file
+} SortedLinkInput;
+
+// Read the next kmer line of an input, check kmers are strictly increasing
+static void _sorted_input_next(SortedLinkInput *in, size_t kmer_size)
+{
+  const char *path = file_filter_path(&in->file->fltr);
+  BinaryKmer prev = in->bkey;
+  size_t nlinks;
+
+  in->more = gpath_reader_read_kmer(in->file, &in->kmer, &nlinks);
+  if(!in->more) return;
+
+  if(in->kmer.end != kmer_size)
+    die("Bad kmer line [%s]: %s", path, in->kmer.b);
+
+  in->bkey = binary_kmer_from_str(in->kmer.b, kmer_size);
+
+  if(in->started && binary_kmers_cmp(prev, in->bkey) >= 0) {
+    die("Link file is not sorted by kmer, use the `sort` command [%s]: %s",
+        path, in->kmer.b);
+  }
+
+  in->started = true;
+}
+
+static void _merge_flush(StrBuf *sbuf, FILE *fh, const char *path)
+{
+  if(fwrite(sbuf->b, 1, sbuf->end, fh) != sbuf->end)
+    die("Cannot write temporary file for: %s [%s]", path, strerror(errno));
+  strbuf_reset(sbuf);
+}
+
+/**
+ * Merge sorted link files into a single gzipped text link file, sorted by
+ * kmer. Call die() if an input is not sorted. Binary (.ctpb) files are
+ * always sorted.
+ * @param files    opened with gpath_reader_open2(), text or binary
+ * @param out_mem  memory for the output buffer, see chunk_writer_fit()
+ * @param save_path_seq if true, trace links through the graph in db_graph to
+ *                 add seq= and juncpos=, requires exactly one colour
+ * @param cmdstr, cmdhdr, hdrs, nhdrs are passed to gpath_save_mkhdr()
+ * @param db_graph gives kmer size and sample names for the header.
+ *                 db_graph->gpstore.gpset must be allocated with `ncols`
+ *                 colours but is not used to store links. Link totals are
+ *                 written to db_graph->gpstore on return.
+ */
+void gpath_merge_sorted(GPathReader *files, size_t nfiles,
+                        FILE *fout, const char *path,
+                        size_t out_mem, bool save_path_seq,
+                        const char *cmdstr, cJSON *cmdhdr,
+                        cJSON **hdrs, size_t nhdrs,
+                        const ZeroSizeBuffer *contig_hists, size_t ncols,
+                        dBGraph *db_graph)
+{
+  ctx_assert(ncols == db_graph->gpstore.gpset.ncols);
+  ctx_assert(!save_path_seq || db_graph->num_of_cols == 1);
+
+  const size_t kmer_size = db_graph->kmer_size;
+  size_t i, j, nkmers = 0, nlinks = 0, nbytes = 0;
+  char kmerstr[MAX_KMER_SIZE+1];
+  BinaryKmer bkey;
+  hkey_t hkey = HASH_NOT_FOUND;
+
+  status("Merging %zu sorted link files into: %s", nfiles, path);
+
+  // The links of the current kmer from all inputs
+  GPathSet gpset;
+  GPathSubset subset;
+  gpath_set_alloc(&gpset, ncols, ONE_MEGABYTE, true, true);
+  gpath_subset_alloc(&subset);
+  gpath_subset_init(&subset, &gpset);
+
+  SizeBuffer counts;
+  StrBuf juncs, sbuf;
+  ByteBuffer seqbuf;
+  size_buf_alloc(&counts, 256);
+  strbuf_alloc(&juncs, 256);
+  strbuf_alloc(&sbuf, 2 * DEFAULT_IO_BUFSIZE);
+  byte_buf_alloc(&seqbuf, 64);
+
+  // Used to trace links through the graph
+  dBNodeBuffer nbuf;
+  SizeBuffer jposbuf;
+  db_node_buf_alloc(&nbuf, 1024);
+  size_buf_alloc(&jposbuf, 256);
+
+  SortedLinkInput *inputs = ctx_calloc(nfiles, sizeof(SortedLinkInput));
+
+  for(i = 0; i < nfiles; i++) {
+    inputs[i].file = &files[i];
+    strbuf_alloc(&inputs[i].kmer, kmer_size+1);
+    _sorted_input_next(&inputs[i], kmer_size);
+  }
+
+  // Header needs totals, so write links to a temporary file first
+  StrBuf tmp_path;
+  strbuf_alloc(&tmp_path, 1024);
+  FILE *tmp_fh = futil_create_tmp_file(&tmp_path, path);
+
+  while(1)
+  {
+    // Find the smallest kmer
+    SortedLinkInput *min = NULL;
+    for(i = 0; i < nfiles; i++) {
+      if(inputs[i].more &&
+         (min == NULL || binary_kmers_cmp(inputs[i].bkey, min->bkey) < 0)) {
+        min = &inputs[i];
+      }
+    }
+
+    if(min == NULL) break;
+
+    bkey = min->bkey;
+    memcpy(kmerstr, min->kmer.b, kmer_size);
+    kmerstr[kmer_size] = '\0';
+
+    // Collect links for this kmer from every input that has it
+    for(i = 0; i < nfiles; i++) {
+      if(inputs[i].more && binary_kmers_are_equal(inputs[i].bkey, bkey)) {
+        gpath_reader_read_links_into(inputs[i].file, &gpset,
+                                     &counts, &juncs, &seqbuf);
+        _sorted_input_next(&inputs[i], kmer_size);
+      }
+    }
+
+    // Combine colours and counts of links found in more than one input
+    gpath_subset_reset(&subset);
+    gpath_subset_load_set(&subset);
+    gpath_subset_rmdup(&subset);
+
+    if(subset.list.len > 0) {
+      if(save_path_seq) {
+        hkey = hash_table_find(&db_graph->ht, bkey);
+        if(hkey == HASH_NOT_FOUND) die("Link kmer not in graph: %s", kmerstr);
+      }
+      gpath_save_subset_sbuf(kmerstr, kmer_size, &subset, hkey,
+                             save_path_seq ? &nbuf : NULL,
+                             save_path_seq ? &jposbuf : NULL,
+                             db_graph, &sbuf);
+      nkmers++;
+      nlinks += subset.list.len;
+      for(j = 0; j < subset.list.len; j++)
+        nbytes += binary_seq_mem(subset.list.b[j]->num_juncs);
+    }
+
+    gpath_set_reset(&gpset);
+
+    if(sbuf.end > DEFAULT_IO_BUFSIZE) _merge_flush(&sbuf, tmp_fh, path);
+  }
+
+  _merge_flush(&sbuf, tmp_fh, path);
+
+  // Header totals are taken from the graph and path store
+  GPathStore *gpstore = &db_graph->gpstore;
+  gpstore->num_kmers_with_paths = nkmers;
+  gpstore->num_paths = nlinks;
+  gpstore->path_bytes = nbytes;
+
+  // Without a graph loaded, kmers with links are all the kmers we know about
+  if(db_graph->ht.num_kmers == 0) db_graph->ht.num_kmers = nkmers;
+
+  cJSON *json = gpath_save_mkhdr(path, cmdstr, cmdhdr, hdrs, nhdrs,
+                                 contig_hists, ncols, db_graph);
+  // Compression overlaps with writing
+  size_t nthreads = 1;
+  size_t chunk_size = chunk_writer_fit(out_mem, &nthreads);
+  ChunkWriter writer;
+  chunk_writer_alloc(&writer, fout, path, nthreads, chunk_size, true);
+  StrBuf *out = chunk_writer_buf(&writer, 0);
+
+  // Header may be larger than a chunk, send it before any links
+  json_hdr_sprint(json, out);
+  cJSON_Delete(json);
+  strbuf_append_str(out, ctp_explanation_comment);
+  chunk_writer_flush(&writer, 0);
+
+  // Copy links from the temporary file
+  if(fseek(tmp_fh, 0L, SEEK_SET) != 0)
+    die("Cannot seek temporary file: %s [%s]", tmp_path.b, strerror(errno));
+
+  size_t s;
+  do {
+    strbuf_ensure_capacity(out, chunk_size);
+    s = fread(out->b + out->end, 1, chunk_size - out->end, tmp_fh);
+    out->end += s;
+    out->b[out->end] = '\0';
+    chunk_writer_done(&writer, 0);
+  } while(s > 0);
+
+  if(ferror(tmp_fh))
+    die("Cannot read temporary file: %s [%s]", tmp_path.b, strerror(errno));
+
+  chunk_writer_dealloc(&writer);
+  fclose(tmp_fh);
+
+  char kmers_str[50], links_str[50];
+  ulong_to_str(nkmers, kmers_str);
+  ulong_to_str(nlinks, links_str);
+  status("  wrote %s links for %s kmers", links_str, kmers_str);
+
+  for(i = 0; i < nfiles; i++) strbuf_dealloc(&inputs[i].kmer);
+  ctx_free(inputs);
+
+  strbuf_dealloc(&tmp_path);
+  size_buf_dealloc(&counts);
+  strbuf_dealloc(&juncs);
+  strbuf_dealloc(&sbuf);
+  byte_buf_dealloc(&seqbuf);
+  db_node_buf_dealloc(&nbuf);
+  size_buf_dealloc(&jposbuf);
+  gpath_subset_dealloc(&subset);
+  gpath_set_dealloc(&gpset);
+}
@@ -0,0 +1,38 @@
+#ifndef GPATH_MERGE_H_
+#define GPATH_MERGE_H_
+
+#include "db_graph.h"
+#include "gpath_reader.h"
+
+//
+// Merge link files that are sorted by kmer without loading them into a graph
+//
+// Inputs are read in step, like the merge step of a merge sort. All links for
+// the smallest kmer are read from every input that has it, duplicate links
+// have their colours and counts combined, and the kmer is written out. Only
+// the links of one kmer are held in memory at a time.
+//
+
+/**
+ * Merge sorted link files into a single gzipped text link file, sorted by
+ * kmer. Call die() if an input is not sorted. Binary (.ctpb) files are
+ * always sorted.
+ * @param files    opened with gpath_reader_open2(), text or binary
+ * @param out_mem  memory for the output buffer, see chunk_writer_fit()
+ * @param save_path_seq if true, trace links through the graph in db_graph to
+ *                 add seq= and juncpos=, requires exactly one colour
+ * @param cmdstr, cmdhdr, hdrs, nhdrs are passed to gpath_save_mkhdr()
+ * @param db_graph gives kmer size and sample names for the header.
+ *                 db_graph->gpstore.gpset must be allocated with `ncols`
+ *                 colours but is not used to store links. Link totals are
+ *                 written to db_graph->gpstore on return.
+ */
+void gpath_merge_sorted(GPathReader *files, size_t nfiles,
+                        FILE *fout, const char *path,
+                        size_t out_mem, bool save_path_seq,
+                        const char *cmdstr, cJSON *cmdhdr,
+                        cJSON **hdrs, size_t nhdrs,
+                        const ZeroSizeBuffer *contig_hists, size_t ncols,
+                        dBGraph *db_graph);
+
+#endif /* GPATH_MERGE_H_ */
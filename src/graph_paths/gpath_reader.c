@@ -13,6 +13,12 @@
 #include "gpath_subset.h"
 #include "json_hdr.h"
 
+#include "msg-pool/msgpool.h"
+
+#include <sys/mman.h>
+#include <fcntl.h> // open()
+#include <sys/stat.h>
+
 /*
 // File format:
 <JSON_HEADER>
@@ -22,6 +28,8 @@ kmer [num] .. ignored
 
 #define load_check(x,msg,...) if(!(x)) { die("[LoadPathError] "msg, ##__VA_ARGS__); }
 
+#define _pad8(x) (((x)+7) & ~(size_t)7)
+
 size_t gpath_reader_get_kmer_size(const GPathReader *file)
 {
   return json_hdr_get_kmer_size(file->json, file->fltr.path.b);
@@ -158,6 +166,71 @@ void _parse_json_header(GPathReader *file)
   if(file->ncolours == 0) die("No colours in JSON header");
 }
 
+// Memory map the binary part of a .ctpb file, which starts after the
+// JSON header (hdr_bytes long)
+static void _gpath_reader_open_binary(GPathReader *file, size_t hdr_bytes)
+{
+  const char *path = file_filter_path(&file->fltr);
+  int fd;
+  struct stat st;
+  void *ptr;
+
+  if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+    die("Cannot open binary link file: %s [%s]", path, strerror(errno));
+
+  size_t base = _pad8(hdr_bytes);
+  if((size_t)st.st_size < base + sizeof(CtpBinHeader))
+    die("Binary link file is truncated: %s", path);
+
+  ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(ptr == MAP_FAILED)
+    die("Cannot memory map file: %s [%s]", path, strerror(errno));
+
+  const uint8_t *b = (const uint8_t*)ptr;
+  const CtpBinHeader *hdr = (const CtpBinHeader*)(b + base);
+
+  if(memcmp(hdr->magic, CTPB_MAGIC, sizeof(hdr->magic)) != 0)
+    die("Not a binary link file: %s", path);
+  if(hdr->version != CTPB_VERSION)
+    die("Binary link file version %u not supported: %s", hdr->version, path);
+  if(hdr->num_bkmer_words != NUM_BKMER_WORDS) {
+    die("Binary link file was built with MAXK=%u, this is MAXK=%i: %s",
+        hdr->num_bkmer_words*32-1, MAX_KMER_SIZE, path);
+  }
+  if(hdr->kmer_size != gpath_reader_get_kmer_size(file) ||
+     hdr->ncols != _gpath_reader_get_filencols(file) ||
+     hdr->num_kmers != gpath_reader_get_num_kmers(file) ||
+     hdr->num_paths != gpath_reader_get_num_paths(file)) {
+    die("Binary link file doesn't match its JSON header: %s", path);
+  }
+
+  size_t offsets[5];
+  offsets[0] = base + _pad8(sizeof(CtpBinHeader));
+  offsets[1] = offsets[0] + (hdr->num_kmers+1)*sizeof(CtpBinKmer);
+  offsets[2] = offsets[1] + hdr->num_paths*sizeof(CtpBinPath);
+  offsets[3] = offsets[2] + _pad8(hdr->num_paths*hdr->ncols);
+  offsets[4] = offsets[3] + _pad8(hdr->seq_bytes);
+
+  if(offsets[4] != (size_t)st.st_size) {
+    die("Binary link file is corrupt: %s [expected %zu bytes, got %zu]",
+        path, offsets[4], (size_t)st.st_size);
+  }
+
+  CtpBinary bin = {.mmap_ptr = ptr, .mmap_len = st.st_size,
+                   .kmer_size = hdr->kmer_size,
+                   .num_kmers = hdr->num_kmers,
+                   .num_paths = hdr->num_paths,
+                   .ncols = hdr->ncols,
+                   .kmers = (const CtpBinKmer*)(b + offsets[0]),
+                   .paths = (const CtpBinPath*)(b + offsets[1]),
+                   .nseen = b + offsets[2],
+                   .seqs = b + offsets[3],
+                   .kmer_idx = 0, .path_idx = 0};
+
+  memcpy(&file->bin, &bin, sizeof(bin));
+}
+
 // Open file, exit on error
 // if successful creates a new GPathReader and returns 1
 void gpath_reader_open2(GPathReader *file, const char *path, const char *mode,
@@ -198,6 +271,18 @@ void gpath_reader_open2(GPathReader *file, const char *path, const char *mode,
 
   // Check we can handle the kmer size
   db_graph_check_kmer_size(kmer_size, file->fltr.path.b);
+
+  // Binary files are memory mapped, only the header is read with gz
+  cJSON *paths = json_hdr_get_paths(file->json, file->fltr.path.b);
+  cJSON *encoding = json_hdr_try(paths, "encoding", cJSON_String, path);
+  if(encoding != NULL && strcmp(encoding->valuestring, "binary") == 0)
+  {
+    if(strcmp(mode, "r") != 0)
+      die("Binary link files can only be opened for reading: %s", path);
+    _gpath_reader_open_binary(file, hdrstr->end);
+    gzclose(file->gz);
+    file->gz = NULL;
+  }
 }
 
 void gpath_reader_open(GPathReader *file, const char *path)
@@ -214,6 +299,7 @@ void gpath_reader_close(GPathReader *file)
   cJSON_Delete(file->json);
   strbuf_dealloc(&file->hdrstr);
   ctx_free(file->colours_json);
+  if(file->bin.mmap_ptr) munmap(file->bin.mmap_ptr, file->bin.mmap_len);
   memset(file, 0, sizeof(GPathReader));
 }
 
@@ -241,6 +327,18 @@ bool gpath_reader_read_kmer(GPathReader *file, StrBuf *kmer, size_t *num_links)
   strbuf_reset(kmer);
   *num_links = 0;
 
+  if(gpath_reader_is_binary(file)) {
+    CtpBinary *bin = &file->bin;
+    if(bin->kmer_idx == bin->num_kmers) return false;
+    const CtpBinKmer *bkmer = &bin->kmers[bin->kmer_idx++];
+    strbuf_ensure_capacity(kmer, bin->kmer_size);
+    binary_kmer_to_str(bkmer->bkey, bin->kmer_size, kmer->b);
+    kmer->end = bin->kmer_size;
+    *num_links = bkmer[1].first_path - bkmer[0].first_path;
+    bin->path_idx = bkmer->first_path;
+    return true;
+  }
+
   const char *path = file_filter_path(&file->fltr);
   int c;
   char *space;
@@ -270,6 +368,38 @@ bool gpath_reader_read_kmer(GPathReader *file, StrBuf *kmer, size_t *num_links)
 
 #define bad_link_line(path,line) die("Bad link line [%s]: %s", path, (line)->b)
 
+// Convert counts for each colour in the file to counts for each colour we
+// are loading into
+static void _link_counts_filter(SizeBuffer *counts, const FileFilter *fltr)
+{
+  size_t i, fromcol, intocol;
+
+  // Use filter - append zeros first
+  size_t offset = counts->len, num_into = file_filter_into_ncols(fltr);
+  size_buf_push_zero(counts, num_into);
+  for(i = 0; i < file_filter_num(fltr); i++) {
+    fromcol = file_filter_fromcol(fltr, i);
+    intocol = file_filter_intocol(fltr, i);
+    counts->b[offset+intocol] += counts->b[fromcol];
+  }
+  memmove(counts->b, counts->b+offset, num_into*sizeof(counts->b[0]));
+  counts->len = num_into;
+}
+
+// Fetch counts for path `pidx` of a binary file, filtered as for text
+static inline void _binary_link_counts(const GPathReader *file, size_t pidx,
+                                       SizeBuffer *counts)
+{
+  const CtpBinary *bin = &file->bin;
+  const uint8_t *nseen = bin->nseen + pidx * bin->ncols;
+  size_t i;
+  size_buf_reset(counts);
+  size_buf_capacity(counts, bin->ncols + file_filter_into_ncols(&file->fltr));
+  for(i = 0; i < bin->ncols; i++) counts->b[i] = nseen[i];
+  counts->len = bin->ncols;
+  _link_counts_filter(counts, &file->fltr);
+}
+
 /**
  * Parse line with format:
  *  [FR] [njuncs] [nseen0,nseen1,...] [juncs:ACAGT] ([seq=] [juncpos=])?
@@ -282,7 +412,7 @@ void link_line_parse(const StrBuf *line, int version, const FileFilter *fltr,
                      StrBuf *seq, SizeBuffer *juncpos)
 {
   const char *path = file_filter_path(fltr);
-  size_t i, fromcol, intocol;
+  size_t i;
   char *end = NULL;
 
   // First first 5 required columns
@@ -328,17 +458,7 @@ void link_line_parse(const StrBuf *line, int version, const FileFilter *fltr,
   else if(counts->len != fltr->filencols)
     bad_link_line(path,line);
 
-  // Use filter - append zeros first
-  // size_buf_reset(counts);
-  size_t offset = counts->len, num_into = file_filter_into_ncols(fltr);
-  size_buf_push_zero(counts, num_into);
-  for(i = 0; i < file_filter_num(fltr); i++) {
-    fromcol = file_filter_fromcol(fltr, i);
-    intocol = file_filter_intocol(fltr, i);
-    counts->b[offset+intocol] += counts->b[fromcol];
-  }
-  memmove(counts->b, counts->b+offset, num_into*sizeof(counts->b[0]));
-  counts->len = num_into;
+  _link_counts_filter(counts, fltr);
 
   // 4:[juncs:ACAGA]
   strbuf_reset(juncs);
@@ -412,6 +532,23 @@ bool gpath_reader_read_link(GPathReader *file,
   StrBuf *line = &file->line;
   strbuf_reset(line);
 
+  if(gpath_reader_is_binary(file)) {
+    CtpBinary *bin = &file->bin;
+    if(bin->kmer_idx == 0 ||
+       bin->path_idx == bin->kmers[bin->kmer_idx].first_path) return false;
+    const CtpBinPath *p = &bin->paths[bin->path_idx];
+    *fw = (p->orient == FORWARD);
+    *njuncs = p->num_juncs;
+    _binary_link_counts(file, bin->path_idx, countbuf);
+    strbuf_ensure_capacity(juncs, p->num_juncs);
+    binary_seq_to_str(bin->seqs + p->seq_offset, p->num_juncs, juncs->b);
+    juncs->end = p->num_juncs;
+    if(seq) strbuf_reset(seq);
+    if(juncpos) size_buf_reset(juncpos);
+    bin->path_idx++;
+    return true;
+  }
+
   while((c = gzgetc_buf(file->gz, &file->strmbuf)) != -1)
   {
     if(char_is_acgt(c)) {
@@ -437,15 +574,55 @@ bool gpath_reader_read_link(GPathReader *file,
   return false;
 }
 
-static hkey_t find_link_kmer(BinaryKmer bkey, int flags,
-                             const char *path, dBGraph *db_graph)
+//
+// Loading links into the graph
+//
+// Text files are read by one thread that splits them into chunks of whole
+// kmer entries, which are passed through a MsgPool to worker threads that
+// parse and insert links. Binary files are split between workers directly.
+// Each kmer appears at most once per file so workers never touch the same
+// kmer's link list at the same time.
+//
+
+#define GPATH_LOAD_CHUNK (ONE_MEGABYTE)
+#define GPATH_LOAD_POOL 4 // chunks in flight per worker
+#define GPATH_LOAD_BLOCK 4096 // kmers claimed at a time from binary files
+
+typedef struct
+{
+  GPathReader *file;
+  int kmer_flags;
+  dBGraph *db_graph;
+  volatile uint8_t *bktlocks; // only needed if adding kmers
+  MsgPool pool;
+  volatile size_t next_kmer; // next binary kmer to claim
+  volatile int warn_nlink_mismatch;
+} GPathLoader;
+
+typedef struct
+{
+  GPathLoader *loader;
+  GPathSet gpset; // links for current kmer
+  GPathSubset subset0, subset1;
+  SizeBuffer counts;
+  StrBuf juncs;
+  ByteBuffer seqbuf;
+  size_t num_kmers_seen, num_links_seen;
+  size_t num_kmers_loaded, num_links_loaded;
+} GPathLoadWorker;
+
+// @bktlocks if not NULL, use thread safe hash table functions
+static hkey_t find_link_kmer(BinaryKmer bkey, int flags, const char *path,
+                             volatile uint8_t *bktlocks, dBGraph *db_graph)
 {
   hkey_t hkey = HASH_NOT_FOUND;
   bool found = false;
 
   switch(flags) {
     case GPATH_ADD_MISSING_KMERS:
-      hkey = hash_table_find_or_insert(&db_graph->ht, bkey, &found);
+      hkey = bktlocks ? hash_table_find_or_insert_mt(&db_graph->ht, bkey,
+                                                     &found, bktlocks)
+                      : hash_table_find_or_insert(&db_graph->ht, bkey, &found);
       break;
     case GPATH_DIE_MISSING_KMERS:
       hkey = hash_table_find(&db_graph->ht, bkey);
@@ -509,111 +686,366 @@ static size_t _load_paths_from_set(dBGraph *db_graph, GPathSet *gpset,
   return subset1->list.len;
 }
 
+// Add a link to our temporary set unless it has no coverage
+// `seq` is packed with binary_seq_from_str()
+static inline void _gpset_add_link(GPathSet *gpset, const uint8_t *seq,
+                                   size_t num_juncs, Orientation orient,
+                                   const SizeBuffer *counts, size_t into_ncols)
+{
+  size_t i, link_covg = 0;
+
+  // Check if link has coverage in any colours
+  for(i = 0; i < into_ncols; i++) link_covg |= counts->b[i];
+  if(!link_covg) return;
+
+  // Add to GPathSet
+  GPathNew newgpath = {.seq = (uint8_t*)seq,
+                       .colset = NULL, .nseen = NULL,
+                       .orient = orient,
+                       .num_juncs = num_juncs};
+
+  GPath *gpath = gpath_set_add_mt(gpset, newgpath);
+
+  // Update nseen and colset
+  // Our temporary gpset always stores nseen counts
+  uint8_t *nseen = gpath_set_get_nseen(gpset, gpath);
+  uint8_t *colset = gpath_get_colset(gpath, gpset->ncols);
+  for(i = 0; i < into_ncols; i++) {
+    nseen[i] = MIN2((size_t)UINT8_MAX, (size_t)nseen[i] + counts->b[i]);
+    bitset_or(colset, i, counts->b[i] > 0);
+  }
+}
+
+// Read links of the kmer last returned by gpath_reader_read_kmer() into
+// `gpset`, skipping links without coverage. `gpset` must keep nseen counts.
+// Returns the number of link lines read
+size_t gpath_reader_read_links_into(GPathReader *file, GPathSet *gpset,
+                                    SizeBuffer *counts, StrBuf *juncs,
+                                    ByteBuffer *seqbuf)
+{
+  size_t nlinks = 0, njuncs, into_ncols = file_filter_into_ncols(&file->fltr);
+  bool fw;
+
+  ctx_assert(gpath_set_has_nseen(gpset));
+  ctx_assert(into_ncols <= gpset->ncols);
+
+  while(gpath_reader_read_link(file, &fw, &njuncs, counts, juncs, NULL, NULL))
+  {
+    byte_buf_capacity(seqbuf, binary_seq_mem(juncs->end));
+    binary_seq_from_str(juncs->b, juncs->end, seqbuf->b);
+    _gpset_add_link(gpset, seqbuf->b, juncs->end, fw ? FORWARD : REVERSE,
+                    counts, into_ncols);
+    nlinks++;
+  }
+
+  return nlinks;
+}
+
+// Add links collected in wrkr->gpset to kmer `bkey`
+static void _load_worker_add_kmer(GPathLoadWorker *wrkr, BinaryKmer bkey)
+{
+  GPathLoader *loader = wrkr->loader;
+  const char *path = file_filter_path(&loader->file->fltr);
+  hkey_t hkey;
+
+  wrkr->num_kmers_seen++;
+  if(wrkr->gpset.num_paths == 0) return;
+
+  wrkr->num_kmers_loaded++;
+  hkey = find_link_kmer(bkey, loader->kmer_flags, path,
+                        loader->bktlocks, loader->db_graph);
+
+  if(hkey != HASH_NOT_FOUND) {
+    wrkr->num_links_loaded += _load_paths_from_set(loader->db_graph,
+                                                   &wrkr->gpset,
+                                                   &wrkr->subset0,
+                                                   &wrkr->subset1, hkey);
+  }
+
+  gpath_set_reset(&wrkr->gpset);
+}
+
+static void _load_worker_check_nlinks(GPathLoadWorker *wrkr, const char *kmer,
+                                      size_t num_links_exp, size_t nlink)
+{
+  if(nlink != num_links_exp &&
+     __sync_bool_compare_and_swap(&wrkr->loader->warn_nlink_mismatch, 0, 1))
+  {
+    warn("Number of links mismatches: %s %zu != %zu [%s]",
+         kmer, num_links_exp, nlink,
+         file_filter_path(&wrkr->loader->file->fltr));
+  }
+}
+
+// Parse a chunk of NUL separated lines, starting with a kmer line
+static void _load_worker_text_chunk(GPathLoadWorker *wrkr, const StrBuf *chunk)
+{
+  const GPathReader *file = wrkr->loader->file;
+  const char *path = file_filter_path(&file->fltr);
+  size_t kmer_size = gpath_reader_get_kmer_size(file);
+  size_t into_ncols = file_filter_into_ncols(&file->fltr);
+  const char *line, *kmer = NULL, *space;
+  size_t len, nlink = 0, num_links_exp = 0, njuncs = 0;
+  BinaryKmer bkey = {.b = {0}};
+  bool fw = true;
+
+  for(line = chunk->b; line < chunk->b + chunk->end; line += len+1)
+  {
+    len = strlen(line);
+
+    if(char_is_acgt(line[0]))
+    {
+      if(kmer) {
+        _load_worker_check_nlinks(wrkr, kmer, num_links_exp, nlink);
+        _load_worker_add_kmer(wrkr, bkey);
+      }
+
+      if((space = strchr(line, ' ')) == NULL ||
+         (size_t)(space - line) != kmer_size ||
+         !parse_entire_size(space+1, &num_links_exp))
+      {
+        die("Bad kmer line [%s]: %s", path, line);
+      }
+
+      kmer = line;
+      bkey = binary_kmer_from_str(kmer, kmer_size);
+      nlink = 0;
+    }
+    else
+    {
+      if(kmer == NULL) die("Link before first kmer [%s]: %s", path, line);
+
+      StrBuf lbuf = {.b = (char*)line, .end = len, .size = len+1};
+      link_line_parse(&lbuf, file->version, &file->fltr,
+                      &fw, &njuncs, &wrkr->counts, &wrkr->juncs, NULL, NULL);
+
+      byte_buf_capacity(&wrkr->seqbuf, binary_seq_mem(wrkr->juncs.end));
+      binary_seq_from_str(wrkr->juncs.b, wrkr->juncs.end, wrkr->seqbuf.b);
+      _gpset_add_link(&wrkr->gpset, wrkr->seqbuf.b, wrkr->juncs.end,
+                      fw ? FORWARD : REVERSE, &wrkr->counts, into_ncols);
+      nlink++;
+      wrkr->num_links_seen++;
+    }
+  }
+
+  if(kmer) {
+    _load_worker_check_nlinks(wrkr, kmer, num_links_exp, nlink);
+    _load_worker_add_kmer(wrkr, bkey);
+  }
+}
+
+static void _load_worker_text(void *arg, size_t threadid)
+{
+  (void)threadid;
+  GPathLoadWorker *wrkr = (GPathLoadWorker*)arg;
+  MsgPool *pool = &wrkr->loader->pool;
+  StrBuf *chunk;
+  int pos;
+
+  while((pos = msgpool_claim_read(pool)) != -1) {
+    memcpy(&chunk, msgpool_get_ptr(pool, pos), sizeof(StrBuf*));
+    _load_worker_text_chunk(wrkr, chunk);
+    strbuf_reset(chunk);
+    msgpool_release(pool, pos, MPOOL_EMPTY);
+  }
+}
+
+// Claim blocks of kmers from a memory mapped binary file. Kmers are already
+// packed so we skip string conversion altogether.
+static void _load_worker_binary(void *arg, size_t threadid)
+{
+  (void)threadid;
+  GPathLoadWorker *wrkr = (GPathLoadWorker*)arg;
+  GPathLoader *loader = wrkr->loader;
+  const GPathReader *file = loader->file;
+  const CtpBinary *bin = &file->bin;
+  size_t into_ncols = file_filter_into_ncols(&file->fltr);
+  size_t start, end, k, p;
+
+  while((start = __sync_fetch_and_add(&loader->next_kmer, GPATH_LOAD_BLOCK))
+          < bin->num_kmers)
+  {
+    end = MIN2(start + GPATH_LOAD_BLOCK, bin->num_kmers);
+
+    for(k = start; k < end; k++) {
+      for(p = bin->kmers[k].first_path; p < bin->kmers[k+1].first_path; p++) {
+        _binary_link_counts(file, p, &wrkr->counts);
+        _gpset_add_link(&wrkr->gpset, bin->seqs + bin->paths[p].seq_offset,
+                        bin->paths[p].num_juncs, bin->paths[p].orient,
+                        &wrkr->counts, into_ncols);
+      }
+      wrkr->num_links_seen += bin->kmers[k+1].first_path - bin->kmers[k].first_path;
+      _load_worker_add_kmer(wrkr, bin->kmers[k].bkey);
+    }
+  }
+}
+
+// Append next line that is not empty or a comment to `buf`, followed by '\0'
+// Sets *start to the offset of the line in buf
+// Returns false at the end of the file
+bool gpath_reader_append_line(GPathReader *file, StrBuf *buf, size_t *start)
+{
+  const char *path = file_filter_path(&file->fltr);
+  int c;
+
+  while((c = gzgetc_buf(file->gz, &file->strmbuf)) != -1)
+  {
+    if(c == '#') gzskipline_buf(file->gz, &file->strmbuf);
+    else if(c != '\n') {
+      *start = buf->end;
+      strbuf_append_char(buf, c);
+      strbuf_gzreadline_buf(buf, file->gz, &file->strmbuf);
+      futil_gzcheck(0, file->gz, path);
+      strbuf_chomp(buf);
+      strbuf_append_char(buf, '\0');
+      return true;
+    }
+  }
+
+  futil_gzcheck(0, file->gz, path);
+  return false;
+}
+
+// Pass lines chunk->b[0..end) to workers, keep the rest in chunk
+static void _gpath_loader_push(GPathLoader *loader, StrBuf *chunk, size_t end)
+{
+  StrBuf *next;
+  int pos = msgpool_claim_write(&loader->pool);
+  memcpy(&next, msgpool_get_ptr(&loader->pool, pos), sizeof(StrBuf*));
+  strbuf_reset(next);
+  strbuf_append_strn(next, chunk->b+end, chunk->end-end);
+  chunk->end = end;
+  chunk->b[end] = '\0';
+  SWAP(*next, *chunk);
+  msgpool_release(&loader->pool, pos, MPOOL_FULL);
+}
+
+// Decompress and split text file into chunks of whole kmer entries
+static void* _gpath_loader_read_thread(void *arg)
+{
+  GPathLoader *loader = (GPathLoader*)arg;
+  StrBuf chunk;
+  size_t start = 0;
+
+  strbuf_alloc(&chunk, GPATH_LOAD_CHUNK + 1024);
+
+  while(gpath_reader_append_line(loader->file, &chunk, &start)) {
+    if(start >= GPATH_LOAD_CHUNK && char_is_acgt(chunk.b[start]))
+      _gpath_loader_push(loader, &chunk, start);
+  }
+
+  if(chunk.end > 0) _gpath_loader_push(loader, &chunk, chunk.end);
+
+  strbuf_dealloc(&chunk);
+  msgpool_wait_til_empty(&loader->pool);
+  msgpool_close(&loader->pool);
+  return NULL;
+}
+
+static void _load_pool_init(void *el, size_t idx, void *arg)
+{
+  StrBuf *bufs = (StrBuf*)arg;
+  StrBuf *ptr = &bufs[idx];
+  memcpy(el, &ptr, sizeof(StrBuf*));
+}
+
+void gpath_reader_load(GPathReader *file, int kmer_flags, dBGraph *db_graph)
+{
+  gpath_reader_load_mt(file, kmer_flags, 1, db_graph);
+}
+
 /**
  * @param kmer_flags must be one of:
  *   * GPATH_ADD_MISSING_KMERS - add kmers to the graph before loading path
  *   * GPATH_DIE_MISSING_KMERS - die with error if cannot find kmer
  *   * GPATH_SKIP_MISSING_KMERS - skip paths where kmer is not in graph
+ * @param nthreads number of threads parsing and inserting links
  */
-void gpath_reader_load(GPathReader *file, int kmer_flags, dBGraph *db_graph)
+void gpath_reader_load_mt(GPathReader *file, int kmer_flags, size_t nthreads,
+                          dBGraph *db_graph)
 {
-  const char *path = file_filter_path(&file->fltr);
+  ctx_assert(nthreads > 0);
+  ctx_assert(!db_graph->gpstore.gpset.can_resize);
 
   file_filter_status(&file->fltr);
 
-  size_t into_ncols = file_filter_into_ncols(&file->fltr);
-
-  // Load paths into this temporary set for each kmer
-  GPathSet gpset;
-  gpath_set_alloc(&gpset, db_graph->num_of_cols, ONE_MEGABYTE, true, true);
-
-  GPathSubset subset0, subset1;
-  gpath_subset_alloc(&subset0);
-  gpath_subset_alloc(&subset1);
-
-  size_t i, nlink, num_links_exp = 0;
+  size_t i, npool = nthreads * GPATH_LOAD_POOL;
   size_t total_kmers_exp = gpath_reader_get_num_kmers(file);
   size_t total_links_exp = gpath_reader_get_num_paths(file);
   size_t num_kmers_seen = 0, num_links_seen = 0;
   size_t num_kmers_loaded = 0, num_links_loaded = 0;
-  bool warn_nlink_mismatch = false;
 
-  StrBuf kmerstr;
-  strbuf_alloc(&kmerstr, 64);
-  bool fw = true;
-  size_t njuncs = 0;
-  StrBuf juncs;
-  SizeBuffer counts;
-  strbuf_alloc(&juncs, 256);
-  size_buf_alloc(&counts, 256);
+  GPathLoader loader;
+  memset(&loader, 0, sizeof(loader));
+  loader.file = file;
+  loader.kmer_flags = kmer_flags;
+  loader.db_graph = db_graph;
+
+  // Need bucket locks to add kmers from multiple threads
+  uint8_t *bktlocks = NULL;
+  if(kmer_flags == GPATH_ADD_MISSING_KMERS) {
+    loader.bktlocks = db_graph->bktlocks;
+    if(loader.bktlocks == NULL) {
+      bktlocks = ctx_calloc(roundup_bits2bytes(db_graph->ht.num_of_buckets), 1);
+      loader.bktlocks = bktlocks;
+    }
+  }
 
-  // Buffer is collapsed into here
-  ByteBuffer seqbuf;
-  byte_buf_alloc(&seqbuf, 64);
+  GPathLoadWorker *workers = ctx_calloc(nthreads, sizeof(GPathLoadWorker));
+
+  for(i = 0; i < nthreads; i++) {
+    workers[i].loader = &loader;
+    gpath_set_alloc(&workers[i].gpset, db_graph->num_of_cols, ONE_MEGABYTE,
+                    true, true);
+    gpath_subset_alloc(&workers[i].subset0);
+    gpath_subset_alloc(&workers[i].subset1);
+    size_buf_alloc(&workers[i].counts, 256);
+    strbuf_alloc(&workers[i].juncs, 256);
+    byte_buf_alloc(&workers[i].seqbuf, 64);
+  }
 
-  for(num_kmers_seen = 0;
-      gpath_reader_read_kmer(file, &kmerstr, &num_links_exp);
-      num_kmers_seen++)
+  if(gpath_reader_is_binary(file))
   {
-    gpath_set_reset(&gpset);
-
-    for(nlink = 0;
-        gpath_reader_read_link(file, &fw, &njuncs,
-                               &counts, &juncs, NULL, NULL);
-        nlink++)
-    {
-      // Check if link has coverage in any colours
-      size_t link_covg = 0;
-      for(i = 0; i < into_ncols; i++) link_covg |= counts.b[i];
+    util_run_threads(workers, nthreads, sizeof(GPathLoadWorker),
+                     nthreads, _load_worker_binary);
+  }
+  else
+  {
+    StrBuf *pool_bufs = ctx_calloc(npool, sizeof(StrBuf));
+    for(i = 0; i < npool; i++) strbuf_alloc(&pool_bufs[i], 1024);
+    msgpool_alloc(&loader.pool, npool, sizeof(StrBuf*), USE_MSG_POOL);
+    msgpool_iterate(&loader.pool, _load_pool_init, pool_bufs);
 
-      if(link_covg)
-      {
-        byte_buf_capacity(&seqbuf, binary_seq_mem(juncs.end));
-        binary_seq_from_str(juncs.b, juncs.end, seqbuf.b);
-
-        // Add to GPathSet
-        GPathNew newgpath = {.seq = seqbuf.b,
-                             .colset = NULL, .nseen = NULL,
-                             .orient = fw ? FORWARD : REVERSE,
-                             .num_juncs = juncs.end};
-
-        GPath *gpath = gpath_set_add_mt(&gpset, newgpath);
-
-        // Update nseen and colset
-        // Our temporary gpset always stores nseen counts
-        uint8_t *nseen = gpath_set_get_nseen(&gpset, gpath);
-        uint8_t *colset = gpath_get_colset(gpath, gpset.ncols);
-        for(i = 0; i < into_ncols; i++) {
-          nseen[i] = MIN2((size_t)UINT8_MAX, (size_t)nseen[i] + counts.b[i]);
-          bitset_or(colset, i, counts.b[i] > 0);
-        }
-      }
-    }
+    pthread_t reader;
+    int rc = pthread_create(&reader, NULL, _gpath_loader_read_thread, &loader);
+    if(rc != 0) die("Creating thread failed: %s", strerror(rc));
 
-    if(nlink != num_links_exp && !warn_nlink_mismatch) {
-      warn("Number of links mismatches: %s %zu != %zu [%s]",
-           kmerstr.b, num_links_exp, nlink, path);
-      warn_nlink_mismatch = true;
-    }
+    util_run_threads(workers, nthreads, sizeof(GPathLoadWorker),
+                     nthreads, _load_worker_text);
 
-    num_links_seen += nlink;
-    num_kmers_loaded += (gpset.entries.len > 0);
+    rc = pthread_join(reader, NULL);
+    if(rc != 0) die("Joining thread failed: %s", strerror(rc));
 
-    if(gpset.entries.len > 0) {
-      BinaryKmer bkey = binary_kmer_from_str(kmerstr.b, db_graph->kmer_size);
-      hkey_t hkey = find_link_kmer(bkey, kmer_flags, path, db_graph);
+    msgpool_dealloc(&loader.pool);
+    for(i = 0; i < npool; i++) strbuf_dealloc(&pool_bufs[i]);
+    ctx_free(pool_bufs);
+  }
 
-      if(hkey != HASH_NOT_FOUND) {
-        num_links_loaded += _load_paths_from_set(db_graph, &gpset,
-                                                 &subset0, &subset1,
-                                                 hkey);
-      }
-    }
+  for(i = 0; i < nthreads; i++) {
+    num_kmers_seen += workers[i].num_kmers_seen;
+    num_links_seen += workers[i].num_links_seen;
+    num_kmers_loaded += workers[i].num_kmers_loaded;
+    num_links_loaded += workers[i].num_links_loaded;
+    gpath_set_dealloc(&workers[i].gpset);
+    gpath_subset_dealloc(&workers[i].subset0);
+    gpath_subset_dealloc(&workers[i].subset1);
+    size_buf_dealloc(&workers[i].counts);
+    strbuf_dealloc(&workers[i].juncs);
+    byte_buf_dealloc(&workers[i].seqbuf);
   }
 
-  strbuf_dealloc(&kmerstr);
-  strbuf_dealloc(&juncs);
-  size_buf_dealloc(&counts);
+  ctx_free(workers);
+  ctx_free(bktlocks);
 
   load_check(total_kmers_exp == num_kmers_seen,
              "header number of kmers don't match seen (exp %zu vs %zu)",
@@ -627,12 +1059,8 @@ void gpath_reader_load(GPathReader *file, int kmer_flags, dBGraph *db_graph)
   char nlinks_str[50], nkmers_str[50];
   ulong_to_str(num_links_loaded, nlinks_str);
   ulong_to_str(num_kmers_loaded, nkmers_str);
-  status("Loaded %s paths from %s kmers", nlinks_str, nkmers_str);
-
-  gpath_subset_dealloc(&subset0);
-  gpath_subset_dealloc(&subset1);
-  gpath_set_dealloc(&gpset);
-  byte_buf_dealloc(&seqbuf);
+  status("Loaded %s paths from %s kmers [%zu threads]",
+         nlinks_str, nkmers_str, nthreads);
 }
 
 void gpath_reader_load_sample_names(const GPathReader *file, dBGraph *db_graph)
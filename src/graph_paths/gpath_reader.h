@@ -9,6 +9,56 @@
 
 #define CTP_FORMAT_VERSION 4
 
+//
+// Binary link files (.ctpb) have the usual JSON header, with
+// "encoding": "binary" in "paths", followed by fixed width arrays that are
+// memory mapped when loading instead of being parsed.
+// The binary part starts at the first 8 byte boundary after the JSON header.
+//
+// Layout (native endian, all sections 8 byte aligned):
+//   CtpBinHeader
+//   CtpBinKmer kmers[num_kmers+1]     sorted by kmer (binary_kmers_cmp), last
+//                                     entry only marks end of path list
+//   CtpBinPath paths[num_paths]       paths of kmer i are
+//                                     kmers[i].first_path..kmers[i+1].first_path-1
+//   uint8_t    nseen[num_paths*ncols] times each link was seen in each colour
+//   uint8_t    seqs[seq_bytes]        junction choices, 2 bits per base
+//
+
+#define CTPB_MAGIC "CTXLINKB"
+#define CTPB_VERSION 1
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version, kmer_size, num_bkmer_words, ncols;
+  uint64_t num_kmers, num_paths, seq_bytes;
+} CtpBinHeader;
+
+typedef struct
+{
+  BinaryKmer bkey;
+  uint64_t first_path;
+} CtpBinKmer;
+
+typedef struct
+{
+  uint64_t seq_offset;
+  uint16_t num_juncs;
+  uint8_t orient, padding[5];
+} CtpBinPath;
+
+typedef struct
+{
+  void *mmap_ptr; // NULL if not a binary file
+  size_t mmap_len;
+  size_t kmer_size, num_kmers, num_paths, ncols;
+  const CtpBinKmer *kmers;
+  const CtpBinPath *paths;
+  const uint8_t *nseen, *seqs;
+  size_t kmer_idx, path_idx; // position when reading links one at a time
+} CtpBinary;
+
 typedef struct
 {
   StreamBuffer strmbuf;
@@ -27,8 +77,12 @@ typedef struct
   int version;
   size_t ncolours;
   cJSON **colours_json;
+
+  CtpBinary bin;
 } GPathReader;
 
+#define gpath_reader_is_binary(file) ((file)->bin.mmap_ptr != NULL)
+
 #define GPATH_ADD_MISSING_KMERS   0
 #define GPATH_DIE_MISSING_KMERS   1
 #define GPATH_SKIP_MISSING_KMERS  2
@@ -77,12 +131,29 @@ void gpath_reader_check(const GPathReader *file, size_t kmer_size, size_t ncols)
 //   GPATH_DIE_MISSING_KMERS - die with error if cannot find kmer
 //   GPATH_SKIP_MISSING_KMERS - skip paths where kmer is not in graph
 void gpath_reader_load(GPathReader *file, int kmer_flags, dBGraph *db_graph);
+
+// As gpath_reader_load() but with `nthreads` threads parsing and inserting
+// links. Text files are decompressed by an extra reader thread.
+void gpath_reader_load_mt(GPathReader *file, int kmer_flags, size_t nthreads,
+                          dBGraph *db_graph);
 void gpath_reader_close(GPathReader *file);
 
 //
 // Reading without loading into a graph
 //
 
+// Append next line that is not empty or a comment to `buf`, followed by '\0'
+// Sets *start to the offset of the line in buf. Text files only.
+// Returns false at the end of the file
+bool gpath_reader_append_line(GPathReader *file, StrBuf *buf, size_t *start);
+
+// Read links of the kmer last returned by gpath_reader_read_kmer() into
+// `gpset`, skipping links without coverage. `gpset` must keep nseen counts.
+// Returns the number of link lines read
+size_t gpath_reader_read_links_into(GPathReader *file, GPathSet *gpset,
+                                    SizeBuffer *counts, StrBuf *juncs,
+                                    ByteBuffer *seqbuf);
+
 // Reads line <kmer> <num_links>
 // Calls die() on error
 // Returns true unless end of file
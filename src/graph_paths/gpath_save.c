@@ -6,6 +6,9 @@
 #include "binary_seq.h"
 #include "util.h"
 #include "json_hdr.h"
+#include "chunk_writer.h"
+#include "gpath_reader.h" // binary file layout
+#include "sort_r/sort_r.h"
 
 const char ctp_explanation_comment[] =
 "# This file was generated with McCortex\n"
@@ -110,13 +113,100 @@ cJSON* gpath_save_mkhdr(const char *path,
 }
 
 
-static inline void _gpath_save_flush(gzFile gzout, StrBuf *sbuf,
-                                     pthread_mutex_t *outlock)
+// Print "<kmer> <nlinks>\n"
+static inline void _gpath_save_kmer_line(const char *kmer, size_t kmer_size,
+                                         size_t nlinks, StrBuf *sbuf)
 {
-  pthread_mutex_lock(outlock);
-  gzwrite(gzout, sbuf->b, sbuf->end);
-  pthread_mutex_unlock(outlock);
-  strbuf_reset(sbuf);
+  // strbuf_sprintf(sbuf, "%s %zu\n", kmer, nlinks);
+  strbuf_append_strn(sbuf, kmer, kmer_size);
+  strbuf_append_char(sbuf, ' ');
+  strbuf_append_ulong(sbuf, nlinks);
+  strbuf_append_char(sbuf, '\n');
+}
+
+// Print "[FR] <njuncs> <nseen0,nseen1,...> <juncs>" without a newline
+static inline void _gpath_save_link_line(const GPath *gpath,
+                                         const GPathSet *gpset, StrBuf *sbuf)
+{
+  const uint8_t *nseenptr = gpath_set_get_nseen(gpset, gpath);
+  size_t col;
+
+  strbuf_append_char(sbuf, gpath->orient == FORWARD ? 'F' : 'R');
+  strbuf_append_char(sbuf, ' ');
+  strbuf_append_ulong(sbuf, gpath->num_juncs);
+  strbuf_append_char(sbuf, ' ');
+  strbuf_append_ulong(sbuf, nseenptr[0]);
+
+  for(col = 1; col < gpset->ncols; col++) {
+    strbuf_append_char(sbuf, ',');
+    strbuf_append_ulong(sbuf, nseenptr[col]);
+  }
+
+  strbuf_append_char(sbuf, ' ');
+  strbuf_ensure_capacity(sbuf, sbuf->end + gpath->num_juncs + 2);
+  binary_seq_to_str(gpath_seq(gpath), gpath->num_juncs, sbuf->b+sbuf->end);
+  sbuf->end += gpath->num_juncs;
+}
+
+// Print " seq=... juncpos=..." by tracing a link from kmer `hkey` through
+// the graph. juncpos is only printed if jposbuf is not NULL.
+static void _gpath_save_link_seq(hkey_t hkey, const GPath *gpath, size_t ncols,
+                                 dBNodeBuffer *nbuf, SizeBuffer *jposbuf,
+                                 const dBGraph *db_graph, StrBuf *sbuf)
+{
+  size_t j, col;
+
+  // First, find a colour this path is in
+  for(col = 0; col < ncols && !gpath_has_colour(gpath, ncols, col); col++) {}
+  if(col == ncols) die("path is not in any colours");
+
+  dBNode node = {.key = hkey, .orient = gpath->orient};
+  db_node_buf_reset(nbuf);
+  if(jposbuf) size_buf_reset(jposbuf); // indices of junctions in nbuf
+  gpath_fetch(node, gpath, nbuf, jposbuf, col, db_graph);
+
+  strbuf_append_str(sbuf, " seq=");
+  strbuf_ensure_capacity(sbuf, sbuf->end + db_graph->kmer_size + nbuf->len);
+  sbuf->end += db_nodes_to_str(nbuf->b, nbuf->len, db_graph,
+                               sbuf->b+sbuf->end);
+
+  if(jposbuf) {
+    strbuf_append_str(sbuf, " juncpos=");
+    strbuf_append_ulong(sbuf, jposbuf->b[0]);
+
+    for(j = 1; j < jposbuf->len; j++) {
+      strbuf_append_char(sbuf, ',');
+      strbuf_append_ulong(sbuf, jposbuf->b[j]);
+    }
+  }
+}
+
+/**
+ * Print links in a subset as an entry for the given kmer. Links are printed
+ * in the order they appear in the subset. Prints nothing if subset is empty.
+ * If nbuf is not NULL, links are traced from `hkey` in `db_graph` to add
+ * seq=... (and juncpos=... if jposbuf is not NULL).
+ */
+void gpath_save_subset_sbuf(const char *kmer, size_t kmer_size,
+                            const GPathSubset *subset,
+                            hkey_t hkey, dBNodeBuffer *nbuf,
+                            SizeBuffer *jposbuf, const dBGraph *db_graph,
+                            StrBuf *sbuf)
+{
+  const GPathSet *gpset = subset->gpset;
+  size_t i;
+  if(subset->list.len == 0) return;
+
+  _gpath_save_kmer_line(kmer, kmer_size, subset->list.len, sbuf);
+
+  for(i = 0; i < subset->list.len; i++) {
+    _gpath_save_link_line(subset->list.b[i], gpset, sbuf);
+    if(nbuf) {
+      _gpath_save_link_seq(hkey, subset->list.b[i], gpset->ncols,
+                           nbuf, jposbuf, db_graph, sbuf);
+    }
+    strbuf_append_char(sbuf, '\n');
+  }
 }
 
 /**
@@ -140,7 +230,7 @@ void gpath_save_sbuf(hkey_t hkey, StrBuf *sbuf, GPathSubset *subset,
   const size_t ncols = gpstore->gpset.ncols;
   GPath *first_gpath = gpath_store_fetch(gpstore, hkey);
   const GPath *gpath;
-  size_t i, j, col;
+  size_t i;
 
   // Load and sort paths for given kmer
   gpath_subset_reset(subset);
@@ -153,88 +243,30 @@ void gpath_save_sbuf(hkey_t hkey, StrBuf *sbuf, GPathSubset *subset,
   BinaryKmer bkmer = db_graph->ht.table[hkey];
   char bkstr[MAX_KMER_SIZE+1];
   binary_kmer_to_str(bkmer, db_graph->kmer_size, bkstr);
-
-  // strbuf_sprintf(sbuf, "%s %zu\n", bkstr, subset->list.len);
-  strbuf_append_strn(sbuf, bkstr, db_graph->kmer_size);
-  strbuf_append_char(sbuf, ' ');
-  strbuf_append_ulong(sbuf, subset->list.len);
-  strbuf_append_char(sbuf, '\n');
-
-  char orchar[2] = {0};
-  orchar[FORWARD] = 'F';
-  orchar[REVERSE] = 'R';
-  const uint8_t *nseenptr;
+  _gpath_save_kmer_line(bkstr, db_graph->kmer_size, subset->list.len, sbuf);
 
   for(i = 0; i < subset->list.len; i++)
   {
     gpath = subset->list.b[i];
-    nseenptr = gpath_set_get_nseen(gpset, gpath);
-
-    // strbuf_sprintf(sbuf, "%c %zu %u %u", orchar[gpath->orient], klen,
-    //                                      gpath->num_juncs, (uint32_t)nseenptr[0]);
-
-    strbuf_append_char(sbuf, orchar[gpath->orient]);
-    strbuf_append_char(sbuf, ' ');
-    strbuf_append_ulong(sbuf, gpath->num_juncs);
-    strbuf_append_char(sbuf, ' ');
-    strbuf_append_ulong(sbuf, nseenptr[0]);
-
-    for(col = 1; col < ncols; col++) {
-      // strbuf_sprintf(sbuf, ",%u", (uint32_t)nseenptr[col]);
-      strbuf_append_char(sbuf, ',');
-      strbuf_append_ulong(sbuf, nseenptr[col]);
-    }
-
-    strbuf_append_char(sbuf, ' ');
-    strbuf_ensure_capacity(sbuf, sbuf->end + gpath->num_juncs + 2);
-    binary_seq_to_str(gpath->seq, gpath->num_juncs, sbuf->b+sbuf->end);
-    sbuf->end += gpath->num_juncs;
+    _gpath_save_link_line(gpath, gpset, sbuf);
 
+    // Trace this path through the graph
     if(nbuf)
-    {
-      // Trace this path through the graph
-      // First, find a colour this path is in
-      for(col = 0; col < ncols && !gpath_has_colour(gpath, ncols, col); col++) {}
-      if(col == ncols) die("path is not in any colours");
-
-      dBNode node = {.key = hkey, .orient = gpath->orient};
-      db_node_buf_reset(nbuf);
-      if(jposbuf) size_buf_reset(jposbuf); // indices of junctions in nbuf
-      gpath_fetch(node, gpath, nbuf, jposbuf, col, db_graph);
-
-      strbuf_append_str(sbuf, " seq=");
-      strbuf_ensure_capacity(sbuf, sbuf->end + db_graph->kmer_size + nbuf->len);
-      sbuf->end += db_nodes_to_str(nbuf->b, nbuf->len, db_graph,
-                                   sbuf->b+sbuf->end);
-
-      if(jposbuf) {
-        strbuf_append_str(sbuf, " juncpos=");
-        strbuf_append_ulong(sbuf, jposbuf->b[0]);
-
-        for(j = 1; j < jposbuf->len; j++) {
-          strbuf_append_char(sbuf, ',');
-          strbuf_append_ulong(sbuf, jposbuf->b[j]);
-        }
-      }
-    }
+      _gpath_save_link_seq(hkey, gpath, ncols, nbuf, jposbuf, db_graph, sbuf);
 
     strbuf_append_char(sbuf, '\n');
   }
 }
 
 // @subset is a temp variable that is reused each time
-// @sbuf   is a temp variable that is reused each time
-static inline int _gpath_gzsave_node(hkey_t hkey,
-                                     StrBuf *sbuf, GPathSubset *subset,
-                                     dBNodeBuffer *nbuf, SizeBuffer *jposbuf,
-                                     gzFile gzout, pthread_mutex_t *outlock,
-                                     const dBGraph *db_graph)
+static inline int _gpath_save_node(hkey_t hkey, GPathSubset *subset,
+                                   dBNodeBuffer *nbuf, SizeBuffer *jposbuf,
+                                   ChunkWriter *writer, size_t threadid,
+                                   const dBGraph *db_graph)
 {
-  gpath_save_sbuf(hkey, sbuf, subset, nbuf, jposbuf, db_graph);
-
-  if(sbuf->end > DEFAULT_IO_BUFSIZE)
-    _gpath_save_flush(gzout, sbuf, outlock);
-
+  gpath_save_sbuf(hkey, chunk_writer_buf(writer, threadid),
+                  subset, nbuf, jposbuf, db_graph);
+  chunk_writer_done(writer, threadid);
   return 0; // => keep iterating
 }
 
@@ -242,8 +274,7 @@ typedef struct
 {
   size_t nthreads;
   bool save_seq; // write seq=... juncpos=...
-  gzFile gzout;
-  pthread_mutex_t *outlock;
+  ChunkWriter *writer;
   dBGraph *db_graph;
 } GPathSaving;
 
@@ -253,11 +284,8 @@ static void gpath_save_thread(void *arg, size_t threadid)
   const dBGraph *db_graph = save->db_graph;
 
   GPathSubset subset;
-  StrBuf sbuf;
-
   gpath_subset_alloc(&subset);
   gpath_subset_init(&subset, &save->db_graph->gpstore.gpset);
-  strbuf_alloc(&sbuf, 2 * DEFAULT_IO_BUFSIZE);
 
   dBNodeBuffer nbuf;
   SizeBuffer jposbuf;
@@ -265,30 +293,27 @@ static void gpath_save_thread(void *arg, size_t threadid)
   size_buf_alloc(&jposbuf, 256);
 
   HASH_ITERATE_PART(&db_graph->ht, threadid, save->nthreads,
-                    _gpath_gzsave_node,
-                    &sbuf, &subset,
+                    _gpath_save_node, &subset,
                     save->save_seq ? &nbuf : NULL, save->save_seq ? &jposbuf : NULL,
-                    save->gzout, save->outlock,
-                    db_graph);
-
-  _gpath_save_flush(save->gzout, &sbuf, save->outlock);
+                    save->writer, threadid, db_graph);
 
   db_node_buf_dealloc(&nbuf);
   size_buf_dealloc(&jposbuf);
   gpath_subset_dealloc(&subset);
-  strbuf_dealloc(&sbuf);
 }
 
 /**
  * Save paths to a file.
- * @param gzout         gzFile to write to
+ * @param fout          file to write gzip compressed output to
  * @param path          path of output file
+ * @param nthreads      threads to print and compress links with
+ * @param out_mem       memory for output buffers, may reduce nthreads
  * @param save_path_seq if true, save seq= and juncpos= for links, requires
  *                      exactly one colour in the graph
  * @param hdrs is array of JSON headers of input files
  */
-void gpath_save(gzFile gzout, const char *path,
-                size_t nthreads, bool save_path_seq,
+void gpath_save(FILE *fout, const char *path,
+                size_t nthreads, size_t out_mem, bool save_path_seq,
                 const char *cmdstr, cJSON *cmdhdr,
                 cJSON **hdrs, size_t nhdrs,
                 const ZeroSizeBuffer *contig_hists, size_t ncols,
@@ -302,30 +327,255 @@ void gpath_save(gzFile gzout, const char *path,
   char npaths_str[50];
   ulong_to_str(db_graph->gpstore.num_paths, npaths_str);
 
+  // Each thread compresses its own chunks of output
+  size_t chunk_size = chunk_writer_fit(out_mem, &nthreads);
+
   status("Saving %s paths to: %s", npaths_str, path);
   status("  using %zu threads", nthreads);
 
-  // Write header
+  ChunkWriter writer;
+  chunk_writer_alloc(&writer, fout, path, nthreads, chunk_size, true);
+
+  // Write header and comments about the format, sent before any links
   cJSON *json = gpath_save_mkhdr(path, cmdstr, cmdhdr, hdrs, nhdrs,
                                  contig_hists, ncols, db_graph);
-  json_hdr_gzprint(json, gzout);
+  json_hdr_sprint(json, chunk_writer_buf(&writer, 0));
   cJSON_Delete(json);
-
-  // Print comments about the format
-  gzputs(gzout, ctp_explanation_comment);
-
-  // Multithreaded
-  pthread_mutex_t outlock;
-  if(pthread_mutex_init(&outlock, NULL) != 0) die("Mutex init failed");
+  strbuf_append_str(chunk_writer_buf(&writer, 0), ctp_explanation_comment);
+  chunk_writer_flush(&writer, 0);
 
   GPathSaving save = {.nthreads = nthreads,
                       .save_seq = save_path_seq,
-                      .gzout = gzout,
-                      .outlock = &outlock,
+                      .writer = &writer,
                       .db_graph = db_graph};
 
   // Iterate over kmers writing paths
   util_multi_thread(&save, nthreads, gpath_save_thread);
-  pthread_mutex_destroy(&outlock);
+  chunk_writer_dealloc(&writer);
+  status("[GPathSave] Graph paths saved to %s", path);
+}
+
+static int _hkey_kmer_cmp(const void *aa, const void *bb, void *arg)
+{
+  const dBGraph *db_graph = (const dBGraph*)arg;
+  hkey_t a = *(const hkey_t*)aa, b = *(const hkey_t*)bb;
+  return binary_kmers_cmp(db_graph->ht.table[a], db_graph->ht.table[b]);
+}
+
+// Returns hash table entries of kmers with links, sorted by kmer. The array
+// has db_graph->gpstore.num_kmers_with_paths entries and must be freed with
+// ctx_free()
+hkey_t* gpath_save_sorted_kmers(const dBGraph *db_graph)
+{
+  const GPathStore *gpstore = &db_graph->gpstore;
+  size_t nkmers = 0;
+  hkey_t hkey;
+
+  hkey_t *hkeys = ctx_malloc(gpstore->num_kmers_with_paths * sizeof(hkey_t));
+
+  for(hkey = 0; hkey < gpstore->graph_capacity; hkey++) {
+    if(gpath_store_fetch(gpstore, hkey) != NULL) {
+      ctx_assert(nkmers < gpstore->num_kmers_with_paths);
+      hkeys[nkmers++] = hkey;
+    }
+  }
+
+  ctx_assert(nkmers == gpstore->num_kmers_with_paths);
+  sort_r(hkeys, nkmers, sizeof(hkey_t), _hkey_kmer_cmp, (void*)db_graph);
+  return hkeys;
+}
+
+//
+// Binary (.ctpb) output
+//
+
+#define _pad8(x) (((x)+7) & ~(size_t)7)
+
+bool gpath_save_is_binary(const char *path)
+{
+  size_t len = strlen(path);
+  return (len >= 5 && strcmp(path+len-5, ".ctpb") == 0);
+}
+
+typedef struct
+{
+  FILE *fh[4]; // kmers, paths, nseen, seqs sections
+  const char *path;
+  GPathSubset subset;
+  uint64_t num_kmers, num_paths, seq_bytes;
+} GPathBinSave;
+
+static inline void _bin_fwrite(const void *ptr, size_t nbytes, FILE *fh,
+                               const char *path)
+{
+  if(fwrite(ptr, 1, nbytes, fh) != nbytes)
+    die("Cannot write to file: %s [%s]", path, strerror(errno));
+}
+
+// Zero pad section to end on an 8 byte boundary
+static void _bin_fpad8(size_t nbytes, FILE *fh, const char *path)
+{
+  const char zeros[8] = {0};
+  _bin_fwrite(zeros, _pad8(nbytes) - nbytes, fh, path);
+}
+
+static inline void _gpath_bin_count(hkey_t hkey, GPathBinSave *save,
+                                    const dBGraph *db_graph)
+{
+  const GPath *gpath = gpath_store_fetch(&db_graph->gpstore, hkey);
+  save->num_kmers += (gpath != NULL);
+  for(; gpath != NULL; gpath = gpath_next(gpath)) {
+    save->num_paths++;
+    save->seq_bytes += binary_seq_mem(gpath->num_juncs);
+  }
+}
+
+static inline void _gpath_bin_write(hkey_t hkey, GPathBinSave *save,
+                                    const dBGraph *db_graph)
+{
+  const GPathSet *gpset = &db_graph->gpstore.gpset;
+  const GPath *gpath;
+  size_t i, nbytes;
+
+  // Paths are written in the same order as the text format
+  gpath_subset_reset(&save->subset);
+  gpath_subset_load_llist(&save->subset,
+                          gpath_store_fetch(&db_graph->gpstore, hkey));
+  gpath_subset_sort(&save->subset);
+
+  if(save->subset.list.len == 0) return;
+
+  CtpBinKmer bkmer = {.bkey = db_graph->ht.table[hkey],
+                      .first_path = save->num_paths};
+  _bin_fwrite(&bkmer, sizeof(bkmer), save->fh[0], save->path);
+
+  for(i = 0; i < save->subset.list.len; i++)
+  {
+    gpath = save->subset.list.b[i];
+    nbytes = binary_seq_mem(gpath->num_juncs);
+
+    CtpBinPath bpath = {.seq_offset = save->seq_bytes,
+                        .num_juncs = gpath->num_juncs,
+                        .orient = gpath->orient};
+
+    _bin_fwrite(&bpath, sizeof(bpath), save->fh[1], save->path);
+    _bin_fwrite(gpath_set_get_nseen(gpset, gpath), gpset->ncols,
+                save->fh[2], save->path);
+    _bin_fwrite(gpath_seq(gpath), nbytes, save->fh[3], save->path);
+
+    save->num_paths++;
+    save->seq_bytes += nbytes;
+  }
+
+  save->num_kmers++;
+}
+
+/**
+ * Save paths to a binary file that can be memory mapped when loading.
+ * Layout is described in gpath_reader.h. Kmer records are sorted by kmer.
+ * Sections are written in one pass over the kmers, each through its own
+ * file handle.
+ * @param fout  file to write to, must be seekable (not STDOUT)
+ * @param path  path of output file, reopened to write sections
+ */
+void gpath_save_binary(FILE *fout, const char *path,
+                       const char *cmdstr, cJSON *cmdhdr,
+                       cJSON **hdrs, size_t nhdrs,
+                       const ZeroSizeBuffer *contig_hists, size_t ncols,
+                       dBGraph *db_graph)
+{
+  ctx_assert(gpath_set_has_nseen(&db_graph->gpstore.gpset));
+  ctx_assert(ncols == db_graph->gpstore.gpset.ncols);
+
+  if(strcmp(path, "-") == 0) die("Cannot write binary links to STDOUT");
+
+  GPathBinSave save;
+  memset(&save, 0, sizeof(save));
+  save.path = path;
+
+  // Kmer records are written in sorted order
+  const size_t nkmers = db_graph->gpstore.num_kmers_with_paths;
+  hkey_t *hkeys = gpath_save_sorted_kmers(db_graph);
+  size_t i;
+
+  for(i = 0; i < nkmers; i++) _gpath_bin_count(hkeys[i], &save, db_graph);
+
+  char npaths_str[50];
+  ulong_to_str(save.num_paths, npaths_str);
+  status("Saving %s paths to: %s [binary]", npaths_str, path);
+
+  ctx_assert(save.num_kmers == db_graph->gpstore.num_kmers_with_paths);
+  ctx_assert(save.num_paths == db_graph->gpstore.num_paths);
+
+  // Write JSON header, padded with newlines to an 8 byte boundary
+  cJSON *json = gpath_save_mkhdr(path, cmdstr, cmdhdr, hdrs, nhdrs,
+                                 contig_hists, ncols, db_graph);
+  cJSON_AddStringToObject(json_hdr_get_paths(json, path), "encoding", "binary");
+  char *jstr = cJSON_Print(json);
+  size_t hdr_bytes = strlen(jstr);
+  _bin_fwrite(jstr, hdr_bytes, fout, path);
+  for(fputc('\n', fout), hdr_bytes++; hdr_bytes & 7; hdr_bytes++)
+    fputc('\n', fout);
+  free(jstr);
+  cJSON_Delete(json);
+
+  CtpBinHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, CTPB_MAGIC, sizeof(hdr.magic));
+  hdr.version = CTPB_VERSION;
+  hdr.kmer_size = db_graph->kmer_size;
+  hdr.num_bkmer_words = NUM_BKMER_WORDS;
+  hdr.ncols = ncols;
+  hdr.num_kmers = save.num_kmers;
+  hdr.num_paths = save.num_paths;
+  hdr.seq_bytes = save.seq_bytes;
+  _bin_fwrite(&hdr, sizeof(hdr), fout, path);
+  _bin_fpad8(sizeof(hdr), fout, path);
+
+  // Section offsets
+  long offsets[4];
+  offsets[0] = ftell(fout);
+  offsets[1] = offsets[0] + (save.num_kmers+1)*sizeof(CtpBinKmer);
+  offsets[2] = offsets[1] + save.num_paths*sizeof(CtpBinPath);
+  offsets[3] = offsets[2] + _pad8(save.num_paths*ncols);
+
+  if(offsets[0] < 0 || fflush(fout) != 0)
+    die("Cannot write to file: %s [%s]", path, strerror(errno));
+
+  save.fh[0] = fout;
+  for(i = 1; i < 4; i++) {
+    if((save.fh[i] = fopen(path, "r+")) == NULL ||
+       fseek(save.fh[i], offsets[i], SEEK_SET) != 0) {
+      die("Cannot reopen file: %s [%s]", path, strerror(errno));
+    }
+  }
+
+  size_t exp_kmers = save.num_kmers, exp_paths = save.num_paths;
+  save.num_kmers = save.num_paths = save.seq_bytes = 0;
+
+  gpath_subset_alloc(&save.subset);
+  gpath_subset_init(&save.subset, &db_graph->gpstore.gpset);
+  for(i = 0; i < nkmers; i++) _gpath_bin_write(hkeys[i], &save, db_graph);
+  gpath_subset_dealloc(&save.subset);
+  ctx_free(hkeys);
+
+  ctx_assert(save.num_kmers == exp_kmers);
+  ctx_assert(save.num_paths == exp_paths);
+  (void)exp_kmers; (void)exp_paths;
+
+  // Sentinel kmer marks the end of the last kmer's paths
+  CtpBinKmer sentinel;
+  memset(&sentinel, 0, sizeof(sentinel));
+  sentinel.first_path = save.num_paths;
+  _bin_fwrite(&sentinel, sizeof(sentinel), save.fh[0], path);
+
+  _bin_fpad8(save.num_paths*ncols, save.fh[2], path);
+  _bin_fpad8(save.seq_bytes, save.fh[3], path);
+
+  for(i = 1; i < 4; i++) {
+    if(fclose(save.fh[i]) != 0)
+      die("Cannot write to file: %s [%s]", path, strerror(errno));
+  }
+
   status("[GPathSave] Graph paths saved to %s", path);
 }
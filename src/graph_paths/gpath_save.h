@@ -4,6 +4,7 @@
 #include "db_graph.h"
 #include "db_node.h"
 #include "gpath_subset.h"
+#include "chunk_writer.h"
 #include "cJSON/cJSON.h"
 
 /*
@@ -46,18 +47,54 @@ void gpath_save_sbuf(hkey_t hkey, StrBuf *sbuf, GPathSubset *subset,
                      const dBGraph *db_graph);
 
 /**
- * Save paths to a file.
+ * Print links in a subset as an entry for the given kmer. Links are printed
+ * in the order they appear in the subset. Prints nothing if subset is empty.
+ * If nbuf is not NULL, links are traced from `hkey` in `db_graph` to add
+ * seq=... (and juncpos=... if jposbuf is not NULL).
+ */
+void gpath_save_subset_sbuf(const char *kmer, size_t kmer_size,
+                            const GPathSubset *subset,
+                            hkey_t hkey, dBNodeBuffer *nbuf,
+                            SizeBuffer *jposbuf, const dBGraph *db_graph,
+                            StrBuf *sbuf);
+
+/**
+ * Save paths to a file. Each of `nthreads` threads prints and gzip compresses
+ * links into separate gzip members, which are concatenated in `fout`.
+ * @param out_mem memory for output buffers, see chunk_writer_fit(). Fewer
+ *                threads are used if there is not enough memory for nthreads
  * @param cmdstr  name of the command being run, to be used to add @cmdhdr
  * @param cmdhdr  JSON header to add under current command->@cmdstr
  *                If cmdstr and cmdhdr are both NULL they are ignored
  * @param hdrs    array of JSON headers of input files
  * @param nhdrs   number of elements in @hdrs
  */
-void gpath_save(gzFile gzout, const char *path,
-                size_t nthreads, bool save_path_seq,
+void gpath_save(FILE *fout, const char *path,
+                size_t nthreads, size_t out_mem, bool save_path_seq,
                 const char *cmdstr, cJSON *cmdhdr,
                 cJSON **hdrs, size_t nhdrs,
                 const ZeroSizeBuffer *contig_hists, size_t ncols,
                 dBGraph *db_graph);
 
+// Returns hash table entries of kmers with links, sorted by kmer. The array
+// has db_graph->gpstore.num_kmers_with_paths entries and must be freed with
+// ctx_free()
+hkey_t* gpath_save_sorted_kmers(const dBGraph *db_graph);
+
+// Output paths ending .ctpb are saved in the binary format
+bool gpath_save_is_binary(const char *path);
+
+/**
+ * Save paths to a binary file that can be memory mapped by GPathReader.
+ * Kmer records are sorted by kmer, so output can be merged with
+ * gpath_merge_sorted(). Arguments are as for gpath_save(). Paths are written
+ * single threaded.
+ * @param fout  must be a seekable file opened at @path
+ */
+void gpath_save_binary(FILE *fout, const char *path,
+                       const char *cmdstr, cJSON *cmdhdr,
+                       cJSON **hdrs, size_t nhdrs,
+                       const ZeroSizeBuffer *contig_hists, size_t ncols,
+                       dBGraph *db_graph);
+
 #endif /* GPATH_SAVE_H_ */
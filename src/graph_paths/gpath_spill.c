@@ -0,0 +1,164 @@
+#include "global.h"
+#include "gpath_spill.h"
+#include "gpath_save.h"
+#include "gpath_merge.h"
+#include "gpath_reader.h"
+#include "gpath_subset.h"
+#include "json_hdr.h"
+#include "file_util.h"
+#include "util.h"
+
+static void _spill_path(const GPathSpill *spill, size_t idx, StrBuf *path)
+{
+  strbuf_reset(path);
+  strbuf_sprintf(path, "%s.spill.%zu", spill->out_path, idx);
+}
+
+// Called by the gate with no threads adding links
+static void _gpath_spill_full(void *arg)
+{
+  GPathSpill *spill = (GPathSpill*)arg;
+  status("[GPathSpill] Link store full");
+  gpath_hash_print_stats(&spill->db_graph->gphash);
+  gpath_spill_write(spill);
+  gpath_hash_reset(&spill->db_graph->gphash);
+}
+
+void gpath_spill_alloc(GPathSpill *spill, const char *out_path,
+                       bool save_path_seq, dBGraph *db_graph)
+{
+  ctx_assert2(strcmp(out_path, "-") != 0, "Cannot spill links with stdout");
+  memset(spill, 0, sizeof(*spill));
+  spill->db_graph = db_graph;
+  spill->out_path = out_path;
+  spill->save_path_seq = save_path_seq;
+  gpath_stage_gate_alloc(&spill->gate, &db_graph->gphash,
+                         _gpath_spill_full, spill);
+}
+
+void gpath_spill_dealloc(GPathSpill *spill)
+{
+  gpath_stage_gate_dealloc(&spill->gate);
+  memset(spill, 0, sizeof(*spill));
+}
+
+static void _spill_flush(StrBuf *sbuf, FILE *fh, const char *path)
+{
+  if(fwrite(sbuf->b, 1, sbuf->end, fh) != sbuf->end)
+    die("Cannot write to file: %s [%s]", path, strerror(errno));
+  strbuf_reset(sbuf);
+}
+
+// Write all links in the GPathStore to a new spill file, then empty the
+// GPathStore. Not thread safe.
+void gpath_spill_write(GPathSpill *spill)
+{
+  dBGraph *db_graph = spill->db_graph;
+  GPathStore *gpstore = &db_graph->gpstore;
+  const size_t ncols = gpstore->gpset.ncols;
+  const size_t nkmers = gpstore->num_kmers_with_paths;
+  size_t i;
+
+  // Spill files are merged by kmer, so write kmers in sorted order
+  hkey_t *hkeys = gpath_save_sorted_kmers(db_graph);
+
+  StrBuf path;
+  strbuf_alloc(&path, 1024);
+  _spill_path(spill, spill->num_spills, &path);
+
+  char links_str[50];
+  ulong_to_str(gpstore->num_paths, links_str);
+  status("[GPathSpill] Writing %s links to: %s", links_str, path.b);
+
+  FILE *fout = futil_fopen_create(path.b, "w");
+
+  // Spill files only need enough of a header to be read back in
+  ZeroSizeBuffer *hists = ctx_calloc(ncols, sizeof(ZeroSizeBuffer));
+  cJSON *json = gpath_save_mkhdr(path.b, NULL, NULL, NULL, 0,
+                                 hists, ncols, db_graph);
+  json_hdr_fprint(json, fout);
+  cJSON_Delete(json);
+  ctx_free(hists);
+
+  GPathSubset subset;
+  StrBuf sbuf;
+  gpath_subset_alloc(&subset);
+  gpath_subset_init(&subset, &gpstore->gpset);
+  strbuf_alloc(&sbuf, 2 * DEFAULT_IO_BUFSIZE);
+
+  // Spill files are complete link files, with seq= and juncpos= if wanted
+  dBNodeBuffer nbuf;
+  SizeBuffer jposbuf;
+  db_node_buf_alloc(&nbuf, 1024);
+  size_buf_alloc(&jposbuf, 256);
+  bool seq = spill->save_path_seq;
+
+  for(i = 0; i < nkmers; i++) {
+    gpath_save_sbuf(hkeys[i], &sbuf, &subset,
+                    seq ? &nbuf : NULL, seq ? &jposbuf : NULL, db_graph);
+    if(sbuf.end > DEFAULT_IO_BUFSIZE) _spill_flush(&sbuf, fout, path.b);
+  }
+
+  _spill_flush(&sbuf, fout, path.b);
+  futil_fclose(fout);
+
+  spill->num_spills++;
+  spill->num_links_spilled += gpstore->num_paths;
+
+  // Traversal lists must stay unused after the reset
+  bool traverse = (gpstore->paths_traverse != NULL);
+  gpath_store_reset(gpstore);
+  if(!traverse) gpstore->paths_traverse = NULL;
+
+  db_node_buf_dealloc(&nbuf);
+  size_buf_dealloc(&jposbuf);
+  gpath_subset_dealloc(&subset);
+  strbuf_dealloc(&sbuf);
+  strbuf_dealloc(&path);
+  ctx_free(hkeys);
+}
+
+/**
+ * Spill remaining links, merge all spill files into text link file `fout`
+ * and remove the spill files. Arguments are as for gpath_save().
+ * GPathHash is no longer needed and may have been freed.
+ */
+void gpath_spill_merge(GPathSpill *spill, FILE *fout, const char *path,
+                       size_t out_mem, const char *cmdstr, cJSON *cmdhdr,
+                       cJSON **hdrs, size_t nhdrs,
+                       const ZeroSizeBuffer *contig_hists, size_t ncols)
+{
+  size_t i, nfiles;
+
+  gpath_spill_write(spill);
+  nfiles = spill->num_spills;
+
+  char links_str[50];
+  ulong_to_str(spill->num_links_spilled, links_str);
+  status("[GPathSpill] Merging %s links from %zu spill files",
+         links_str, nfiles);
+
+  StrBuf spill_path;
+  strbuf_alloc(&spill_path, 1024);
+  GPathReader *files = ctx_calloc(nfiles, sizeof(GPathReader));
+
+  for(i = 0; i < nfiles; i++) {
+    _spill_path(spill, i, &spill_path);
+    gpath_reader_open(&files[i], spill_path.b);
+  }
+
+  // Links are traced again since duplicates across spill files are merged
+  gpath_merge_sorted(files, nfiles, fout, path, out_mem, spill->save_path_seq,
+                     cmdstr, cmdhdr, hdrs, nhdrs,
+                     contig_hists, ncols, spill->db_graph);
+
+  for(i = 0; i < nfiles; i++) {
+    gpath_reader_close(&files[i]);
+    _spill_path(spill, i, &spill_path);
+    if(unlink(spill_path.b) != 0)
+      warn("Cannot remove spill file: %s [%s]", spill_path.b, strerror(errno));
+  }
+
+  ctx_free(files);
+  strbuf_dealloc(&spill_path);
+}
@@ -0,0 +1,49 @@
+#ifndef GPATH_SPILL_H_
+#define GPATH_SPILL_H_
+
+#include "db_graph.h"
+#include "gpath_stage.h"
+#include "cJSON/cJSON.h"
+
+//
+// Write links to disk when the GPathHash / GPathStore fill up
+//
+// When a GPathStageGate finds the link store full, all links are written to a
+// temporary text link file sorted by kmer (<out>.spill.<N>) and the store is
+// emptied. At the end remaining links are spilled and all spill files are
+// merged with gpath_merge_sorted() into the output file.
+//
+// Nothing else may read the GPathStore while adding links (i.e. links are not
+// used for traversal), since it may be emptied at any time.
+//
+
+typedef struct
+{
+  GPathStageGate gate; // pass to gpath_stage_set_gate()
+  dBGraph *db_graph;
+  const char *out_path; // spill files are named after the output file
+  bool save_path_seq; // write seq= and juncpos=, see gpath_save()
+  size_t num_spills;
+  uint64_t num_links_spilled;
+} GPathSpill;
+
+// `out_path` must not be stdout ("-")
+void gpath_spill_alloc(GPathSpill *spill, const char *out_path,
+                       bool save_path_seq, dBGraph *db_graph);
+void gpath_spill_dealloc(GPathSpill *spill);
+
+// Write all links in the GPathStore to a new spill file, then empty the
+// GPathStore. Not thread safe.
+void gpath_spill_write(GPathSpill *spill);
+
+/**
+ * Spill remaining links, merge all spill files into text link file `fout`
+ * and remove the spill files. Arguments are as for gpath_save().
+ * GPathHash is no longer needed and may have been freed.
+ */
+void gpath_spill_merge(GPathSpill *spill, FILE *fout, const char *path,
+                       size_t out_mem, const char *cmdstr, cJSON *cmdhdr,
+                       cJSON **hdrs, size_t nhdrs,
+                       const ZeroSizeBuffer *contig_hists, size_t ncols);
+
+#endif /* GPATH_SPILL_H_ */
@@ -25,7 +25,7 @@ int main(int argc, char **argv)
   size_t i, kmer_size = 7, ncols = 3;
 
   gpath_reader_check(&pfile, kmer_size, ncols);
-  gzFile gzout = futil_gzopen_create(out_path, "w");
+  FILE *fout = futil_fopen_create(out_path, "w");
 
   dBGraph db_graph;
   db_graph_alloc(&db_graph, kmer_size, ncols, 1, 1024, DBG_ALLOC_EDGES);
@@ -51,8 +51,9 @@ int main(int argc, char **argv)
   hash_table_print_stats(&db_graph.ht);
 
   // Write output file
-  gpath_save(gzout, out_path, 1, true, NULL, NULL, &pfile.json, 1, &db_graph);
-  gzclose(gzout);
+  gpath_save(fout, out_path, 1, chunk_writer_mem(1, CHUNK_WRITER_SIZE), true,
+             NULL, NULL, &pfile.json, 1, &db_graph);
+  fclose(fout);
 
   // Checks
   // gpath_checks_all_paths(&db_graph, 2); // use two threads
@@ -0,0 +1,152 @@
+// request decl for access(), exec*() and PATH_MAX
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <ctype.h>
+#include <unistd.h>
+
+/*
+  `mccortex <command> [options] <args>`
+
+  McCortex is compiled once per kmer word count (mccortex31, mccortex63, ...)
+  since the number of 64 bit words per kmer is fixed at compile time. This
+  launcher picks the kmer size from the command line (-k <K>) or the header of
+  the first graph file (.ctx) it is given, then runs the smallest installed
+  binary that can hold that kmer size. That way each kmer uses as few words as
+  possible (e.g. k=33 runs in mccortex63 not mccortex95).
+
+  Binaries are searched for in the same directory as this launcher, then $PATH.
+  Set MCCORTEX_VERBOSE=1 to print which binary is run.
+*/
+
+// Largest MAXK binary we look for (32*n-1)
+#define DISPATCH_MAX_KMER 1023
+
+static const char *prog = "mccortex";
+
+// Returns 0 if not a valid kmer size
+static size_t parse_kmer_size(const char *str)
+{
+  char *end;
+  unsigned long k = strtoul(str, &end, 10);
+  if(end == str || *end != '\0' || k == 0 || k > DISPATCH_MAX_KMER) return 0;
+  return (size_t)k;
+}
+
+// Read kmer size from the header of a graph file
+// Returns 0 if not a graph file
+static size_t graph_file_kmer_size(const char *arg)
+{
+  char path[PATH_MAX+1];
+  const char *ptr = arg, *ext;
+
+  // Skip colour prefix e.g. 0:in.ctx or 1-3:in.ctx (join)
+  while(isdigit((unsigned char)*ptr) || *ptr == ',' || *ptr == '-') ptr++;
+  if(*ptr == ':' && ptr > arg) ptr++;
+  else ptr = arg;
+
+  // Drop colour suffix e.g. in.ctx:0,6-8
+  if((ext = strstr(ptr, ".ctx")) == NULL) return 0;
+  size_t len = (ext + strlen(".ctx")) - ptr;
+  if(len > PATH_MAX) return 0;
+  memcpy(path, ptr, len);
+  path[len] = '\0';
+
+  FILE *fh = fopen(path, "r");
+  if(fh == NULL) return 0;
+
+  char magic[6];
+  uint32_t version = 0, kmer_size = 0;
+  bool success = (fread(magic, 1, sizeof(magic), fh) == sizeof(magic) &&
+                  memcmp(magic, "CORTEX", sizeof(magic)) == 0 &&
+                  fread(&version, sizeof(uint32_t), 1, fh) == 1 &&
+                  fread(&kmer_size, sizeof(uint32_t), 1, fh) == 1);
+  fclose(fh);
+
+  return success && kmer_size <= DISPATCH_MAX_KMER ? kmer_size : 0;
+}
+
+// Largest kmer size requested with -k/--kmer, otherwise from the first input
+// graph file found in the arguments (not -o/--out). Returns 0 if none found
+static size_t args_kmer_size(int argc, char **argv)
+{
+  size_t k, kmer_size = 0, graph_kmer_size = 0;
+  int i;
+
+  for(i = 2; i < argc; i++) {
+    if(strcmp(argv[i], "--") == 0) continue;
+    if(strcmp(argv[i], "-k") == 0 || strcmp(argv[i], "--kmer") == 0) {
+      if(i+1 < argc && (k = parse_kmer_size(argv[++i])) > kmer_size)
+        kmer_size = k;
+    }
+    else if(strncmp(argv[i], "--kmer=", 7) == 0) {
+      if((k = parse_kmer_size(argv[i]+7)) > kmer_size) kmer_size = k;
+    }
+    else if(strncmp(argv[i], "-k", 2) == 0) {
+      if((k = parse_kmer_size(argv[i]+2)) > kmer_size) kmer_size = k;
+    }
+    else if(strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--out") == 0) {
+      i++; // output may be a stale graph with a different kmer size
+    }
+    else if(!graph_kmer_size) {
+      graph_kmer_size = graph_file_kmer_size(argv[i]);
+    }
+  }
+
+  return kmer_size ? kmer_size : graph_kmer_size;
+}
+
+// Try to exec `<dir>/mccortex<maxk>`, or search $PATH if dir is NULL
+// Only returns on failure
+static void try_exec(const char *dir, size_t maxk, char **argv, bool verbose)
+{
+  char bin[PATH_MAX+1], name[32];
+  snprintf(name, sizeof(name), "%s%zu", prog, maxk);
+
+  if(dir != NULL) {
+    if(snprintf(bin, sizeof(bin), "%s/%s", dir, name) >= (int)sizeof(bin))
+      return;
+    if(access(bin, X_OK) != 0) return;
+  }
+  else strcpy(bin, name);
+
+  if(verbose) fprintf(stderr, "[%s] running %s\n", prog, bin);
+  argv[0] = bin;
+  if(dir != NULL) execv(bin, argv);
+  else execvp(bin, argv);
+}
+
+int main(int argc, char **argv)
+{
+  size_t kmer_size, maxk;
+  char dir[PATH_MAX+1], *slash;
+  const char *verbose_env = getenv("MCCORTEX_VERBOSE");
+  bool verbose = (verbose_env != NULL && strcmp(verbose_env, "0") != 0);
+
+  kmer_size = args_kmer_size(argc, argv);
+  if(!kmer_size) kmer_size = 31;
+
+  // Directory this launcher is in
+  slash = strrchr(argv[0], '/');
+  if(slash != NULL && (size_t)(slash - argv[0]) < sizeof(dir)) {
+    memcpy(dir, argv[0], slash - argv[0]);
+    dir[slash - argv[0]] = '\0';
+  }
+  else slash = NULL;
+
+  // Smallest binary that can hold the kmer size first
+  for(maxk = ((kmer_size+31)/32)*32-1; maxk <= DISPATCH_MAX_KMER; maxk += 32) {
+    if(slash != NULL) try_exec(dir, maxk, argv, verbose);
+    try_exec(NULL, maxk, argv, verbose);
+  }
+
+  fprintf(stderr, "[%s] Error: no %s<K> binary found for kmer size %zu; "
+                  "compile with `make MAXK=%zu`\n",
+          prog, prog, kmer_size, ((kmer_size+31)/32)*32-1);
+  return EXIT_FAILURE;
+}
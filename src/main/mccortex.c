@@ -28,7 +28,7 @@ CtxCmd cmdobjs[] = {
 },
 {
   .cmd = "sort", .func = ctx_sort, .hide = false,
-  .blurb = "sort the kmers in a graph file",
+  .blurb = "sort the kmers in a graph or link file",
   .usage = sort_usage
 },
 {
@@ -1,26 +1,43 @@
 #ifndef GPATH_H_
 #define GPATH_H_
 
-// 20 bytes per path
 typedef struct GPathStruct GPath;
 
 #define GPATH_MAX_KMERS UINT32_MAX
 #define GPATH_MAX_JUNCS (UINT16_MAX>>1)
 #define GPATH_MAX_SEEN UINT8_MAX
 
-// 8+2+8=18bytes (could be 5+2+5 = 12)
+// 5+2=7 bytes per path, stored in a GPathSet arena directly followed by:
+//   seq    binary_seq_mem(num_juncs) bytes
+//   colset (ncols+7)/8 bytes
+//   nseen  ncols bytes, only if the set keeps counts
+// so no pointer to the sequence is needed and a path's data shares cache
+// lines. `next` is a signed byte offset to the next path in the same arena,
+// zero if there is none, so links survive the arena being reallocated.
 struct GPathStruct
 {
-  uint8_t *seq;
+  int64_t next:40;
   uint16_t num_juncs:15, orient:1;
-  GPath *next;
 } __attribute__((packed));
 
-#define gpath_get_colset(gp,ncols) ((gp)->seq - (((ncols)+7)/8))
+#define gpath_seq(gp) ((uint8_t*)((gp)+1))
+// colset comes after the sequence so does not depend on ncols
+#define gpath_get_colset(gp,ncols) ((void)(ncols), gpath_seq(gp) + (((gp)->num_juncs+3)/4))
 #define gpath_has_colour(gp,ncols,col) bitset_get(gpath_get_colset(gp,ncols),col)
 #define gpath_set_colour(gp,ncols,col) bitset_set(gpath_get_colset(gp,ncols),col)
 #define gpath_wipe_colset(gp,ncols) memset(gpath_get_colset(gp,ncols), 0, ((ncols)+7)/8)
 
+static inline GPath* gpath_next(const GPath *gp)
+{
+  return gp->next ? (GPath*)((const uint8_t*)gp + gp->next) : NULL;
+}
+
+// `nxt` must be NULL or in the same GPathSet as `gp`
+static inline void gpath_set_next(GPath *gp, const GPath *nxt)
+{
+  gp->next = nxt ? (const uint8_t*)nxt - (const uint8_t*)gp : 0;
+}
+
 // Compare by orient, sequence, number of junctions, number of kmers
 int gpath_cmp(const GPath *a, const GPath *b);
 
@@ -18,15 +18,19 @@ age=2 and (b) has age=1.
 
 */
 
+#define GPATH_FOLLOW_WINDOW 8 // must be a power of two
+
 // This struct is packed so we can hash it quickly
 struct GPathFollowStruct
 {
   const GPath *gpath;
   uint16_t pos, len;
   uint32_t age; // age is >= pos
-  // A small buffer of upcoming 24 bases
-  // uint16_t first_cached; // first base in buffer (multiple of 4: 0,4,8,...)
-  // uint8_t cache[6]; // first..first+23 (24 bases)
+  // Upcoming junctions decoded one base per byte, so stepping doesn't touch
+  // the path store. Holds bases from pos rounded down to a multiple of
+  // GPATH_FOLLOW_WINDOW, zero past the end of the path. Only depends on pos
+  // so that hashing is deterministic.
+  uint8_t window[GPATH_FOLLOW_WINDOW];
 } __attribute__((packed));
 
 typedef struct GPathFollowStruct GPathFollow;
@@ -34,8 +38,37 @@ typedef struct GPathFollowStruct GPathFollow;
 #include "madcrowlib/madcrow_buffer.h"
 madcrow_buffer(gpath_follow_buf,GPathFollowBuffer,GPathFollow);
 
-#define gpath_follow_get_base(path,pos) (binary_seq_get((path)->gpath->seq,pos))
-// Nucleotide gpath_follow_get_base(GPathFollow *path, size_t pos);
+// Random access, reads from the path store
+#define gpath_follow_get_base(path,pos) (binary_seq_get(gpath_seq((path)->gpath),pos))
+
+// Base at path->pos
+#define gpath_follow_next_base(path) \
+        ((Nucleotide)(path)->window[(path)->pos & (GPATH_FOLLOW_WINDOW-1)])
+
 GPathFollow gpath_follow_create(const GPath *gpath);
 
+// Decode the window of junctions containing path->pos
+void gpath_follow_fill_window(GPathFollow *path);
+
+// Move on to the next junction
+static inline void gpath_follow_advance(GPathFollow *path)
+{
+  path->pos++;
+  if((path->pos & (GPATH_FOLLOW_WINDOW-1)) == 0) gpath_follow_fill_window(path);
+}
+
+/**
+ * Next bases of all paths in a buffer as a bit mask, bit (1<<base) set if any
+ * path takes base next. Compare against the bases of the next nodes with
+ * bitwise operations rather than checking paths one at a time.
+ */
+static inline uint8_t gpath_follow_buf_next_mask(const GPathFollowBuffer *pbuf)
+{
+  size_t i;
+  uint8_t mask = 0;
+  for(i = 0; i < pbuf->len; i++)
+    mask |= (uint8_t)(1U << gpath_follow_next_base(&pbuf->b[i]));
+  return mask;
+}
+
 #endif /* GPATH_FOLLOW_H_ */
@@ -6,6 +6,7 @@
 #include "misc/city.h"
 
 // Entry is [hkey:5][gpindex:5] = 10 bytes
+// gpindex is the byte offset of the path in the GPathSet arena
 
 // We compare with REHASH_LIMIT(16)*bucket_size(<255) = 4080
 // so we need 12 bits to have 2^12 = 4096 possibilities
@@ -71,6 +72,7 @@ void gpath_hash_reset(GPathHash *gphash)
 {
   gphash->num_entries = 0;
   memset(gphash->table, 0xff, gphash->capacity * sizeof(GPEntry));
+  memset(gphash->bucket_nitems, 0, gphash->num_of_buckets * sizeof(uint8_t));
 }
 
 void gpath_hash_print_stats(const GPathHash *gphash)
@@ -94,7 +96,7 @@ static inline bool _gphash_entries_match(const GPathSet *gpset, GPEntry entry,
                                          hkey_t hkey, GPathNew newgpath)
 {
   return (hkey == entry.hkey &&
-          gpaths_are_equal(gpset->entries.b[entry.gpindex], newgpath));
+          gpath_equals_new(gpath_set_get_entry(gpset, entry.gpindex), newgpath));
 }
 
 // Use a bucket lock to find or add an entry
@@ -124,14 +126,14 @@ static inline GPath* _find_or_add_in_bucket_mt(GPathHash *gphash, uint64_t hash,
     if(_gphash_entries_match(gpset, entry, hkey, newgpath))
     {
       *found = true;
-      gpath_ret = gpset->entries.b + entry.gpindex;
+      gpath_ret = gpath_set_get_entry(gpset, entry.gpindex);
       break;
     }
     else if(PATH_HASH_ENTRY_EMPTY(entry))
     {
       gpath_ret = gpath_store_add_mt(gphash->gpstore, hkey, newgpath);
       *entryptr = (GPEntry){.hkey = hkey,
-                            .gpindex = gpath_ret - gpset->entries.b};
+                            .gpindex = gpset_get_pkey(gpset, gpath_ret)};
 
       __sync_synchronize(); // add entry before updating count
       __sync_fetch_and_add((volatile uint8_t*)&gphash->bucket_nitems[hash], 1);
@@ -160,16 +162,22 @@ static inline GPath* _find_in_bucket_mt(const GPathHash *gphash, uint64_t hash,
 
   for(entry = start; entry < end; entry++)
     if(_gphash_entries_match(gpset, *entry, hkey, newgpath))
-      return gpset->entries.b + entry->gpindex;
+      return gpath_set_get_entry(gpset, entry->gpindex);
 
   return NULL;
 }
 
+uint64_t gpath_hash_path(hkey_t hkey, GPathNew newgpath)
+{
+  size_t mem = binary_seq_mem(newgpath.num_juncs);
+  return CityHash64WithSeeds((const char*)newgpath.seq, mem, hkey, 0);
+}
+
 // Returns NULL if out of memory
 // Thread Safe: uses bucket level locks
-GPath* gpath_hash_find_or_insert_mt(GPathHash *gphash,
-                                    hkey_t hkey, GPathNew newgpath,
-                                    bool *found)
+GPath* gpath_hash_find_or_insert_hashed_mt(GPathHash *gphash,
+                                           hkey_t hkey, GPathNew newgpath,
+                                           uint64_t entropy, bool *found)
 {
   ctx_assert(newgpath.seq != NULL);
   ctx_assert(gphash->table != NULL);
@@ -178,12 +186,13 @@ GPath* gpath_hash_find_or_insert_mt(GPathHash *gphash,
   *found = false;
 
   size_t i, mem = binary_seq_mem(newgpath.num_juncs);
-  uint64_t entropy = hkey, hash;
+  uint64_t hash;
   GPath *gpath = NULL;
 
   for(i = 0; i < REHASH_LIMIT; i++)
   {
-    entropy = CityHash64WithSeeds((const char*)newgpath.seq, mem, entropy, i);
+    if(i > 0)
+      entropy = CityHash64WithSeeds((const char*)newgpath.seq, mem, entropy, i);
     hash = entropy & gphash->mask;
 
     uint8_t bucket_fill = *(volatile uint8_t *)&gphash->bucket_nitems[hash];
@@ -204,3 +213,14 @@ GPath* gpath_hash_find_or_insert_mt(GPathHash *gphash,
   gpath_hash_print_stats(gphash);
   die("[GPathHash] Out of memory");
 }
+
+// Returns NULL if out of memory
+// Thread Safe: uses bucket level locks
+GPath* gpath_hash_find_or_insert_mt(GPathHash *gphash,
+                                    hkey_t hkey, GPathNew newgpath,
+                                    bool *found)
+{
+  return gpath_hash_find_or_insert_hashed_mt(gphash, hkey, newgpath,
+                                             gpath_hash_path(hkey, newgpath),
+                                             found);
+}
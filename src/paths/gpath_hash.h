@@ -55,4 +55,13 @@ GPath* gpath_hash_find_or_insert_mt(GPathHash *restrict phash,
                                     hkey_t hkey, GPathNew newgpath,
                                     bool *found);
 
+// Hash of a path, used to pick the first bucket to look in
+uint64_t gpath_hash_path(hkey_t hkey, GPathNew newgpath);
+#define gpath_hash_bucket(phash,hash) ((hash) & (phash)->mask)
+
+// As gpath_hash_find_or_insert_mt() with `hash` from gpath_hash_path()
+GPath* gpath_hash_find_or_insert_hashed_mt(GPathHash *restrict phash,
+                                           hkey_t hkey, GPathNew newgpath,
+                                           uint64_t hash, bool *found);
+
 #endif /* GPATH_HASH_H_ */
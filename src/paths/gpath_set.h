@@ -5,11 +5,13 @@
 #include "common_buffers.h"
 #include "binary_seq.h"
 
-#include "madcrowlib/madcrow_buffer.h"
-madcrow_buffer(gpath_buf, GPathBuffer, GPath);
-
+// Byte offset of a path in its GPathSet arena
 typedef uint64_t pkey_t;
 
+// Save 16 bytes at the end of the sequence store
+// This is relied on by GPathFollow
+#define SEQ_STORE_PADDING 16
+
 // These passed around to be added
 typedef struct
 {
@@ -19,22 +21,54 @@ typedef struct
   Orientation orient;
 } GPathNew;
 
+// Paths are packed one after another into a single arena, see gpath.h
 typedef struct
 {
   const size_t ncols;
-  GPathBuffer entries;
-  ByteBuffer seqs; // colset+seq for each path
-  ByteBuffer nseen_buf; // counts for how many times we've seen path
+  ByteBuffer arena; // GPath+seq+colset(+nseen) for each path
+  size_t num_paths;
+  bool keep_nseen; // store counts for how many times we've seen each path
   bool can_resize;
 } GPathSet;
 
+// Number of bytes used by a path in the arena
+#define gpath_set_entry_bytes(gpset,njuncs) \
+  (sizeof(GPath) + binary_seq_mem(njuncs) + \
+   ((gpset)->ncols+7)/8 + ((gpset)->keep_nseen ? (gpset)->ncols : 0))
 
 static inline pkey_t gpset_get_pkey(const GPathSet *gpset, const GPath *gpath)
 {
-  ctx_assert2(gpath >= gpset->entries.b &&
-              gpath <= gpset->entries.b+gpset->entries.len,
+  ctx_assert2((const uint8_t*)gpath >= gpset->arena.b &&
+              (const uint8_t*)gpath < gpset->arena.b+gpset->arena.len,
               "GPath is not in GPathSet");
-  return gpath - gpset->entries.b;
+  return (const uint8_t*)gpath - gpset->arena.b;
+}
+
+#define gpath_set_get_entry(gpset,pkey) ((GPath*)((gpset)->arena.b + (pkey)))
+
+// Smallest number of bytes used by a path in the arena
+#define gpath_set_min_entry_bytes(gpset) gpath_set_entry_bytes(gpset,0)
+
+// Path ids are pkeys in units of the smallest entry, for bit arrays over the
+// paths in a set. Ids are unique and less than gpath_set_num_pathids()
+#define gpath_set_num_pathids(gpset) \
+  ((gpset)->arena.len / gpath_set_min_entry_bytes(gpset))
+
+static inline size_t gpset_get_pathid(const GPathSet *gpset, const GPath *gpath)
+{
+  return gpset_get_pkey(gpset, gpath) / gpath_set_min_entry_bytes(gpset);
+}
+
+// Iterate over all paths in a set, not thread safe
+#define gpath_set_first(gpset) \
+  ((gpset)->arena.len ? gpath_set_get_entry(gpset,0) : NULL)
+
+static inline GPath* gpath_set_next_entry(const GPathSet *gpset,
+                                          const GPath *gpath)
+{
+  const uint8_t *ptr = (const uint8_t*)gpath +
+                       gpath_set_entry_bytes(gpset, gpath->num_juncs);
+  return ptr < gpset->arena.b + gpset->arena.len ? (GPath*)ptr : NULL;
 }
 
 // If resize true, cannot do multithreaded but can resize array
@@ -57,8 +91,8 @@ void gpath_set_print_stats(const GPathSet *gpset);
 // Copies newgpath.seq over and wipe new colset
 GPath* gpath_set_add_mt(GPathSet *gpset, GPathNew newgpath);
 
-// Returns true if we are storing number of sightings and kmer length
-#define gpath_set_has_nseen(gpset) ((gpset)->nseen_buf.b != NULL)
+// Returns true if we are storing number of sightings
+#define gpath_set_has_nseen(gpset) ((gpset)->keep_nseen)
 
 uint8_t* gpath_set_get_nseen(const GPathSet *gpset, const GPath *gpath);
 
@@ -74,8 +108,9 @@ void gpath_set_zero_nseen(GPathSet *gpset);
 
 GPathNew gpath_set_get(const GPathSet *gpset, const GPath *gpath);
 
-#define gpaths_are_equal(a,b) \
-  ((a).orient == (b).orient && \
-   binary_seqs_cmp((a).seq, (a).num_juncs, (b).seq, (b).num_juncs) == 0)
+// Compare a stored path `gp` with a GPathNew `b`
+#define gpath_equals_new(gp,b) \
+  ((gp)->orient == (b).orient && \
+   binary_seqs_cmp(gpath_seq(gp), (gp)->num_juncs, (b).seq, (b).num_juncs) == 0)
 
 #endif /* GPATH_SET_H_ */
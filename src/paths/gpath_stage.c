@@ -0,0 +1,238 @@
+#include "global.h"
+#include "gpath_stage.h"
+#include "util.h"
+#include "binary_seq.h"
+#include "hash_mem.h"
+#include "sort_r/sort_r.h"
+
+// Flush once the table is 3/4 full to keep probe lengths short
+#define gpath_stage_limit(stage) ((stage)->capacity/4*3)
+
+void gpath_stage_alloc(GPathStage *stage, GPathHash *gphash, size_t capacity)
+{
+  ctx_assert(capacity >= GPATH_STAGE_MIN_CAPACITY);
+  ctx_assert(!(capacity & (capacity-1)));
+  memset(stage, 0, sizeof(*stage));
+  stage->gphash = gphash;
+  stage->capacity = capacity;
+  stage->seq_size = capacity * GPATH_STAGE_SEQ_PER_ENTRY;
+  stage->table = ctx_calloc(capacity, sizeof(GPathStageEntry));
+  stage->seq = ctx_malloc(stage->seq_size);
+}
+
+void gpath_stage_dealloc(GPathStage *stage)
+{
+  ctx_assert2(stage->num_entries == 0, "Staged paths not flushed");
+  ctx_free(stage->table);
+  ctx_free(stage->seq);
+  memset(stage, 0, sizeof(*stage));
+}
+
+size_t gpath_stage_fit(size_t mem)
+{
+  size_t cap = GPATH_STAGE_CAPACITY;
+  while(cap > GPATH_STAGE_MIN_CAPACITY && gpath_stage_mem(cap) > mem)
+    cap >>= 1;
+  return cap;
+}
+
+void gpath_stage_gate_alloc(GPathStageGate *gate, const GPathHash *gphash,
+                            void (*full)(void *arg), void *arg)
+{
+  memset(gate, 0, sizeof(*gate));
+  // Past this the GPathHash starts failing to find room in buckets
+  gate->max_entries = gphash->capacity * IDEAL_OCCUPANCY;
+  gate->full = full;
+  gate->arg = arg;
+  if(pthread_rwlock_init(&gate->lock, NULL) != 0) die("rwlock init failed");
+}
+
+void gpath_stage_gate_dealloc(GPathStageGate *gate)
+{
+  ctx_assert(gate->rsvd_entries == 0 && gate->rsvd_bytes == 0);
+  pthread_rwlock_destroy(&gate->lock);
+  memset(gate, 0, sizeof(*gate));
+}
+
+static inline bool _stage_entry_match(const GPathStage *stage,
+                                      GPathStageEntry entry, uint64_t hash,
+                                      hkey_t hkey, GPathNew newgpath, size_t col)
+{
+  return (entry.hash == hash && entry.hkey == hkey && entry.col == col &&
+          entry.num_juncs == newgpath.num_juncs &&
+          entry.orient == newgpath.orient &&
+          memcmp(stage->seq + entry.seq_offset, newgpath.seq,
+                 binary_seq_mem(newgpath.num_juncs)) == 0);
+}
+
+void gpath_stage_add(GPathStage *stage, hkey_t hkey, GPathNew newgpath,
+                     size_t col)
+{
+  size_t i, mem = binary_seq_mem(newgpath.num_juncs);
+  uint64_t hash = gpath_hash_path(hkey, newgpath);
+  GPathStageEntry *entry;
+
+  const size_t mask = stage->capacity - 1;
+  ctx_assert(mem <= stage->seq_size);
+
+  // Linear probing, table is never full
+  for(i = hash & mask; ; i = (i+1) & mask)
+  {
+    entry = &stage->table[i];
+    if(entry->count == 0) break;
+    if(_stage_entry_match(stage, *entry, hash, hkey, newgpath, col)) {
+      if(entry->count < UINT32_MAX) entry->count++;
+      return;
+    }
+  }
+
+  // New path, make room for it first
+  if(stage->num_entries >= gpath_stage_limit(stage) ||
+     stage->seq_len + mem > stage->seq_size)
+  {
+    gpath_stage_flush(stage);
+    entry = &stage->table[hash & mask];
+  }
+
+  memcpy(stage->seq + stage->seq_len, newgpath.seq, mem);
+
+  *entry = (GPathStageEntry){.hash = hash, .hkey = hkey,
+                             .num_juncs = newgpath.num_juncs,
+                             .orient = newgpath.orient,
+                             .seq_offset = stage->seq_len,
+                             .count = 1, .col = col};
+
+  stage->seq_len += mem;
+  stage->num_entries++;
+}
+
+static int _stage_entry_cmp(const void *aa, const void *bb, void *arg)
+{
+  const GPathHash *gphash = (const GPathHash*)arg;
+  const GPathStageEntry *a = (const GPathStageEntry*)aa;
+  const GPathStageEntry *b = (const GPathStageEntry*)bb;
+  uint64_t x = gpath_hash_bucket(gphash, a->hash);
+  uint64_t y = gpath_hash_bucket(gphash, b->hash);
+  return (x > y) - (x < y);
+}
+
+// Check there is room for `nentries` new paths using `nbytes` of GPathSet
+static inline bool _gate_has_room(const GPathStageGate *gate,
+                                  const GPathHash *gphash,
+                                  size_t nentries, size_t nbytes)
+{
+  const GPathSet *gpset = &gphash->gpstore->gpset;
+  size_t num_entries = *(volatile const size_t*)&gphash->num_entries;
+  size_t arena_len = *(volatile const size_t*)&gpset->arena.len;
+  return (num_entries + nentries <= gate->max_entries &&
+          arena_len + nbytes + SEQ_STORE_PADDING <= gpset->arena.size);
+}
+
+static inline bool _gate_reserve(GPathStageGate *gate, const GPathHash *gphash,
+                                 size_t nentries, size_t nbytes)
+{
+  size_t e = __sync_add_and_fetch(&gate->rsvd_entries, nentries);
+  size_t b = __sync_add_and_fetch(&gate->rsvd_bytes, nbytes);
+  if(_gate_has_room(gate, gphash, e, b)) return true;
+  __sync_fetch_and_sub(&gate->rsvd_entries, nentries);
+  __sync_fetch_and_sub(&gate->rsvd_bytes, nbytes);
+  return false;
+}
+
+// Returns holding the read lock with room reserved for the batch
+static void _gate_enter(GPathStageGate *gate, const GPathHash *gphash,
+                        size_t nentries, size_t nbytes)
+{
+  pthread_rwlock_rdlock(&gate->lock);
+
+  while(!_gate_reserve(gate, gphash, nentries, nbytes))
+  {
+    // Wait for other threads to finish their batches, then empty the hash
+    pthread_rwlock_unlock(&gate->lock);
+    pthread_rwlock_wrlock(&gate->lock);
+
+    // Another thread may have already made room
+    if(!_gate_has_room(gate, gphash, nentries, nbytes)) {
+      if(gphash->num_entries == 0)
+        die("[GPathStage] Not enough memory to add %zu paths", nentries);
+      gate->full(gate->arg);
+    }
+
+    pthread_rwlock_unlock(&gate->lock);
+    pthread_rwlock_rdlock(&gate->lock);
+  }
+}
+
+static void _gate_leave(GPathStageGate *gate, size_t nentries, size_t nbytes)
+{
+  __sync_fetch_and_sub(&gate->rsvd_entries, nentries);
+  __sync_fetch_and_sub(&gate->rsvd_bytes, nbytes);
+  pthread_rwlock_unlock(&gate->lock);
+}
+
+static void _stage_add_batch(GPathStage *stage,
+                             const GPathStageEntry *batch, size_t n)
+{
+  GPathHash *gphash = stage->gphash;
+  const GPathSet *gpset = &gphash->gpstore->gpset;
+  GPathStageEntry entry;
+  size_t i;
+  GPath *gpath;
+  uint8_t *nseen;
+  bool found;
+
+  for(i = 0; i < n; i++)
+  {
+    entry = batch[i];
+    GPathNew newgpath = {.seq = stage->seq + entry.seq_offset,
+                         .orient = entry.orient, .num_juncs = entry.num_juncs,
+                         .colset = NULL, .nseen = NULL};
+
+    gpath = gpath_hash_find_or_insert_hashed_mt(gphash, entry.hkey, newgpath,
+                                                entry.hash, &found);
+
+    // Add colour and all sightings at once
+    bitset_set(gpath_get_colset(gpath, gpset->ncols), entry.col);
+    nseen = gpath_set_get_nseen(gpset, gpath);
+    if(nseen != NULL)
+      safe_add_uint8_mt(&nseen[entry.col], MIN2(entry.count, UINT8_MAX));
+  }
+}
+
+// Thread Safe: with other threads flushing or adding to the same GPathHash
+void gpath_stage_flush(GPathStage *stage)
+{
+  GPathHash *gphash = stage->gphash;
+  const GPathSet *gpset = &gphash->gpstore->gpset;
+  GPathStageEntry *table = stage->table;
+  size_t i, j, end, nbytes, n = 0;
+
+  if(stage->num_entries == 0) return;
+
+  // Pack entries at the start of the table, then visit the GPathHash in
+  // bucket order
+  for(i = 0; i < stage->capacity; i++)
+    if(table[i].count) table[n++] = table[i];
+
+  ctx_assert(n == stage->num_entries);
+  sort_r(table, n, sizeof(GPathStageEntry), _stage_entry_cmp, gphash);
+
+  if(stage->gate == NULL) _stage_add_batch(stage, table, n);
+  else
+  {
+    // Reserve room for the worst case: every path in the batch is new
+    for(i = 0; i < n; i = end)
+    {
+      end = MIN2(i + GPATH_STAGE_GATE_BATCH, n);
+      for(j = i, nbytes = 0; j < end; j++)
+        nbytes += gpath_set_entry_bytes(gpset, table[j].num_juncs);
+
+      _gate_enter(stage->gate, gphash, end-i, nbytes);
+      _stage_add_batch(stage, table+i, end-i);
+      _gate_leave(stage->gate, end-i, nbytes);
+    }
+  }
+
+  memset(table, 0, stage->capacity * sizeof(GPathStageEntry));
+  stage->num_entries = stage->seq_len = 0;
+}
@@ -0,0 +1,86 @@
+#ifndef GPATH_STAGE_H_
+#define GPATH_STAGE_H_
+
+#include "gpath_hash.h"
+#include <pthread.h>
+
+//
+// Per-thread staging of new paths before they are added to a GPathHash
+//
+// Reads from high coverage regions give the same paths over and over. Rather
+// than taking a GPathHash bucket lock for every sighting, each thread merges
+// duplicates and their counts in a private table. When the table fills up it
+// is flushed to the GPathHash sorted by bucket, taking one lock per distinct
+// path and adding all of its sightings at once.
+//
+
+#define GPATH_STAGE_CAPACITY (1UL<<14) // max entries, power of two
+#define GPATH_STAGE_MIN_CAPACITY 512 // seq must fit the longest path (8KB)
+#define GPATH_STAGE_SEQ_PER_ENTRY 16 // bytes of packed path sequence
+#define GPATH_STAGE_GATE_BATCH 256 // paths added per pass through a gate
+
+// Memory used by a GPathStage with `cap` entries
+#define gpath_stage_mem(cap) \
+        ((cap)*(sizeof(GPathStageEntry) + GPATH_STAGE_SEQ_PER_ENTRY))
+
+typedef struct
+{
+  uint64_t hash; // from gpath_hash_path()
+  uint64_t hkey:40, num_juncs:15, orient:1;
+  uint32_t seq_offset; // offset in GPathStage.seq
+  uint32_t count; // number of times seen, 0 => empty entry
+  uint32_t col; // colour to add path to
+} __attribute((packed)) GPathStageEntry;
+
+//
+// A GPathStageGate stops stages filling the GPathHash and its GPathSet. Before
+// adding a batch of paths, a flushing thread reserves room for all of them.
+// If there is not enough room, it waits for other threads to finish flushing
+// and calls full(), which must empty the GPathHash and GPathStore.
+//
+typedef struct
+{
+  pthread_rwlock_t lock; // held for reading while adding a batch
+  size_t max_entries; // limit on GPathHash entries
+  volatile size_t rsvd_entries, rsvd_bytes; // reserved by flushing threads
+  void (*full)(void *arg);
+  void *arg;
+} GPathStageGate;
+
+typedef struct
+{
+  GPathHash *gphash; // flush into this table
+  GPathStageGate *gate; // NULL unless set with gpath_stage_set_gate()
+  GPathStageEntry *table;
+  size_t capacity, num_entries;
+  uint8_t *seq;
+  size_t seq_len, seq_size;
+} GPathStage;
+
+// `capacity` must be a power of two, see gpath_stage_fit()
+void gpath_stage_alloc(GPathStage *stage, GPathHash *gphash, size_t capacity);
+void gpath_stage_dealloc(GPathStage *stage);
+
+// Largest stage capacity that uses at most `mem` bytes, limited to
+// [GPATH_STAGE_MIN_CAPACITY, GPATH_STAGE_CAPACITY]
+size_t gpath_stage_fit(size_t mem);
+
+// `full` is called with `arg` when the GPathHash is full. It is never called
+// while any thread is flushing a stage through the same gate.
+void gpath_stage_gate_alloc(GPathStageGate *gate, const GPathHash *gphash,
+                            void (*full)(void *arg), void *arg);
+void gpath_stage_gate_dealloc(GPathStageGate *gate);
+
+// All stages flushing into the same GPathHash must use the same gate
+#define gpath_stage_set_gate(stage,g) ((stage)->gate = (g))
+
+// Record a sighting of a path in colour `col`
+// newgpath.seq is copied. May flush the table first if it is full.
+void gpath_stage_add(GPathStage *stage, hkey_t hkey, GPathNew newgpath,
+                     size_t col);
+
+// Add all staged paths to the GPathHash and empty the table
+// Thread Safe: with other threads flushing or adding to the same GPathHash
+void gpath_stage_flush(GPathStage *stage);
+
+#endif /* GPATH_STAGE_H_ */
@@ -117,15 +117,17 @@ static void _gpstore_add_to_llist_mt(GPathStore *gpstore, hkey_t hkey, GPath *gp
 {
   // Add to linked list
   ctx_assert(sizeof(size_t) == sizeof(GPath*));
+  GPath *head;
   do {
-    gpath->next = *(GPath *volatile const*)&gpstore->paths_all[hkey];
+    head = *(GPath *volatile const*)&gpstore->paths_all[hkey];
+    gpath_set_next(gpath, head);
   }
   while(!__sync_bool_compare_and_swap((volatile size_t*)&gpstore->paths_all[hkey],
-                                      (size_t)gpath->next, (size_t)gpath));
+                                      (size_t)head, (size_t)gpath));
 
   // Update stats
   size_t nbytes = binary_seq_mem(gpath->num_juncs);
-  size_t new_kmer = (gpath->next == NULL ? 1 : 0);
+  size_t new_kmer = (head == NULL ? 1 : 0);
   __sync_fetch_and_add((volatile uint64_t*)&gpstore->num_kmers_with_paths, new_kmer);
   __sync_fetch_and_add((volatile uint64_t*)&gpstore->num_paths, 1);
   __sync_fetch_and_add((volatile uint64_t*)&gpstore->path_bytes, nbytes);
@@ -135,8 +137,8 @@ static void _gpstore_add_to_llist_mt(GPathStore *gpstore, hkey_t hkey, GPath *gp
 GPath* gpstore_find(const GPathStore *gpstore, hkey_t hkey, GPathNew find)
 {
   GPath *gpath = gpath_store_fetch(gpstore, hkey);
-  for(; gpath != NULL; gpath = gpath->next)
-    if(gpaths_are_equal(*gpath, find))
+  for(; gpath != NULL; gpath = gpath_next(gpath))
+    if(gpath_equals_new(gpath, find))
       return gpath;
   return NULL;
 }
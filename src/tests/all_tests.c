@@ -65,7 +65,8 @@ void all_tests_add_paths_multi(dBGraph *graph, const char **seqs, size_t nseqs,
   size_t nkmers = graph->gpstore.num_kmers_with_paths;
 
   size_t i, nworkers = 1;
-  GenPathWorker *wrkrs = gen_paths_workers_alloc(nworkers, graph);
+  GenPathWorker *wrkrs;
+  wrkrs = gen_paths_workers_alloc(nworkers, GPATH_STAGE_CAPACITY, graph);
 
   // Set up asyncio input data
   AsyncIOInput io = {.file1 = NULL, .file2 = NULL,
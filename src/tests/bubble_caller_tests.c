@@ -43,7 +43,7 @@ static void _call_bubble(BubbleCaller *caller,
   TASSERT(edges_get_outdegree(edges5p, node5p.orient) > 1);
   TASSERT(edges_get_indegree(edges3p, node3p.orient) > 1);
 
-  find_bubbles(caller, node5p);
+  TASSERT(find_bubbles(caller, node5p, false));
 
   GCacheUnitig *snode3p;
   Orientation snorient3p;
@@ -89,6 +89,15 @@ static void test_bubbles(dBGraph *graph, const char **seqs, size_t nseqs,
 
   _call_bubble(caller, flank5p, flank3p, alleles, nalleles, &nbuf, &sbuf);
 
+  // A fork that goes over its budget is deferred, then gives the same bubble
+  // when called again without a budget
+  const size_t kmer_size = graph->kmer_size;
+  dBNode node5p = db_graph_find_str(graph, flank5p+strlen(flank5p)-kmer_size);
+  prefs.max_task_kmers = 1;
+  TASSERT(!find_bubbles(caller, node5p, true));
+  _call_bubble(caller, flank5p, flank3p, alleles, nalleles, &nbuf, &sbuf);
+  prefs.max_task_kmers = 0;
+
   strbuf_dealloc(&sbuf);
   db_node_buf_dealloc(&nbuf);
   bubble_callers_destroy(caller, 1);
@@ -3,6 +3,8 @@
 #include "db_graph.h"
 #include "db_node.h"
 #include "build_graph.h"
+#include "dup_filter.h"
+#include "hash.h"
 
 #include <math.h>
 
@@ -12,6 +14,78 @@ static Covg kmer_get_covg(const char *kmer, const dBGraph *db_graph)
   return db_node_get_covg(db_graph, node.key, 0);
 }
 
+static void test_dup_filter()
+{
+  test_status("Testing remove PCR duplicates with DupFilter");
+
+  dBGraph graph;
+  size_t kmer_size = 19, ncols = 1;
+
+  db_graph_alloc(&graph, kmer_size, ncols, ncols, 1024,
+                 DBG_ALLOC_EDGES | DBG_ALLOC_COVGS | DBG_ALLOC_BKTLOCKS);
+
+  DupFilter fltr;
+  dup_filter_alloc(&fltr, 100);
+
+  read_t r1, r2;
+  seq_read_alloc(&r1);
+  seq_read_alloc(&r2);
+
+  SeqLoadingStats stats;
+  memset(&stats, 0, sizeof(stats));
+
+  SeqLoadingPrefs prefs = {.fq_cutoff = 0, .hp_cutoff = 0,
+                           .matedir = READPAIR_FR,
+                           .colour = 0, .remove_pcr_dups = true,
+                           .dup_filter = &fltr};
+
+  // Load a pair of reads
+  seq_read_set(&r1, "CTACGATGTATGCTTAGCTGTTCCG");
+  seq_read_set(&r2, "TAGAACGTTCCCTACACGTCCTATG");
+  TASSERT(build_graph_from_reads_mt(&r1, &r2, 0, 0, &prefs, &stats, &graph));
+  TASSERT(kmer_get_covg("CTACGATGTATGCTTAGCT", &graph) == 1);
+
+  // Same start kmers -> duplicate
+  seq_read_set(&r1, "CTACGATGTATGCTTAGCTAATGAT");
+  seq_read_set(&r2, "TAGAACGTTCCCTACACGTTGTTTG");
+  TASSERT(!build_graph_from_reads_mt(&r1, &r2, 0, 0, &prefs, &stats, &graph));
+  TASSERT(kmer_get_covg("CTACGATGTATGCTTAGCT", &graph) == 1);
+  TASSERT(stats.num_dup_pe_pairs == 1);
+
+  // Same first read, different mate -> not a duplicate
+  seq_read_set(&r1, "CTACGATGTATGCTTAGCTAATGAT");
+  seq_read_set(&r2, "GCGTTACCTACTGACAGCTAAGCAT");
+  TASSERT(build_graph_from_reads_mt(&r1, &r2, 0, 0, &prefs, &stats, &graph));
+  TASSERT(kmer_get_covg("CTACGATGTATGCTTAGCT", &graph) == 2);
+
+  // Single ended reads don't match pairs
+  seq_read_set(&r1, "CTACGATGTATGCTTAGCTAGTGTG");
+  TASSERT(build_graph_from_reads_mt(&r1, NULL, 0, 0, &prefs, &stats, &graph));
+  TASSERT(!build_graph_from_reads_mt(&r1, NULL, 0, 0, &prefs, &stats, &graph));
+  TASSERT(kmer_get_covg("CTACGATGTATGCTTAGCT", &graph) == 3);
+  TASSERT(stats.num_dup_se_reads == 1);
+
+  // Filter can be reset (e.g. for a new sample)
+  dup_filter_reset(&fltr);
+  TASSERT(build_graph_from_reads_mt(&r1, NULL, 0, 0, &prefs, &stats, &graph));
+  TASSERT(kmer_get_covg("CTACGATGTATGCTTAGCT", &graph) == 4);
+
+  // All keys added should be found again
+  size_t i, nfound = 0, nkeys = 2000;
+  dup_filter_dealloc(&fltr);
+  dup_filter_alloc(&fltr, nkeys);
+  for(i = 0; i < nkeys; i++) nfound += dup_filter_add_mt(&fltr, ctx_hash64(&i, sizeof(i), 0));
+  TASSERT(nfound < 5);
+  for(i = nfound = 0; i < nkeys; i++) nfound += dup_filter_add_mt(&fltr, ctx_hash64(&i, sizeof(i), 0));
+  TASSERT2(nfound + fltr.nfailed == nkeys, "%zu %zu", nfound, (size_t)fltr.nfailed);
+
+  seq_read_dealloc(&r1);
+  seq_read_dealloc(&r2);
+
+  dup_filter_dealloc(&fltr);
+  db_graph_dealloc(&graph);
+}
+
 void test_build_graph()
 {
   test_status("Testing remove PCR duplicates in build_graph.c");
@@ -151,4 +225,6 @@ void test_build_graph()
   seq_read_dealloc(&r2);
 
   db_graph_dealloc(&graph);
+
+  test_dup_filter();
 }
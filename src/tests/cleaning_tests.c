@@ -123,6 +123,29 @@ void _test_graph_cleaning()
   TASSERT(graph.ht.num_kmers == 0, "%"PRIu64" kmers", graph.ht.num_kmers);
   TASSERT(graph.ht.num_kmers == hash_table_count_kmers(&graph.ht));
 
+  // Tip (15+15 kmers) with a tip (10 kmers) half way along it.
+  // The first pass removes the two outer tips, exposing the first half of the
+  // long tip as a new tip, which is removed in the next round
+  char tip1[100+30+1], tip2[100+15+10+1];
+  memcpy(tip1, graphseq, 100);
+  memcpy(tip1+100, graphseq+500, 30);
+  tip1[130] = '\0';
+  memcpy(tip2, tip1, 115);
+  memcpy(tip2+115, graphseq+700, 10);
+  tip2[125] = '\0';
+
+  build_graph_from_str_mt(&graph, 0, graphseq, 200, false);
+  build_graph_from_str_mt(&graph, 0, tip1, strlen(tip1), false);
+  build_graph_from_str_mt(&graph, 0, tip2, strlen(tip2), false);
+  TASSERT2(graph.ht.num_kmers == 200-19+1 + 30 + 10,
+           "%"PRIu64" kmers", graph.ht.num_kmers);
+
+  size_t rounds = clean_graph_iterate(nthreads, 0, 2*19-1, 0, NULL, NULL,
+                                      visited, keep, &graph);
+  TASSERT2(rounds >= 1, "rounds: %zu", rounds);
+  TASSERT2(graph.ht.num_kmers == 200-19+1, "%"PRIu64" kmers", graph.ht.num_kmers);
+  TASSERT(graph.ht.num_kmers == hash_table_count_kmers(&graph.ht));
+
   ctx_free(visited);
   ctx_free(keep);
 
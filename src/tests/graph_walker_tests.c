@@ -4,12 +4,18 @@
 #include "generate_paths.h"
 #include "graph_walker.h"
 
-static void _check_junction_gaps(GraphWalker *wlk, size_t *exp_gaps, size_t n)
+// Returns number of nodes walked
+// If `jump` is true, skip along unitigs with graph_walker_jump_unitig()
+static size_t _check_junction_gaps(GraphWalker *wlk, size_t *exp_gaps, size_t n,
+                                   bool jump)
 {
   GraphStep step;
-  size_t idx = 0;
+  size_t idx = 0, nwalked = 0;
+  dBNodeBuffer nbuf;
+  db_node_buf_alloc(&nbuf, 64);
 
   while(graph_walker_next(wlk)) {
+    nwalked++;
     step = wlk->last_step;
     if(graph_step_status_is_fork(step.status)) {
       TASSERT2(idx < n, "idx:%zu n:%zu", idx, n);
@@ -19,9 +25,12 @@ static void _check_junction_gaps(GraphWalker *wlk, size_t *exp_gaps, size_t n)
       }
       idx++;
     }
+    if(jump) nwalked += graph_walker_jump_unitig(wlk, NULL, &nbuf);
   }
 
   TASSERT2(idx == n, "Didn't see expected no. of forks %zu vs %zu", idx, n);
+  db_node_buf_dealloc(&nbuf);
+  return nwalked;
 }
 
 static void _test_graph_walker_test1()
@@ -65,11 +74,38 @@ static void _test_graph_walker_test1()
 
   dBNode node = db_graph_find_str(&graph, "CAGATTAAAGG");
   graph_walker_start(&wlk, node);
-  size_t exp_gap1[2] = {5, 18};
+  size_t exp_gap1[2] = {5, 18}, nsteps, njumps;
 
-  _check_junction_gaps(&wlk, exp_gap1, sizeof(exp_gap1) / sizeof(exp_gap1[0]));
+  nsteps = _check_junction_gaps(&wlk, exp_gap1, 2, false);
   graph_walker_finish(&wlk);
 
+  // Jumping along unitigs must give the same path gaps
+  graph_walker_start(&wlk, node);
+  njumps = _check_junction_gaps(&wlk, exp_gap1, 2, true);
+  graph_walker_finish(&wlk);
+  TASSERT2(nsteps == njumps, "%zu vs %zu", nsteps, njumps);
+
+  // Walking twice with a decision cache gives the same decisions, taken from
+  // the cache the second time
+  GraphWalkerCache cache;
+  graph_walker_cache_alloc(&cache, 8);
+  wlk.cache = &cache;
+
+  graph_walker_start(&wlk, node);
+  _check_junction_gaps(&wlk, exp_gap1, 2, false);
+  graph_walker_finish(&wlk);
+  size_t nlookups = wlk.cache_lookups;
+  TASSERT2(nlookups > 0 && wlk.cache_hits == 0, "%zu", wlk.cache_hits);
+
+  graph_walker_start(&wlk, node);
+  _check_junction_gaps(&wlk, exp_gap1, 2, false);
+  graph_walker_finish(&wlk);
+  TASSERT2(wlk.cache_lookups == 2*nlookups, "%zu", wlk.cache_lookups);
+  TASSERT2(wlk.cache_hits == nlookups, "%zu vs %zu", wlk.cache_hits, nlookups);
+
+  wlk.cache = NULL;
+  graph_walker_cache_dealloc(&cache);
+
   // Add the third read which should disrupt expected path gap
   // 4 new paths, 0 new kmer paths
   all_tests_add_paths(&graph, seqs[2], params, 4, 0);
@@ -77,8 +113,13 @@ static void _test_graph_walker_test1()
   graph_walker_start(&wlk, node);
   size_t exp_gap2[2] = {5, 5+11+18};
 
-  _check_junction_gaps(&wlk, exp_gap2, sizeof(exp_gap2) / sizeof(exp_gap2[0]));
+  nsteps = _check_junction_gaps(&wlk, exp_gap2, 2, false);
+  graph_walker_finish(&wlk);
+
+  graph_walker_start(&wlk, node);
+  njumps = _check_junction_gaps(&wlk, exp_gap2, 2, true);
   graph_walker_finish(&wlk);
+  TASSERT2(nsteps == njumps, "%zu vs %zu", nsteps, njumps);
 
   // Done
   graph_walker_dealloc(&wlk);
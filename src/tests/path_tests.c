@@ -4,6 +4,9 @@
 #include "build_graph.h"
 #include "generate_paths.h"
 #include "gpath_checks.h"
+#include "gpath_stage.h"
+#include "gpath_follow.h"
+#include "binary_seq.h"
 
 //       junctions:  >     >           <     <     <
 const char seq0[] = "CCTGGGTGCGAATGACACCAAATCGAATGAC"; // a->d
@@ -88,7 +91,7 @@ static void _check_node_paths(const char *kmer,
   #define MAX_SEQ 128
   char seq[MAX_SEQ];
 
-  for(; path != NULL; path = path->next)
+  for(; path != NULL; path = gpath_next(path))
   {
     if(path->orient == node.orient &&
        gpath_has_colour(path, gpstore->gpset.ncols, colour))
@@ -176,7 +179,221 @@ static void _test_add_paths()
   db_graph_dealloc(&graph);
 }
 
+// Paths are packed into one arena which may move when it grows
+static void _test_gpath_set_arena()
+{
+  test_status("Testing GPathSet arena layout and linked paths");
+
+  const size_t ncols = 3, npaths = 100;
+  GPathSet gpset;
+  gpath_set_alloc(&gpset, ncols, 64, true, true);
+
+  uint8_t seq[GPATH_MAX_JUNCS/4+1], nseen[3];
+  GPath *gpath, *prev = NULL;
+  pkey_t pkeys[npaths];
+  size_t i, n;
+
+  for(i = 0; i < npaths; i++) {
+    memset(seq, (int)i, sizeof(seq));
+    nseen[0] = i; nseen[1] = i+1; nseen[2] = i+2;
+    GPathNew newgp = {.seq = seq, .colset = NULL, .nseen = nseen,
+                      .num_juncs = i, .orient = i & 1};
+    gpath = gpath_set_add_mt(&gpset, newgp);
+    gpath_set_colour(gpath, ncols, i % ncols);
+    gpath_set_next(gpath, prev); // link back to previous path
+    pkeys[i] = gpset_get_pkey(&gpset, gpath);
+    prev = gpath;
+  }
+
+  TASSERT(gpset.num_paths == npaths);
+
+  // Path ids are increasing and fit in a bit array of num_pathids bits
+  size_t pathid, prev_pathid = 0, npathids = gpath_set_num_pathids(&gpset);
+
+  // Walk arena in order
+  for(n = 0, gpath = gpath_set_first(&gpset); gpath != NULL;
+      gpath = gpath_set_next_entry(&gpset, gpath), n++) {
+    TASSERT(gpset_get_pkey(&gpset, gpath) == pkeys[n]);
+    pathid = gpset_get_pathid(&gpset, gpath);
+    TASSERT(pathid < npathids);
+    TASSERT(n == 0 || pathid > prev_pathid);
+    prev_pathid = pathid;
+    TASSERT(gpath->num_juncs == n);
+    TASSERT(gpath->orient == (n & 1));
+    TASSERT(gpath_has_colour(gpath, ncols, n % ncols));
+    TASSERT(gpath_colset_bits_set(gpath, ncols) == 1);
+    TASSERT(gpath_set_get_nseen(&gpset, gpath)[2] == n+2);
+    memset(seq, (int)n, sizeof(seq));
+    GPathNew cmp = {.seq = seq, .num_juncs = n, .orient = n & 1};
+    TASSERT(gpath_equals_new(gpath, cmp));
+  }
+  TASSERT(n == npaths);
+
+  // Walk linked list from last path back to the first
+  gpath = gpath_set_get_entry(&gpset, pkeys[npaths-1]);
+  for(n = npaths; gpath != NULL; gpath = gpath_next(gpath), n--)
+    TASSERT(gpset_get_pkey(&gpset, gpath) == pkeys[n-1]);
+  TASSERT(n == 0);
+
+  gpath_set_dealloc(&gpset);
+}
+
+// Duplicate paths are merged in the stage and counts added when flushed
+static void _test_gpath_stage()
+{
+  test_status("Testing staging paths before adding to GPathHash");
+
+  GPathStore gpstore;
+  GPathHash gphash;
+  GPathStage stage;
+  gpath_store_alloc(&gpstore, 1, 1024, 0, ONE_MEGABYTE, true, false);
+  gpath_hash_alloc(&gphash, &gpstore, ONE_MEGABYTE);
+  gpath_stage_alloc(&stage, &gphash, GPATH_STAGE_CAPACITY);
+
+  uint8_t seq[2] = {0x1b, 0x0e};
+  GPathNew newgp = {.seq = seq, .colset = NULL, .nseen = NULL,
+                    .num_juncs = 7, .orient = FORWARD};
+  GPath *gpath;
+  size_t i, nstaged = stage.capacity;
+
+  for(i = 0; i < 300; i++) gpath_stage_add(&stage, 1, newgp, 0);
+  gpath_stage_add(&stage, 2, newgp, 0);
+  gpath_stage_add(&stage, 2, newgp, 0);
+  TASSERT(gpstore.num_paths == 0);
+
+  gpath_stage_flush(&stage);
+  TASSERT(gpstore.num_paths == 2);
+  TASSERT(stage.num_entries == 0);
+
+  // counts saturate at 255
+  gpath = gpath_store_fetch(&gpstore, 1);
+  TASSERT(gpath != NULL && gpath_next(gpath) == NULL);
+  TASSERT(gpath_equals_new(gpath, newgp));
+  TASSERT(gpath_set_get_nseen(&gpstore.gpset, gpath)[0] == 255);
+  gpath = gpath_store_fetch(&gpstore, 2);
+  TASSERT(gpath != NULL && gpath_next(gpath) == NULL);
+  TASSERT(gpath_set_get_nseen(&gpstore.gpset, gpath)[0] == 2);
+
+  // Adding more distinct paths than fit in the stage flushes it
+  for(i = 0; i < nstaged; i++) {
+    seq[0] = i; seq[1] = (i >> 8) & 0x3f;
+    gpath_stage_add(&stage, i % 1000, newgp, 0);
+  }
+  TASSERT(gpstore.num_paths > 2);
+  gpath_stage_flush(&stage);
+  TASSERT2(gpstore.num_paths == 2 + nstaged, "%zu", (size_t)gpstore.num_paths);
+
+  gpath_stage_dealloc(&stage);
+  gpath_hash_dealloc(&gphash);
+  gpath_store_dealloc(&gpstore);
+}
+
+typedef struct
+{
+  GPathHash *gphash;
+  size_t num_full, num_paths;
+} StageGateTest;
+
+static void _stage_gate_full(void *arg)
+{
+  StageGateTest *t = (StageGateTest*)arg;
+  t->num_full++;
+  t->num_paths += t->gphash->gpstore->num_paths;
+  gpath_store_reset(t->gphash->gpstore);
+  gpath_hash_reset(t->gphash);
+}
+
+// Gate empties the store when it fills up instead of running out of memory
+static void _test_gpath_stage_gate()
+{
+  test_status("Testing staging paths through a gate");
+
+  GPathStore gpstore;
+  GPathHash gphash;
+  GPathStage stage;
+  GPathStageGate gate;
+  gpath_store_alloc(&gpstore, 1, 1024, 0, 1024*sizeof(GPath*)+8192, true, false);
+  gpath_hash_alloc(&gphash, &gpstore, 8192);
+  gpath_stage_alloc(&stage, &gphash, GPATH_STAGE_MIN_CAPACITY);
+
+  StageGateTest t = {.gphash = &gphash, .num_full = 0, .num_paths = 0};
+  gpath_stage_gate_alloc(&gate, &gphash, _stage_gate_full, &t);
+  gpath_stage_set_gate(&stage, &gate);
+
+  uint8_t seq[2] = {0, 0};
+  GPathNew newgp = {.seq = seq, .colset = NULL, .nseen = NULL,
+                    .num_juncs = 7, .orient = FORWARD};
+  size_t i, npaths = 4000;
+
+  for(i = 0; i < npaths; i++) {
+    seq[0] = i; seq[1] = (i >> 8) & 0x3f;
+    gpath_stage_add(&stage, i % 1000, newgp, 0);
+  }
+  gpath_stage_flush(&stage);
+
+  TASSERT(t.num_full > 0);
+  TASSERT2(t.num_paths + gpstore.num_paths == npaths, "%zu + %zu",
+           t.num_paths, (size_t)gpstore.num_paths);
+  TASSERT(gphash.num_entries == gpstore.num_paths);
+
+  gpath_stage_gate_dealloc(&gate);
+  gpath_stage_dealloc(&stage);
+  gpath_hash_dealloc(&gphash);
+  gpath_store_dealloc(&gpstore);
+}
+
+static void _test_gpath_follow()
+{
+  test_status("Testing following paths through a window of junctions");
+
+  GPathSet gpset;
+  gpath_set_alloc(&gpset, 1, 1024, true, false);
+
+  // 21 junctions spans three windows, last one partly full
+  const char juncs[] = "ACGTTGCAAACCGGTTTGCAG";
+  size_t i, njuncs = strlen(juncs);
+  uint8_t seq[8] = {0};
+  binary_seq_from_str(juncs, njuncs, seq);
+
+  GPathNew newgp = {.seq = seq, .colset = NULL, .nseen = NULL,
+                    .num_juncs = njuncs, .orient = FORWARD};
+  GPath *gpath = gpath_set_add_mt(&gpset, newgp);
+
+  GPathFollow fpath = gpath_follow_create(gpath), fpath2;
+  TASSERT(fpath.len == njuncs);
+
+  for(i = 0; i < njuncs; i++) {
+    TASSERT2(gpath_follow_next_base(&fpath) == dna_char_to_nuc(juncs[i]),
+             "i: %zu", i);
+    TASSERT(gpath_follow_next_base(&fpath) == gpath_follow_get_base(&fpath, i));
+
+    // Window only depends on position
+    fpath2 = fpath;
+    gpath_follow_fill_window(&fpath2);
+    TASSERT(memcmp(&fpath, &fpath2, sizeof(GPathFollow)) == 0);
+
+    gpath_follow_advance(&fpath);
+  }
+
+  // Next base mask
+  GPathFollowBuffer pbuf;
+  gpath_follow_buf_alloc(&pbuf, 4);
+  fpath = gpath_follow_create(gpath); // A
+  gpath_follow_buf_add(&pbuf, fpath);
+  gpath_follow_advance(&fpath); // C
+  gpath_follow_buf_add(&pbuf, fpath);
+  gpath_follow_buf_add(&pbuf, fpath);
+  TASSERT(gpath_follow_buf_next_mask(&pbuf) == ((1<<dna_char_to_nuc('A')) | (1<<dna_char_to_nuc('C'))));
+
+  gpath_follow_buf_dealloc(&pbuf);
+  gpath_set_dealloc(&gpset);
+}
+
 void test_paths()
 {
   _test_add_paths();
+  _test_gpath_set_arena();
+  _test_gpath_stage();
+  _test_gpath_stage_gate();
+  _test_gpath_follow();
 }
@@ -65,7 +65,8 @@ static void test_repeat_loop()
   // Allocate graph, but don't add any sequence
   all_tests_construct_graph(&graph, kmer_size, ncols, NULL, 0, params);
 
-  GenPathWorker *gen_path_wrkr = gen_paths_workers_alloc(1, &graph);
+  GenPathWorker *gen_path_wrkr;
+  gen_path_wrkr = gen_paths_workers_alloc(1, GPATH_STAGE_CAPACITY, &graph);
 
   GraphWalker gwlk;
   RepeatWalker rptwlk;
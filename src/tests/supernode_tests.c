@@ -4,6 +4,7 @@
 #include "db_node.h"
 #include "supernode.h"
 #include "build_graph.h"
+#include "unitig_index.h"
 
 #include "bit_array/bit_macros.h"
 
@@ -76,6 +77,64 @@ static void pull_out_supernodes(const char **seq, const char **ans, size_t n,
   db_node_buf_dealloc(&nbuf);
 }
 
+// Every kmer of the input must be found in the unitig index, at a position
+// in its unitig where the unitig has the same kmer
+static void test_unitig_index_find(const char **seq, size_t n,
+                                   const dBGraph *graph)
+{
+  const size_t kmer_size = graph->kmer_size;
+  UnitigKmerGraph ugraph;
+  UnitigIndex uindex;
+  uint8_t *visited = ctx_calloc(roundup_bits2bytes(graph->ht.capacity), 1);
+
+  unitig_graph_alloc(&ugraph, graph);
+  unitig_index_build(&uindex, &ugraph, 2, visited);
+  TASSERT(uindex.num_kmers == graph->ht.num_kmers);
+
+  StrBuf sbuf;
+  strbuf_alloc(&sbuf, 256);
+
+  size_t i, j, len;
+  BinaryKmer bkmer, bkey, ukmer;
+  const UnitigKmer *ukm;
+  Orientation orient;
+
+  for(i = 0; i < n; i++) {
+    len = strlen(seq[i]);
+    for(j = 0; j+kmer_size <= len; j++)
+    {
+      bkmer = binary_kmer_from_str(seq[i]+j, kmer_size);
+      bkey = binary_kmer_get_key(bkmer, kmer_size);
+      ukm = unitig_index_find(&uindex, bkmer);
+      TASSERT(ukm != NULL);
+      if(ukm == NULL) continue;
+
+      TASSERT(binary_kmers_are_equal(ukm->bkey, bkey));
+      TASSERT(ukm->unitig < uindex.num_unitigs);
+      TASSERT(ukm->offset < unitig_index_nkmers(&uindex, ukm->unitig));
+
+      // Kmer in unitig read forward
+      strbuf_reset(&sbuf);
+      unitig_index_seq(&uindex, ukm->unitig, FORWARD, &sbuf);
+      ukmer = binary_kmer_from_str(sbuf.b + ukm->offset, kmer_size);
+
+      orient = binary_kmers_are_equal(bkmer, bkey) ? ukm->orient : !ukm->orient;
+      if(orient == REVERSE)
+        bkmer = binary_kmer_reverse_complement(bkmer, kmer_size);
+      TASSERT(binary_kmers_are_equal(ukmer, bkmer));
+    }
+  }
+
+  // Kmer not in the graph
+  bkmer = binary_kmer_from_str("GGGGGGGGGGGGGGGGGGGGGGGGGGGGGGG", kmer_size);
+  TASSERT(unitig_index_find(&uindex, bkmer) == NULL);
+
+  strbuf_dealloc(&sbuf);
+  unitig_index_close(&uindex);
+  unitig_graph_dealloc(&ugraph);
+  ctx_free(visited);
+}
+
 void test_supernode()
 {
   test_status("testing supernode_find()...");
@@ -114,5 +173,8 @@ void test_supernode()
 
   pull_out_supernodes(seq, ans, NSEQ, &graph);
 
+  test_status("testing unitig_index_find()...");
+  test_unitig_index_find(seq, NSEQ, &graph);
+
   db_graph_dealloc(&graph);
 }
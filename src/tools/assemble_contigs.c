@@ -77,7 +77,7 @@ static void _assemble_contig(Assembler *assem, hkey_t hkey, const GPath *gpath,
   }
 
   GraphStep step;
-  size_t dir, init_len = nbuf->len;
+  size_t dir, njump, init_len = nbuf->len;
 
   for(dir = 0; dir < 2; dir++)
   {
@@ -117,6 +117,13 @@ static void _assemble_contig(Assembler *assem, hkey_t hkey, const GPath *gpath,
       }
 
       if(!rpt_walker_attempt_traverse(rptwlk, wlk)) { hit_cycle = true; break; }
+
+      // Skip to the end of a non-branching stretch in one go
+      njump = graph_walker_jump_unitig(wlk, rptwlk->visited, nbuf);
+      if(njump > 0) {
+        s.wlk_steps[wlk->last_step.status] += njump;
+        if(!rpt_walker_attempt_traverse(rptwlk, wlk)) { hit_cycle = true; break; }
+      }
     }
 
     // Grab some stats
@@ -281,9 +288,9 @@ static int _assemble_from_paths(hkey_t hkey, Assembler *assem)
 
   gpath_set_reset(gpset);
 
-  for(; gpath != NULL; gpath = gpath->next)
+  for(; gpath != NULL; gpath = gpath_next(gpath))
   {
-    pathid = gpset_get_pkey(&gpstore->gpset, gpath);
+    pathid = gpset_get_pathid(&gpstore->gpset, gpath);
 
     if(gpath_has_colour(gpath, ncols, colour) && !bitset_get(used_paths, pathid))
     {
@@ -373,8 +380,11 @@ void assemble_contigs(size_t nthreads,
   else
     status("[Assemble]   Writing contigs to %s", futil_outpath_str(out_path));
 
+  // Paths are marked used by their path id, see gpset_get_pathid()
+  const GPathSet *gpset = &db_graph->gpstore.gpset;
   size_t npaths = db_graph->gpstore.num_paths;
-  size_t npathwords = (npaths+sizeof(size_t)*8-1)/(sizeof(size_t)*8);
+  size_t npathids = gpath_set_num_pathids(gpset);
+  size_t npathwords = (npathids+sizeof(size_t)*8-1)/(sizeof(size_t)*8);
   size_t *used_paths = NULL;
   if(seed_with_unused_paths) used_paths = ctx_calloc(npathwords, sizeof(size_t));
 
@@ -384,6 +394,12 @@ void assemble_contigs(size_t nthreads,
   pthread_mutex_t outlock;
   if(pthread_mutex_init(&outlock, NULL) != 0) die("Mutex init failed");
 
+  // Decisions at forks are shared between threads. Only forks where we are
+  // following links are cached, so only needed if we have links
+  GraphWalkerCache wlk_cache;
+  bool use_cache = (npaths > 0);
+  if(use_cache) graph_walker_cache_alloc(&wlk_cache, GRAPH_WALKER_CACHE_BITS);
+
   for(i = 0; i < nthreads; i++) {
     Assembler tmp = {.nthreads = nthreads,
                      .num_contig_ptr = &num_contigs,
@@ -402,6 +418,7 @@ void assemble_contigs(size_t nthreads,
     graph_walker_alloc(&tmp.wlk, db_graph);
     graph_walker_setup(&tmp.wlk, use_missing_info_check, colour, colour, db_graph);
     tmp.used_paths = tmp.wlk.used_paths = used_paths;
+    tmp.wlk.cache = use_cache ? &wlk_cache : NULL;
 
     rpt_walker_alloc(&tmp.rptwlk, db_graph->ht.capacity, 22); // 4MB
     assemble_contigs_stats_init(&tmp.stats);
@@ -436,10 +453,12 @@ void assemble_contigs(size_t nthreads,
     if(seed_with_unused_paths && npaths > 0)
     {
       // Check if there are unused paths
-      size_t top_bits = npaths - (npaths / (sizeof(size_t)*8)) * (sizeof(size_t)*8);
-      for(i = 0; i+1 < npathwords && used_paths[i] != SIZE_MAX; i++) {}
+      const GPath *gpath;
+      for(gpath = gpath_set_first(gpset);
+          gpath != NULL && bitset_get(used_paths, gpset_get_pathid(gpset, gpath));
+          gpath = gpath_set_next_entry(gpset, gpath)) {}
 
-      if(i+1 < npathwords || used_paths[npathwords-1] < bitmask64(top_bits)) {
+      if(gpath != NULL) {
         status("[Assemble] Seeding with unused paths...");
         util_run_threads(workers, nthreads, sizeof(workers[0]),
                          nthreads, assemble_from_paths);
@@ -451,12 +470,15 @@ void assemble_contigs(size_t nthreads,
 
   for(i = 0; i < nthreads; i++) {
     db_node_buf_dealloc(&workers[i].nbuf);
+    workers[i].stats.num_cache_lookups = workers[i].wlk.cache_lookups;
+    workers[i].stats.num_cache_hits = workers[i].wlk.cache_hits;
     graph_walker_dealloc(&workers[i].wlk);
     rpt_walker_dealloc(&workers[i].rptwlk);
     assemble_contigs_stats_merge(stats, &workers[i].stats);
     assemble_contigs_stats_destroy(&workers[i].stats);
   }
 
+  if(use_cache) graph_walker_cache_dealloc(&wlk_cache);
   pthread_mutex_destroy(&outlock);
   ctx_free(workers);
   ctx_free(used_paths);
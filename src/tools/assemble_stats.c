@@ -144,6 +144,9 @@ void assemble_contigs_stats_merge(AssembleContigStats *dst,
 
   dst->num_reseed_abort    += src->num_reseed_abort;
   dst->num_seeds_not_found += src->num_seeds_not_found;
+
+  dst->num_cache_lookups += src->num_cache_lookups;
+  dst->num_cache_hits    += src->num_cache_hits;
 }
 
 #define PREFIX "[Assembled] "
@@ -303,4 +306,9 @@ void assemble_contigs_stats_print(const AssembleContigStats *s)
 
   status(PREFIX"Junctions:");
   _print_grphwlk_state("Paths resolved", states[GRPHWLK_USEPATH], njunc);
+
+  if(s->num_cache_lookups) {
+    status(PREFIX"Junction decision cache:");
+    _print_grphwlk_state("Cache hits", s->num_cache_hits, s->num_cache_lookups);
+  }
 }
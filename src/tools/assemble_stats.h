@@ -53,6 +53,7 @@ typedef struct
   uint64_t num_contigs_from_seed_paths;
   uint64_t num_reseed_abort; // aborted - already visited seed
   uint64_t num_seeds_not_found; // seed contig didn't have any matching kmers
+  uint64_t num_cache_lookups, num_cache_hits; // junction decision cache
 } AssembleContigStats;
 
 // Results from a single contig
@@ -616,7 +616,7 @@ void breakpoints_call(size_t nthreads, size_t ref_col,
                       gzFile gzout, const char *out_path,
                       const read_t *reads, size_t num_reads,
                       char **seq_paths, size_t num_seq_paths,
-                      bool load_ref_edges,
+                      bool load_ref_edges, const char *ref_index_path,
                       size_t min_ref_nkmers, size_t max_ref_nkmers,
                       cJSON **hdrs, size_t nhdrs,
                       dBGraph *db_graph)
@@ -626,8 +626,18 @@ void breakpoints_call(size_t nthreads, size_t ref_col,
   Edges *tmp_edges = db_graph->col_edges;
   if(!load_ref_edges) db_graph->col_edges = NULL;
 
-  KOGraph kograph = kograph_create(reads, num_reads, true, ref_col,
-                                   nthreads, db_graph);
+  KOGraph kograph;
+
+  if(ref_index_path == NULL) {
+    kograph = kograph_create(reads, num_reads, true, ref_col, nthreads, db_graph);
+  } else {
+    uint64_t checksum = kograph_checksum(reads, num_reads);
+    if(!kograph_load(&kograph, ref_index_path, checksum, ref_col,
+                     nthreads, db_graph)) {
+      kograph = kograph_create_save(reads, num_reads, ref_col, nthreads,
+                                    checksum, ref_index_path, db_graph);
+    }
+  }
 
   // Restore graph edges
   db_graph->col_edges = tmp_edges;
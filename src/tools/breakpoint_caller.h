@@ -34,7 +34,7 @@ void breakpoints_call(size_t nthreads, size_t ref_col,
                       gzFile gzout, const char *out_path,
                       const read_t *reads, size_t num_reads,
                       char **seq_paths, size_t num_seq_paths,
-                      bool load_ref_edges,
+                      bool load_ref_edges, const char *ref_index_path,
                       size_t min_ref_flank, size_t max_ref_flank,
                       cJSON **hdrs, size_t nhdrs,
                       dBGraph *db_graph);
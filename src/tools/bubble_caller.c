@@ -248,10 +248,29 @@ static void print_bubble(BubbleCaller *caller,
   pthread_mutex_unlock(caller->out_lock);
 }
 
+static inline double _secs_since(const struct timeval *t0)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (now.tv_sec - t0->tv_sec) + (now.tv_usec - t0->tv_usec) / 1e6;
+}
+
+static inline bool _over_budget(const BubbleCaller *caller)
+{
+  const BubbleCallingPrefs *prefs = caller->prefs;
+  return (prefs->max_task_kmers &&
+          graph_cache_num_nodes(&caller->cache) > prefs->max_task_kmers) ||
+         (prefs->max_task_secs > 0 &&
+          _secs_since(&caller->task_start) > prefs->max_task_secs);
+}
+
 // `fork_node` is a node with outdegree > 1
-void find_bubbles(BubbleCaller *caller, dBNode fork_node)
+// Returns false if we went over the task budget in caller->prefs (and the
+// cache is incomplete), otherwise true
+bool find_bubbles(BubbleCaller *caller, dBNode fork_node, bool use_budget)
 {
   graph_cache_reset(&caller->cache);
+  gettimeofday(&caller->task_start, NULL);
 
   const dBGraph *db_graph = caller->db_graph;
   GraphCache *cache = &caller->cache;
@@ -302,6 +321,8 @@ void find_bubbles(BubbleCaller *caller, dBNode fork_node)
 
         graph_walker_finish(wlk);
         graph_crawler_reset_rpt_walker(rptwlk, cache, pathid);
+
+        if(use_budget && _over_budget(caller)) return false;
       }
     }
   }
@@ -309,6 +330,8 @@ void find_bubbles(BubbleCaller *caller, dBNode fork_node)
   // Set up 5p flank
   caller->flank5p.b[0] = db_node_reverse(fork_node);
   caller->flank5p.len = 0; // set to one to signify we haven't fetched flank yet
+
+  return true;
 }
 
 static bool paths_all_share_unitig(const GraphCache *cache,
@@ -470,27 +493,142 @@ static void write_bubbles_to_file(BubbleCaller *caller)
   }
 }
 
-static inline int bubble_caller_node(hkey_t hkey, BubbleCaller *caller)
+//
+// Scheduling: threads claim small blocks of the hash table from a shared
+// counter. Forks that take more than the task budget are deferred; once every
+// block is done, deferred forks are handed out one at a time with no budget.
+// A few hard regions (repeats, centromeres) then run in parallel at the end
+// rather than holding up whichever thread found them.
+//
+
+#define BUBBLE_BLOCK_SIZE 4096
+
+struct BubbleSchedulerStruct
 {
-  Edges edges = db_node_get_edges(caller->db_graph, hkey, 0);
-  if(edges_get_outdegree(edges, FORWARD) > 1) {
-    find_bubbles(caller, (dBNode){.key = hkey, .orient = FORWARD});
-    write_bubbles_to_file(caller);
-  }
-  if(edges_get_outdegree(edges, REVERSE) > 1) {
-    find_bubbles(caller, (dBNode){.key = hkey, .orient = REVERSE});
-    write_bubbles_to_file(caller);
+  volatile size_t next_block, next_deferred;
+  dBNodeBuffer deferred;
+  pthread_mutex_t lock; // lock for adding to deferred
+};
+
+// Keep the slowest tasks, slowest first
+static void _task_stats_add(BubbleTaskStats *stats, BubbleTask task)
+{
+  size_t i;
+  stats->ntasks++;
+  stats->secs += task.secs;
+  stats->max_secs = MAX2(stats->max_secs, task.secs);
+
+  if(stats->nslowest == BUBBLE_NUM_SLOW_TASKS &&
+     task.secs <= stats->slowest[BUBBLE_NUM_SLOW_TASKS-1].secs) return;
+
+  i = MIN2(stats->nslowest, BUBBLE_NUM_SLOW_TASKS-1);
+  for(; i > 0 && stats->slowest[i-1].secs < task.secs; i--)
+    stats->slowest[i] = stats->slowest[i-1];
+
+  stats->slowest[i] = task;
+  stats->nslowest = MIN2(stats->nslowest+1, BUBBLE_NUM_SLOW_TASKS);
+}
+
+// Returns false if task was deferred
+static bool bubble_caller_task(BubbleCaller *caller, dBNode node,
+                               bool use_budget)
+{
+  BubbleScheduler *sched = caller->sched;
+
+  if(!find_bubbles(caller, node, use_budget)) {
+    pthread_mutex_lock(&sched->lock);
+    db_node_buf_add(&sched->deferred, node);
+    pthread_mutex_unlock(&sched->lock);
+    caller->task_stats.ndeferred++;
+    return false;
   }
 
-  return 0; // => keep iterating
+  write_bubbles_to_file(caller);
+
+  BubbleTask task = {.node = node,
+                     .nkmers = graph_cache_num_nodes(&caller->cache),
+                     .secs = _secs_since(&caller->task_start)};
+
+  _task_stats_add(&caller->task_stats, task);
+  return true;
+}
+
+static inline void bubble_caller_node(hkey_t hkey, BubbleCaller *caller)
+{
+  Edges edges = db_node_get_edges(caller->db_graph, hkey, 0);
+  if(edges_get_outdegree(edges, FORWARD) > 1)
+    bubble_caller_task(caller, (dBNode){.key = hkey, .orient = FORWARD}, true);
+  if(edges_get_outdegree(edges, REVERSE) > 1)
+    bubble_caller_task(caller, (dBNode){.key = hkey, .orient = REVERSE}, true);
 }
 
 void bubble_caller(void *args, size_t threadid)
 {
+  (void)threadid;
+  BubbleCaller *caller = (BubbleCaller*)args;
+  BubbleScheduler *sched = caller->sched;
+  const HashTable *ht = &caller->db_graph->ht;
+  size_t blk, h, end;
+
+  while((blk = __sync_fetch_and_add(&sched->next_block, 1)) *
+        BUBBLE_BLOCK_SIZE < ht->capacity)
+  {
+    h = blk * BUBBLE_BLOCK_SIZE;
+    end = MIN2(h + BUBBLE_BLOCK_SIZE, ht->capacity);
+    for(; h < end; h++)
+      if(HASH_ENTRY_ASSIGNED(ht->table[h]))
+        bubble_caller_node(h, caller);
+  }
+}
+
+// Call deferred forks without a budget, one fork at a time
+static void bubble_caller_deferred(void *args, size_t threadid)
+{
+  (void)threadid;
   BubbleCaller *caller = (BubbleCaller*)args;
+  BubbleScheduler *sched = caller->sched;
+  size_t i;
 
-  HASH_ITERATE_PART(&caller->db_graph->ht, threadid, caller->nthreads,
-                    bubble_caller_node, caller);
+  while((i = __sync_fetch_and_add(&sched->next_deferred, 1)) < sched->deferred.len)
+    bubble_caller_task(caller, sched->deferred.b[i], false);
+}
+
+static void bubble_caller_print_task_stats(const BubbleCaller *callers,
+                                           size_t ncallers,
+                                           const dBGraph *db_graph)
+{
+  BubbleTaskStats stats;
+  size_t i, j;
+  memset(&stats, 0, sizeof(stats));
+
+  for(i = 0; i < ncallers; i++) {
+    const BubbleTaskStats *s = &callers[i].task_stats;
+    stats.ndeferred += s->ndeferred;
+    stats.ntasks += s->ntasks - s->nslowest; // re-added below
+    stats.secs += s->secs;
+    for(j = 0; j < s->nslowest; j++) {
+      _task_stats_add(&stats, s->slowest[j]);
+      stats.secs -= s->slowest[j].secs;
+    }
+  }
+
+  if(stats.ntasks == 0) return;
+
+  char ntasks_str[50], ndefer_str[50], nkmers_str[50];
+  char kmer_str[MAX_KMER_SIZE+3];
+
+  status("[bubbles] %s forks in %.2f thread-secs (mean %.2g secs, max %.2f secs)",
+         ulong_to_str(stats.ntasks, ntasks_str), stats.secs,
+         stats.secs / stats.ntasks, stats.max_secs);
+  status("[bubbles] %s forks went over budget and were deferred",
+         ulong_to_str(stats.ndeferred, ndefer_str));
+
+  for(i = 0; i < stats.nslowest; i++) {
+    db_node_to_str(db_graph, stats.slowest[i].node, kmer_str);
+    status("[bubbles]   slow fork %s: %.3f secs, %s kmers", kmer_str,
+           stats.slowest[i].secs,
+           ulong_to_str(stats.slowest[i].nkmers, nkmers_str));
+  }
 }
 
 void invoke_bubble_caller(size_t num_of_threads,
@@ -517,10 +655,29 @@ void invoke_bubble_caller(size_t num_of_threads,
   BubbleCaller *callers = bubble_callers_new(num_of_threads, prefs,
                                              gzout, db_graph);
 
+  BubbleScheduler sched;
+  memset(&sched, 0, sizeof(sched));
+  db_node_buf_alloc(&sched.deferred, 1024);
+  if(pthread_mutex_init(&sched.lock, NULL) != 0) die("mutex init failed");
+  for(i = 0; i < num_of_threads; i++) callers[i].sched = &sched;
+
   // Run
   util_run_threads(callers, num_of_threads, sizeof(callers[0]),
                    num_of_threads, bubble_caller);
 
+  if(sched.deferred.len > 0) {
+    char ndefer_str[50];
+    status("[bubbles] Calling %s deferred forks with no budget",
+           ulong_to_str(sched.deferred.len, ndefer_str));
+    util_run_threads(callers, num_of_threads, sizeof(callers[0]),
+                     num_of_threads, bubble_caller_deferred);
+  }
+
+  bubble_caller_print_task_stats(callers, num_of_threads, db_graph);
+
+  pthread_mutex_destroy(&sched.lock);
+  db_node_buf_dealloc(&sched.deferred);
+
   // Report number of bubble called+printed
   uint64_t nhaploid = 0, nserial = 0, nbubbles = callers[0].nbubbles_ptr[0];
 
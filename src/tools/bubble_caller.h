@@ -7,6 +7,8 @@
 #include "repeat_walker.h"
 #include "cmd.h"
 
+#include <sys/time.h> // struct timeval
+
 #include "cJSON/cJSON.h"
 
 #include "htslib/khash.h"
@@ -23,8 +25,33 @@ typedef struct
   const size_t *haploid_cols;
   size_t nhaploid_cols;
   bool remove_serial_bubbles;
+  // Budget for exploring from one fork node. Forks that go over are deferred
+  // and called without limits once all other forks are done. 0 => no limit
+  size_t max_task_kmers;
+  double max_task_secs;
 } BubbleCallingPrefs;
 
+// Timing of calling bubbles from one fork node
+typedef struct
+{
+  dBNode node;
+  size_t nkmers; // kmers in the graph cache
+  double secs;
+} BubbleTask;
+
+#define BUBBLE_NUM_SLOW_TASKS 10
+
+typedef struct
+{
+  size_t ntasks, ndeferred;
+  double secs, max_secs;
+  // Slowest tasks, slowest first
+  BubbleTask slowest[BUBBLE_NUM_SLOW_TASKS];
+  size_t nslowest;
+} BubbleTaskStats;
+
+typedef struct BubbleSchedulerStruct BubbleScheduler;
+
 #include "madcrowlib/madcrow_buffer.h"
 madcrow_buffer(cache_stepptr_buf, GCacheStepPtrBuf, GCacheStep*);
 
@@ -47,6 +74,8 @@ typedef struct
   StrBuf output_buf;
   uint64_t num_haploid_bubbles; // number of dropped bubbles in haploid sample
   uint64_t num_serial_bubbles; // how many bubbles were dropped for 'serial'
+  BubbleTaskStats task_stats;
+  struct timeval task_start;
 
   // Shared data
   uint64_t *nbubbles_ptr; // statistics - shared pointer
@@ -54,6 +83,7 @@ typedef struct
   const dBGraph *db_graph;
   gzFile gzout;
   pthread_mutex_t *const out_lock;
+  BubbleScheduler *sched; // set by invoke_bubble_caller()
 } BubbleCaller;
 
 BubbleCaller* bubble_callers_new(size_t num_callers,
@@ -64,7 +94,9 @@ BubbleCaller* bubble_callers_new(size_t num_callers,
 void bubble_callers_destroy(BubbleCaller *callers, size_t num_callers);
 
 // `fork_node` is a node with outdegree > 1
-void find_bubbles(BubbleCaller *caller, dBNode fork_node);
+// Returns false if we went over the task budget in caller->prefs (and the
+// cache is incomplete), otherwise true
+bool find_bubbles(BubbleCaller *caller, dBNode fork_node, bool use_budget);
 
 // Load GCacheSteps into caller->spp_forward (if they traverse the unitig forward)
 // or caller->spp_reverse (if they traverse the unitig in reverse)
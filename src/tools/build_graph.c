@@ -7,6 +7,7 @@
 #include "seq_loading_stats.h"
 #include "util.h"
 #include "file_util.h"
+#include "hash.h"
 
 #include <pthread.h>
 #include "seq_file/seq_file.h"
@@ -15,8 +16,9 @@
 #define BUILD_GRAPH_COUNTER_STEP 100
 
 typedef struct {
-  dBGraph *db_graph;
-  SeqLoadingStats *stats; // [files]
+  dBGraph *graphs;
+  size_t ngraphs, nfiles;
+  SeqLoadingStats *stats; // [graph*nfiles + file]
   size_t nreads;
   volatile size_t *shared_nreads;
 } BuildGraphThread;
@@ -31,10 +33,11 @@ typedef struct {
 #define db_node_set_read_start_mt(graph,node) \
         bitset_set_mt((graph)->readstrt, 2*(node).key+(node).orient)
 
+// Reads must already be oriented with seq_reader_orient_mp_FF()
 // Returns true if start1, start2 set and reads should be added
 static bool seq_reads_are_novel(read_t *r1, read_t *r2,
                                 uint8_t fq_cutoff1, uint8_t fq_cutoff2,
-                                uint8_t hp_cutoff, ReadMateDir matedir,
+                                uint8_t hp_cutoff,
                                 SeqLoadingStats *stats, dBGraph *db_graph)
 {
   // Remove SAM/BAM duplicates
@@ -43,8 +46,6 @@ static bool seq_reads_are_novel(read_t *r1, read_t *r2,
     return false;
   }
 
-  seq_reader_orient_mp_FF(r1, r2, matedir);
-
   const size_t kmer_size = db_graph->kmer_size;
   size_t start1, start2 = 0;
   bool got_kmer1 = false, got_kmer2 = false;
@@ -91,6 +92,48 @@ static bool seq_reads_are_novel(read_t *r1, read_t *r2,
   return true;
 }
 
+// Same as above using a DupFilter keyed on a hash of the oriented start kmers
+// of the read (pair) instead of the readstrt bitset
+static bool seq_reads_are_novel_fltr(read_t *r1, read_t *r2,
+                                     uint8_t fq_cutoff1, uint8_t fq_cutoff2,
+                                     uint8_t hp_cutoff, size_t kmer_size,
+                                     DupFilter *fltr)
+{
+  // Remove SAM/BAM duplicates
+  if(r1->from_sam && seq_read_bam(r1)->core.flag & BAM_FDUP &&
+     (r2 == NULL || (r2->from_sam && seq_read_bam(r2)->core.flag & BAM_FDUP))) {
+    return false;
+  }
+
+  size_t start1, start2;
+  bool got_kmer1, got_kmer2 = false;
+  BinaryKmer bkmer1, bkmer2;
+  uint64_t hash = r2 ? 1 : 0; // don't let SE reads match PE
+
+  start1 = seq_contig_start(r1, 0, kmer_size, fq_cutoff1, hp_cutoff);
+  got_kmer1 = (start1 < r1->seq.end);
+
+  if(r2) {
+    start2 = seq_contig_start(r2, 0, kmer_size, fq_cutoff2, hp_cutoff);
+    got_kmer2 = (start2 < r2->seq.end);
+  }
+
+  // No kmers -> nothing to add
+  if(!got_kmer1 && !got_kmer2) return false;
+
+  // Reads are oriented, so hash the oriented kmers not the kmer keys
+  if(got_kmer1) {
+    bkmer1 = binary_kmer_from_str(r1->seq.b + start1, kmer_size);
+    hash = ctx_hash64(bkmer1.b, sizeof(BinaryKmer), hash ^ 0x1);
+  }
+  if(got_kmer2) {
+    bkmer2 = binary_kmer_from_str(r2->seq.b + start2, kmer_size);
+    hash = ctx_hash64(bkmer2.b, sizeof(BinaryKmer), hash ^ 0x2);
+  }
+
+  return !dup_filter_add_mt(fltr, hash);
+}
+
 
 //
 // Add to the de bruijn graph
@@ -189,7 +232,23 @@ static void load_read(const read_t *r, uint8_t qual_cutoff, uint8_t hp_cutoff,
 }
 
 // Stats must be private to this thread
-void build_graph_from_reads_mt(read_t *r1, read_t *r2,
+static void count_reads(const read_t *r1, const read_t *r2,
+                        SeqLoadingStats *stats, bool is_dup)
+{
+  stats->total_bases_read += r1->seq.end + (r2 ? r2->seq.end : 0);
+
+  if(r2) stats->num_pe_reads += 2;
+  else   stats->num_se_reads += 1;
+
+  if(is_dup) {
+    if(r2) stats->num_dup_pe_pairs++;
+    else   stats->num_dup_se_reads++;
+  }
+}
+
+// Stats must be private to this thread
+// Returns false if reads were PCR duplicates and not loaded
+bool build_graph_from_reads_mt(read_t *r1, read_t *r2,
                                uint8_t fq_offset1, uint8_t fq_offset2,
                                const SeqLoadingPrefs *prefs,
                                SeqLoadingStats *stats,
@@ -206,28 +265,35 @@ void build_graph_from_reads_mt(read_t *r1, read_t *r2,
     fq_cutoff2 += fq_offset2;
   }
 
-  size_t total_bases = r1->seq.end + (r2 ? r2->seq.end : 0);
-  stats->total_bases_read += total_bases;
-
-  if(r2) stats->num_pe_reads += 2;
-  else   stats->num_se_reads += 1;
-
   // printf(">%s %zu\n", r1->name.b, colour);
 
-  if(prefs->remove_pcr_dups && !seq_reads_are_novel(r1, r2,
-                                                   fq_cutoff1, fq_cutoff2,
-                                                   prefs->hp_cutoff, prefs->matedir,
-                                                   stats, db_graph))
-  {
-    if(r2) stats->num_dup_pe_pairs++;
-    else   stats->num_dup_se_reads++;
+  bool is_novel = true;
+
+  if(prefs->remove_pcr_dups) {
+    // Orient reads for duplicate detection then restore them, so the same
+    // reads can be passed to more than one graph. Loading is strand agnostic.
+    seq_reader_orient_mp_FF(r1, r2, prefs->matedir);
+    if(prefs->dup_filter != NULL) {
+      is_novel = seq_reads_are_novel_fltr(r1, r2, fq_cutoff1, fq_cutoff2,
+                                          prefs->hp_cutoff, db_graph->kmer_size,
+                                          prefs->dup_filter);
+    } else {
+      is_novel = seq_reads_are_novel(r1, r2, fq_cutoff1, fq_cutoff2,
+                                     prefs->hp_cutoff, stats, db_graph);
+    }
+    seq_reader_orient_mp_FF(r1, r2, prefs->matedir);
   }
-  else {
+
+  count_reads(r1, r2, stats, !is_novel);
+
+  if(is_novel) {
     load_read(r1, fq_cutoff1, prefs->hp_cutoff, prefs->must_exist_in_graph,
               prefs->colour, stats, db_graph);
     if(r2) load_read(r2, fq_cutoff2, prefs->hp_cutoff, prefs->must_exist_in_graph,
                      prefs->colour, stats, db_graph);
   }
+
+  return is_novel;
 }
 
 static void add_reads_to_graph(AsyncIOData *data, size_t threadid, void *ptr)
@@ -236,11 +302,30 @@ static void add_reads_to_graph(AsyncIOData *data, size_t threadid, void *ptr)
   BuildGraphThread *wrkr = (BuildGraphThread*)ptr;
   const BuildGraphTask *task = (BuildGraphTask*)data->ptr;
   read_t *r2 = data->r2.name.end == 0 && data->r2.seq.end == 0 ? NULL : &data->r2;
-
-  build_graph_from_reads_mt(&data->r1, r2,
-                            data->fq_offset1, data->fq_offset2,
-                            &task->prefs, wrkr->stats,
-                            wrkr->db_graph);
+  size_t g;
+  bool is_novel;
+
+  // Reads are parsed once and added to each graph
+  is_novel = build_graph_from_reads_mt(&data->r1, r2,
+                                       data->fq_offset1, data->fq_offset2,
+                                       &task->prefs, &wrkr->stats[task->idx],
+                                       &wrkr->graphs[0]);
+
+  // A DupFilter is shared by all graphs, so only test reads against it once
+  SeqLoadingPrefs prefs = task->prefs;
+  if(prefs.dup_filter != NULL) prefs.remove_pcr_dups = false;
+
+  for(g = 1; g < wrkr->ngraphs; g++) {
+    if(!is_novel && prefs.dup_filter != NULL) {
+      count_reads(&data->r1, r2, &wrkr->stats[g*wrkr->nfiles + task->idx], true);
+    } else {
+      build_graph_from_reads_mt(&data->r1, r2,
+                                data->fq_offset1, data->fq_offset2,
+                                &prefs,
+                                &wrkr->stats[g*wrkr->nfiles + task->idx],
+                                &wrkr->graphs[g]);
+    }
+  }
 
   // Print progress
   wrkr->nreads++;
@@ -253,15 +338,21 @@ static void add_reads_to_graph(AsyncIOData *data, size_t threadid, void *ptr)
   }
 }
 
-// One thread used per input file, nthreads used to add reads to graph
-void build_graph(dBGraph *db_graph, BuildGraphTask *files,
-                 size_t nfiles, size_t nthreads)
+// One thread used per input file, nthreads used to add reads to graphs
+// Reads are parsed once and added to each of the `ngraphs` graphs
+// Updates ginfo of each graph, task stats are those of the first graph
+// If `graph_stats` is not NULL, stats for each graph summed over all tasks
+// are added to graph_stats[0..ngraphs-1]
+void build_graphs(dBGraph *graphs, size_t ngraphs,
+                  BuildGraphTask *files, size_t nfiles,
+                  size_t nthreads, SeqLoadingStats *graph_stats)
 {
-  ctx_assert(db_graph->bktlocks != NULL);
+  size_t i, f, g;
+  ctx_assert(ngraphs > 0);
+  for(g = 0; g < ngraphs; g++) ctx_assert(graphs[g].bktlocks != NULL);
 
   // Start async io reading
   AsyncIOInput *async_tasks = ctx_malloc(nfiles * sizeof(AsyncIOInput));
-  size_t i, f;
 
   for(f = 0; f < nfiles; f++) {
     files[f].idx = f;
@@ -270,11 +361,14 @@ void build_graph(dBGraph *db_graph, BuildGraphTask *files,
   }
 
   BuildGraphThread *threads = ctx_calloc(nthreads, sizeof(BuildGraphThread));
+  SeqLoadingStats *stats = ctx_calloc(ngraphs*nfiles, sizeof(SeqLoadingStats));
   size_t total_nreads = 0;
 
   for(i = 0; i < nthreads; i++) {
-    threads[i].stats = ctx_calloc(nfiles, sizeof(SeqLoadingStats));
-    threads[i].db_graph = db_graph;
+    threads[i].stats = ctx_calloc(ngraphs*nfiles, sizeof(SeqLoadingStats));
+    threads[i].graphs = graphs;
+    threads[i].ngraphs = ngraphs;
+    threads[i].nfiles = nfiles;
     threads[i].shared_nreads = &total_nreads;
   }
 
@@ -283,21 +377,37 @@ void build_graph(dBGraph *db_graph, BuildGraphTask *files,
 
   // Merge stats
   for(i = 0; i < nthreads; i++) {
-    for(f = 0; f < nfiles; f++)
-      seq_loading_stats_merge(&files[f].stats, &threads[i].stats[f]);
+    for(f = 0; f < ngraphs*nfiles; f++)
+      seq_loading_stats_merge(&stats[f], &threads[i].stats[f]);
     ctx_free(threads[i].stats);
   }
   ctx_free(threads);
   ctx_free(async_tasks);
 
+  for(f = 0; f < nfiles; f++)
+    seq_loading_stats_merge(&files[f].stats, &stats[f]);
+
   // Copy stats into ginfo
   size_t max_col = 0;
-  for(f = 0; f < nfiles; f++) {
-    max_col = MAX2(max_col, files[f].prefs.colour);
-    graph_info_update_stats(&db_graph->ginfo[files[f].prefs.colour], &files[f].stats);
+  for(g = 0; g < ngraphs; g++) {
+    for(f = 0; f < nfiles; f++) {
+      max_col = MAX2(max_col, files[f].prefs.colour);
+      graph_info_update_stats(&graphs[g].ginfo[files[f].prefs.colour],
+                              &stats[g*nfiles + f]);
+      if(graph_stats != NULL)
+        seq_loading_stats_merge(&graph_stats[g], &stats[g*nfiles + f]);
+    }
+    graphs[g].num_of_cols_used = MAX2(graphs[g].num_of_cols_used, max_col+1);
   }
 
-  db_graph->num_of_cols_used = MAX2(db_graph->num_of_cols_used, max_col+1);
+  ctx_free(stats);
+}
+
+// One thread used per input file, nthreads used to add reads to graph
+void build_graph(dBGraph *db_graph, BuildGraphTask *files,
+                 size_t nfiles, size_t nthreads)
+{
+  build_graphs(db_graph, 1, files, nfiles, nthreads, NULL);
 }
 
 // One thread used per input file, nthreads used to add reads to graph
@@ -14,6 +14,7 @@
 #include "seq_reader.h"
 #include "async_read_io.h"
 #include "seq_loading_stats.h"
+#include "dup_filter.h"
 
 typedef struct
 {
@@ -21,6 +22,8 @@ typedef struct
   ReadMateDir matedir;
   Colour colour;
   bool remove_pcr_dups, must_exist_in_graph;
+  // If not NULL, used for remove_pcr_dups instead of the graph's readstrt
+  DupFilter *dup_filter;
 } SeqLoadingPrefs;
 
 typedef struct
@@ -39,7 +42,8 @@ typedef struct
                                                  .hp_cutoff = 0, \
                                                  .matedir = READPAIR_FR, \
                                                  .colour = 0, \
-                                                 .remove_pcr_dups = false}
+                                                 .remove_pcr_dups = false, \
+                                                 .dup_filter = NULL}
 
 #include "madcrowlib/madcrow_buffer.h"
 madcrow_buffer(build_graph_task_buf, BuildGraphTaskBuffer, BuildGraphTask);
@@ -54,7 +58,8 @@ void build_graph_task_print_stats(const BuildGraphTask *task);
 
 // Threadsafe graph construction
 // Beware: this function does not update ginfo
-void build_graph_from_reads_mt(read_t *r1, read_t *r2,
+// Returns false if reads were PCR duplicates and not loaded
+bool build_graph_from_reads_mt(read_t *r1, read_t *r2,
                                uint8_t fq_offset1, uint8_t fq_offset2,
                                const SeqLoadingPrefs *prefs,
                                SeqLoadingStats *stats,
@@ -65,6 +70,15 @@ void build_graph_from_reads_mt(read_t *r1, read_t *r2,
 void build_graph(dBGraph *db_graph, BuildGraphTask *files,
                  size_t num_files, size_t num_build_threads);
 
+// Build several graphs (e.g. with different kmer sizes) from one pass over
+// the input. Reads are parsed once and added to each graph.
+// Updates ginfo of each graph, task stats are those of the first graph
+// If `graph_stats` is not NULL, stats for each graph summed over all tasks
+// are added to graph_stats[0..ngraphs-1]
+void build_graphs(dBGraph *graphs, size_t ngraphs,
+                  BuildGraphTask *files, size_t num_files,
+                  size_t num_build_threads, SeqLoadingStats *graph_stats);
+
 // One thread used per input file, num_build_threads used to add reads to graph
 // Updates ginfo
 void build_graph_from_seq(dBGraph *db_graph, seq_file_t **files,
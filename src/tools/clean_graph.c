@@ -3,6 +3,7 @@
 #include "file_util.h"
 #include "supernode.h"
 #include "prune_nodes.h"
+#include "graph_file_reader.h"
 #include "clean_graph.h"
 
 #include "carrays/carrays.h" // gca_median()
@@ -489,6 +490,153 @@ int cleaning_get_threshold(size_t num_threads,
   return threshold_est;
 }
 
+//
+// Estimate cleaning thresholds by streaming kmers from graph files
+//
+
+// Kmer records are a fixed size so we can split each file into ranges of kmers
+// and have each thread fseek to its own range
+#define STREAM_MIN_JOB_KMERS (1<<16)
+
+typedef struct
+{
+  const GraphFileReader *file;
+  size_t start, nkmers; // range of kmers in the file
+  bool flatten; // load all colours into colour 0
+  size_t ncols;
+  uint64_t *kmer_hists; // ncols x DUMP_COVG_ARRSIZE, shared between jobs
+} CovgHistJob;
+
+static void covg_hist_job(void *arg, size_t threadid)
+{
+  (void)threadid;
+  const CovgHistJob *job = (const CovgHistJob*)arg;
+  const GraphFileReader *src = job->file;
+  const char *path = file_filter_path(&src->fltr);
+  size_t i, col, covg, ncols = job->ncols;
+  size_t kmer_bytes = sizeof(BinaryKmer) +
+                      src->hdr.num_of_cols * (sizeof(Covg)+sizeof(Edges));
+
+  // Reader with its own file handle, header is shared read only
+  GraphFileReader rdr;
+  memset(&rdr, 0, sizeof(rdr));
+  memcpy(&rdr.hdr, &src->hdr, sizeof(rdr.hdr));
+  file_filter_copy(&rdr.fltr, &src->fltr);
+  if(job->flatten) file_filter_flatten(&rdr.fltr, 0);
+  rdr.fh = futil_fopen(path, "r");
+  strm_buf_alloc(&rdr.strm, ONE_MEGABYTE);
+
+  if(graph_file_fseek(&rdr, src->hdr_size + job->start*kmer_bytes, SEEK_SET) != 0)
+    die("fseek failed: %s [%s]", strerror(errno), path);
+
+  size_t intoncols = file_filter_into_ncols(&rdr.fltr);
+  ctx_assert(intoncols <= ncols);
+  BinaryKmer bkmer;
+  Covg covgs[intoncols];
+  Edges edges[intoncols];
+  uint64_t *hists = ctx_calloc(ncols * DUMP_COVG_ARRSIZE, sizeof(uint64_t));
+
+  for(i = 0; i < job->nkmers; i++) {
+    if(!graph_file_read_reset(&rdr, &bkmer, covgs, edges))
+      die("Unexpected end of file: %s", path);
+    for(col = 0; col < intoncols; col++) {
+      if(covgs[col] == 0) continue; // kmer not in this colour
+      covg = MIN2(covgs[col], DUMP_COVG_ARRSIZE-1);
+      hists[col*DUMP_COVG_ARRSIZE + covg]++;
+    }
+  }
+
+  for(i = 0; i < ncols * DUMP_COVG_ARRSIZE; i++)
+    if(hists[i]) __sync_fetch_and_add(&job->kmer_hists[i], hists[i]);
+
+  ctx_free(hists);
+  strm_buf_dealloc(&rdr.strm);
+  fclose(rdr.fh);
+  file_filter_close(&rdr.fltr);
+}
+
+// Uses the same kmer coverage histogram as cleaning_get_threshold(), built
+// from file ranges read in parallel instead of from the loaded graph
+size_t cleaning_estimate_thresholds(size_t num_threads,
+                                    const GraphFileReader *gfiles,
+                                    size_t num_gfiles,
+                                    bool flatten, size_t ncols,
+                                    int *thresholds)
+{
+  ctx_assert(num_threads > 0);
+  ctx_assert(!flatten || ncols == 1);
+
+  size_t i, j, col, njobs = 0, nkmers, job_kmers, total_kmers = 0, nfound = 0;
+  size_t *files_per_col = ctx_calloc(ncols, sizeof(size_t));
+
+  for(i = 0; i < num_gfiles; i++) {
+    if(file_filter_isstdin(&gfiles[i].fltr) || gfiles[i].num_of_kmers < 0)
+      die("Cannot stream graph without file size: %s",
+          file_filter_path(&gfiles[i].fltr));
+    if(flatten) files_per_col[0]++;
+    else {
+      ctx_assert(file_filter_into_ncols(&gfiles[i].fltr) <= ncols);
+      for(col = 0; col < ncols; col++)
+        files_per_col[col] += file_filter_iscolloaded(&gfiles[i].fltr, col);
+    }
+    nkmers = graph_file_nkmers(&gfiles[i]);
+    total_kmers += nkmers;
+    job_kmers = MAX2(nkmers / (num_threads*4), STREAM_MIN_JOB_KMERS);
+    njobs += (nkmers + job_kmers - 1) / job_kmers;
+  }
+
+  char nkmers_str[50];
+  ulong_to_str(total_kmers, nkmers_str);
+  status("[cleaning] Streaming %s kmers from %zu file%s with %zu threads...",
+         nkmers_str, num_gfiles, util_plural_str(num_gfiles), num_threads);
+
+  uint64_t *kmer_hists = ctx_calloc(ncols * DUMP_COVG_ARRSIZE, sizeof(uint64_t));
+  CovgHistJob *jobs = ctx_calloc(MAX2(njobs, 1), sizeof(CovgHistJob));
+
+  for(i = njobs = 0; i < num_gfiles; i++) {
+    nkmers = graph_file_nkmers(&gfiles[i]);
+    job_kmers = MAX2(nkmers / (num_threads*4), STREAM_MIN_JOB_KMERS);
+    for(j = 0; j < nkmers; j += job_kmers) {
+      jobs[njobs++] = (CovgHistJob){.file = &gfiles[i], .start = j,
+                                    .nkmers = MIN2(job_kmers, nkmers-j),
+                                    .flatten = flatten, .ncols = ncols,
+                                    .kmer_hists = kmer_hists};
+    }
+  }
+
+  if(njobs > 0)
+    util_run_threads(jobs, njobs, sizeof(CovgHistJob), num_threads, covg_hist_job);
+
+  double alpha = 0, beta = 0, false_pos = 0, false_neg = 0;
+
+  for(col = 0; col < ncols; col++)
+  {
+    if(files_per_col[col] > 1) {
+      warn("[cleaning] colour %zu is loaded from %zu files, coverage of shared "
+           "kmers is not summed", col, files_per_col[col]);
+    }
+    thresholds[col] = files_per_col[col] == 0 ? -1 :
+                      cleaning_pick_kmer_threshold(kmer_hists + col*DUMP_COVG_ARRSIZE,
+                                                   DUMP_COVG_ARRSIZE,
+                                                   &alpha, &beta,
+                                                   &false_pos, &false_neg);
+    if(thresholds[col] < 0)
+      status("[cleaning] colour %zu: cannot pick a cleaning threshold", col);
+    else {
+      status("[cleaning] colour %zu: alpha=%f, beta=%f FP=%f FN=%f "
+             "threshold: < %i", col, alpha, beta, false_pos, false_neg,
+             thresholds[col]);
+      nfound++;
+    }
+  }
+
+  ctx_free(jobs);
+  ctx_free(kmer_hists);
+  ctx_free(files_per_col);
+
+  return nfound;
+}
+
 /**
  * Mark a unitig to keep or delete. Update stats on decision.
  */
@@ -552,10 +700,11 @@ static inline void unitig_mark(dBNodeBuffer nbuf, size_t threadid, void *arg)
  *   `visited` will be 1 at each original kmer index
  *   `keep` will be 1 at each retained kmer index
  **/
-void clean_graph(size_t num_threads,
-                 size_t covg_threshold, size_t min_keep_tip,
-                 const char *covgs_csv_path, const char *lens_csv_path,
-                 uint8_t *visited, uint8_t *keep, dBGraph *db_graph)
+static void _clean_graph(size_t num_threads,
+                         size_t covg_threshold, size_t min_keep_tip,
+                         const char *covgs_csv_path, const char *lens_csv_path,
+                         uint8_t *visited, uint8_t *keep, uint8_t *lost_edges,
+                         dBGraph *db_graph)
 {
   ctx_assert(db_graph->num_of_cols == 1);
   ctx_assert(db_graph->num_edge_cols > 0);
@@ -606,7 +755,7 @@ void clean_graph(size_t num_threads,
          num_tip_snode_kmers_str, util_plural_str(cl.num_tip_and_low_snode_kmers));
 
   // Remove nodes not marked to keep
-  prune_nodes_lacking_flag(num_threads, keep, db_graph);
+  prune_nodes_lacking_flag_mark(num_threads, keep, lost_edges, db_graph);
 
   // Wipe memory
   memset(visited, 0, roundup_bits2bytes(db_graph->ht.capacity));
@@ -639,6 +788,282 @@ void clean_graph(size_t num_threads,
   unitig_cleaner_dealloc(&cl);
 }
 
+void clean_graph(size_t num_threads,
+                 size_t covg_threshold, size_t min_keep_tip,
+                 const char *covgs_csv_path, const char *lens_csv_path,
+                 uint8_t *visited, uint8_t *keep, dBGraph *db_graph)
+{
+  _clean_graph(num_threads, covg_threshold, min_keep_tip,
+               covgs_csv_path, lens_csv_path,
+               visited, keep, NULL, db_graph);
+}
+
+//
+// Iterative cleaning: only revisit unitigs next to removed kmers
+//
+
+madcrow_buffer(hkey_buf,HKeyBuffer,hkey_t);
+
+typedef struct
+{
+  const size_t nthreads, covg_threshold, min_keep_tip;
+  const HKeyBuffer *front; // kmers that lost an edge in the last round
+  uint8_t *visited, *rmvbits, *lost_edges;
+  dBNodeBuffer *nbufs, *rmvbufs; // one per thread
+  CovgBuffer *cbufs;
+  size_t num_tips, num_low_covg_snodes, num_tip_kmers, num_low_covg_snode_kmers;
+  dBGraph *db_graph;
+} FrontierCleaner;
+
+// Move set bits of `lost_edges` into `front` and clear them
+static void frontier_fetch(uint8_t *lost_edges, size_t nbits, HKeyBuffer *front)
+{
+  size_t i, b, nbytes = roundup_bits2bytes(nbits);
+  hkey_buf_reset(front);
+  for(i = 0; i < nbytes; i++) {
+    if(lost_edges[i]) {
+      for(b = 0; b < 8; b++)
+        if((lost_edges[i] >> b) & 1) hkey_buf_add(front, i*8+b);
+      lost_edges[i] = 0;
+    }
+  }
+}
+
+// Re-evaluate the unitig containing each frontier kmer
+static void frontier_mark(void *arg, size_t threadid)
+{
+  FrontierCleaner *fc = (FrontierCleaner*)arg;
+  const dBGraph *db_graph = fc->db_graph;
+  dBNodeBuffer *nbuf = &fc->nbufs[threadid];
+  CovgBuffer *cbuf = &fc->cbufs[threadid];
+  size_t i, j;
+  hkey_t hkey, node0;
+  bool got_lock, low_covg_snode, removable_tip;
+
+  for(i = threadid; i < fc->front->len; i += fc->nthreads)
+  {
+    hkey = fc->front->b[i];
+    if(bitset_get_mt(fc->visited, hkey)) continue;
+
+    db_node_buf_reset(nbuf);
+    supernode_find(hkey, nbuf, db_graph);
+
+    // Claim unitig by its lowest hkey, as in supernodes_iterate()
+    node0 = MIN2(nbuf->b[0].key, nbuf->b[nbuf->len-1].key);
+    bitlock_try_acquire(fc->visited, node0, &got_lock);
+    if(!got_lock) continue;
+
+    for(j = 0; j < nbuf->len; j++)
+      (void)bitset_set_mt(fc->visited, nbuf->b[j].key);
+
+    fetch_coverages(*nbuf, cbuf, db_graph);
+    low_covg_snode = (gca_median_uint32(cbuf->b, cbuf->len) < fc->covg_threshold);
+    removable_tip = nodes_are_removable_tip(*nbuf, fc->min_keep_tip, db_graph);
+
+    if(removable_tip) {
+      __sync_fetch_and_add((volatile size_t *)&fc->num_tips, 1);
+      __sync_fetch_and_add((volatile size_t *)&fc->num_tip_kmers, nbuf->len);
+    } else if(low_covg_snode) {
+      __sync_fetch_and_add((volatile size_t *)&fc->num_low_covg_snodes, 1);
+      __sync_fetch_and_add((volatile size_t *)&fc->num_low_covg_snode_kmers, nbuf->len);
+    }
+
+    if(low_covg_snode || removable_tip) {
+      for(j = 0; j < nbuf->len; j++)
+        (void)bitset_set_mt(fc->rmvbits, nbuf->b[j].key);
+      db_node_buf_push(&fc->rmvbufs[threadid], nbuf->b, nbuf->len);
+    }
+  }
+}
+
+// Remove edges from remaining nodes to removed nodes, add those remaining
+// nodes to the next frontier
+static void frontier_prune_edges(void *arg, size_t threadid)
+{
+  FrontierCleaner *fc = (FrontierCleaner*)arg;
+  dBGraph *db_graph = fc->db_graph;
+  const dBNodeBuffer *rmvbuf = &fc->rmvbufs[threadid];
+  size_t i, col;
+  hkey_t hkey;
+  BinaryKmer bkmer;
+  Edges edges, remove_edge_mask;
+  Orientation or;
+  Nucleotide nuc, lost_nuc;
+  dBNode next_node;
+
+  for(i = 0; i < rmvbuf->len; i++)
+  {
+    hkey = rmvbuf->b[i].key;
+    bkmer = db_node_get_bkmer(db_graph, hkey);
+    edges = db_node_get_edges_union(db_graph, hkey);
+
+    for(or = 0; or < 2; or++)
+    {
+      // See prune_connecting_edges() in prune_nodes.c
+      if(or == FORWARD) {
+        lost_nuc = binary_kmer_first_nuc(bkmer, db_graph->kmer_size);
+        lost_nuc = dna_nuc_complement(lost_nuc);
+      }
+      else lost_nuc = binary_kmer_last_nuc(bkmer);
+
+      for(nuc = 0; nuc < 4; nuc++)
+      {
+        if(!edges_has_edge(edges, nuc, or)) continue;
+        next_node = db_graph_next_node(db_graph, bkmer, nuc, or);
+        ctx_assert(next_node.key != HASH_NOT_FOUND);
+        if(bitset_get_mt(fc->rmvbits, next_node.key)) continue;
+
+        remove_edge_mask = nuc_orient_to_edge(lost_nuc,
+                                              rev_orient(next_node.orient));
+        for(col = 0; col < db_graph->num_edge_cols; col++) {
+          __sync_fetch_and_and(&db_node_edges(db_graph, next_node.key, col),
+                               (Edges)~remove_edge_mask);
+        }
+        (void)bitset_set_mt(fc->lost_edges, next_node.key);
+      }
+    }
+  }
+}
+
+static void frontier_prune_nodes(void *arg, size_t threadid)
+{
+  FrontierCleaner *fc = (FrontierCleaner*)arg;
+  dBNodeBuffer *rmvbuf = &fc->rmvbufs[threadid];
+  size_t i;
+
+  for(i = 0; i < rmvbuf->len; i++) {
+    prune_node_without_edges_mt(fc->db_graph, rmvbuf->b[i].key);
+    (void)bitset_del_mt(fc->rmvbits, rmvbuf->b[i].key);
+  }
+  db_node_buf_reset(rmvbuf);
+}
+
+/**
+ * Clean graph with clean_graph(), then keep re-checking unitigs next to removed
+ * kmers. Each round only visits unitigs that lost an edge in the last round.
+ *
+ * @param max_rounds Maximum number of extra rounds, 0 => until no change
+ * @return number of extra rounds run
+ */
+size_t clean_graph_iterate(size_t num_threads,
+                           size_t covg_threshold, size_t min_keep_tip,
+                           size_t max_rounds,
+                           const char *covgs_csv_path, const char *lens_csv_path,
+                           uint8_t *visited, uint8_t *keep, dBGraph *db_graph)
+{
+  ctx_assert(db_graph->num_of_cols == 1);
+
+  size_t i, round, nbytes = roundup_bits2bytes(db_graph->ht.capacity);
+  size_t init_nkmers = db_graph->ht.num_kmers;
+  uint8_t *lost_edges = ctx_calloc(nbytes, 1);
+
+  // First pass over the whole graph, histograms are written at the end
+  _clean_graph(num_threads, covg_threshold, min_keep_tip, NULL, NULL,
+               visited, keep, lost_edges, db_graph);
+
+  HKeyBuffer front;
+  hkey_buf_alloc(&front, 1024);
+
+  dBNodeBuffer *nbufs = ctx_calloc(num_threads, sizeof(dBNodeBuffer));
+  dBNodeBuffer *rmvbufs = ctx_calloc(num_threads, sizeof(dBNodeBuffer));
+  CovgBuffer *cbufs = ctx_calloc(num_threads, sizeof(CovgBuffer));
+
+  for(i = 0; i < num_threads; i++) {
+    db_node_buf_alloc(&nbufs[i], 1024);
+    db_node_buf_alloc(&rmvbufs[i], 1024);
+    covg_buf_alloc(&cbufs[i], 1024);
+  }
+
+  char front_str[50], tips_str[50], tip_kmers_str[50];
+  char snodes_str[50], snode_kmers_str[50];
+
+  for(round = 1; max_rounds == 0 || round <= max_rounds; round++)
+  {
+    frontier_fetch(lost_edges, db_graph->ht.capacity, &front);
+    if(front.len == 0) { round--; break; }
+
+    FrontierCleaner fc = {.nthreads = num_threads,
+                          .covg_threshold = covg_threshold,
+                          .min_keep_tip = min_keep_tip,
+                          .front = &front,
+                          .visited = visited, .rmvbits = keep,
+                          .lost_edges = lost_edges,
+                          .nbufs = nbufs, .rmvbufs = rmvbufs, .cbufs = cbufs,
+                          .num_tips = 0, .num_low_covg_snodes = 0,
+                          .num_tip_kmers = 0, .num_low_covg_snode_kmers = 0,
+                          .db_graph = db_graph};
+
+    util_multi_thread(&fc, num_threads, frontier_mark);
+    util_multi_thread(&fc, num_threads, frontier_prune_edges);
+    util_multi_thread(&fc, num_threads, frontier_prune_nodes);
+
+    memset(visited, 0, nbytes);
+
+    ulong_to_str(front.len, front_str);
+    ulong_to_str(fc.num_tips, tips_str);
+    ulong_to_str(fc.num_tip_kmers, tip_kmers_str);
+    ulong_to_str(fc.num_low_covg_snodes, snodes_str);
+    ulong_to_str(fc.num_low_covg_snode_kmers, snode_kmers_str);
+    status("[cleaning] Round %zu: %s frontier kmers; removed %s tips [%s kmer%s] "
+           "and %s low coverage unitigs [%s kmer%s]", round, front_str,
+           tips_str, tip_kmers_str, util_plural_str(fc.num_tip_kmers),
+           snodes_str, snode_kmers_str,
+           util_plural_str(fc.num_low_covg_snode_kmers));
+  }
+
+  if(max_rounds && round > max_rounds) {
+    round = max_rounds;
+    status("[cleaning] Stopped after %zu rounds", max_rounds);
+  }
+
+  for(i = 0; i < num_threads; i++) {
+    db_node_buf_dealloc(&nbufs[i]);
+    db_node_buf_dealloc(&rmvbufs[i]);
+    covg_buf_dealloc(&cbufs[i]);
+  }
+  ctx_free(nbufs);
+  ctx_free(rmvbufs);
+  ctx_free(cbufs);
+  hkey_buf_dealloc(&front);
+  ctx_free(lost_edges);
+
+  char remain_nkmers_str[100], removed_nkmers_str[100];
+  size_t remain_nkmers = db_graph->ht.num_kmers;
+  size_t removed_nkmers = init_nkmers - remain_nkmers;
+  ulong_to_str(remain_nkmers, remain_nkmers_str);
+  ulong_to_str(removed_nkmers, removed_nkmers_str);
+  status("[cleaning] After %zu extra round%s remaining kmers: %s removed: %s (%.1f%%)",
+         round, util_plural_str(round), remain_nkmers_str, removed_nkmers_str,
+         safe_percent(removed_nkmers, init_nkmers));
+
+  // Histograms of the final graph
+  if(covgs_csv_path != NULL || lens_csv_path != NULL)
+  {
+    UnitigCleaner cl;
+    unitig_cleaner_alloc(&cl, num_threads, 0, 0, NULL, db_graph);
+    supernodes_iterate(num_threads, visited, db_graph, unitig_get_covg, &cl);
+    memset(visited, 0, nbytes);
+
+    if(covgs_csv_path != NULL) {
+      cleaning_write_covg_histogram(covgs_csv_path,
+                                    cl.kmer_covgs_init,
+                                    cl.unitig_covgs_init,
+                                    cl.covg_arrsize);
+    }
+
+    if(lens_csv_path != NULL) {
+      cleaning_write_len_histogram(lens_csv_path,
+                                   cl.len_hist_init,
+                                   cl.len_arrsize,
+                                   db_graph->kmer_size);
+    }
+
+    unitig_cleaner_dealloc(&cl);
+  }
+
+  return round;
+}
+
 static FILE* _open_histogram_file(const char *path, const char *name)
 {
   FILE *fout;
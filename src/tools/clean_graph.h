@@ -2,6 +2,7 @@
 #define CLEAN_GRAPH_H_
 
 #include "db_graph.h"
+#include "graph_file_reader.h"
 
 /**
  * Pick a cleaning threshold from kmer coverage histogram. Assumes low coverage
@@ -38,6 +39,23 @@ int cleaning_get_threshold(size_t num_threads,
                            uint8_t *visited,
                            const dBGraph *db_graph);
 
+/**
+ * Estimate unitig cleaning threshold for each colour by streaming kmers from
+ * graph files in parallel, without loading a graph. A kmer found in more than
+ * one file is counted once per file rather than having its coverages summed,
+ * so estimates are exact if each colour is loaded from a single file.
+ *
+ * @param flatten    If true, estimate a single threshold for all colours pooled
+ * @param ncols      Number of colours loaded (1 if flatten)
+ * @param thresholds Returns the threshold for each colour, -1 if none found
+ * @return number of colours for which a threshold was found
+ */
+size_t cleaning_estimate_thresholds(size_t num_threads,
+                                    const GraphFileReader *gfiles,
+                                    size_t num_gfiles,
+                                    bool flatten, size_t ncols,
+                                    int *thresholds);
+
 /**
  * Remove low coverage unitigs and clip tips
  * - Remove unitigs with mean coverage < `covg_threshold`
@@ -53,6 +71,19 @@ void clean_graph(size_t num_threads,
                  const char *covgs_csv_path, const char *lens_csv_path,
                  uint8_t *visited, uint8_t *keep, dBGraph *db_graph);
 
+/**
+ * As clean_graph(), then repeatedly re-check unitigs next to removed kmers,
+ * since removing a tip can expose a new one. Each round only visits the
+ * frontier of kmers that lost an edge in the previous round.
+ * @param max_rounds Maximum number of extra rounds, 0 => until no change
+ * @return number of extra rounds run
+ */
+size_t clean_graph_iterate(size_t num_threads,
+                           size_t covg_threshold, size_t min_keep_tip,
+                           size_t max_rounds,
+                           const char *covgs_csv_path, const char *lens_csv_path,
+                           uint8_t *visited, uint8_t *keep, dBGraph *db_graph);
+
 void cleaning_write_covg_histogram(const char *path,
                                    const uint64_t *covg_hist,
                                    const uint64_t *kmer_hist,
@@ -14,6 +14,7 @@
 #include "seq_reader.h"
 #include "binary_seq.h"
 #include "gpath_checks.h"
+#include "gpath_stage.h"
 
 //
 // Multithreaded code to add paths to the graph from sequence data
@@ -41,6 +42,9 @@ struct GenPathWorker
 
   CorrectAlnWorker corrector;
 
+  // New paths are collected here before being added to the graph
+  GPathStage stage;
+
   // Nucleotides and positions of junctions
   // only one array allocated for each type, rev points to half way through
   uint8_t *pck_fw, *pck_rv;
@@ -53,7 +57,8 @@ struct GenPathWorker
 volatile size_t print_contig_id = 0, print_path_id = 0;
 
 
-size_t gen_paths_worker_est_mem(const dBGraph *db_graph)
+size_t gen_paths_worker_est_mem(size_t stage_capacity,
+                                const dBGraph *db_graph)
 {
   size_t job_mem, corrector_mem, junc_mem, packed_mem;
   job_mem = 1024*4; // Assume 1024 bytes per read, 2 reads, seq+qual
@@ -61,17 +66,20 @@ size_t gen_paths_worker_est_mem(const dBGraph *db_graph)
   junc_mem = 2 * INIT_BUFLEN * (sizeof(Nucleotide)+sizeof(size_t));
   packed_mem = INIT_BUFLEN;
 
-  return job_mem + corrector_mem + junc_mem + packed_mem + sizeof(GenPathWorker);
+  return job_mem + corrector_mem + junc_mem + packed_mem +
+         gpath_stage_mem(stage_capacity) + sizeof(GenPathWorker);
 }
 
 // GenPathWorker stores four buffers of size n
 #define gworker_seq_buf(n) (binary_seq_mem(n)*4)
 
-static void _gen_paths_worker_alloc(GenPathWorker *wrkr, dBGraph *db_graph)
+static void _gen_paths_worker_alloc(GenPathWorker *wrkr, size_t stage_capacity,
+                                    dBGraph *db_graph)
 {
   GenPathWorker tmp = {.db_graph = db_graph};
 
   correct_aln_worker_alloc(&tmp.corrector, true, db_graph);
+  gpath_stage_alloc(&tmp.stage, &db_graph->gphash, stage_capacity);
 
   // Junction data
   // only fw arrays are malloc'd, rv point to fw
@@ -89,17 +97,19 @@ static void _gen_paths_worker_alloc(GenPathWorker *wrkr, dBGraph *db_graph)
 static void _gen_paths_worker_dealloc(GenPathWorker *wrkr)
 {
   correct_aln_worker_dealloc(&wrkr->corrector);
+  gpath_stage_dealloc(&wrkr->stage);
   ctx_free(wrkr->pck_fw);
   ctx_free(wrkr->pos_fw);
 }
 
 
-GenPathWorker* gen_paths_workers_alloc(size_t n, dBGraph *graph)
+GenPathWorker* gen_paths_workers_alloc(size_t n, size_t stage_capacity,
+                                       dBGraph *graph)
 {
   size_t i;
   GenPathWorker *workers = ctx_malloc(n * sizeof(GenPathWorker));
   for(i = 0; i < n; i++)
-    _gen_paths_worker_alloc(&workers[i], graph);
+    _gen_paths_worker_alloc(&workers[i], stage_capacity, graph);
   return workers;
 }
 
@@ -110,6 +120,13 @@ void gen_paths_workers_dealloc(GenPathWorker *workers, size_t n)
   ctx_free(workers);
 }
 
+void gen_paths_workers_set_gate(GenPathWorker *workers, size_t n,
+                                GPathStageGate *gate)
+{
+  size_t i;
+  for(i = 0; i < n; i++) gpath_stage_set_gate(&workers[i].stage, gate);
+}
+
 static inline void worker_nuc_cap(GenPathWorker *wrkr, size_t req_cap)
 {
   size_t old_cap = wrkr->junc_arrsize, old_pck_mem, new_pck_mem;
@@ -160,7 +177,6 @@ static inline size_t _juncs_to_paths(const size_t *restrict pos_pl,
 {
   dBGraph *db_graph = wrkr->db_graph;
   const size_t ctpcol = wrkr->task.crt_params.ctpcol;
-  GPathSet *gpset = &db_graph->gphash.gpstore->gpset;
 
   size_t i, num_added = 0;
   dBNode node;
@@ -244,7 +260,6 @@ static inline size_t _juncs_to_paths(const size_t *restrict pos_pl,
     uint8_t top_byte = packed_ptr[top_idx];
     packed_ptr[top_idx] &= 0xff >> (8 - bits_in_top_byte(plen));
 
-    bool found = false;
     GPathNew newgpath = {.seq = packed_ptr,
                          .orient = node.orient, .num_juncs = plen,
                          .colset = NULL, .nseen = NULL};
@@ -260,20 +275,11 @@ static inline size_t _juncs_to_paths(const size_t *restrict pos_pl,
     //          kmerstr, node.orient, start_pl, start_mn, pos_mn[start_mn]);
     // #endif
 
-    GPath *gpath = gpath_hash_find_or_insert_mt(&db_graph->gphash, node.key,
-                                                newgpath, &found);
-
-    // Add colour
-    bitset_set(gpath_get_colset(gpath, gpset->ncols), ctpcol);
-    uint8_t *nseen = gpath_set_get_nseen(gpset, gpath);
-    if(nseen != NULL) safe_add_uint8_mt(&nseen[ctpcol], 1);
+    // Merged with other sightings, added to the graph when the stage is flushed
+    gpath_stage_add(&wrkr->stage, node.key, newgpath, ctpcol);
 
     packed_ptr[top_idx] = top_byte; // restore top byte
 
-    #ifdef CTXVERBOSE
-      printf("We %s\n", found ? "abandoned" : "added");
-    #endif
-
     // If the path already exists, all of its subpaths also already exist
     // if(found && plen < GPATH_MAX_JUNCS) break;
     num_added++;
@@ -465,6 +471,7 @@ void gen_paths_worker_seq(GenPathWorker *wrkr, AsyncIOData *data,
   memcpy(&wrkr->task, task, sizeof(CorrectAlnInput));
 
   reads_to_paths(wrkr);
+  gpath_stage_flush(&wrkr->stage);
 }
 
 // Function used in tests
@@ -496,6 +503,12 @@ void gen_paths_from_str_mt(GenPathWorker *gen_path_wrkr, char *seq,
   gen_paths_worker_seq(gen_path_wrkr, &iodata, &task);
 }
 
+static void _gen_paths_flush_stage(void *arg, size_t threadid)
+{
+  (void)threadid;
+  gpath_stage_flush(&((GenPathWorker*)arg)->stage);
+}
+
 void generate_paths(CorrectAlnInput *tasks, size_t num_inputs,
                     GenPathWorker *workers, size_t num_workers)
 {
@@ -512,6 +525,10 @@ void generate_paths(CorrectAlnInput *tasks, size_t num_inputs,
 
   ctx_free(asyncio_tasks);
 
+  // Add paths still held by each worker
+  util_run_threads(workers, num_workers, sizeof(GenPathWorker),
+                   num_workers, _gen_paths_flush_stage);
+
   // Merge stats into workers[0]
   for(i = 1; i < num_workers; i++)
     correct_aln_merge_stats(&workers[0].corrector, &workers[i].corrector);
@@ -7,16 +7,25 @@
 #include "db_graph.h"
 #include "seq_loading_stats.h"
 #include "correct_aln_input.h"
+#include "gpath_stage.h"
 
 typedef struct GenPathWorker GenPathWorker;
 
-// Estimate memory required per worker thread
-size_t gen_paths_worker_est_mem(const dBGraph *db_graph);
+// Estimate memory required per worker thread, using a GPathStage with
+// `stage_capacity` entries (see gpath_stage_fit())
+size_t gen_paths_worker_est_mem(size_t stage_capacity,
+                                const dBGraph *db_graph);
 
-GenPathWorker* gen_paths_workers_alloc(size_t n, dBGraph *graph);
+// `stage_capacity` is the size of each worker's GPathStage, see gpath_stage.h
+GenPathWorker* gen_paths_workers_alloc(size_t n, size_t stage_capacity,
+                                       dBGraph *graph);
 
 void gen_paths_workers_dealloc(GenPathWorker *mem, size_t n);
 
+// Limit how full workers fill the GPathHash, see gpath_stage.h
+void gen_paths_workers_set_gate(GenPathWorker *workers, size_t n,
+                                GPathStageGate *gate);
+
 // Add a single contig using a given worker
 void gen_paths_worker_seq(GenPathWorker *wrkr, AsyncIOData *data,
                           const CorrectAlnInput *task);
@@ -146,6 +146,31 @@ static void store_node_neighbours(const hkey_t hkey, dBNodeBuffer *nbuf,
 }
 
 
+// Frontier nodes are visited in hash table order, so each one is a cache miss.
+// Two stage pipeline: fetch the kmer and edges of the node two steps ahead,
+// then the buckets of the neighbours of the node one step ahead (whose kmer
+// and edges should have arrived by now).
+#define SUBGRAPH_PREFETCH 8
+
+static inline void prefetch_frontier(const dBNodeBuffer *nbuf, size_t i,
+                                     const dBGraph *db_graph)
+{
+  hkey_t hkey;
+  BinaryKmer bkmer;
+  Edges edges;
+
+  if(i + 2*SUBGRAPH_PREFETCH < nbuf->len)
+    db_graph_prefetch_node(db_graph, nbuf->b[i + 2*SUBGRAPH_PREFETCH].key);
+
+  if(i + SUBGRAPH_PREFETCH < nbuf->len) {
+    hkey = nbuf->b[i + SUBGRAPH_PREFETCH].key;
+    bkmer = db_node_get_bkmer(db_graph, hkey);
+    edges = db_node_get_edges_union(db_graph, hkey);
+    db_graph_prefetch_next(db_graph, bkmer, FORWARD, edges);
+    db_graph_prefetch_next(db_graph, bkmer, REVERSE, edges);
+  }
+}
+
 static void extend(SubgraphBuilder *builder, size_t dist)
 {
   const dBGraph *db_graph = builder->db_graph;
@@ -162,6 +187,7 @@ static void extend(SubgraphBuilder *builder, size_t dist)
     for(d = 0; d < dist; d++) {
       db_node_buf_reset(nbuf1);
       for(i = 0; i < nbuf0->len; i++) {
+        prefetch_frontier(nbuf0, i, db_graph);
         store_node_neighbours(nbuf0->b[i].key, nbuf1, kmer_mask, db_graph);
       }
       SWAP(nbuf0, nbuf1);